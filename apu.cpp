@@ -1,10 +1,44 @@
 #include "apu.hpp"
 #include "cpu_apu_io.hpp"
+#include "state.hpp"
 
-SNES_APU::SNES_APU(CPU_APU_IO* cpu_io) : cpu_io(cpu_io) {
+#include <algorithm>
+
+SNES_APU::SNES_APU(CPU_APU_IO* cpu_io) : cpu_io(cpu_io), cpu(cpu_io, &dsp) {
     
 }
 
 bool SNES_APU::clock() {
-    return cpu.clock();
-}
\ No newline at end of file
+    bool running = cpu.clock();
+
+    // the apu has its own 1.024 MHz clock, converted exactly rather than
+    // accumulating the ~20.97 master cycles per spc700 cycle
+    cycles++;
+    time = cycles * MASTER_CLOCK_HZ / APU_CLOCK_HZ;
+    return running;
+}
+
+bool SNES_APU::runUntil(uint64_t target) {
+    while(time < target) {
+        byte spc_cycles = cpu.step();
+        if(spc_cycles == 0) {
+            // stopped, time just passes
+            cycles = std::max(cycles, (target * APU_CLOCK_HZ + MASTER_CLOCK_HZ - 1) / MASTER_CLOCK_HZ);
+            time = cycles * MASTER_CLOCK_HZ / APU_CLOCK_HZ;
+            break;
+        }
+        cycles += spc_cycles;
+        time = cycles * MASTER_CLOCK_HZ / APU_CLOCK_HZ;
+    }
+    cpu_io->updateAPU();
+    return !cpu.isStopped();
+}
+
+void SNES_APU::serialize(SNES_STATE& state) {
+    if(!state.begin(STATE_TAG('A', 'P', 'U', ' '), 1)) return;
+    state.value(time);
+    state.value(cycles);
+    state.end();
+
+    cpu.serialize(state);
+}
@@ -6,15 +6,29 @@
 #include "spc700.hpp"
 #include "dsp.hpp"
 #include "cpu_apu_io.hpp"
+#include "scheduler.hpp"
 
-class SNES_APU {
+class SNES_APU : public SNES_CLOCKED {
 public:
     SNES_APU(CPU_APU_IO* cpu_io);
     bool clock();
+    // catches the spc700 up to a master clock timestamp, possibly on its own thread
+    bool runUntil(uint64_t target) override;
+
+    uint64_t getCycles() {return cycles;};
+    SNES_DSP* getDSP() {return &dsp;};
+    // traces the spc700's instructions, see SPC700::tracer
+    void setTracer(SNES_TRACER* tracer) {cpu.tracer = tracer;};
+
+    void serialize(SNES_STATE& state);
 private:
     CPU_APU_IO* cpu_io;
-    SPC700 cpu;
+    // before cpu, its bus hands the dsp the audio RAM
     SNES_DSP dsp;
+    SPC700 cpu;
+
+    // spc700 cycles run so far, time is derived from this
+    uint64_t cycles = 0;
 };
 
-#endif //_APU_H
\ No newline at end of file
+#endif //_APU_H
@@ -1,5 +1,129 @@
 #include "aram.hpp"
+#include "state.hpp"
 
-SNES_ARAM::SNES_ARAM() {
-    
-}
\ No newline at end of file
+// boot ROM: waits for the $BBAA handshake, then copies data blocks sent
+// through the ports into RAM and jumps to the uploaded program
+static const byte ipl_rom[64] = {
+    0xCD, 0xEF, 0xBD, 0xE8, 0x00, 0xC6, 0x1D, 0xD0, 0xFC, 0x8F, 0xAA, 0xF4, 0x8F, 0xBB, 0xF5, 0x78,
+    0xCC, 0xF4, 0xD0, 0xFB, 0x2F, 0x19, 0xEB, 0xF4, 0xD0, 0xFC, 0x7E, 0xF4, 0xD0, 0x0B, 0xE4, 0xF5,
+    0xCB, 0xF4, 0xD7, 0x00, 0xFC, 0xD0, 0xF3, 0xAB, 0x01, 0x10, 0xEF, 0x7E, 0xF4, 0x10, 0xEB, 0xBA,
+    0xF6, 0xDA, 0x00, 0xBA, 0xF4, 0xC4, 0xF4, 0xDD, 0x5D, 0xD0, 0xDB, 0x1F, 0x00, 0x00, 0xC0, 0xFF
+};
+
+SNES_ARAM::SNES_ARAM(CPU_APU_IO* cpu_io, SNES_DSP* dsp) : cpu_io(cpu_io), dsp(dsp) {
+    dsp->setRAM(data.data());
+    reset();
+}
+
+void SNES_ARAM::reset() {
+    data.fill(0);
+    ipl_enabled = true;
+    dsp_addr = 0;
+    dsp_phase = 0;
+
+    for(int i = 0; i < 3; i++) {
+        timers[i] = {false, (twobyte)(i == 2 ? 16 : 128), 0, 0, 0, 0};
+    }
+}
+
+void SNES_ARAM::serialize(SNES_STATE& state) {
+    if(!state.begin(STATE_TAG('A', 'R', 'A', 'M'), 1)) return;
+    state.value(data);
+    state.value(ipl_enabled);
+    state.value(dsp_addr);
+    state.value(dsp_phase);
+    for(timer& t : timers) {
+        state.value(t.enabled);
+        state.value(t.period);
+        state.value(t.phase);
+        state.value(t.target);
+        state.value(t.stage);
+        state.value(t.counter);
+    }
+    state.end();
+
+    dsp->serialize(state);
+}
+
+void SNES_ARAM::tick(byte cycles) {
+    // no instruction is longer than a sample
+    dsp_phase += cycles;
+    if(dsp_phase >= DSP_CYCLES_PER_SAMPLE) {
+        dsp_phase -= DSP_CYCLES_PER_SAMPLE;
+        dsp->sample();
+    }
+
+    for(timer& t : timers) {
+        if(!t.enabled) continue;
+
+        t.phase += cycles;
+        while(t.phase >= t.period) {
+            t.phase -= t.period;
+            if(++t.stage == t.target) {
+                t.stage = 0;
+                t.counter = (t.counter + 1) & 0x0F;
+            }
+        }
+    }
+}
+
+byte SNES_ARAM::readIO(twobyte addr) {
+    if(addr >= 0xFFC0) return ipl_rom[addr - 0xFFC0];
+
+    switch(addr) {
+        case 0xF2:
+            return dsp_addr;
+        case 0xF3:
+            return dsp->read(dsp_addr);
+        case 0xF4: case 0xF5: case 0xF6: case 0xF7:
+            return cpu_io->readAPU(addr - 0xF4);
+        case 0xFD: case 0xFE: case 0xFF: {
+            timer& t = timers[addr - 0xFD];
+            byte value = t.counter;
+            t.counter = 0;
+            return value;
+        }
+        case 0xF0: case 0xF1: case 0xFA: case 0xFB: case 0xFC:
+            // write-only
+            return 0x00;
+        default:
+            return data[addr];
+    }
+}
+
+void SNES_ARAM::writeIO(twobyte addr, byte entry) {
+    switch(addr) {
+        case 0xF1:
+            for(int i = 0; i < 3; i++) {
+                bool enable = entry & (1 << i);
+                // starting a timer resets it
+                if(enable && !timers[i].enabled) {
+                    timers[i].stage = 0;
+                    timers[i].counter = 0;
+                }
+                timers[i].enabled = enable;
+            }
+            if(entry & 0x10) {
+                cpu_io->clearAPU(0);
+                cpu_io->clearAPU(1);
+            }
+            if(entry & 0x20) {
+                cpu_io->clearAPU(2);
+                cpu_io->clearAPU(3);
+            }
+            ipl_enabled = entry & 0x80;
+            break;
+        case 0xF2:
+            dsp_addr = entry;
+            break;
+        case 0xF3:
+            dsp->write(dsp_addr, entry);
+            break;
+        case 0xF4: case 0xF5: case 0xF6: case 0xF7:
+            cpu_io->writeAPU(addr - 0xF4, entry);
+            break;
+        case 0xFA: case 0xFB: case 0xFC:
+            timers[addr - 0xFA].target = entry;
+            break;
+    }
+}
@@ -2,14 +2,65 @@
 #define _ARAM_H
 
 #include "common.h"
+#include "cpu_apu_io.hpp"
+#include "dsp.hpp"
 
 #include <array>
 
+class SNES_STATE;
+
+// the spc700's 64 KB address space: audio RAM, with the function registers
+// at $00F0-$00FF and the IPL boot ROM over $FFC0-$FFFF while it's enabled
 class SNES_ARAM {
 public:
-    SNES_ARAM();
+    SNES_ARAM(CPU_APU_IO* cpu_io, SNES_DSP* dsp);
+
+    void reset();
+
+    byte read8(twobyte addr);
+    void write8(twobyte addr, byte entry);
+
+    // advances the timers and the dsp, called with the cycles of every instruction
+    void tick(byte cycles);
+
+    void serialize(SNES_STATE& state);
 private:
+    byte readIO(twobyte addr);
+    void writeIO(twobyte addr, byte entry);
+
+    CPU_APU_IO* cpu_io;
+    SNES_DSP* dsp;
+
     std::array<byte, SNES_ARAM_SIZE> data;
+    bool ipl_enabled;
+    byte dsp_addr;
+    // cycles towards the next dsp sample
+    byte dsp_phase;
+
+    // T0 and T1 tick at 8 kHz (every 128 cycles), T2 at 64 kHz (every 16)
+    struct timer {
+        bool enabled;
+        twobyte period;
+        twobyte phase;
+        // 0 counts as 256
+        byte target;
+        byte stage;
+        // 4-bit, cleared on read
+        byte counter;
+    };
+    timer timers[3];
 };
 
-#endif //_ARAM_H
\ No newline at end of file
+inline byte SNES_ARAM::read8(twobyte addr) {
+    if((addr & 0xFFF0) == 0x00F0) return readIO(addr);
+    if(addr >= 0xFFC0 && ipl_enabled) return readIO(addr);
+    return data[addr];
+}
+
+inline void SNES_ARAM::write8(twobyte addr, byte entry) {
+    // writes always reach RAM, even under the registers and the IPL ROM
+    data[addr] = entry;
+    if((addr & 0xFFF0) == 0x00F0) writeIO(addr, entry);
+}
+
+#endif //_ARAM_H
@@ -0,0 +1,161 @@
+#include "common.h"
+
+#include "batch.hpp"
+#include "snes.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+// FNV-1a
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ULL) {
+	const byte* p = (const byte*)data;
+	for(size_t i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+static std::string jsonString(const std::string& text) {
+	std::string out = "\"";
+	for(char c : text) {
+		switch(c) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if((byte)c < 0x20) {
+					char escaped[8];
+					snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					out += escaped;
+				} else {
+					out += c;
+				}
+		}
+	}
+	return out + "\"";
+}
+
+static std::string hex64(uint64_t value) {
+	char text[20];
+	snprintf(text, sizeof(text), "\"%016llx\"", (unsigned long long)value);
+	return text;
+}
+
+bool SNES_BATCH::load(std::istream& manifest, std::ostream& errors) {
+	std::string line;
+	for(size_t number = 1; std::getline(manifest, line); number++) {
+		line = line.substr(0, line.find('#'));
+		std::istringstream fields(line);
+
+		SNES_BATCH_JOB job = {"", 60, 0};
+		if(!(fields >> job.rom)) continue;
+
+		std::string option;
+		while(fields >> option) {
+			if(option.compare(0, 7, "frames=") == 0) {
+				job.frames = strtoull(option.c_str() + 7, NULL, 10);
+				job.master_cycles = 0;
+			} else if(option.compare(0, 7, "cycles=") == 0) {
+				job.master_cycles = strtoull(option.c_str() + 7, NULL, 10);
+				job.frames = 0;
+			} else {
+				errors << "batch: line " << number << ": unknown option " << option << std::endl;
+				return false;
+			}
+		}
+		if(!job.master_cycles) job.master_cycles = job.frames * PPU_CYCLES_PER_LINE * PPU_LINES_PER_FRAME;
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+void SNES_BATCH::run(int threads, bool jit, std::ostream& out) {
+	if(threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	if((size_t)threads > jobs.size()) threads = std::max((size_t)1, jobs.size());
+
+	queues = std::vector<QUEUE>(threads);
+	for(size_t i = 0; i < jobs.size(); i++)
+		queues[i % threads].jobs.push_back(i);
+
+	std::vector<std::thread> pool;
+	for(int i = 1; i < threads; i++)
+		pool.emplace_back(&SNES_BATCH::worker, this, i, jit, &out);
+	worker(0, jit, &out);
+	for(std::thread& thread : pool)
+		thread.join();
+}
+
+bool SNES_BATCH::next(size_t thread, size_t& job) {
+	{
+		QUEUE& own = queues[thread];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if(!own.jobs.empty()) {
+			job = own.jobs.back();
+			own.jobs.pop_back();
+			return true;
+		}
+	}
+	// no job ever adds more, so one empty pass means everything is taken
+	for(size_t i = 1; i < queues.size(); i++) {
+		QUEUE& victim = queues[(thread + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if(!victim.jobs.empty()) {
+			job = victim.jobs.front();
+			victim.jobs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void SNES_BATCH::worker(size_t thread, bool jit, std::ostream* out) {
+	size_t job;
+	while(next(thread, job)) {
+		std::string result = runJob(job, jit);
+		std::lock_guard<std::mutex> guard(out_lock);
+		*out << result << std::endl;
+	}
+}
+
+std::string SNES_BATCH::runJob(size_t index, bool jit) {
+	const SNES_BATCH_JOB& job = jobs[index];
+	std::ostringstream log;
+
+	// too big for a thread's stack
+	std::unique_ptr<SNES> snes(new SNES());
+	snes->setLog(&log);
+	if(jit) snes->setJIT(true);
+
+	std::ostringstream json;
+	json << "{\"index\":" << index << ",\"rom\":" << jsonString(job.rom);
+
+	auto start = std::chrono::steady_clock::now();
+	bool loaded = snes->loadROM(job.rom);
+	bool running = loaded && snes->run(job.master_cycles);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	json << ",\"loaded\":" << (loaded ? "true" : "false");
+	if(loaded) {
+		std::vector<byte> state(snes->stateSize());
+		snes->saveState(state.data(), state.size());
+		uint64_t frames = snes->getFrame();
+
+		json << ",\"halted\":" << (running ? "false" : "true")
+		<< ",\"master_cycles\":" << snes->getTime()
+		<< ",\"frames\":" << frames
+		<< ",\"instructions\":" << snes->getInstructions()
+		<< ",\"skipped_cycles\":" << snes->getSkippedCycles()
+		<< ",\"state_hash\":" << hex64(hashBytes(state.data(), state.size()))
+		<< ",\"framebuffer_hash\":" << hex64(hashBytes(snes->getFramebuffer(), PPU_WIDTH * snes->getHeight() * sizeof(uint32_t)))
+		<< ",\"seconds\":" << seconds
+		<< ",\"fps\":" << (seconds > 0 ? frames / seconds : 0);
+	}
+	json << ",\"log\":" << jsonString(log.str()) << "}";
+	return json.str();
+}
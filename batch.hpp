@@ -0,0 +1,56 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include "common.h"
+
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// one ROM of a batch and how long to run it
+struct SNES_BATCH_JOB {
+	std::string rom;
+	// from frames=n, or cycles=n master cycles
+	uint64_t frames;
+	uint64_t master_cycles;
+};
+
+// headless runs of many ROMs, one SNES instance per job, spread over a pool
+// of threads. the manifest has a line per job:
+//
+//	path/to/game.sfc frames=600
+//	path/to/test.sfc cycles=2000000
+//
+// (60 frames without a budget, # starts a comment). each finished job
+// prints one JSON object on its own line, in the order they finish, with
+// its index in the manifest, hashes of the final save state and picture,
+// and timing
+class SNES_BATCH {
+public:
+	// false after reporting a bad line on errors
+	bool load(std::istream& manifest, std::ostream& errors);
+	size_t size() {return jobs.size();};
+
+	// 0 threads uses every core
+	void run(int threads, bool jit, std::ostream& out);
+private:
+	std::vector<SNES_BATCH_JOB> jobs;
+
+	// jobs are dealt out to per-thread queues up front. a thread works
+	// from the back of its own and steals from the front of the others'
+	// when it runs out, so a few long ROMs don't hold up the rest
+	struct QUEUE {
+		std::mutex lock;
+		std::deque<size_t> jobs;
+	};
+	std::vector<QUEUE> queues;
+	bool next(size_t thread, size_t& job);
+	void worker(size_t thread, bool jit, std::ostream* out);
+	std::string runJob(size_t index, bool jit);
+
+	std::mutex out_lock;
+};
+
+#endif //_BATCH_H
@@ -0,0 +1,1839 @@
+#include "common.h"
+
+#include "cpu.hpp"
+#include "jit.hpp"
+#include "ram.hpp"
+#include "cpu_apu_io.hpp"
+#include "trace.hpp"
+#include "apu.hpp"
+#include "dsp.hpp"
+#include "ppu.hpp"
+#include "scheduler.hpp"
+#include "state.hpp"
+#include "profile.hpp"
+#include "snes.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// synthetic instruction mix, run from $80:8000 with the reset vector pointing at it
+static const byte alu_loop[] = {
+	0x18,			// CLC
+	0xA9, 0x01,		// LDA #$01
+	0x69, 0x02,		// ADC #$02
+	0x85, 0x10,		// STA $10
+	0x29, 0x7F,		// AND #$7F
+	0x09, 0x01,		// ORA #$01
+	0x49, 0xFF,		// EOR #$FF
+	0xA5, 0x10,		// LDA $10
+	0xAA,			// TAX
+	0xE8,			// INX
+	0xC8,			// INY
+	0x8A,			// TXA
+	0x0A,			// ASL A
+	0x4A,			// LSR A
+	0xEA,			// NOP
+	0x80, 0xE8		// BRA -24
+};
+
+// writes a loROM image (at least 32 KB) starting with the program to a temp file
+static std::string writeBenchROM(const byte* program, size_t size) {
+	std::vector<byte> rom(size < 0x8000 ? 0x8000 : size, 0xEA);
+	for(size_t i = 0; i < size; i++)
+		rom[i] = program[i];
+	rom[0x7FFC] = 0x00;
+	rom[0x7FFD] = 0x80;
+
+	char path[] = "/tmp/snes_bench_XXXXXX";
+	int fd = mkstemp(path);
+	if(fd < 0) {
+		std::cout << "bench: could not create temp ROM" << std::endl;
+		exit(1);
+	}
+	close(fd);
+
+	std::ofstream f(path, std::ios::binary);
+	f.write((const char*)rom.data(), rom.size());
+	return path;
+}
+
+//
+// repetition and results
+//
+
+// timed figures are measured --runs=n times (5 by default), each run doing
+// its share of the work, and reported as the median with the spread of the
+// runs. --json=file also writes every figure as a JSON line, for comparing
+// builds
+static int bench_runs = 5;
+static std::ofstream bench_json;
+
+struct bench_stats {
+	double median, min, max, stddev;
+};
+
+// one() does a run and returns the seconds it measured
+template<typename F>
+static bench_stats repeat(F one) {
+	std::vector<double> seconds;
+	for(int i = 0; i < bench_runs; i++)
+		seconds.push_back(one());
+	std::sort(seconds.begin(), seconds.end());
+
+	size_t n = seconds.size();
+	double mean = 0, squares = 0;
+	for(double s : seconds) mean += s / n;
+	for(double s : seconds) squares += (s - mean) * (s - mean);
+
+	bench_stats stats;
+	stats.median = n & 1 ? seconds[n / 2] : (seconds[n / 2 - 1] + seconds[n / 2]) / 2;
+	stats.min = seconds[0];
+	stats.max = seconds[n - 1];
+	stats.stddev = n > 1 ? sqrt(squares / (n - 1)) : 0;
+	return stats;
+}
+
+// a result of work units (instructions, frames...) per run, as time per unit
+// and units per second
+static void record(const std::string& name, const bench_stats& stats, double work, const std::string& unit) {
+	double per_unit = stats.median / work;
+	double rate = work / stats.median;
+
+	std::cout << name << ": " << std::fixed << std::setprecision(2);
+	if(per_unit < 1e-5) std::cout << per_unit * 1e9 << " ns/" << unit;
+	else std::cout << per_unit * 1e3 << " ms/" << unit;
+	if(rate >= 1e6) std::cout << ", " << rate / 1e6 << " M " << unit << "s/s";
+	else std::cout << ", " << std::setprecision(1) << rate << " " << unit << "s/s";
+	std::cout << " (+-" << std::setprecision(1) << stats.stddev / stats.median * 100 << "%, " << bench_runs << " runs)" << std::endl;
+
+	if(!bench_json.is_open()) return;
+	bench_json << std::setprecision(9) << std::defaultfloat
+	<< "{\"name\":\"" << name << "\",\"unit\":\"" << unit << "\",\"work\":" << work
+	<< ",\"runs\":" << bench_runs << ",\"seconds_median\":" << stats.median << ",\"seconds_min\":" << stats.min
+	<< ",\"seconds_max\":" << stats.max << ",\"seconds_stddev\":" << stats.stddev
+	<< ",\"ns_per_unit\":" << per_unit * 1e9 << ",\"per_second\":" << rate << "}" << std::endl;
+}
+
+// for the openROM messages of every run
+static std::ostream bench_quiet(nullptr);
+
+static void loadBenchROM(SNES_CPU& cpu, const std::string& path) {
+	cpu.mem->log = &bench_quiet;
+	if(!cpu.mem->openROM(path)) {
+		std::cout << "bench: could not load ROM" << std::endl;
+		exit(1);
+	}
+	cpu.init();
+}
+
+// one instruction at a time through step(), then in batches through
+// run(), which returns the cycles each batch took
+static void benchCPU(size_t instructions, SNES_TRACER* tracer = nullptr, const char* label = "cpu alu_loop step") {
+	std::string path = writeBenchROM(alu_loop, sizeof(alu_loop));
+	size_t per_run = instructions / bench_runs;
+
+	for(bool batched : {false, true}) {
+		// the traced runs only time stepping
+		if(batched && tracer) break;
+		uint64_t consumed = 0, elapsed = 0;
+		bench_stats stats = repeat([&]() {
+			CPU_APU_IO io;
+			SNES_CPU cpu(&io);
+			loadBenchROM(cpu, path);
+			cpu.tracer = tracer;
+			cpu.mem->tracer = tracer;
+
+			auto start = std::chrono::steady_clock::now();
+			if(batched) {
+				while(cpu.getInstructions() < per_run)
+					consumed += cpu.run(DEFAULT_SYNC_INTERVAL);
+				elapsed += cpu.time;
+			} else {
+				for(size_t executed = 0; executed < per_run; executed++)
+					cpu.step();
+			}
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		});
+		if(consumed != elapsed) {
+			std::cout << "cpu run: " << consumed << " cycles returned, " << elapsed << " passed, MISMATCH" << std::endl;
+			exit(1);
+		}
+		record(batched ? "cpu alu_loop run" : label, stats, per_run, "instruction");
+	}
+
+	unlink(path.c_str());
+}
+
+// patches the immediate of a LDA #$nn ; JML back routine in WRAM every
+// iteration and jumps to it, so cached blocks have to be dropped when their
+// code is written. (RTL doesn't restore K yet, hence the JML)
+static const byte smc_loop[] = {
+	0xA9, 0xA9,					// LDA #$A9
+	0x8F, 0x00, 0x20, 0x7E,		// STA $7E2000
+	0xA9, 0x5C,					// LDA #$5C
+	0x8F, 0x02, 0x20, 0x7E,		// STA $7E2002
+	0xA9, 0x2B,					// LDA #$2B
+	0x8F, 0x03, 0x20, 0x7E,		// STA $7E2003
+	0xA9, 0x80,					// LDA #$80
+	0x8F, 0x04, 0x20, 0x7E,		// STA $7E2004
+	0x8F, 0x05, 0x20, 0x7E,		// STA $7E2005		; routine returns to $80802B
+	0xA5, 0x10,					// LDA $10
+	0x18,						// CLC
+	0x69, 0x01,					// ADC #$01
+	0x85, 0x10,					// STA $10
+	0x8F, 0x01, 0x20, 0x7E,		// STA $7E2001		; patch the immediate
+	0x5C, 0x00, 0x20, 0x7E,		// JML $7E2000
+	0x18,						// CLC
+	0x65, 0x11,					// ADC $11
+	0x85, 0x11,					// STA $11
+	0x80, 0xEA					// BRA -22
+};
+
+// runUntil() with and without the block cache, which have to end up in the same state
+static void benchBlockCache(size_t instructions) {
+	struct PROGRAM {
+		const char* name;
+		const byte* code;
+		size_t size;
+	};
+	const PROGRAM programs[] = {{"alu_loop", alu_loop, sizeof(alu_loop)}, {"smc_loop", smc_loop, sizeof(smc_loop)}};
+
+	for(const PROGRAM& program : programs) {
+		std::string path = writeBenchROM(program.code, program.size);
+		uint32_t reference = 0;
+		double reference_seconds = 0;
+		for(bool cached : {false, true}) {
+			CPU_APU_IO io;
+			SNES_CPU cpu(&io);
+			if(!cpu.mem->openROM(path)) {
+				std::cout << "bench: could not load ROM" << std::endl;
+				exit(1);
+			}
+			cpu.init();
+			cpu.setBlockCache(cached);
+
+			uint64_t master_cycles = instructions * 2 * MASTER_CYCLES_PER_CPU_CYCLE;
+			auto start = std::chrono::steady_clock::now();
+			cpu.runUntil(master_cycles);
+			auto end = std::chrono::steady_clock::now();
+
+			uint32_t state = cpu.time ^ (cpu.debugAccum() << 8);
+			state = state * 31 + cpu.mem->read8(0x7E, 0x0010);
+			state = state * 31 + cpu.mem->read8(0x7E, 0x0011);
+
+			double seconds = std::chrono::duration<double>(end - start).count();
+			if(!cached) {
+				reference = state;
+				reference_seconds = seconds;
+			}
+			std::cout << "cpu " << program.name << (cached ? " block cache: " : " decoding:    ")
+			<< std::fixed << std::setprecision(3) << seconds << "s";
+			if(cached) std::cout << " (" << std::setprecision(2) << reference_seconds / seconds << "x)";
+			std::cout << (state == reference ? "" : "  MISMATCH") << std::endl;
+			if(state != reference) exit(1);
+		}
+		unlink(path.c_str());
+	}
+}
+
+// copies a routine to $7E3000 once, then only calls it. its cached code stays
+// valid until something else writes the page
+static const byte wram_loop[] = {
+	0xA9, 0x18,					// LDA #$18			; CLC
+	0x8F, 0x00, 0x30, 0x7E,		// STA $7E3000
+	0xA9, 0x69,					// LDA #$69			; ADC #$03
+	0x8F, 0x01, 0x30, 0x7E,		// STA $7E3001
+	0xA9, 0x03,					// LDA #$03
+	0x8F, 0x02, 0x30, 0x7E,		// STA $7E3002
+	0xA9, 0x5C,					// LDA #$5C			; JML $80802C
+	0x8F, 0x03, 0x30, 0x7E,		// STA $7E3003
+	0xA9, 0x2C,					// LDA #$2C
+	0x8F, 0x04, 0x30, 0x7E,		// STA $7E3004
+	0xA9, 0x80,					// LDA #$80
+	0x8F, 0x05, 0x30, 0x7E,		// STA $7E3005
+	0x8F, 0x06, 0x30, 0x7E,		// STA $7E3006
+	0x5C, 0x00, 0x30, 0x7E,		// JML $7E3000
+	0x85, 0x10,					// STA $10
+	0x80, 0xF8					// BRA -8
+};
+
+// rewinding and forking with copy-on-write memory snapshots. two machines
+// run wram_loop in step, one taking snapshots: they have to stay identical,
+// and restoring a snapshot has to act like writing its bytes back through
+// the bus, code cache and jit included
+static void benchSnapshot(size_t instructions) {
+	std::string path = writeBenchROM(wram_loop, sizeof(wram_loop));
+	CPU_APU_IO io;
+	SNES_CPU cpu(&io), reference(&io);
+	for(SNES_CPU* c : {&cpu, &reference}) {
+		if(!c->mem->openROM(path)) {
+			std::cout << "bench: could not load ROM" << std::endl;
+			exit(1);
+		}
+		c->init();
+		c->setJIT(true);
+	}
+	auto same = [&]() {
+		SNES_CPU_REGISTERS a = cpu.getRegisters(), b = reference.getRegisters();
+		if(cpu.time != reference.time || a.C != b.C || a.PC != b.PC || a.P != b.P) return false;
+		for(threebyte addr = 0x7E0000; addr < 0x800000; addr++)
+			if(cpu.mem->read8(addr) != reference.mem->read8(addr)) return false;
+		return true;
+	};
+
+	// a rewind buffer of the last second, a snapshot every frame
+	const uint64_t frame = PPU_CYCLES_PER_LINE * PPU_LINES_PER_FRAME;
+	const size_t frames = 600;
+	std::vector<SNES_MEMORY_SNAPSHOT> rewind;
+	double snapshot_seconds = 0;
+	for(size_t i = 0; i < frames; i++) {
+		cpu.runUntil(cpu.time + frame);
+		reference.runUntil(reference.time + frame);
+		auto start = std::chrono::steady_clock::now();
+		rewind.push_back(cpu.mem->snapshot());
+		snapshot_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if(rewind.size() > 60) rewind.erase(rewind.begin());
+	}
+	bool ok = same();
+
+	std::set<const byte*> held;
+	for(const SNES_MEMORY_SNAPSHOT& snapshot : rewind) {
+		for(size_t i = 0; i < snapshot.pageCount(); i++)
+			held.insert(snapshot.getPage(i));
+	}
+	size_t rewind_kb = held.size() * MEM_PAGE_SIZE / 1024;
+	size_t full_kb = rewind.size() * rewind[0].pageCount() * MEM_PAGE_SIZE / 1024;
+
+	// change the routine on both, then go back to the oldest snapshot on
+	// one while the other writes the same bytes itself
+	for(SNES_CPU* c : {&cpu, &reference}) {
+		c->mem->write8(0x7E, 0x3002, 0x05);
+		c->runUntil(c->time + frame);
+	}
+	const SNES_MEMORY_SNAPSHOT& oldest = rewind[0];
+	auto start = std::chrono::steady_clock::now();
+	cpu.mem->restore(oldest);
+	double restore_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	for(threebyte addr = 0x7E0000; addr < 0x800000; addr++)
+		reference.mem->write8(addr >> 16, addr & 0xFFFF, oldest.getPage((addr - 0x7E0000) >> MEM_PAGE_BITS)[addr & MEM_PAGE_MASK]);
+	uint64_t target = cpu.time + instructions * 2 * MASTER_CYCLES_PER_CPU_CYCLE;
+	cpu.runUntil(target);
+	reference.runUntil(target);
+	ok &= same();
+
+	// forks: children of one snapshot, each with a byte of its own
+	const size_t children = 4096;
+	SNES_MEMORY_SNAPSHOT base = cpu.mem->snapshot();
+	std::vector<SNES_MEMORY_SNAPSHOT> forks;
+	start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < children; i++) {
+		cpu.mem->restore(base);
+		cpu.mem->write8(0x7F, 0x8000 + i, 0xFF);
+		forks.push_back(cpu.mem->snapshot());
+	}
+	double fork_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / children;
+	held.clear();
+	for(const SNES_MEMORY_SNAPSHOT& snapshot : forks) {
+		for(size_t i = 0; i < snapshot.pageCount(); i++)
+			held.insert(snapshot.getPage(i));
+	}
+	size_t fork_kb = held.size() * MEM_PAGE_SIZE / 1024;
+	cpu.mem->restore(forks[children - 1]);
+	ok &= cpu.mem->read8(0x7F, 0x8000 + children - 1) == 0xFF && cpu.mem->read8(0x7F, 0x8000) == 0x00;
+
+	std::cout << "snapshot every frame: " << std::fixed << std::setprecision(2) << snapshot_seconds * 1e6 / frames
+	<< "us, last " << rewind.size() << " held in " << rewind_kb << " KB (" << full_kb << " KB copied whole), restore "
+	<< restore_us << "us" << std::endl;
+	std::cout << "snapshot " << children << " forks: " << fork_us << "us each, " << fork_kb << " KB"
+	<< (ok ? "" : "  MISMATCH") << std::endl;
+	unlink(path.c_str());
+	if(!ok) exit(1);
+}
+
+// native mode with 16-bit registers, mixing compiled instructions with ones
+// the jit leaves to the interpreter (BIT) and a register read ($4016)
+static const byte wide_loop[] = {
+	0x18,					// CLC
+	0xFB,					// XCE
+	0xC2, 0x30,				// REP #$30
+	0xA9, 0x34, 0x12,		// LDA #$1234
+	0xA2, 0x00, 0x00,		// LDX #$0000
+	0xA0, 0x10, 0x00,		// LDY #$0010
+	0x18,					// CLC
+	0x69, 0x11, 0x11,		// ADC #$1111
+	0x85, 0x20,				// STA $20
+	0x8D, 0x00, 0x30,		// STA $3000
+	0x4D, 0x00, 0x30,		// EOR $3000
+	0x0D, 0x22, 0x00,		// ORA $0022
+	0xE8,					// INX
+	0x88,					// DEY
+	0x38,					// SEC
+	0x69, 0x01, 0x00,		// ADC #$0001
+	0xE9, 0x03, 0x00,		// SBC #$0003
+	0x2D, 0x20, 0x00,		// AND $0020
+	0xC5, 0x20,				// CMP $20
+	0x24, 0x20,				// BIT $20
+	0x64, 0x24,				// STZ $24
+	0x8A,					// TXA
+	0x65, 0x24,				// ADC $24
+	0x85, 0x22,				// STA $22
+	0xCD, 0x16, 0x40,		// CMP $4016
+	0x0A,					// ASL A
+	0x4A,					// LSR A
+	0xC0, 0x00, 0x00,		// CPY #$0000
+	0xD0, 0xD0,				// BNE -48
+	0xA0, 0x10, 0x00,		// LDY #$0010
+	0x80, 0xCB				// BRA -53
+};
+
+// differential run of the interpreter against the jit: both run to the same
+// timestamps and have to agree on the registers, the instruction count and
+// WRAM every time
+static void benchJIT(size_t instructions) {
+	if(!SNES_JIT::supported()) {
+		std::cout << "cpu jit: not supported on this host" << std::endl;
+		return;
+	}
+
+	struct PROGRAM {
+		const char* name;
+		const byte* code;
+		size_t size;
+	};
+	const PROGRAM programs[] = {{"alu_loop", alu_loop, sizeof(alu_loop)}, {"smc_loop", smc_loop, sizeof(smc_loop)},
+		{"wide_loop", wide_loop, sizeof(wide_loop)}};
+	const uint64_t chunk = 1 << 16;
+
+	for(const PROGRAM& program : programs) {
+		std::string path = writeBenchROM(program.code, program.size);
+		CPU_APU_IO io[2];
+		SNES_CPU interp(&io[0]);
+		SNES_CPU jit(&io[1]);
+		SNES_CPU* cpus[2] = {&interp, &jit};
+		double seconds[2] = {0, 0};
+		for(SNES_CPU* cpu : cpus) {
+			if(!cpu->mem->openROM(path)) {
+				std::cout << "bench: could not load ROM" << std::endl;
+				exit(1);
+			}
+			cpu->init();
+		}
+		jit.setJIT(true);
+
+		uint64_t master_cycles = instructions * 2 * MASTER_CYCLES_PER_CPU_CYCLE;
+		for(uint64_t target = chunk; target <= master_cycles; target += chunk) {
+			for(int i = 0; i < 2; i++) {
+				auto start = std::chrono::steady_clock::now();
+				cpus[i]->runUntil(target);
+				auto end = std::chrono::steady_clock::now();
+				seconds[i] += std::chrono::duration<double>(end - start).count();
+			}
+
+			SNES_CPU_REGISTERS a = interp.getRegisters();
+			SNES_CPU_REGISTERS b = jit.getRegisters();
+			bool same = a.C == b.C && a.X == b.X && a.Y == b.Y && a.S == b.S && a.D == b.D && a.PC == b.PC
+				&& a.DBR == b.DBR && a.K == b.K && a.P == b.P && a.e == b.e
+				&& interp.time == jit.time && interp.getInstructions() == jit.getInstructions();
+			// WRAM only now and then, it's 128 KB
+			bool last = target + chunk > master_cycles;
+			for(threebyte addr = 0x7E0000; same && (last || (target & 0xFFFFF) == 0) && addr < 0x800000; addr++)
+				same = interp.mem->read8(addr) == jit.mem->read8(addr);
+			if(!same) {
+				std::cout << "cpu " << program.name << " jit: MISMATCH after " << interp.getInstructions()
+				<< " instructions" << std::hex
+				<< "\n  interp: PC=" << (int)a.K << ":" << a.PC << " C=" << a.C << " X=" << a.X << " Y=" << a.Y
+				<< " P=" << (int)a.P << std::dec << " time=" << interp.time << std::hex
+				<< "\n  jit:    PC=" << (int)b.K << ":" << b.PC << " C=" << b.C << " X=" << b.X << " Y=" << b.Y
+				<< " P=" << (int)b.P << std::dec << " time=" << jit.time << std::endl;
+				exit(1);
+			}
+		}
+
+		std::cout << "cpu " << program.name << " jit: " << std::fixed << std::setprecision(3) << seconds[1]
+		<< "s (" << std::setprecision(2) << seconds[0] / seconds[1] << "x the block cache), "
+		<< jit.getInstructions() << " instructions, state matches" << std::endl;
+		unlink(path.c_str());
+	}
+}
+
+// loads and stores over ROM, bank 0 low RAM and WRAM through its mirrors
+static const byte mem_loop[] = {
+	0xBD, 0x00, 0x80,			// LDA $8000,X		; ROM
+	0x9D, 0x00, 0x01,			// STA $0100,X		; low RAM in bank 0
+	0xBF, 0x00, 0x02, 0x7E,		// LDA $7E0200,X	; the same RAM in bank $7E
+	0x9F, 0x00, 0x00, 0x7F,		// STA $7F0000,X
+	0x18,						// CLC
+	0x65, 0x10,					// ADC $10
+	0x85, 0x10,					// STA $10
+	0xE8,						// INX
+	0xD0, 0xEA,					// BNE -22
+	0x80, 0xE8					// BRA -24
+};
+
+// short blocks ending in taken and untaken branches
+static const byte branch_loop[] = {
+	0xE8,			// INX
+	0x8A,			// TXA
+	0x29, 0x03,		// AND #$03
+	0xD0, 0x02,		// BNE +2
+	0xC8,			// INY
+	0xC8,			// INY
+	0xC9, 0x02,		// CMP #$02
+	0x30, 0x01,		// BMI +1
+	0xC8,			// INY
+	0x98,			// TYA
+	0x10, 0x02,		// BPL +2
+	0x88,			// DEY
+	0xEA,			// NOP
+	0x50, 0xEC		// BVC -20
+};
+
+// 64 KB block moves between the two WRAM banks, counting round trips at $7E8000
+static const byte move_loop[] = {
+	0x18,						// CLC
+	0xFB,						// XCE
+	0xC2, 0x30,					// REP #$30
+	0xA9, 0xFF, 0xFF,			// LDA #$FFFF		; 65536 bytes
+	0xA2, 0x00, 0x00,			// LDX #$0000
+	0xA0, 0x00, 0x00,			// LDY #$0000
+	0x54, 0x7E, 0x7F,			// MVN
+	0xA9, 0xFF, 0xFF,			// LDA #$FFFF
+	0xA2, 0xFF, 0xFF,			// LDX #$FFFF
+	0xA0, 0xFF, 0xFF,			// LDY #$FFFF
+	0x44, 0x7F, 0x7E,			// MVP
+	0xAF, 0x00, 0x80, 0x7E,		// LDA $7E8000
+	0x1A,						// INC A
+	0x8F, 0x00, 0x80, 0x7E,		// STA $7E8000
+	0x80, 0xDD					// BRA -35
+};
+
+// instruction mixes through runUntil() as the scheduler runs them, in the
+// interpreter and the jit, and block moves in bytes
+static void benchMixes(size_t instructions) {
+	struct PROGRAM {
+		const char* name;
+		const byte* code;
+		size_t size;
+	};
+	const PROGRAM programs[] = {{"alu_loop", alu_loop, sizeof(alu_loop)}, {"wide_loop", wide_loop, sizeof(wide_loop)},
+		{"mem_loop", mem_loop, sizeof(mem_loop)}, {"branch_loop", branch_loop, sizeof(branch_loop)}};
+	uint64_t master_cycles = instructions / bench_runs * 2 * MASTER_CYCLES_PER_CPU_CYCLE;
+
+	for(const PROGRAM& program : programs) {
+		std::string path = writeBenchROM(program.code, program.size);
+		for(bool jit : {false, true}) {
+			if(jit && !SNES_JIT::supported()) continue;
+			uint64_t executed = 0;
+			bench_stats stats = repeat([&]() {
+				CPU_APU_IO io;
+				SNES_CPU cpu(&io);
+				loadBenchROM(cpu, path);
+				cpu.setJIT(jit);
+
+				auto start = std::chrono::steady_clock::now();
+				cpu.runUntil(master_cycles);
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				executed = cpu.getInstructions();
+				return seconds;
+			});
+			record(std::string("cpu ") + program.name + (jit ? " jit" : ""), stats, executed, "instruction");
+		}
+		unlink(path.c_str());
+	}
+
+	// until a number of round trips. a move stops at the end of each batch,
+	// so at the scheduler's interval it's split into that many pieces
+	std::string path = writeBenchROM(move_loop, sizeof(move_loop));
+	const twobyte trips = 16;
+	for(uint64_t interval : {(uint64_t)1 << 20, (uint64_t)DEFAULT_SYNC_INTERVAL}) {
+		uint64_t moved = 0;
+		bench_stats stats = repeat([&]() {
+			CPU_APU_IO io;
+			SNES_CPU cpu(&io);
+			loadBenchROM(cpu, path);
+
+			auto start = std::chrono::steady_clock::now();
+			while(cpu.mem->read16(0x7E8000) < trips)
+				cpu.runUntil(cpu.time + interval);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			moved = cpu.mem->read16(0x7E8000) * 2 * 0x10000ULL;
+			return seconds;
+		});
+		record(interval == DEFAULT_SYNC_INTERVAL ? "cpu mvn/mvp 64 KB synced" : "cpu mvn/mvp 64 KB", stats, moved, "byte");
+	}
+	unlink(path.c_str());
+}
+
+// fills by moving onto the next byte, both ways, then a copy out of the ROM
+// over a page boundary of WRAM. the operand bytes are source, destination
+static const byte move_checks[] = {
+	0x18,						// CLC
+	0xFB,						// XCE
+	0xC2, 0x30,					// REP #$30
+	0xA9, 0xFE, 0x0F,			// LDA #$0FFE
+	0xA2, 0x00, 0x20,			// LDX #$2000
+	0xA0, 0x01, 0x20,			// LDY #$2001
+	0x54, 0x7E, 0x7E,			// MVN		; 7E:2000-2FFF from 7E:2000
+	0xA9, 0xFE, 0x0F,			// LDA #$0FFE
+	0xA2, 0xFF, 0x3F,			// LDX #$3FFF
+	0xA0, 0xFE, 0x3F,			// LDY #$3FFE
+	0x44, 0x7F, 0x7F,			// MVP		; 7F:3000-3FFF from 7F:3FFF
+	0xA9, 0xFF, 0x01,			// LDA #$01FF
+	0xA2, 0x00, 0x80,			// LDX #$8000
+	0xA0, 0x80, 0x4F,			// LDY #$4F80
+	0x54, 0x00, 0x7E,			// MVN		; 7E:4F80-517F from 00:8000
+	0x42						// WDM, not implemented, halts
+};
+
+// the moves have to take 7 cycles a byte however they're split up, and
+// never run past the end of a batch by more than one byte
+static void benchMoves() {
+	struct RESULT {
+		uint64_t time;
+		bool filled;
+		bool copied;
+		bool overshot;
+	};
+	auto run = [](byte count_high, bool block_cache, uint64_t interval) {
+		std::vector<byte> program(move_checks, move_checks + sizeof(move_checks));
+		program[30] = count_high;
+		std::string path = writeBenchROM(program.data(), program.size());
+		CPU_APU_IO io;
+		SNES_CPU cpu(&io);
+		loadBenchROM(cpu, path);
+		unlink(path.c_str());
+		cpu.setBlockCache(block_cache);
+		cpu.mem->write8(0x7E, 0x2000, 0xA5);
+		cpu.mem->write8(0x7F, 0x3FFF, 0x5A);
+
+		RESULT result = {0, true, true, false};
+		for(uint64_t target = interval; cpu.runUntil(target); target += interval)
+			result.overshot |= cpu.time - target >= 7 * MASTER_CYCLES_PER_CPU_CYCLE;
+		result.time = cpu.time;
+		for(twobyte addr = 0x2000; addr < 0x3000; addr++) {
+			result.filled &= cpu.mem->read8(0x7E, addr) == 0xA5;
+			result.filled &= cpu.mem->read8(0x7F, addr + 0x1000) == 0x5A;
+		}
+		for(twobyte i = 0; i <= ((count_high << 8) | 0xFF); i++)
+			result.copied &= cpu.mem->read8(0x7E, 0x4F80 + i) == cpu.mem->read8(0x00, 0x8000 + i);
+		return result;
+	};
+
+	RESULT whole = run(0x01, true, 1ULL << 40);
+	RESULT batched = run(0x01, true, DEFAULT_SYNC_INTERVAL);
+	RESULT stepped = run(0x01, false, 1);
+	RESULT shorter = run(0x00, true, 1ULL << 40);
+	bool moved = whole.filled && whole.copied && batched.filled && batched.copied && stepped.filled && stepped.copied;
+	bool timed = whole.time == batched.time && whole.time == stepped.time
+		&& whole.time - shorter.time == 0x100 * 7 * MASTER_CYCLES_PER_CPU_CYCLE;
+	bool interruptible = !batched.overshot && !stepped.overshot;
+
+	std::cout << "mvn/mvp " << (moved ? "moves ok" : "MOVES WRONG") << ", " << (timed ? "7 cycles a byte" : "CYCLES WRONG")
+	<< ", " << (interruptible ? "stop with the batch" : "RUN PAST THE BATCH") << std::endl;
+	if(!moved || !timed || !interruptible) exit(1);
+}
+
+// the mirroring logic SNES_MEMORY used before the page table, kept here as the baseline
+struct LegacyMemory {
+	std::vector<byte> data = std::vector<byte>(1024 * 64 * 256);
+
+	static void apply_mirrors(byte& bank, twobyte addr) {
+		if(addr <= 0x1FFF && (bank <= 0x3F || (bank >= 0x80 && bank <= 0xBF))) bank = 0x7E;
+		if(addr >= 0x8000 && bank <= 0x7D) bank += 0x80;
+		if(addr >= 0x2100 && addr <= 0x21FF && (bank <= 0x3F || (bank >= 0x80 && bank <= 0xBF))) bank = 0x00;
+		if(addr >= 0x4200 && addr <= 0x43FF && (bank <= 0x3F || (bank >= 0x80 && bank <= 0xBF))) bank = 0x00;
+	}
+
+	byte read8(byte bank, twobyte addr) {
+		apply_mirrors(bank, addr);
+		return data[addr + (bank << 16)];
+	}
+};
+
+// builds a set of addresses matching one access pattern
+static std::vector<threebyte> memoryPattern(const std::string& name) {
+	std::vector<threebyte> addrs(1 << 16);
+	uint32_t seed = 12345;
+	for(size_t i = 0; i < addrs.size(); i++) {
+		seed = seed * 1103515245 + 12345;
+		twobyte r = seed >> 16;
+		if(name == "bank0_lowram")
+			addrs[i] = r & 0x1FFF;
+		else if(name == "lowram_mirrors")
+			addrs[i] = (((seed >> 8) & 0x3F) | (seed & 0x80)) << 16 | (r & 0x1FFF);
+		else if(name == "wram_7e")
+			addrs[i] = 0x7E0000 | r;
+		else if(name == "rom_fetch")
+			addrs[i] = 0x808000 | (i & 0x7FFF);
+		else
+			addrs[i] = ((seed >> 8) & 0xFF0000) | r;
+	}
+	return addrs;
+}
+
+template<typename F>
+static double timeReads(const std::vector<threebyte>& addrs, size_t reads, F read) {
+	byte sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < reads; i++) {
+		threebyte addr = addrs[i & 0xFFFF];
+		sum += read(addr >> 16, addr & 0xFFFF);
+	}
+	auto end = std::chrono::steady_clock::now();
+	// keep the reads from being optimized away
+	volatile byte sink = sum;
+	(void)sink;
+	return std::chrono::duration<double>(end - start).count();
+}
+
+static void benchMemory(size_t reads) {
+	CPU_APU_IO io;
+	SNES_MEMORY* mem = new SNES_MEMORY(&io);
+	LegacyMemory* legacy = new LegacyMemory();
+
+	const char* patterns[] = {"bank0_lowram", "lowram_mirrors", "wram_7e", "rom_fetch", "random"};
+	size_t per_run = reads / bench_runs;
+	for(const char* name : patterns) {
+		std::vector<threebyte> addrs = memoryPattern(name);
+
+		bench_stats old_s = repeat([&]() {
+			return timeReads(addrs, per_run, [&](byte bank, twobyte addr) {return legacy->read8(bank, addr);});
+		});
+		bench_stats new_s = repeat([&]() {
+			return timeReads(addrs, per_run, [&](byte bank, twobyte addr) {return mem->read8(bank, addr);});
+		});
+		record(std::string("memory ") + name + " apply_mirrors", old_s, per_run, "read");
+		record(std::string("memory ") + name + " page table", new_s, per_run, "read");
+	}
+
+	delete legacy;
+	delete mem;
+}
+
+// resident anonymous memory of this process in KB, from /proc/self/smaps_rollup
+static size_t rssAnonKB() {
+	std::ifstream f("/proc/self/smaps_rollup");
+	std::string line;
+	while(std::getline(f, line)) {
+		if(line.compare(0, 10, "Anonymous:") == 0)
+			return strtoull(line.c_str() + 10, NULL, 10);
+	}
+	return 0;
+}
+
+// loads the same 4 MB image into many SNES_MEMORY instances, like a batch run would
+static void benchROMLoad(size_t instances) {
+	std::vector<byte> program(alu_loop, alu_loop + sizeof(alu_loop));
+	program.resize(0x400000, 0xEA);
+	std::string path = writeBenchROM(program.data(), program.size());
+
+	CPU_APU_IO io;
+	std::vector<SNES_MEMORY*> mems;
+	size_t rss_before = rssAnonKB();
+
+	auto start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < instances; i++) {
+		SNES_MEMORY* mem = new SNES_MEMORY(&io);
+		mem->openROM(path);
+		// touch every ROM bank like a running game would
+		for(threebyte addr = 0x808000; addr < 0x1000000; addr += 0x10000)
+			mem->read8(addr);
+		mems.push_back(mem);
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	size_t rss_after = rssAnonKB();
+	double seconds = std::chrono::duration<double>(end - start).count();
+	std::cout << "rom load: " << instances << " instances of a 4 MB ROM, "
+	<< std::fixed << std::setprecision(3) << (seconds * 1e3 / instances) << " ms/instance, "
+	<< (rss_after - rss_before) / instances << " KB anonymous RSS/instance" << std::endl;
+
+	// a failed open over a loaded image, missing or too big, leaves the
+	// cartridge area reading as open bus rather than from the unmapped file
+	std::vector<byte> huge(0x900000, 0xEA);
+	std::string huge_path = writeBenchROM(huge.data(), huge.size());
+	bool unloaded = true;
+	for(const std::string& bad : {path + ".missing", huge_path}) {
+		SNES_MEMORY* mem = mems[0];
+		mem->log = &bench_quiet;
+		mem->openROM(path);
+		unloaded &= !mem->openROM(bad);
+		for(threebyte addr = 0x808000; addr < 0x1000000; addr += 0x1000)
+			unloaded &= mem->read8(addr) == 0;
+	}
+	unlink(huge_path.c_str());
+	std::cout << "rom reopen failures: " << (unloaded ? "open bus" : "FAILED") << std::endl;
+
+	// 2 KB of SRAM repeats through its 4 KB pages and its banks, as games
+	// probing its size expect. map mode 20, 2 KB of SRAM, a valid checksum
+	std::vector<byte> small(0x8000, 0xEA);
+	small[0x7FD5] = 0x20;
+	small[0x7FD8] = 0x01;
+	small[0x7FDC] = small[0x7FDD] = 0x00;
+	small[0x7FDE] = small[0x7FDF] = 0xFF;
+	std::string small_path = writeBenchROM(small.data(), small.size());
+	SNES_MEMORY* mem = mems[0];
+	bool mirrored = mem->openROM(small_path);
+	mem->write8(0x70, 0x0000, 0x5A);
+	mem->write8(0x70, 0x0FFF, 0xA5);
+	mirrored &= mem->read8(0x700800) == 0x5A && mem->read8(0x7007FF) == 0xA5;
+	mirrored &= mem->read8(0x717800) == 0x5A && mem->read16(0xF007FF) == 0x5AA5;
+	unlink(small_path.c_str());
+	std::cout << "sram 2 KB: " << (mirrored ? "mirrored" : "NOT MIRRORED") << std::endl;
+
+	for(SNES_MEMORY* mem : mems)
+		delete mem;
+	unlink(path.c_str());
+	if(!unloaded || !mirrored) exit(1);
+}
+
+// same loop through the scheduler with the apu following, at several sync intervals
+static void benchScheduler(size_t instructions) {
+	std::string path = writeBenchROM(alu_loop, sizeof(alu_loop));
+	const uint64_t intervals[] = {MASTER_CYCLES_PER_CPU_CYCLE, DEFAULT_SYNC_INTERVAL, 8192};
+
+	for(uint64_t interval : intervals) {
+		CPU_APU_IO io;
+		SNES_CPU cpu(&io);
+		SNES_APU apu(&io);
+		SNES_SCHEDULER scheduler(&cpu);
+		scheduler.addComponent(&apu);
+		scheduler.setSyncInterval(interval);
+		io.connect(&scheduler, &cpu, &apu);
+
+		if(!cpu.mem->openROM(path)) {
+			std::cout << "bench: could not load ROM" << std::endl;
+			exit(1);
+		}
+		cpu.init();
+
+		// the loop averages just over 2 cycles per instruction
+		uint64_t master_cycles = instructions * 2 * MASTER_CYCLES_PER_CPU_CYCLE;
+		auto start = std::chrono::steady_clock::now();
+		scheduler.run(master_cycles);
+		auto end = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(end - start).count();
+		double emulated = (double)scheduler.now() / MASTER_CLOCK_HZ;
+		std::cout << "scheduler sync every " << std::setw(4) << interval << " master cycles: "
+		<< std::fixed << std::setprecision(3) << seconds << "s for " << emulated << "s emulated ("
+		<< std::setprecision(1) << emulated / seconds << "x realtime)" << std::endl;
+	}
+
+	unlink(path.c_str());
+}
+
+// the spc700 on its own, spinning in the IPL ROM waiting for the cpu
+static void benchSPC(double emulated_seconds, SNES_TRACER* tracer = nullptr, const char* label = "spc700 ipl idle") {
+	uint64_t master_cycles = (uint64_t)(emulated_seconds / bench_runs * MASTER_CLOCK_HZ);
+	uint64_t cycles = 0;
+	bench_stats stats = repeat([&]() {
+		CPU_APU_IO io;
+		SNES_APU apu(&io);
+		io.tracer = tracer;
+		apu.setTracer(tracer);
+		auto start = std::chrono::steady_clock::now();
+		apu.runUntil(master_cycles);
+		cycles = apu.getCycles();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	});
+	record(label, stats, cycles, "cycle");
+}
+
+// 8 voices looping a pseudo-random BRR sample with every filter, envelopes,
+// pitch modulation, noise and a 4-tap echo into audio RAM
+static void setupDSP(SNES_DSP& dsp, std::vector<byte>& aram) {
+	const twobyte dir = 0x0200, sample = 0x1000;
+	const int blocks = 64;
+
+	aram[dir] = sample & 0xFF;
+	aram[dir + 1] = sample >> 8;
+	aram[dir + 2] = sample & 0xFF;
+	aram[dir + 3] = sample >> 8;
+
+	uint32_t seed = 1;
+	for(int b = 0; b < blocks; b++) {
+		twobyte block = sample + b * 9;
+		// ranges 8-12, filters 0-3, end and loop on the last block
+		aram[block] = ((8 + b % 5) << 4) | ((b & 3) << 2) | (b == blocks - 1 ? 0x03 : 0x00);
+		for(int i = 1; i < 9; i++) {
+			seed = seed * 1103515245 + 12345;
+			aram[block + i] = seed >> 24;
+		}
+	}
+
+	dsp.write(0x5D, dir >> 8);
+	for(int v = 0; v < DSP_VOICES; v++) {
+		twobyte pitch = 0x0800 + v * 0x0234;
+		dsp.write((v << 4) | 0x00, 0x30 + v);
+		dsp.write((v << 4) | 0x01, 0x50 - v);
+		dsp.write((v << 4) | 0x02, pitch & 0xFF);
+		dsp.write((v << 4) | 0x03, pitch >> 8);
+		dsp.write((v << 4) | 0x04, 0x00);
+		dsp.write((v << 4) | 0x05, v == 5 ? 0x00 : 0x8F);
+		dsp.write((v << 4) | 0x06, 0xE8);
+		dsp.write((v << 4) | 0x07, 0xDF);
+	}
+	const byte fir[8] = {0x7F, 0x00, 0x00, 0x00, 0xF0, 0x10, 0x20, 0x30};
+	for(int t = 0; t < 8; t++)
+		dsp.write((t << 4) | 0x0F, fir[t]);
+
+	dsp.write(0x0C, 0x7F);
+	dsp.write(0x1C, 0x7F);
+	dsp.write(0x2C, 0x40);
+	dsp.write(0x3C, 0x40);
+	dsp.write(0x0D, 0x50);
+	dsp.write(0x2D, 0x04);
+	dsp.write(0x3D, 0x80);
+	dsp.write(0x4D, 0xF0);
+	dsp.write(0x6D, 0x80);
+	dsp.write(0x7D, 0x02);
+	dsp.write(0x6C, 0x1A);
+	dsp.write(0x4C, 0xFF);
+}
+
+// every voice loop path has to match the scalar one sample for sample
+static void benchDSP(size_t samples) {
+	const SNES_DSP_PATH paths[] = {DSP_SCALAR, DSP_SSE2, DSP_AVX2};
+	const char* names[] = {"scalar", "sse2", "avx2"};
+	uint32_t reference = 0;
+	bool same = true;
+
+	for(int p = 0; p < 3; p++) {
+		if(!SNES_DSP::supported(paths[p])) {
+			std::cout << "dsp " << names[p] << ": not supported" << std::endl;
+			continue;
+		}
+
+		uint32_t sum = 0;
+		size_t per_run = samples / bench_runs;
+		bench_stats stats = repeat([&]() {
+			std::vector<byte> aram(SNES_ARAM_SIZE, 0);
+			SNES_DSP dsp;
+			dsp.setRAM(aram.data());
+			dsp.setPath(paths[p]);
+			setupDSP(dsp, aram);
+
+			sum = 0;
+			int16_t frames[512 * 2];
+			auto start = std::chrono::steady_clock::now();
+			for(size_t i = 0; i < per_run; i++) {
+				dsp.sample();
+				if(dsp.available() == 512) {
+					dsp.readSamples(frames, 512);
+					for(int16_t f : frames)
+						sum = sum * 31 + (twobyte)f;
+				}
+			}
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		});
+
+		if(p == 0) reference = sum;
+		same &= sum == reference;
+		record(std::string("dsp ") + names[p], stats, per_run, "sample");
+		if(sum != reference) std::cout << "dsp " << names[p] << ": MISMATCH" << std::endl;
+	}
+
+	if(!same) exit(1);
+}
+
+static void ppuWrite16(SNES_PPU& ppu, twobyte reg, twobyte value) {
+	ppu.write(reg, value & 0xFF);
+	ppu.write(reg, value >> 8);
+}
+
+// fills vram, cgram and oam with pseudo-random data and sets up a mode 1 scene
+// (3 scrolled bgs, 128 16x16 sprites, a window and half color math) or a
+// rotated mode 7 one
+static void setupPPU(SNES_PPU& ppu, bool mode7) {
+	uint32_t seed = 7;
+	auto next = [&seed]() {seed = seed * 1103515245 + 12345; return seed >> 16;};
+
+	ppu.write(0x2115, 0x80);
+	ppu.write(0x2116, 0x00);
+	ppu.write(0x2117, 0x00);
+	for(int i = 0; i < 0x8000; i++) {
+		twobyte word = next();
+		// mode 7 maps: tile numbers in the low byte of the first 16K words
+		if(mode7 && i < 0x4000) word = (word & 0xFF00) | (i & 0x3F);
+		ppu.write(0x2118, word & 0xFF);
+		ppu.write(0x2119, word >> 8);
+	}
+
+	ppu.write(0x2121, 0x00);
+	for(int i = 0; i < 256; i++) {
+		twobyte color = next() & 0x7FFF;
+		ppu.write(0x2122, color & 0xFF);
+		ppu.write(0x2122, color >> 8);
+	}
+
+	ppu.write(0x2102, 0x00);
+	ppu.write(0x2103, 0x00);
+	for(int i = 0; i < 128; i++) {
+		ppu.write(0x2104, (i * 37) & 0xFF);
+		ppu.write(0x2104, (i * 53) % 224);
+		ppu.write(0x2104, next() & 0xFF);
+		ppu.write(0x2104, next() & 0xFF);
+	}
+	for(int i = 0; i < 32; i++)
+		ppu.write(0x2104, 0x00);
+	ppu.write(0x2101, 0x60);
+
+	if(mode7) {
+		ppu.write(0x2105, 0x07);
+		ppu.write(0x211A, 0x00);
+		ppuWrite16(ppu, 0x211B, 0x00B5);
+		ppuWrite16(ppu, 0x211C, 0x00B5);
+		ppuWrite16(ppu, 0x211D, 0xFF4B);
+		ppuWrite16(ppu, 0x211E, 0x00B5);
+		ppuWrite16(ppu, 0x211F, 0x0080);
+		ppuWrite16(ppu, 0x2120, 0x0080);
+		ppu.write(0x212C, 0x11);
+	} else {
+		ppu.write(0x2105, 0x09);
+		ppu.write(0x2107, 0x70);
+		ppu.write(0x2108, 0x74);
+		ppu.write(0x2109, 0x78);
+		ppu.write(0x210B, 0x21);
+		ppu.write(0x210C, 0x04);
+		ppuWrite16(ppu, 0x210D, 13);
+		ppuWrite16(ppu, 0x210E, 7);
+		ppuWrite16(ppu, 0x210F, 100);
+		ppuWrite16(ppu, 0x2110, 50);
+		ppu.write(0x2126, 40);
+		ppu.write(0x2127, 200);
+		ppu.write(0x2123, 0x20);
+		ppu.write(0x212E, 0x02);
+		ppu.write(0x212C, 0x13);
+		ppu.write(0x212D, 0x04);
+		ppu.write(0x2130, 0x02);
+		ppu.write(0x2131, 0x43);
+	}
+	ppu.write(0x2132, 0xE4);
+	ppu.write(0x2100, 0x0F);
+}
+
+// headless frames per second, with tile decode and color math in SSE2 and
+// scalar code, then on worker threads. all of them have to draw the same frames
+static void benchPPU(size_t frames) {
+	struct PPU_CONFIG {
+		bool simd;
+		int threads;
+	};
+	std::vector<PPU_CONFIG> configs = {{false, 0}, {true, 0}, {true, 2}};
+	int cores = std::thread::hardware_concurrency();
+	if(cores > 2) configs.push_back({true, cores});
+
+	for(bool mode7 : {false, true}) {
+		uint32_t reference = 0;
+		for(const PPU_CONFIG& config : configs) {
+			uint32_t sum = 0;
+			size_t per_run = std::max((size_t)1, frames / bench_runs);
+			bool supported = true;
+			bench_stats stats = repeat([&]() {
+				SNES_PPU ppu;
+				supported = ppu.setSIMD(config.simd);
+				setupPPU(ppu, mode7);
+				ppu.setThreads(config.threads);
+
+				sum = 0;
+				uint64_t frame_cycles = (uint64_t)PPU_CYCLES_PER_LINE * PPU_LINES_PER_FRAME;
+				auto start = std::chrono::steady_clock::now();
+				for(size_t f = 1; supported && f <= per_run; f++) {
+					// scroll, and stream some new tiles in like a game would in vblank
+					ppuWrite16(ppu, 0x210D, f);
+					ppuWrite16(ppu, 0x2110, f / 2);
+					ppuWrite16(ppu, 0x211B, 0x00B5 + (f & 0x3F));
+					ppu.write(0x2116, (f * 0x200) & 0xFF);
+					ppu.write(0x2117, ((f * 0x200) >> 8) & 0x7F);
+					for(int i = 0; i < 0x400; i++) {
+						ppu.write(0x2118, i + f);
+						ppu.write(0x2119, i ^ f);
+					}
+					// a split halfway down, and the sprite flags so far
+					ppu.runUntil(f * frame_cycles - frame_cycles / 2);
+					ppuWrite16(ppu, 0x210F, f * 3);
+					sum = sum * 31 + ppu.read(0x213E);
+					ppu.runUntil(f * frame_cycles);
+
+					const uint32_t* fb = ppu.getFramebuffer();
+					for(int i = 0; i < PPU_WIDTH * ppu.getHeight(); i += 61)
+						sum = sum * 31 + fb[i];
+				}
+				return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			});
+			if(!supported) continue;
+
+			if(!config.simd) reference = sum;
+			std::ostringstream name;
+			name << "ppu " << (mode7 ? "mode 7" : "mode 1") << (config.simd ? " sse2" : " scalar");
+			if(config.threads) name << " " << config.threads << " threads";
+			record(name.str(), stats, per_run, "frame");
+			if(sum != reference) std::cout << name.str() << ": MISMATCH" << std::endl;
+			if(sum != reference) exit(1);
+		}
+	}
+}
+
+// boots the apu through the IPL ROM handshake, uploads spc_ping to $0200 and
+// starts it, then talks to it through the ports on every iteration
+static const byte ipl_upload[] = {
+	0xA9, 0xAA,			// LDA #$AA
+	0xCD, 0x40, 0x21,	// CMP $2140		; wait for the IPL's $BBAA
+	0xD0, 0xFB,			// BNE -5
+	0xA9, 0xBB,			// LDA #$BB
+	0xCD, 0x41, 0x21,	// CMP $2141
+	0xD0, 0xFB,			// BNE -5
+	0xA9, 0x00,			// LDA #$00
+	0x8D, 0x42, 0x21,	// STA $2142		; destination $0200
+	0xA9, 0x02,			// LDA #$02
+	0x8D, 0x43, 0x21,	// STA $2143
+	0xA9, 0x01,			// LDA #$01
+	0x8D, 0x41, 0x21,	// STA $2141		; transfer
+	0xA9, 0xCC,			// LDA #$CC
+	0x8D, 0x40, 0x21,	// STA $2140
+	0xCD, 0x40, 0x21,	// CMP $2140
+	0xD0, 0xFB,			// BNE -5
+	0xA2, 0x00,			// LDX #$00
+	0xBD, 0x00, 0x90,	// LDA $9000,X		; send a byte, wait for the index to echo
+	0x8D, 0x41, 0x21,	// STA $2141
+	0x8E, 0x40, 0x21,	// STX $2140
+	0xEC, 0x40, 0x21,	// CPX $2140
+	0xD0, 0xFB,			// BNE -5
+	0xE8,				// INX
+	0xE0, 0x07,			// CPX #$07
+	0xD0, 0xED,			// BNE -19
+	0xA9, 0x00,			// LDA #$00
+	0x8D, 0x42, 0x21,	// STA $2142		; jump to $0200
+	0xA9, 0x02,			// LDA #$02
+	0x8D, 0x43, 0x21,	// STA $2143
+	0xA9, 0x00,			// LDA #$00		; not STZ, which stores A
+	0x8D, 0x41, 0x21,	// STA $2141
+	0xE8,				// INX
+	0x8E, 0x40, 0x21,	// STX $2140
+	0xEC, 0x40, 0x21,	// CPX $2140
+	0xD0, 0xFB,			// BNE -5
+	0xE8,				// INX
+	0x8E, 0x40, 0x21,	// STX $2140
+	0xAD, 0x43, 0x21,	// LDA $2143
+	0x65, 0x10,			// ADC $10
+	0x85, 0x10,			// STA $10
+	0x80, 0xF3			// BRA -13
+};
+
+// spc700 side: answers with port 0 + 1 on port 3
+static const byte spc_ping[] = {
+	0xE4, 0xF4,			// MOV A,$F4
+	0xBC,				// INC A
+	0xC4, 0xF7,			// MOV $F7,A
+	0x2F, 0xF9			// BRA -7
+};
+
+// ipl_upload at $8000 with spc_ping at $9000, filler between them
+static std::string writeUploadROM(byte filler = 0xEA) {
+	std::vector<byte> program(0x1000 + sizeof(spc_ping), filler);
+	std::copy(ipl_upload, ipl_upload + sizeof(ipl_upload), program.begin());
+	std::copy(spc_ping, spc_ping + sizeof(spc_ping), program.begin() + 0x1000);
+	return writeBenchROM(program.data(), program.size());
+}
+
+struct run_result {
+	uint64_t cpu_time;
+	uint64_t apu_time;
+	twobyte accumulator;
+	uint32_t wram_sum;
+	double seconds;
+};
+
+static run_result runPorts(const std::string& path, uint64_t master_cycles, uint64_t interval, bool threaded) {
+	CPU_APU_IO io;
+	SNES_CPU cpu(&io);
+	SNES_APU apu(&io);
+	SNES_SCHEDULER scheduler(&cpu);
+	scheduler.addComponent(&apu);
+	scheduler.setSyncInterval(interval);
+	scheduler.setWindow(interval);
+	io.connect(&scheduler, &cpu, &apu);
+
+	if(!cpu.mem->openROM(path)) {
+		std::cout << "bench: could not load ROM" << std::endl;
+		exit(1);
+	}
+	cpu.init();
+	scheduler.setThreaded(threaded);
+
+	auto start = std::chrono::steady_clock::now();
+	scheduler.run(master_cycles);
+	auto end = std::chrono::steady_clock::now();
+	scheduler.setThreaded(false);
+
+	run_result r = {cpu.time, apu.time, cpu.debugAccum(), 0, std::chrono::duration<double>(end - start).count()};
+	for(threebyte addr = 0x7E0000; addr < 0x800000; addr++)
+		r.wram_sum = r.wram_sum * 31 + cpu.mem->read8(addr);
+	return r;
+}
+
+// determinism check: the threaded apu has to end up exactly where the
+// single-threaded run does, whatever the sync interval
+static void benchAPUThread(size_t instructions) {
+	std::string path = writeUploadROM();
+	uint64_t master_cycles = instructions * 4 * MASTER_CYCLES_PER_CPU_CYCLE;
+	const uint64_t intervals[] = {MASTER_CYCLES_PER_CPU_CYCLE, DEFAULT_SYNC_INTERVAL, MAX_SYNC_INTERVAL};
+
+	run_result reference = runPorts(path, master_cycles, DEFAULT_SYNC_INTERVAL, false);
+	bool deterministic = true;
+
+	for(uint64_t interval : intervals) {
+		for(bool threaded : {false, true}) {
+			run_result r = runPorts(path, master_cycles, interval, threaded);
+			bool same = r.cpu_time == reference.cpu_time && r.apu_time == reference.apu_time &&
+				r.accumulator == reference.accumulator && r.wram_sum == reference.wram_sum;
+			deterministic &= same;
+
+			std::cout << "apu " << (threaded ? "threaded" : "inline  ") << " sync every " << std::setw(5) << interval
+			<< " master cycles: " << std::fixed << std::setprecision(3) << r.seconds << "s"
+			<< (same ? "" : "  MISMATCH") << std::endl;
+		}
+	}
+
+	std::cout << "apu determinism: " << (deterministic ? "ok" : "FAILED") << std::endl;
+	unlink(path.c_str());
+	if(!deterministic) exit(1);
+}
+
+// a console with path loaded, on the heap as SNES is too big for a
+// thread's stack
+static std::unique_ptr<SNES> loadMachine(const std::string& path) {
+	std::unique_ptr<SNES> machine(new SNES());
+	machine->setLog(&bench_quiet);
+	if(!machine->loadROM(path)) {
+		std::cout << "bench: could not load ROM" << std::endl;
+		exit(1);
+	}
+	return machine;
+}
+
+// where a machine has got to: its clock, registers and WRAM. the state
+// itself can't be compared, the apu ports' queues depend on how far the
+// apu's thread had got
+static uint64_t machineHash(SNES& machine) {
+	SNES_CPU_REGISTERS regs = machine.getRegisters();
+	uint64_t h = machine.getTime();
+	h = h * 31 + machine.getInstructions();
+	h = h * 31 + machine.getFrame();
+	h = h * 31 + regs.C;
+	h = h * 31 + regs.X;
+	h = h * 31 + regs.Y;
+	h = h * 31 + regs.PC;
+	h = h * 31 + regs.P;
+	SNES_MEMORY* mem = machine.getMemory();
+	for(threebyte addr = 0x7E0000; addr < 0x800000; addr++)
+		h = h * 31 + mem->read8(addr);
+	return h;
+}
+
+// save and restore times, and a check that a restored machine carries on
+// exactly like the one the state was taken from: in place, and in a fresh
+// machine with the apu and the ppu on threads
+static void benchState(size_t instructions) {
+	std::string path = writeUploadROM();
+	uint64_t master_cycles = instructions * 4 * MASTER_CYCLES_PER_CPU_CYCLE;
+
+	std::unique_ptr<SNES> machine = loadMachine(path);
+	machine->run(master_cycles);
+
+	size_t size = machine->stateSize();
+	std::vector<byte> buffer(size);
+	const int rounds = 1000;
+
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < rounds; i++)
+		machine->saveState(buffer.data(), buffer.size());
+	auto end = std::chrono::steady_clock::now();
+	double save_us = std::chrono::duration<double, std::micro>(end - start).count() / rounds;
+
+	start = std::chrono::steady_clock::now();
+	bool loaded = true;
+	for(int i = 0; i < rounds; i++)
+		loaded &= machine->loadState(buffer.data(), buffer.size());
+	end = std::chrono::steady_clock::now();
+	double load_us = std::chrono::duration<double, std::micro>(end - start).count() / rounds;
+
+	machine->run(master_cycles);
+	uint64_t reference = machineHash(*machine);
+
+	loaded &= machine->loadState(buffer.data(), buffer.size());
+	machine->run(master_cycles);
+	bool same = machineHash(*machine) == reference;
+
+	std::unique_ptr<SNES> fresh = loadMachine(path);
+	fresh->setThreadedAPU(true);
+	fresh->setPPUThreads(2);
+	loaded &= fresh->loadState(buffer.data(), buffer.size());
+	fresh->run(master_cycles);
+	fresh->setThreadedAPU(false);
+	bool fresh_same = machineHash(*fresh) == reference;
+
+	// a state cut short has to be refused. one that claims to end before
+	// its last chunk fails after the others are read, and has to leave the
+	// machine as it was all the same
+	bool refused = !fresh->loadState(buffer.data(), buffer.size() - 1) && machine->saveState(buffer.data(), size / 2) == 0;
+	machine->saveState(buffer.data(), buffer.size());
+	fresh->run(master_cycles);
+	std::vector<byte> before(fresh->stateSize()), after(before.size()), cut = buffer;
+	fresh->saveState(before.data(), before.size());
+	SNES_STATE_HEADER header;
+	memcpy(&header, cut.data(), sizeof(header));
+	header.size--;
+	memcpy(cut.data(), &header, sizeof(header));
+	refused &= !fresh->loadState(cut.data(), cut.size());
+	fresh->saveState(after.data(), after.size());
+	refused &= before == after;
+
+	// nor does one taken with another image of the same size
+	std::string other_path = writeUploadROM(0xDB);
+	refused &= !loadMachine(other_path)->loadState(buffer.data(), buffer.size());
+	unlink(other_path.c_str());
+
+	std::cout << "state " << size / 1024 << " KB: save " << std::fixed << std::setprecision(1) << save_us
+	<< "us, load " << load_us << "us" << std::endl;
+	bool ok = loaded && same && fresh_same && refused;
+	std::cout << "state determinism: " << (ok ? "ok" : "FAILED") << (same ? "" : "  MISMATCH in place")
+	<< (fresh_same ? "" : "  MISMATCH fresh machine") << (loaded ? "" : "  LOAD FAILED")
+	<< (refused ? "" : "  BAD STATE ACCEPTED OR NOT UNDONE") << std::endl;
+	unlink(path.c_str());
+	if(!ok) exit(1);
+}
+
+// the whole machine through the scheduler, cpu, apu and ppu, a frame at a time
+static void benchFrames(size_t frames) {
+	std::string path = writeUploadROM();
+	uint64_t frame_cycles = (uint64_t)PPU_CYCLES_PER_LINE * PPU_LINES_PER_FRAME;
+	size_t per_run = std::max((size_t)1, frames / bench_runs);
+
+	uint64_t reference = 0;
+	bool same = true, first = true;
+	bench_stats stats = repeat([&]() {
+		std::unique_ptr<SNES> machine = loadMachine(path);
+		auto start = std::chrono::steady_clock::now();
+		machine->run(per_run * frame_cycles);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if(first) reference = machineHash(*machine);
+		same &= machineHash(*machine) == reference;
+		first = false;
+		return seconds;
+	});
+	record("system frames", stats, per_run, "frame");
+	unlink(path.c_str());
+	if(!same) {
+		std::cout << "system frames: MISMATCH" << std::endl;
+		exit(1);
+	}
+}
+
+// sets VTIME, HTIME and NMITIMEN from the patched bytes, then waits for
+// interrupts (or spins, with the WAI patched to a NOP). the handlers count
+// nmis at $10 and irqs at $12 and acknowledge them
+static const byte wait_loop[] = {
+	0x18,				// CLC
+	0xFB,				// XCE
+	0xA9, 0x00,			// LDA #vtime
+	0x8D, 0x09, 0x42,	// STA $4209
+	0xA9, 0x00,			// LDA #htime
+	0x8D, 0x07, 0x42,	// STA $4207
+	0xA9, 0x00,			// LDA #nmitimen
+	0x8D, 0x00, 0x42,	// STA $4200
+	0x58,				// CLI
+	0xCB,				// WAI
+	0x80, 0xFD,			// BRA -3
+	// nmi, $8015
+	0xC2, 0x20,			// REP #$20
+	0xA5, 0x10,			// LDA $10
+	0x1A,				// INC A
+	0x85, 0x10,			// STA $10
+	0xE2, 0x20,			// SEP #$20
+	0xAD, 0x10, 0x42,	// LDA $4210
+	0x40,				// RTI
+	// irq, $8022
+	0xC2, 0x20,			// REP #$20
+	0xA5, 0x12,			// LDA $12
+	0x1A,				// INC A
+	0x85, 0x12,			// STA $12
+	0xE2, 0x20,			// SEP #$20
+	0xAD, 0x11, 0x42,	// LDA $4211
+	0x40				// RTI
+};
+
+static std::string writeWaitROM(byte nmitimen, byte htime, byte vtime, bool wait) {
+	std::vector<byte> rom(0x8000, 0xEA);
+	std::copy(wait_loop, wait_loop + sizeof(wait_loop), rom.begin());
+	rom[3] = vtime;
+	rom[8] = htime;
+	rom[13] = nmitimen;
+	if(!wait) rom[18] = 0xEA;
+	// native nmi and irq vectors
+	rom[0x7FEA] = 0x15;
+	rom[0x7FEB] = 0x80;
+	rom[0x7FEE] = 0x22;
+	rom[0x7FEF] = 0x80;
+	return writeBenchROM(rom.data(), rom.size());
+}
+
+// each kind of interrupt has to come exactly as often as the raster says,
+// and be taken once each time, at the same times whatever the sync interval
+// and with the apu on its own thread. then frames of a program that only waits for
+// the nmi, against the same program spinning instead
+static void benchInterrupts(size_t frames) {
+	uint64_t frame_cycles = (uint64_t)PPU_CYCLES_PER_LINE * PPU_LINES_PER_FRAME;
+	struct CHECK {
+		const char* name;
+		byte nmitimen;
+		uint64_t nmis;
+		uint64_t irqs;
+	};
+	const uint64_t checked = 10;
+	const CHECK checks[] = {
+		{"nmi", 0x80, checked, 0}, {"v-irq", 0xA0, checked, checked},
+		{"h-irq", 0x10, 0, checked * PPU_LINES_PER_FRAME}, {"hv-irq", 0x30, 0, checked}
+	};
+	bool timed = true;
+	for(const CHECK& check : checks) {
+		std::string path = writeWaitROM(check.nmitimen, 200, 100, true);
+		std::unique_ptr<SNES> machine = loadMachine(path);
+		machine->run(checked * frame_cycles);
+		std::unique_ptr<SNES> other = loadMachine(path);
+		other->setSyncInterval(MAX_SYNC_INTERVAL);
+		other->setThreadedAPU(true);
+		other->run(checked * frame_cycles);
+		other->setThreadedAPU(false);
+		unlink(path.c_str());
+
+		SNES_MEMORY* mem = machine->getMemory();
+		SNES_INTERRUPTS& interrupts = mem->interrupts;
+		uint64_t nmis = mem->read16(0x7E0010);
+		uint64_t irqs = mem->read16(0x7E0012);
+		// the first h-irq may go by while the timer is being set up
+		bool ok = machineHash(*machine) == machineHash(*other) && nmis == check.nmis && interrupts.getNMIs() == nmis && interrupts.getIRQs() == irqs
+			&& irqs <= check.irqs && irqs + (check.nmitimen == 0x10 ? 1 : 0) >= check.irqs;
+		if(!ok) {
+			std::cout << "interrupts " << check.name << ": " << nmis << " nmis, " << irqs << " irqs taken, "
+			<< interrupts.getNMIs() << " and " << interrupts.getIRQs() << " raised, FAILED" << std::endl;
+		}
+		timed &= ok;
+	}
+	std::cout << "interrupts " << (timed ? "ok" : "FAILED") << std::endl;
+	if(!timed) exit(1);
+
+	size_t per_run = std::max((size_t)1, frames / bench_runs);
+	for(bool wait : {true, false}) {
+		std::string path = writeWaitROM(0x80, 0, 0, wait);
+		bench_stats stats = repeat([&]() {
+			std::unique_ptr<SNES> machine = loadMachine(path);
+			auto start = std::chrono::steady_clock::now();
+			machine->run(per_run * frame_cycles);
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		});
+		record(wait ? "idle frames waiting" : "idle frames spinning", stats, per_run, "frame");
+		unlink(path.c_str());
+	}
+}
+
+// a main loop that sets a flag at $10 and polls it until the nmi handler
+// clears it, counting frames at $12, as games wait for vblank
+static const byte poll_loop[] = {
+	0x18,				// CLC
+	0xFB,				// XCE
+	0xA9, 0x80,			// LDA #$80
+	0x8D, 0x00, 0x42,	// STA $4200
+	0xA9, 0x01,			// LDA #$01
+	0x85, 0x10,			// STA $10
+	0xA5, 0x10,			// LDA $10
+	0xD0, 0xFC,			// BNE -4
+	0xC2, 0x20,			// REP #$20
+	0xA5, 0x12,			// LDA $12
+	0x1A,				// INC A
+	0x85, 0x12,			// STA $12
+	0xE2, 0x20,			// SEP #$20
+	0x80, 0xED,			// BRA -19
+	// nmi, $801A
+	0xA9, 0x00,			// LDA #$00
+	0x85, 0x10,			// STA $10
+	0xAD, 0x10, 0x42,	// LDA $4210
+	0x40				// RTI
+};
+
+// skipping the polling has to leave the machine as running it does, in the
+// interpreter and the jit, and with the batches it stretches to the next
+// nmi, whatever the sync interval and with the apu on its own thread. a
+// loop polling the apu's ports (through the slow path) is never skipped.
+// then frames of the polling program with the skipping on and off
+static void benchIdleSkip(size_t frames) {
+	uint64_t frame_cycles = (uint64_t)PPU_CYCLES_PER_LINE * PPU_LINES_PER_FRAME;
+	std::vector<byte> rom(0x8000, 0xEA);
+	std::copy(poll_loop, poll_loop + sizeof(poll_loop), rom.begin());
+	rom[0x7FEA] = 0x1A;
+	rom[0x7FEB] = 0x80;
+	std::string path = writeBenchROM(rom.data(), rom.size());
+
+	const uint64_t checked = 10;
+	std::unique_ptr<SNES> polled = loadMachine(path);
+	polled->setIdleSkip(false);
+	polled->run(checked * frame_cycles);
+	std::unique_ptr<SNES> skipped = loadMachine(path);
+	skipped->run(checked * frame_cycles);
+	uint64_t reference = machineHash(*polled);
+	bool ok = machineHash(*skipped) == reference && polled->getSkippedCycles() == 0
+		&& skipped->getSkippedCycles() > 0 && skipped->getMemory()->read16(0x7E0012) == checked;
+	if(SNES_JIT::supported()) {
+		std::unique_ptr<SNES> native = loadMachine(path);
+		native->setJIT(true);
+		native->run(checked * frame_cycles);
+		ok &= machineHash(*native) == reference && native->getSkippedCycles() > 0;
+	}
+	std::unique_ptr<SNES> spread = loadMachine(path);
+	spread->setSyncInterval(MAX_SYNC_INTERVAL);
+	spread->setThreadedAPU(true);
+	spread->run(checked * frame_cycles);
+	spread->setThreadedAPU(false);
+	ok &= machineHash(*spread) == reference && spread->getSkippedCycles() > 0;
+	std::string upload = writeUploadROM();
+	std::unique_ptr<SNES> ports = loadMachine(upload);
+	ports->run(checked * frame_cycles);
+	ok &= ports->getSkippedCycles() == 0;
+	unlink(upload.c_str());
+
+	std::cout << "idle skip " << (ok ? "ok" : "FAILED") << ", "
+	<< std::fixed << std::setprecision(1) << 100.0 * skipped->getSkippedCycles() / skipped->getTime()
+	<< "% of cycles skipped" << std::endl;
+	if(!ok) {
+		unlink(path.c_str());
+		exit(1);
+	}
+
+	size_t per_run = std::max((size_t)1, frames / bench_runs);
+	for(bool skip : {true, false}) {
+		bench_stats stats = repeat([&]() {
+			std::unique_ptr<SNES> machine = loadMachine(path);
+			machine->setIdleSkip(skip);
+			auto start = std::chrono::steady_clock::now();
+			machine->run(per_run * frame_cycles);
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		});
+		record(skip ? "idle frames polling, skipped" : "idle frames polling", stats, per_run, "frame");
+	}
+	unlink(path.c_str());
+}
+
+// a subroutine called from a loop, for the profiler's call stacks
+static const byte call_loop[] = {
+	0x20, 0x08, 0x80,	// JSR $8008
+	0xE8,				// INX
+	0x80, 0xFA,			// BRA -6
+	0xEA, 0xEA,			// NOP NOP
+	0x18,				// CLC
+	0x69, 0x01,			// ADC #$01
+	0x60				// RTS
+};
+
+// cycles past the base costs of its instructions: the D cycle, an index
+// crossing into the next bank, a branch taken and not, and a block move
+static const byte extras_loop[] = {
+	0x18,				// CLC
+	0xFB,				// XCE
+	0xC2, 0x30,			// REP #$30
+	0xA9, 0x01, 0x00,	// LDA #$0001
+	0x5B,				// TCD
+	0xA2, 0x00, 0x00,	// LDX #$0000
+	0xA5, 0x10,			// LDA $10
+	0x7D, 0xF0, 0xFF,	// ADC $FFF0,X
+	0x85, 0x10,			// STA $10
+	0xE8,				// INX
+	0xE0, 0x20, 0x00,	// CPX #$0020
+	0xD0, 0xF3,			// BNE -13
+	0xA2, 0x00, 0x01,	// LDX #$0100
+	0xA0, 0x00, 0x02,	// LDY #$0200
+	0xA9, 0x03, 0x00,	// LDA #$0003
+	0x54, 0x7E, 0x7E,	// MVN $7E,$7E
+	0x80, 0xE2			// BRA -30
+};
+
+// the block cache and the jit with and without the profiler, and a check
+// that it counted every instruction, gave each its own cycles and followed
+// the calls
+static void benchProfiler(size_t instructions) {
+	uint64_t master_cycles = instructions / bench_runs * 2 * MASTER_CYCLES_PER_CPU_CYCLE;
+	std::string path = writeBenchROM(alu_loop, sizeof(alu_loop));
+	SNES_PROFILER profiler;
+	bool counted = true;
+	for(bool jit : {false, true}) {
+		if(jit && !SNES_JIT::supported()) break;
+		bench_stats times[2];
+		uint64_t executed = 0;
+		for(bool profiled : {false, true}) {
+			times[profiled] = repeat([&]() {
+				CPU_APU_IO io;
+				SNES_CPU cpu(&io);
+				loadBenchROM(cpu, path);
+				cpu.setJIT(jit);
+				profiler.clear();
+				if(profiled) cpu.profiler = &profiler;
+
+				auto start = std::chrono::steady_clock::now();
+				cpu.runUntil(master_cycles);
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				executed = cpu.getInstructions();
+				cpu.flushProfile();
+				return seconds;
+			});
+			record(std::string("cpu alu_loop ") + (jit ? "jit " : "") + (profiled ? "profiled" : "unprofiled"), times[profiled], executed, "instruction");
+		}
+		uint64_t count = 0;
+		for(int op = 0; op < 256; op++)
+			count += profiler.getCount(op);
+		counted &= count == executed && profiler.getSamples() > 0;
+		// best runs, the medians of short runs wander further than the difference
+		std::cout << "profiler overhead" << (jit ? " with the jit: " : ": ") << std::fixed << std::setprecision(1)
+		<< (times[1].min / times[0].min - 1) * 100 << "% (best of " << bench_runs << ")" << std::endl;
+	}
+	unlink(path.c_str());
+
+	path = writeBenchROM(call_loop, sizeof(call_loop));
+	CPU_APU_IO io;
+	SNES_CPU cpu(&io);
+	loadBenchROM(cpu, path);
+	profiler.setPeriod(7);
+	cpu.profiler = &profiler;
+	cpu.runUntil(200000);
+	cpu.flushProfile();
+	unlink(path.c_str());
+
+	std::ostringstream folded;
+	profiler.writeFolded(folded);
+	bool ok = counted && folded.str().find("reset;00:8008 ") != std::string::npos
+		&& folded.str().find("reset;00:8008;") == std::string::npos && profiler.getCount(0x20) == profiler.getCount(0x60) + 1;
+
+	// stepped one at a time, then in cached blocks, then natively
+	path = writeBenchROM(extras_loop, sizeof(extras_loop));
+	SNES_PROFILER profiles[3];
+	int modes = SNES_JIT::supported() ? 3 : 2;
+	for(int mode = 0; mode < modes; mode++) {
+		CPU_APU_IO io;
+		SNES_CPU cpu(&io);
+		loadBenchROM(cpu, path);
+		cpu.setBlockCache(mode > 0);
+		cpu.setJIT(mode == 2);
+		cpu.profiler = &profiles[mode];
+		cpu.runUntil(master_cycles);
+		cpu.flushProfile();
+	}
+	unlink(path.c_str());
+	bool exact = true;
+	for(int mode = 1; mode < modes; mode++)
+		for(int op = 0; op < 256; op++)
+			exact &= profiles[mode].getCount(op) == profiles[0].getCount(op) && profiles[mode].getCycles(op) == profiles[0].getCycles(op);
+	ok &= exact;
+	std::cout << "profiler " << (ok ? "counts ok" : "FAILED") << (exact ? "" : "  CYCLES MISPLACED") << std::endl;
+	if(!ok) exit(1);
+}
+
+// an idle loop for the machine to sit in while registers are poked
+static const byte idle_loop[] = {
+	0x80, 0xFE			// BRA -2
+};
+
+static void dmaChannel(SNES_MEMORY* mem, int c, byte dmap, byte bbad, threebyte addr, twobyte size) {
+	twobyte base = 0x4300 + (c << 4);
+	mem->write8(0, base, dmap);
+	mem->write8(0, base + 1, bbad);
+	mem->write8(0, base + 2, addr & 0xFF);
+	mem->write8(0, base + 3, (addr >> 8) & 0xFF);
+	mem->write8(0, base + 4, addr >> 16);
+	mem->write8(0, base + 5, size & 0xFF);
+	mem->write8(0, base + 6, size >> 8);
+}
+
+// every kind of general purpose transfer with and without the block copies,
+// which have to leave the same memories and take the same cycles: to VRAM,
+// CGRAM, OAM and the WRAM port, a fill, and VRAM, CGRAM and OAM read back
+// into WRAM to compare them. then an hdma table feeding the WRAM port
+static void benchDMA(size_t transfers) {
+	std::string path = writeBenchROM(idle_loop, sizeof(idle_loop));
+	uint64_t hashes[2];
+	for(bool fast : {false, true}) {
+		std::unique_ptr<SNES> machine = loadMachine(path);
+		SNES_MEMORY* mem = machine->getMemory();
+		mem->dma.setFastPaths(fast);
+		for(threebyte addr = 0x7F0000; addr < 0x800000; addr++)
+			mem->write8(addr >> 16, addr & 0xFFFF, (addr * 7) ^ (addr >> 9));
+
+		mem->write8(0, 0x2115, 0x80);
+		mem->write8(0, 0x2116, 0x00);
+		mem->write8(0, 0x2117, 0x00);
+		dmaChannel(mem, 0, 0x01, 0x18, 0x7F0001, 0x8001);
+		mem->write8(0, 0x2121, 0x00);
+		dmaChannel(mem, 1, 0x00, 0x22, 0x7F8000, 0x0200);
+		mem->write8(0, 0x2102, 0x00);
+		mem->write8(0, 0x2103, 0x00);
+		dmaChannel(mem, 2, 0x00, 0x04, 0x7F9000, 0x0220);
+		mem->write8(0, 0x2181, 0x00);
+		mem->write8(0, 0x2182, 0x40);
+		mem->write8(0, 0x2183, 0x00);
+		dmaChannel(mem, 3, 0x00, 0x80, 0x008000, 0x8000);
+		dmaChannel(mem, 4, 0x09, 0x18, 0x7F0005, 0x1000);
+		mem->write8(0, 0x420B, 0x1F);
+
+		// reading VRAM starts from the prefetched word
+		mem->write8(0, 0x2116, 0x00);
+		mem->write8(0, 0x2117, 0x00);
+		dmaChannel(mem, 0, 0x81, 0x39, 0x7E8000, 0x0000);
+		mem->write8(0, 0x2121, 0x00);
+		dmaChannel(mem, 1, 0x80, 0x3B, 0x7E2000, 0x0200);
+		mem->write8(0, 0x2102, 0x00);
+		mem->write8(0, 0x2103, 0x00);
+		dmaChannel(mem, 2, 0x80, 0x38, 0x7E2200, 0x0220);
+		mem->write8(0, 0x420B, 0x07);
+		hashes[fast] = machineHash(*machine);
+
+		if(!fast) continue;
+		bool blocks = mem->dma.getBlockBytes() == 0x8001 + 0x200 + 0x220 + 0x8000 + 0x1000;
+
+		// the ppu catches up with the transfers' cycles first, at the end of
+		// a run of an instruction
+		machine->run(MASTER_CYCLES_PER_CPU_CYCLE);
+
+		// hdma through the WRAM port: a direct table of single bytes on channel
+		// 1, and an indirect one of pairs on channel 2
+		static const byte direct[] = {0x85, 1, 2, 3, 4, 5, 0x02, 6, 0x81, 7, 0x00};
+		static const byte indirect[] = {0x83, 0x00, 0x11, 0x00};
+		static const byte expected[] = {1, 0x11, 0x12, 2, 0x13, 0x14, 3, 0x15, 0x16, 4, 5, 6, 7, 0};
+		for(size_t i = 0; i < sizeof(direct); i++) mem->write8(0x7E, 0x1000 + i, direct[i]);
+		for(size_t i = 0; i < sizeof(indirect); i++) mem->write8(0x7E, 0x1080 + i, indirect[i]);
+		for(int i = 0; i < 6; i++) mem->write8(0x7E, 0x1100 + i, 0x11 + i);
+		dmaChannel(mem, 1, 0x00, 0x80, 0x7E1000, 0);
+		dmaChannel(mem, 2, 0x42, 0x80, 0x7E1080, 0);
+		mem->write8(0, 0x4327, 0x7E);
+		mem->write8(0, 0x2181, 0x00);
+		mem->write8(0, 0x2182, 0x30);
+		mem->write8(0, 0x2183, 0x00);
+		mem->write8(0, 0x420C, 0x06);
+		// to the end of the next frame's hdma
+		uint64_t frame_cycles = (uint64_t)PPU_CYCLES_PER_LINE * PPU_LINES_PER_FRAME;
+		machine->run(frame_cycles + 240 * PPU_CYCLES_PER_LINE - machine->getTime() % frame_cycles);
+		mem->write8(0, 0x420C, 0x00);
+		bool hdma = true;
+		for(size_t i = 0; i < sizeof(expected); i++)
+			hdma &= mem->read8(0x7E, 0x3000 + i) == expected[i];
+
+		std::cout << "dma " << (hashes[0] == hashes[1] ? "block copies match" : "MISMATCH")
+		<< (blocks ? "" : ", BLOCK COPIES NOT TAKEN") << ", hdma " << (hdma ? "ok" : "FAILED") << std::endl;
+		if(hashes[0] != hashes[1] || !blocks || !hdma) exit(1);
+	}
+
+	// 32 KB from WRAM to VRAM, as games do in vblank
+	for(bool fast : {false, true}) {
+		std::unique_ptr<SNES> machine = loadMachine(path);
+		SNES_MEMORY* mem = machine->getMemory();
+		mem->dma.setFastPaths(fast);
+		size_t per_run = std::max((size_t)1, transfers / bench_runs);
+		bench_stats stats = repeat([&]() {
+			auto start = std::chrono::steady_clock::now();
+			for(size_t i = 0; i < per_run; i++) {
+				mem->write8(0, 0x2115, 0x80);
+				mem->write8(0, 0x2116, 0x00);
+				mem->write8(0, 0x2117, 0x00);
+				dmaChannel(mem, 0, 0x01, 0x18, 0x7E8000, 0x8000);
+				mem->write8(0, 0x420B, 0x01);
+			}
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		});
+		record(fast ? "dma wram to vram block copies" : "dma wram to vram bytewise", stats, per_run * 0x8000, "byte");
+	}
+	unlink(path.c_str());
+}
+
+// the plain bench binary has tracing compiled out; bench_trace (make bench-trace)
+// compiles it in, so its "tracing off" run against "cpu alu_loop" from the plain
+// binary is the cost of the runtime checks alone
+static void benchTracing(size_t instructions) {
+#ifdef SNES_TRACE
+	SNES_TRACER tracer(1 << 20);
+	benchCPU(instructions, &tracer, "trace compiled in, tracing off");
+
+	tracer.configure("cpu=1");
+	tracer.open("/dev/null");
+	benchCPU(instructions / 10, &tracer, "trace cpu=1");
+	tracer.close();
+
+	tracer.configure("cpu=1,mem=2");
+	tracer.open("/dev/null");
+	benchCPU(instructions / 10, &tracer, "trace cpu=1,mem=2");
+	tracer.close();
+
+	tracer.configure("cpu=0,mem=0,apu=2");
+	tracer.open("/dev/null");
+	benchSPC(instructions / 20000000.0, &tracer, "trace apu=2");
+	tracer.close();
+#else
+	std::cout << "trace compiled out, run make bench-trace for the tracing overhead" << std::endl;
+#endif
+}
+
+// bench [instructions] [--runs=n] [--json=file]
+//
+// every kernel runs --runs times (5 by default) on its share of the work and
+// reports the median with the spread. --json also writes a line per kernel
+// for scripts comparing builds
+int main(int argc, char** argv) {
+	size_t instructions = 20000000;
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if(arg.compare(0, 7, "--runs=") == 0) {
+			bench_runs = std::max(1, atoi(arg.c_str() + 7));
+		} else if(arg.compare(0, 7, "--json=") == 0) {
+			bench_json.open(arg.substr(7));
+			if(!bench_json) {
+				std::cout << "bench: could not open " << arg.substr(7) << std::endl;
+				return 1;
+			}
+		} else {
+			instructions = strtoull(arg.c_str(), NULL, 10);
+		}
+	}
+
+	// runs first so the RSS numbers aren't hidden by memory freed back to the allocator
+	benchROMLoad(16);
+	benchCPU(instructions);
+	benchMixes(instructions);
+	benchMoves();
+	benchProfiler(instructions);
+	benchBlockCache(instructions);
+	benchJIT(instructions);
+	benchSnapshot(instructions / 10);
+	benchTracing(instructions);
+	benchScheduler(instructions);
+	benchSPC(instructions / 2000000.0);
+	benchDSP(instructions / 10);
+	benchPPU(instructions / 20000);
+	benchAPUThread(instructions / 50);
+	benchState(instructions / 50);
+	benchFrames(instructions / 100000);
+	benchInterrupts(instructions / 20000);
+	benchIdleSkip(instructions / 20000);
+	benchDMA(instructions / 10000);
+	benchMemory(instructions * 5);
+	return 0;
+}
@@ -4,21 +4,28 @@
 class SNES_MEMORY;
 #include "ram.hpp"
 #include "cpu_apu_io.hpp"
+#include "jit.hpp"
+#include "profile.hpp"
+#include "state.hpp"
 
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 
-SNES_CPU::SNES_CPU(CPU_APU_IO* apu_io) {
+SNES_CPU::SNES_CPU(CPU_APU_IO* apu_io) : apu_io(apu_io) {
 	mem = new SNES_MEMORY(apu_io);
+	mem->cpu = this;
+	code_pages.resize(MEM_PAGE_COUNT);
 }
 
 SNES_CPU::~SNES_CPU() {
-	//nothing yet
+	delete jit;
 }
 
 void SNES_CPU::init() {
-	status.full = 0x00;
+	setStatus(0x00);
 	e = 1;
 	status.bits.m = 1;
 	status.bits.x = 1;
@@ -26,42 +33,470 @@ void SNES_CPU::init() {
 	DBR = 0x00;
 	PC = mem->reset_vector();
 	*SH = 0x01;
+	nmi_pending = false;
+	waiting = false;
+	stopped = false;
+	idle_spin = false;
+	updateRegisterWidths();
+	// a new ROM may have been loaded
+	flushCode();
+}
+
+uint32_t SNES_CPU::step() {
+	if(halted) return 0;
+
+	byte k = K;
+	decoded_op op = decode(PC);
+	uint32_t cycles = execute(op, k);
+	if(profiler) profiler->instruction(op.opcode, (k << 16) | op.pc, cycles, (K << 16) | PC);
+	return cycles;
+}
+
+// fetches the opcode and its operand bytes at K:pc, leaving pc after them
+SNES_CPU::decoded_op SNES_CPU::decode(twobyte& pc) {
+	decoded_op op;
+	op.pc = pc;
+	op.opcode = mem->readROM8(K, pc);
+	op.inst = &ops[op.opcode];
+
+	switch(op.inst->length) {
+		case 1: op.operand = mem->readROM8(K, pc); break;
+		case 2: op.operand = mem->readROM16(K, pc); break;
+		case 3: op.operand = mem->readROM24(K, pc); break;
+		default: op.operand = 0; break;
+	}
+	op.next = pc;
+	return op;
 }
 
-bool SNES_CPU::clock() {
-	if(cyclesRemaining == 0) {
-		// check for m/x/e flags
-		updateRegisterWidths();
+// PC already points past the instruction
+uint32_t SNES_CPU::execute(const decoded_op& op, byte k) {
+	const instruction& inst = *op.inst;
+	operand = op.operand;
 
-		// get opcode
-		byte opcode = mem->readROM8(K, PC);
-		
-		// fetch data based on addressing mode
-		(this->ops[opcode]).mode();
-		// execute op
-		(this->ops[opcode]).op();
-		
-		cyclesRemaining += (this->ops[opcode].cycleCount)();
+	// fetch data based on addressing mode
+	(this->*inst.mode)();
+	// execute op
+	(this->*inst.op)();
+	
+	uint32_t cycles = cycleCount(inst);
+	instructions++;
 
-		iBoundary = false;
-		branchTaken = false;
-		branchBoundary = false;
-		wrap_writes = false;
-		
-#ifdef DEBUG
-		std::cout << "-- executed opcode 0x" << std::hex << (unsigned int)opcode << std::dec << " (" << (this->ops[opcode]).name << ")" << std::endl;
-		debugPrint();
-#endif
+	iBoundary = false;
+	branchTaken = false;
+	branchBoundary = false;
+	wrap_writes = false;
+	
+	TRACE(tracer, TRACE_CPU, TRACE_INFO, TRACE_EV_OPCODE, op.opcode, (k << 16) | op.pc, C, X, Y,
+		S | (D << 16), getStatus() | (e << 8) | (DBR << 16));
+	if(halted) {
+		*mem->log << "halted on unimplemented opcode 0x" << std::hex << HEX_BYTE_PRINT(op.opcode) << std::dec << std::endl;
 	}
-	cyclesRemaining--;
+	return cycles;
+}
+
+bool SNES_CPU::runUntil(uint64_t target) {
+	run_target = target;
+	while(time < run_target) {
+		// either line wakes a WAI, an irq even with I set, which carries on
+		// after the WAI without taking it
+		if((nmi_pending || irq_line) && !stopped) {
+			waiting = false;
+			if(nmi_pending) {
+				nmi_pending = false;
+				idle_spin = false;
+				nmi();
+			} else if(!status.bits.i) {
+				idle_spin = false;
+				irq();
+			}
+		}
+		// the scheduler ends the batch at the next event, nothing happens before
+		if(waiting || stopped) {
+			time = run_target;
+			break;
+		}
+
+		if(block_cache) {
+			runBlock(run_target);
+			if(halted) return false;
+			continue;
+		}
+		idle_spin = false;
+		uint32_t cycles = step();
+		if(halted) return false;
+		time += cycles * MASTER_CYCLES_PER_CPU_CYCLE;
+	}
+	// pick up what the apu wrote during the batch
+	apu_io->updateCPU();
 	return true;
 }
 
+uint64_t SNES_CPU::run(uint64_t cycle_budget) {
+	uint64_t start = time;
+	runUntil(time + cycle_budget);
+	return time - start;
+}
+
+//
+// block cache
+//
+
+void SNES_CPU::setBlockCache(bool enabled) {
+	block_cache = enabled;
+	flushCode();
+}
+
+void SNES_CPU::invalidateCode(size_t page) {
+	if(code_pages[page].empty()) return;
+	retired_code.push_back(std::move(code_pages[page]));
+	code_pages[page].clear();
+	code_invalidations++;
+}
+
+void SNES_CPU::flushCode() {
+	for(size_t page = 0; page < code_pages.size(); page++)
+		invalidateCode(page);
+}
+
+SNES_CPU::code_block* SNES_CPU::findBlock() {
+	threebyte addr = (K << 16) | PC;
+	code_page& page = code_pages[addr >> MEM_PAGE_BITS];
+	uint32_t key = (addr << 2) | widths;
+
+	auto found = page.find(key);
+	if(found != page.end()) return &found->second;
+
+	// code running from the registers is never cached
+	if(!mem->watchCode(addr)) return nullptr;
+
+	code_block& block = page[key];
+	twobyte pc = PC;
+	while(block.code.size() < CPU_MAX_BLOCK) {
+		const instruction& inst = ops[mem->read8(K, pc)];
+		if((pc & MEM_PAGE_MASK) + inst.length > MEM_PAGE_MASK) break;
+
+		block.code.push_back(decode(pc));
+		if(inst.endsBlock) break;
+	}
+
+	// the first instruction crosses into the next page
+	if(block.code.empty()) {
+		page.erase(key);
+		return nullptr;
+	}
+
+	block.idle = block.code.back().inst->endsBlock;
+	for(const decoded_op& op : block.code)
+		block.idle &= op.inst->readOnly;
+	return &block;
+}
+
+// runs the block at K:PC, stopping early at target like runUntil() would
+void SNES_CPU::runBlock(uint64_t target) {
+	if(profiler && !retired_code.empty()) profileRetired();
+	retired_code.clear();
+
+	code_block* block = findBlock();
+	if(!block) {
+		idle_spin = false;
+		uint32_t cycles = step();
+		if(!halted) time += cycles * MASTER_CYCLES_PER_CPU_CYCLE;
+		return;
+	}
+
+	// traced runs see every pass
+	bool idle = block->idle && idle_skip && !tracer && !mem->tracer;
+	SNES_CPU_REGISTERS before;
+	uint64_t start = time, slow_reads = 0;
+	threebyte addr = (K << 16) | PC;
+	if(idle) {
+		before = getRegisters();
+		slow_reads = mem->getSlowReads();
+	} else {
+		idle_spin = false;
+	}
+
+	if(jit && runNative(*block, target)) {
+		if(idle) skipIdle(*block, before, start, slow_reads);
+		return;
+	}
+
+	uint64_t invalidations = code_invalidations;
+	byte k = K;
+	size_t executed = 0;
+	uint64_t cycles = 0;
+	bool whole = false;
+	uint64_t* extras = nullptr;
+	if(profiler) {
+		if(block->exits.empty()) profileAlloc(*block);
+		extras = block->extras.data();
+	}
+	for(const decoded_op& op : block->code) {
+		PC = op.next;
+		uint32_t op_cycles = execute(op, k);
+		if(extras) {
+			uint32_t extra = op_cycles - op.inst->cycles;
+			extras[executed] += extra;
+			if(idle) pass_extras[executed] = extra;
+		}
+		executed++;
+		if(halted) break;
+		cycles += op_cycles;
+		time += op_cycles * MASTER_CYCLES_PER_CPU_CYCLE;
+		whole = executed == block->code.size();
+		// the rest of the block may have just been overwritten
+		if(time >= run_target || code_invalidations != invalidations) break;
+	}
+	if(profiler) profilePass(*block, addr, executed, cycles);
+	if(whole && idle) skipIdle(*block, before, start, slow_reads);
+}
+
+// pass_extras only grows, so it fits every block that has been given its
+// counts
+void SNES_CPU::profileAlloc(code_block& block) {
+	size_t n = block.code.size();
+	block.exits.assign(n, 0);
+	block.native_exits.assign(n, 0);
+	block.extras.assign(n, 0);
+	if(pass_extras.size() < n) pass_extras.resize(n);
+}
+
+inline void SNES_CPU::profilePass(code_block& block, threebyte addr, size_t executed, uint64_t cycles) {
+	if(!executed) return;
+	block.exits[executed - 1]++;
+	profiler->elapse(addr, cycles);
+	// calls and returns end blocks
+	if(executed == block.code.size()) profiler->jump(block.code.back().opcode, (K << 16) | PC);
+}
+
+inline void SNES_CPU::profileNative(code_block& block, threebyte addr, size_t executed, uint64_t cycles) {
+	if(block.exits.empty()) profileAlloc(block);
+	// skipIdle() repeats an idle pass's extras: the D cycle the code was
+	// built for, and a branch at the end taken when the pass takes as long
+	// as the code can
+	if(block.idle) {
+		for(size_t i = 0; i < executed; i++)
+			pass_extras[i] = (block.code[i].inst->cycleMods & CYC_DL) ? block.native_dl : 0;
+		if(executed == block.code.size() && (block.code.back().inst->cycleMods & CYC_BR)
+			&& cycles * MASTER_CYCLES_PER_CPU_CYCLE == block.native_cycles)
+			pass_extras[executed - 1]++;
+	}
+	if(!executed) return;
+	block.native_exits[executed - 1]++;
+	block.native_profile_cycles += cycles;
+	profiler->elapse(addr, cycles);
+	if(executed == block.code.size()) profiler->jump(block.code.back().opcode, (K << 16) | PC);
+}
+
+void SNES_CPU::profileCounts(code_block& block) {
+	if(block.exits.empty()) return;
+
+	// the native code's passes took the D cycle it was built for, and what
+	// they took past that went to taken branches at the end
+	size_t n = block.code.size();
+	uint64_t native = 0, native_base = 0;
+	for(size_t i = n; i-- > 0;) {
+		const instruction& inst = *block.code[i].inst;
+		native += block.native_exits[i];
+		uint32_t dl = (inst.cycleMods & CYC_DL) ? block.native_dl : 0;
+		native_base += native * (inst.cycles + dl);
+		block.extras[i] += native * dl;
+	}
+	if(block.native_profile_cycles > native_base) block.extras[n - 1] += block.native_profile_cycles - native_base;
+
+	// an instruction ran in every pass that ended at it or after it, and
+	// took its base cost in each plus the extras it recorded
+	uint64_t reached = 0;
+	for(size_t i = n; i-- > 0;) {
+		const decoded_op& op = block.code[i];
+		reached += block.exits[i] + block.native_exits[i];
+		if(reached) profiler->count(op.opcode, reached, reached * op.inst->cycles + block.extras[i]);
+	}
+	block.exits.assign(n, 0);
+	block.native_exits.assign(n, 0);
+	block.extras.assign(n, 0);
+	block.native_profile_cycles = 0;
+}
+
+void SNES_CPU::profileRetired() {
+	for(code_page& page : retired_code)
+		for(auto& entry : page)
+			profileCounts(entry.second);
+}
+
+void SNES_CPU::flushProfile() {
+	if(!profiler) return;
+	profileRetired();
+	for(code_page& page : code_pages)
+		for(auto& entry : page)
+			profileCounts(entry.second);
+}
+
+// a pass that ends where it started with every register as it was, having
+// read only plain memory, goes the same way every time until something else
+// writes that memory: an interrupt handler, or hdma. the cpu reports itself
+// idle from then on, so the scheduler runs the batch to the next event, and
+// the passes that fit before the end of the batch are skipped. the last one
+// runs to end the batch where it would have
+void SNES_CPU::skipIdle(code_block& block, const SNES_CPU_REGISTERS& before, uint64_t start, uint64_t slow_reads) {
+	SNES_CPU_REGISTERS after = getRegisters();
+	bool same = after.C == before.C && after.X == before.X && after.Y == before.Y && after.S == before.S
+		&& after.D == before.D && after.PC == before.PC && after.DBR == before.DBR && after.K == before.K
+		&& after.P == before.P && after.e == before.e;
+	idle_spin = same && mem->getSlowReads() == slow_reads && !mem->dma.hdmaWritesMemory();
+	if(!idle_spin || time >= run_target) return;
+
+	uint64_t pass = time - start;
+	uint64_t passes = (run_target - 1 - time) / pass;
+	time += passes * pass;
+	instructions += passes * block.code.size();
+	skipped_cycles += passes * pass;
+	if(profiler && passes) {
+		// each went the way the last one did
+		uint64_t cycles = passes * pass / MASTER_CYCLES_PER_CPU_CYCLE;
+		block.exits.back() += passes;
+		for(size_t i = 0; i < block.code.size(); i++)
+			block.extras[i] += passes * pass_extras[i];
+		profiler->elapse((K << 16) | PC, cycles);
+	}
+}
+
+bool SNES_CPU::setJIT(bool enabled) {
+	if(enabled && !SNES_JIT::supported()) return false;
+
+	if(enabled && !jit) {
+		jit = new SNES_JIT();
+		if(!jit->ready()) {
+			*mem->log << "jit: the host refused executable memory" << std::endl;
+			delete jit;
+			jit = nullptr;
+			return false;
+		}
+	}
+	if(!enabled) {
+		delete jit;
+		jit = nullptr;
+	}
+	flushCode();
+	return true;
+}
+
+bool SNES_CPU::runNative(code_block& block, uint64_t target) {
+	// traced runs see every instruction
+	if(tracer || mem->tracer) return false;
+
+	if(!block.native) {
+		if(++block.hits != JIT_THRESHOLD) return false;
+		if(!jit->compile(this, block)) {
+			// out of room, start over
+			flushCode();
+			jit->reset();
+			return false;
+		}
+		if(!block.native) return false;
+	}
+
+	// the native code doesn't do decimal mode or the D cycle it wasn't built
+	// for, and must not overshoot target by more than its last instruction
+	if(status.bits.d || block.native_dl != DLNONZERO) return false;
+	if(time + block.native_cycles >= target) return false;
+
+	// the native code keeps n and z in status
+	uint64_t start = time;
+	threebyte addr = (K << 16) | PC;
+	status.full = getStatus();
+	uint32_t executed = block.native(this);
+	setStatus(status.full);
+	instructions += executed;
+	if(profiler) profileNative(block, addr, executed, (time - start) / MASTER_CYCLES_PER_CPU_CYCLE);
+	// it stopped before an instruction the interpreter has to run
+	if(executed < block.code.size()) {
+		uint32_t cycles = step();
+		if(profiler && block.idle) pass_extras[executed] = cycles - block.code[executed].inst->cycles;
+		if(!halted) time += cycles * MASTER_CYCLES_PER_CPU_CYCLE;
+	}
+	return true;
+}
+
+void SNES_CPU::setStatus(byte value) {
+	status.full = value;
+	n_result = (value & 0x80) << 8;
+	z_result = !(value & 0x02);
+}
+
+void SNES_CPU::serialize(SNES_STATE& state) {
+	if(!state.begin(STATE_TAG('C', 'P', 'U', ' '), 1)) return;
+
+	byte P = getStatus();
+	state.value(C);
+	state.value(X);
+	state.value(Y);
+	state.value(S);
+	state.value(D);
+	state.value(PC);
+	state.value(DBR);
+	state.value(K);
+	state.value(P);
+	state.value(e);
+	state.value(fetched);
+	state.value(fetched_addr);
+	state.value(operand);
+	state.value(halted);
+	state.value(time);
+	state.value(instructions);
+	state.value(nmi_pending);
+	state.value(irq_line);
+	state.value(waiting);
+	state.value(stopped);
+	state.end();
+
+	mem->serialize(state);
+
+	if(state.loading() && state.ok()) {
+		setStatus(P);
+		updateRegisterWidths();
+		// the restored memory didn't go through the write watches
+		flushCode();
+		idle_spin = false;
+	}
+}
+
+SNES_CPU_REGISTERS SNES_CPU::getRegisters() {
+	SNES_CPU_REGISTERS regs;
+	regs.C = C;
+	regs.X = X;
+	regs.Y = Y;
+	regs.S = S;
+	regs.D = D;
+	regs.PC = PC;
+	regs.DBR = DBR;
+	regs.K = K;
+	regs.P = getStatus();
+	regs.e = e;
+	return regs;
+}
+
+uint32_t SNES_CPU::cycleCount(const instruction& inst) {
+	uint32_t cycles = inst.cycles;
+	byte mods = inst.cycleMods;
+
+	if(mods) {
+		if(mods & CYC_E) cycles += EZERO;
+		if(mods & CYC_DL) cycles += DLNONZERO;
+		if(mods & CYC_IB) cycles += iBoundary;
+		if(mods & CYC_BR) cycles += branchTaken;
+		if(mods & CYC_MV) cycles += 7 * (moved - 1);
+	}
+
+	return cycles;
+}
+
 void SNES_CPU::debugPrint() {
 	std::cout << "status flags: " << std::endl;
 	std::cout << "n v m x d i z c (e)" << std::endl;
 	for(int i = 7; i >= 0; i--)
-		std::cout << getBit(status.full, i) << " ";
+		std::cout << getBit(getStatus(), i) << " ";
 	std::cout << " " << e << std::endl;
 	std::cout << "accumulator: " << C << std::endl;
 	for(int i = 15; i >= 0; i--)
@@ -77,6 +512,7 @@ void SNES_CPU::debugPrint() {
 	std::cout << std::endl;
 }
 
+// must be called whenever m, x or e may have changed (init, REP, SEP, PLP, XCE, RTI)
 void SNES_CPU::updateRegisterWidths() {
 	if(e) {
 		status.bits.m = 1;
@@ -91,6 +527,9 @@ void SNES_CPU::updateRegisterWidths() {
 		*XH = 0x00;
 		*YH = 0x00;
 	}
+
+	widths = (status.bits.m ? 2 : 0) | (status.bits.x ? 1 : 0);
+	ops = opTables[widths].data();
 }
 
 void SNES_CPU::push_stack_threebyte(threebyte value) {
@@ -137,6 +576,7 @@ byte SNES_CPU::pop_stack_byte() {
 // operations
 //
 
+template<bool M8>
 void SNES_CPU::ADC() {
 	if(status.bits.d) {
 		status.bits.c = 0;
@@ -149,7 +589,7 @@ void SNES_CPU::ADC() {
 			upper_nybble_sum++;
 		}
 
-		if(status.bits.m) {
+		if(M8) {
 			if(upper_nybble_sum > 0x09) {
 				upper_nybble_sum += 0x06;
 				upper_nybble_sum &= 0x0F;
@@ -158,8 +598,7 @@ void SNES_CPU::ADC() {
 
 			*A = (upper_nybble_sum << 4) | lower_nybble_sum;
 			
-			status.bits.n = getBit(*A, 7);
-			status.bits.z = (*A == 0x00);
+			setNZ8(*A);
 			return;
 		} else {
 			byte lower_nybble_sum_hi = (*B & 0x0F) + (*fetched_hi & 0x0F);
@@ -185,12 +624,14 @@ void SNES_CPU::ADC() {
 
 			C =  (twobyte)(upper_nybble_sum_hi << 12) | (lower_nybble_sum_hi << 8) | (upper_nybble_sum << 4) | lower_nybble_sum;
 		
-			status.bits.n = getBit(C, 15);
-			status.bits.z = (C = 0x0000);
+			// C ends up 0 with z clear, as it always has
+			n_result = C;
+			z_result = 1;
+			C = 0x0000;
 			return;
 		}
 	} else {
-		if(status.bits.m) {
+		if(M8) {
 			bool final_c = ((twobyte)*A + (*fetched_lo + status.bits.c) > (twobyte)0xFF);
 			bool high_bit_pre_adc = getBit(*A, 7);
 			
@@ -199,8 +640,7 @@ void SNES_CPU::ADC() {
 			
 			status.bits.v = ((high_bit_pre_adc == getBit((*fetched_lo + status.bits.c), 7)) && (high_bit_pre_adc != getBit(*A, 7)));
 			status.bits.c = final_c;
-			status.bits.n = getBit(*A, 7);
-			status.bits.z = (*A == 0x00);
+			setNZ8(*A);
 		} else {
 			bool final_c = ((threebyte)C + (fetched + status.bits.c) > (threebyte)0xFFFF);
 			bool high_bit_pre_adc = getBit(C, 15);
@@ -210,28 +650,27 @@ void SNES_CPU::ADC() {
 			
 			status.bits.v = ((high_bit_pre_adc == getBit((fetched + status.bits.c), 15)) && (high_bit_pre_adc != getBit(C, 15)));
 			status.bits.c = final_c;
-			status.bits.n = getBit(C, 15);
-			status.bits.z = (C == 0x0000);
+			setNZ16(C);
 		}
 	}
 }
 
+template<bool M8>
 void SNES_CPU::AND() {
-	if(status.bits.m) {
+	if(M8) {
 		*A &= *fetched_lo;
 		
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		C &= fetched;
 		
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::ASL() {
-	if(status.bits.m) {
+	if(M8) {
 		byte data = *fetched_lo;
 		
 		status.bits.c = getBit(data, 7);
@@ -239,8 +678,7 @@ void SNES_CPU::ASL() {
 		
 		mem->write8(*fetched_addr_bank, *fetched_addr_abs, data);
 		
-		status.bits.n = getBit(data, 7);
-		status.bits.z = (data == 0x00);
+		setNZ8(data);
 	} else {
 		twobyte data = fetched;
 		
@@ -249,29 +687,28 @@ void SNES_CPU::ASL() {
 		
 		mem->write16(*fetched_addr_bank, *fetched_addr_abs, data, wrap_writes);
 		
-		status.bits.n = getBit(data, 15);
-		status.bits.z = (data == 0x0000);
+		setNZ16(data);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::ASLA() {
-	if(status.bits.m) {
+	if(M8) {
 		status.bits.c = getBit(*A, 7);
 		*A <<= 1;
 		
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		status.bits.c = getBit(C, 15);
 		C <<= 1;
 		
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::LSR() {
-	if(status.bits.m) {
+	if(M8) {
 		byte data = *fetched_lo;
 		
 		status.bits.c = getBit(data, 0);
@@ -279,8 +716,7 @@ void SNES_CPU::LSR() {
 		
 		mem->write8(*fetched_addr_bank, *fetched_addr_abs, data);
 		
-		status.bits.n = getBit(data, 7);
-		status.bits.z = (data == 0x00);
+		setNZ8(data);
 	} else {
 		twobyte data = fetched;
 		
@@ -289,24 +725,22 @@ void SNES_CPU::LSR() {
 		
 		mem->write16(*fetched_addr_bank, *fetched_addr_abs, data, wrap_writes);
 		
-		status.bits.n = getBit(data, 15);
-		status.bits.z = (data == 0x0000);
+		setNZ16(data);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::LSRA() {
-	if(status.bits.m) {
+	if(M8) {
 		status.bits.c = getBit(*A, 0);
 		*A >>= 1;
 		
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		status.bits.c = getBit(C, 0);
 		C >>= 1;
 		
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
@@ -325,60 +759,62 @@ void SNES_CPU::BCS() {
 }
 
 void SNES_CPU::BEQ() {
-	if(status.bits.z){
+	if(flagZ()){
 		PC += *fetched_lo;
 		branchTaken = true;
 	} else branchTaken = false;
 }
 
+template<bool M8>
 void SNES_CPU::BIT() {
-	if(status.bits.m) {
+	if(M8) {
 		byte data = *A;
 		data &= *fetched_lo;
 		
-		status.bits.n = getBit(*A, 7);
+		n_result = *A << 8;
 		status.bits.v = getBit(*A, 6);
-		status.bits.z = (data == 0x00);
+		z_result = data;
 	} else {
 		twobyte data = C;
 		data &= fetched;
 		
-		status.bits.n = getBit(C, 15);
+		n_result = C;
 		status.bits.v = getBit(C, 14);
-		status.bits.z = (data == 0x0000);
+		z_result = data;
 	}
 }
 
+template<bool M8>
 void SNES_CPU::BITIMM() {
-	if(status.bits.m) {
+	if(M8) {
 		byte data = *A;
 		data &= *fetched_lo;
 		
-		status.bits.z = (data == 0x00);
+		z_result = data;
 	} else {
 		twobyte data = C;
 		data &= fetched;
 		
-		status.bits.z = (data == 0x0000);
+		z_result = data;
 	}
 }
 
 void SNES_CPU::BMI() {
-	if(status.bits.n){
+	if(flagN()){
 		PC += (signedbyte)*fetched_lo;
 		branchTaken = true;
 	} else branchTaken = false;
 }
 
 void SNES_CPU::BNE() {
-	if(!status.bits.z){
+	if(!flagZ()){
 		PC += (signedbyte)*fetched_lo;
 		branchTaken = true;
 	} else branchTaken = false;
 }
 
 void SNES_CPU::BPL() {
-	if(!status.bits.n){
+	if(!flagN()){
 		PC += (signedbyte)*fetched_lo;
 		branchTaken = true;
 	} else branchTaken = false;
@@ -411,7 +847,7 @@ void SNES_CPU::BVS() {
 void SNES_CPU::BRK() {
 	push_stack_byte(K);
 	push_stack_twobyte(PC);
-	push_stack_byte(status.full);
+	push_stack_byte(getStatus());
 
 	DBR = 0x00;
 
@@ -425,7 +861,7 @@ void SNES_CPU::BRK() {
 void SNES_CPU::COP() {
 	push_stack_byte(K);
 	push_stack_twobyte(PC);
-	push_stack_byte(status.full);
+	push_stack_byte(getStatus());
 
 	DBR = 0x00;
 
@@ -436,6 +872,30 @@ void SNES_CPU::COP() {
 	PC = mem->cop_vector();
 }
 
+void SNES_CPU::nmi() {
+	interrupt(mem->nmi_vector(e));
+}
+
+void SNES_CPU::irq() {
+	interrupt(mem->irq_vector(e));
+}
+
+// unlike BRK, the status is pushed with B clear in emulation mode and DBR
+// is left alone
+void SNES_CPU::interrupt(twobyte vector) {
+	if(!e) push_stack_byte(K);
+	push_stack_twobyte(PC);
+	push_stack_byte(e ? getStatus() & ~0x10 : getStatus());
+
+	status.bits.d = 0;
+	status.bits.i = 1;
+
+	K = 0x00;
+	PC = vector;
+	time += (e ? 7 : 8) * MASTER_CYCLES_PER_CPU_CYCLE;
+	if(profiler) profiler->interrupt(PC);
+}
+
 void SNES_CPU::CLC() {
 	status.bits.c = 0;
 }
@@ -452,16 +912,16 @@ void SNES_CPU::CLV() {
 	status.bits.v = 0;
 }
 
+template<bool M8>
 void SNES_CPU::CMP() {
-	if(status.bits.m) {
+	if(M8) {
 		byte A_copy = *A;
 		
 		status.bits.c = (A_copy >= *fetched_lo);
 		
 		A_copy -= *fetched_lo;
 		
-		status.bits.n = getBit(A_copy, 7);
-		status.bits.z = (A_copy == 0x00);
+		setNZ8(A_copy);
 	} else {
 		twobyte C_copy = C;
 		
@@ -469,21 +929,20 @@ void SNES_CPU::CMP() {
 		
 		C_copy -= fetched;
 		
-		status.bits.n = getBit(C_copy, 15);
-		status.bits.z = (C_copy == 0x0000);
+		setNZ16(C_copy);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::CPX() {
-	if(status.bits.x) {
+	if(X8) {
 		byte X_copy = *XL;
 		
 		status.bits.c = (X_copy >= *fetched_lo);
 		
 		X_copy -= *fetched_lo;
 		
-		status.bits.n = getBit(X_copy, 7);
-		status.bits.z = (X_copy == 0x00);
+		setNZ8(X_copy);
 	} else {
 		twobyte X_copy = X;
 		
@@ -491,21 +950,20 @@ void SNES_CPU::CPX() {
 		
 		X_copy -= fetched;
 		
-		status.bits.n = getBit(X_copy, 15);
-		status.bits.z = (X_copy == 0x0000);
+		setNZ16(X_copy);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::CPY() {
-	if(status.bits.x) {
+	if(X8) {
 		byte Y_copy = *YL;
 		
 		status.bits.c = (Y_copy >= *fetched_lo);
 		
 		Y_copy -= *fetched_lo;
 		
-		status.bits.n = getBit(Y_copy, 7);
-		status.bits.z = (Y_copy == 0x00);
+		setNZ8(Y_copy);
 	} else {
 		twobyte Y_copy = Y;
 		
@@ -513,21 +971,20 @@ void SNES_CPU::CPY() {
 		
 		Y_copy -= fetched;
 		
-		status.bits.n = getBit(Y_copy, 15);
-		status.bits.z = (Y_copy == 0x0000);
+		setNZ16(Y_copy);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::DEC() {
-	if(status.bits.m) {
+	if(M8) {
 		byte data = mem->read8(*fetched_addr_bank, *fetched_addr_abs);
 		
 		data--;
 		
 		mem->write8(*fetched_addr_bank, *fetched_addr_abs, data);
 		
-		status.bits.n = getBit(data, 7);
-		status.bits.z = (data == 0x00);
+		setNZ8(data);
 	} else {
 		twobyte data = mem->read16(*fetched_addr_bank, *fetched_addr_abs);
 		
@@ -535,77 +992,72 @@ void SNES_CPU::DEC() {
 		
 		mem->write16(*fetched_addr_bank, *fetched_addr_abs, data);
 		
-		status.bits.n = getBit(data, 15);
-		status.bits.z = (data == 0x0000);
+		setNZ16(data);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::DECA() {
-	if(status.bits.m) {
+	if(M8) {
 		(*A)--;
 		
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		C--;
 		
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::DEX() {
-	if(status.bits.x) {
+	if(X8) {
 		(*XL)--;
 		
-		status.bits.n = getBit(*XL, 7);
-		status.bits.z = (*XL == 0x00);
+		setNZ8(*XL);
 	} else {
 		X--;
 		
-		status.bits.n = getBit(X, 15);
-		status.bits.z = (X == 0x0000);
+		setNZ16(X);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::DEY() {
-	if(status.bits.x) {
+	if(X8) {
 		(*YL)--;
 		
-		status.bits.n = getBit(*YL, 7);
-		status.bits.z = (*YL == 0x00);
+		setNZ8(*YL);
 	} else {
 		Y--;
 		
-		status.bits.n = getBit(Y, 15);
-		status.bits.z = (Y == 0x0000);
+		setNZ16(Y);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::EOR() {
-	if(status.bits.m) {
+	if(M8) {
 		*A ^= *fetched_lo;
 
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		C ^= fetched;
 
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::INC() {
-	if(status.bits.m) {
+	if(M8) {
 		byte data = mem->read8(*fetched_addr_bank, *fetched_addr_abs);
 		
 		data++;
 		
 		mem->write8(*fetched_addr_bank, *fetched_addr_abs, data);
 		
-		status.bits.n = getBit(data, 7);
-		status.bits.z = (data == 0x00);
+		setNZ8(data);
 	} else {
 		twobyte data = mem->read16(*fetched_addr_bank, *fetched_addr_abs);
 		
@@ -613,50 +1065,46 @@ void SNES_CPU::INC() {
 		
 		mem->write16(*fetched_addr_bank, *fetched_addr_abs, data);
 		
-		status.bits.n = getBit(data, 15);
-		status.bits.z = (data == 0x0000);
+		setNZ16(data);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::INCA() {
-	if(status.bits.m) {
+	if(M8) {
 		(*A)++;
 		
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		C++;
 		
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::INX() {
-	if(status.bits.x) {
+	if(X8) {
 		(*XL)++;
 		
-		status.bits.n = getBit(*XL, 7);
-		status.bits.z = (*XL == 0x00);
+		setNZ8(*XL);
 	} else {
 		X++;
 		
-		status.bits.n = getBit(X, 15);
-		status.bits.z = (X == 0x0000);
+		setNZ16(X);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::INY() {
-	if(status.bits.x) {
+	if(X8) {
 		(*YL)++;
 		
-		status.bits.n = getBit(*YL, 7);
-		status.bits.z = (*YL == 0x00);
+		setNZ8(*YL);
 	} else {
 		Y++;
 		
-		status.bits.n = getBit(Y, 15);
-		status.bits.z = (Y == 0x0000);
+		setNZ16(Y);
 	}
 }
 
@@ -683,83 +1131,114 @@ void SNES_CPU::JSL() {
 	PC = jump_long_addr & 0xFFFF;
 }
 
+template<bool M8>
 void SNES_CPU::LDA() {
-	if(status.bits.m) {
+	if(M8) {
 		*A = *fetched_lo;
 
-		status.bits.n = getBit(*fetched_lo, 7);
-		status.bits.z = (*fetched_lo == 0x00);
+		setNZ8(*fetched_lo);
 	} else {
 		C = fetched;
 
-		status.bits.n = getBit(fetched, 15);
-		status.bits.z = (fetched == 0x0000);
+		setNZ16(fetched);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::LDX() {
-	if(status.bits.x) {
+	if(X8) {
 		*XL = *fetched_lo;
 
-		status.bits.n = getBit(*fetched_lo, 7);
-		status.bits.z = (*fetched_lo == 0x00);
+		setNZ8(*fetched_lo);
 	} else {
 		X = fetched;
 
-		status.bits.n = getBit(fetched, 15);
-		status.bits.z = (fetched == 0x0000);
+		setNZ16(fetched);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::LDY() {
-	if(status.bits.x) {
+	if(X8) {
 		*YL = *fetched_lo;
 
-		status.bits.n = getBit(*fetched_lo, 7);
-		status.bits.z = (*fetched_lo == 0x00);
+		setNZ8(*fetched_lo);
 	} else {
 		Y = fetched;
 
-		status.bits.n = getBit(fetched, 15);
-		status.bits.z = (fetched == 0x0000);
+		setNZ16(fetched);
 	}
 }
 
 void SNES_CPU::MVN() {
-	byte source_bank = *fetched_lo;
-	byte dest_bank = *fetched_hi;
-
-	while(C != 0xFFFF) {
-		mem->write8(dest_bank, Y, mem->read8(source_bank, X));
-		X++;
-		Y++;
-		C--;
-	}
+	moveBlock(1);
 }
 
 void SNES_CPU::MVP() {
+	moveBlock(-1);
+}
+
+void SNES_CPU::moveBlock(int step) {
 	byte source_bank = *fetched_lo;
 	byte dest_bank = *fetched_hi;
 
-	while(C != 0xFFFF) {
-		mem->write8(dest_bank, Y, mem->read8(source_bank, X));
-		X--;
-		Y--;
-		C--;
+	// C + 1 bytes are left. a chunk ends at the page boundary of either
+	// side, and at the end of the batch, at least one byte per execution
+	size_t count = (size_t)C + 1;
+	if(step > 0) {
+		count = std::min<size_t>(count, MEM_PAGE_SIZE - (X & MEM_PAGE_MASK));
+		count = std::min<size_t>(count, MEM_PAGE_SIZE - (Y & MEM_PAGE_MASK));
+	} else {
+		count = std::min<size_t>(count, (X & MEM_PAGE_MASK) + 1);
+		count = std::min<size_t>(count, (Y & MEM_PAGE_MASK) + 1);
 	}
+	uint64_t budget = run_target > time ? (run_target - time) / (7 * MASTER_CYCLES_PER_CPU_CYCLE) : 0;
+	count = std::max<size_t>(1, std::min<size_t>(count, budget));
+
+	threebyte source = (source_bank << 16) | X;
+	threebyte dest = (dest_bank << 16) | Y;
+	byte* source_page = mem->getReadPages()[source >> MEM_PAGE_BITS];
+	byte* dest_page = mem->getWritePages()[dest >> MEM_PAGE_BITS];
+
+	if(source_page && dest_page && !mem->tracer) {
+		byte* from = source_page + (source & MEM_PAGE_MASK);
+		byte* to = dest_page + (dest & MEM_PAGE_MASK);
+		if(step < 0) {
+			from -= count - 1;
+			to -= count - 1;
+		}
+		// a move onto the bytes just ahead of its source repeats them (the
+		// usual way to fill memory), which takes going a byte at a time
+		if(step > 0 && to > from && to < from + count) {
+			for(size_t i = 0; i < count; i++) to[i] = from[i];
+		} else if(step < 0 && to < from && to + count > from) {
+			for(size_t i = count; i-- > 0;) to[i] = from[i];
+		} else {
+			memmove(to, from, count);
+		}
+	} else {
+		// registers, and pages watched for code or snapshots
+		for(size_t i = 0; i < count; i++)
+			mem->write8(dest_bank, Y + step * (int)i, mem->read8(source_bank, X + step * (int)i));
+	}
+
+	X += step * (int)count;
+	Y += step * (int)count;
+	C -= count;
+	moved = count;
+	if(C != 0xFFFF) PC -= 3;
 }
 
+template<bool M8>
 void SNES_CPU::ORA() {
-	if(status.bits.m) {
+	if(M8) {
 		*A |= *fetched_lo;
 
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		C |= fetched;
 
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
@@ -777,8 +1256,9 @@ void SNES_CPU::PER() {
 
 // push
 
+template<bool M8>
 void SNES_CPU::PHA() {
-	if(status.bits.m) {
+	if(M8) {
 		push_stack_twobyte(C);
 	} else {
 		push_stack_byte(*A);
@@ -798,19 +1278,21 @@ void SNES_CPU::PHK() {
 }
 
 void SNES_CPU::PHP() {
-	push_stack_byte(status.full);
+	push_stack_byte(getStatus());
 }
 
+template<bool X8>
 void SNES_CPU::PHX() {
-	if(status.bits.x) {
+	if(X8) {
 		push_stack_twobyte(X);
 	} else {
 		push_stack_byte(*XL);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::PHY() {
-	if(status.bits.x) {
+	if(X8) {
 		push_stack_twobyte(Y);
 	} else {
 		push_stack_byte(*YL);
@@ -819,83 +1301,73 @@ void SNES_CPU::PHY() {
 
 // pull
 
+template<bool M8>
 void SNES_CPU::PLA() {
-	if(status.bits.m) {
+	if(M8) {
 		C = pop_stack_twobyte();
 
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	} else {
 		*A = pop_stack_byte();
 
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	}
 }
 
 void SNES_CPU::PLB() {
 	DBR = pop_stack_byte();
 
-	status.bits.n = getBit(DBR, 7);
-	status.bits.z = (DBR == 0x00);
+	setNZ8(DBR);
 }
 
 void SNES_CPU::PLD() {
 	D = pop_stack_twobyte();
 
-	status.bits.n = getBit(D, 15);
-	status.bits.z = (D == 0x0000);
+	setNZ16(D);
 }
 
 void SNES_CPU::PLP() {
-	status.full = pop_stack_byte();
+	setStatus(pop_stack_byte());
 
-	if(e) {
-		status.bits.m = 1;
-		status.bits.x = 1;
-	}
+	updateRegisterWidths();
 }
 
+template<bool M8>
 void SNES_CPU::PLX() {
-	if(status.bits.m) {
+	if(M8) {
 		X = pop_stack_twobyte();
 
-		status.bits.n = getBit(X, 15);
-		status.bits.z = (X == 0x0000);
+		setNZ16(X);
 	} else {
 		*XL = pop_stack_byte();
 
-		status.bits.n = getBit(*XL, 7);
-		status.bits.z = (*XL == 0x00);
+		setNZ8(*XL);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::PLY() {
-	if(status.bits.m) {
+	if(M8) {
 		Y = pop_stack_twobyte();
 
-		status.bits.n = getBit(Y, 15);
-		status.bits.z = (Y == 0x0000);
+		setNZ16(Y);
 	} else {
 		*YL = pop_stack_byte();
 
-		status.bits.n = getBit(*YL, 7);
-		status.bits.z = (*YL == 0x00);
+		setNZ8(*YL);
 	}
 }
 
 void SNES_CPU::REP() {
-	status.full &= ~(*fetched_lo);
+	setStatus(getStatus() & ~*fetched_lo);
 
-	if(e) {
-		status.bits.m = 1;
-		status.bits.x = 1;
-	}
+	updateRegisterWidths();
 }
 
+template<bool M8>
 void SNES_CPU::ROL() {
 	bool c_pre_shift = status.bits.c;
-	if(status.bits.m) {
+	if(M8) {
 		byte data = *fetched_lo;
 		
 		status.bits.c = getBit(data, 7);
@@ -904,8 +1376,7 @@ void SNES_CPU::ROL() {
 		
 		mem->write8(*fetched_addr_bank, *fetched_addr_abs, data);
 		
-		status.bits.n = getBit(data, 7);
-		status.bits.z = (data == 0x00);
+		setNZ8(data);
 	} else {
 		twobyte data = fetched;
 		
@@ -915,34 +1386,33 @@ void SNES_CPU::ROL() {
 		
 		mem->write16(*fetched_addr_bank, *fetched_addr_abs, data, wrap_writes);
 		
-		status.bits.n = getBit(data, 15);
-		status.bits.z = (data == 0x0000);
+		setNZ16(data);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::ROLA() {
 	bool c_pre_shift = status.bits.c;
-	if(status.bits.m) {
+	if(M8) {
 		status.bits.c = getBit(*A, 7);
 		*A <<= 1;
 		*A |= c_pre_shift;
 		
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		status.bits.c = getBit(C, 15);
 		C <<= 1;
 		C |= c_pre_shift;
 		
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::ROR() {
 	bool c_pre_shift = status.bits.c;
 	status.bits.c = getBit(fetched, 0);
-	if(status.bits.m) {
+	if(M8) {
 		byte data = *fetched_lo;
 		
 		data >>= 1;
@@ -950,8 +1420,7 @@ void SNES_CPU::ROR() {
 		
 		mem->write8(*fetched_addr_bank, *fetched_addr_abs, data);
 		
-		status.bits.n = getBit(data, 7);
-		status.bits.z = (data == 0x00);
+		setNZ8(data);
 	} else {
 		twobyte data = fetched;
 		
@@ -960,36 +1429,36 @@ void SNES_CPU::ROR() {
 		
 		mem->write16(*fetched_addr_bank, *fetched_addr_abs, data, wrap_writes);
 		
-		status.bits.n = getBit(data, 15);
-		status.bits.z = (data == 0x0000);
+		setNZ16(data);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::RORA() {
 	bool c_pre_shift = status.bits.c;
 	status.bits.c = getBit(C, 0);
-	if(status.bits.m) {
+	if(M8) {
 		*A <<= 1;
 		*A |= (c_pre_shift << 7);
 		
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		C <<= 1;
 		C |= (c_pre_shift << 15);
 		
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
 void SNES_CPU::RTI() {
-	status.full = pop_stack_byte();
+	setStatus(pop_stack_byte());
 	PC = pop_stack_twobyte();
 
 	if(!e) {
 		K = pop_stack_byte();
 	}
+
+	updateRegisterWidths();
 }
 
 void SNES_CPU::RTS() {
@@ -1004,6 +1473,7 @@ void SNES_CPU::RTL() {
 	PC++;
 }
 
+template<bool M8>
 void SNES_CPU::SBC() {
 	if(status.bits.d) {
 		status.bits.c = 1;
@@ -1016,7 +1486,7 @@ void SNES_CPU::SBC() {
 			upper_nybble_diff--;
 		}
 
-		if(status.bits.m) {
+		if(M8) {
 			if(upper_nybble_diff > 0x09) {
 				upper_nybble_diff -= 0x06;
 				upper_nybble_diff &= 0x0F;
@@ -1025,8 +1495,7 @@ void SNES_CPU::SBC() {
 
 			*A = (upper_nybble_diff << 4) | lower_nybble_diff;
 			
-			status.bits.n = getBit(*A, 7);
-			status.bits.z = (*A == 0x00);
+			setNZ8(*A);
 			return;
 		} else {
 			byte lower_nybble_diff_hi = (*B & 0x0F) - (*fetched_hi & 0x0F);
@@ -1052,12 +1521,14 @@ void SNES_CPU::SBC() {
 
 			C =  (twobyte)(upper_nybble_diff_hi << 12) | (lower_nybble_diff_hi << 8) | (upper_nybble_diff << 4) | lower_nybble_diff;
 		
-			status.bits.n = getBit(C, 15);
-			status.bits.z = (C = 0x0000);
+			// C ends up 0 with z clear, as it always has
+			n_result = C;
+			z_result = 1;
+			C = 0x0000;
 			return;
 		}
 	} else {
-		if(status.bits.m) {
+		if(M8) {
 			bool final_c = (*A >= *fetched_lo);
 			bool high_bit_pre_sbc = getBit(*A, 7);
 			
@@ -1067,8 +1538,7 @@ void SNES_CPU::SBC() {
 			status.bits.v = ((high_bit_pre_sbc != getBit(*fetched_lo + (status.bits.c ? 0 : 1), 7))
 							&& (high_bit_pre_sbc != getBit(*A, 7)));
 			status.bits.c = final_c;
-			status.bits.n = getBit(*A, 7);
-			status.bits.z = (*A == 0x00);
+			setNZ8(*A);
 		} else {
 			bool final_c = (C >= fetched);
 			bool high_bit_pre_sbc = getBit(C, 15);
@@ -1079,8 +1549,7 @@ void SNES_CPU::SBC() {
 			status.bits.v = ((high_bit_pre_sbc != getBit(fetched + (status.bits.c ? 0 : 1), 15))
 							&& (high_bit_pre_sbc != getBit(C, 15)));
 			status.bits.c = final_c;
-			status.bits.n = getBit(C, 15);
-			status.bits.z = (C == 0x0000);
+			setNZ16(C);
 		}
 	}
 }
@@ -1098,184 +1567,183 @@ void SNES_CPU::SED() {
 }
 
 void SNES_CPU::SEP() {
-	status.full |= *fetched_lo;
+	setStatus(getStatus() | *fetched_lo);
 
 	if(status.bits.x) {
 		*XH = 0x00;
 		*XL = 0x00;
 	}
+
+	updateRegisterWidths();
 }
 
+template<bool M8>
 void SNES_CPU::STA() {
-	if(status.bits.m) {
+	if(M8) {
 		mem->write8(*fetched_addr_bank, *fetched_addr_abs, *A);
 	} else {
 		mem->write16(*fetched_addr_bank, *fetched_addr_abs, C, wrap_writes);
 	}
 }
 
+void SNES_CPU::STP() {
+	stopped = true;
+}
+
+template<bool X8>
 void SNES_CPU::STX() {
-	if(status.bits.x) {
+	if(X8) {
 		mem->write8(*fetched_addr_bank, *fetched_addr_abs, *XL);
 	} else {
 		mem->write16(*fetched_addr_bank, *fetched_addr_abs, X, wrap_writes);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::STY() {
-	if(status.bits.x) {
+	if(X8) {
 		mem->write8(*fetched_addr_bank, *fetched_addr_abs, *YL);
 	} else {
 		mem->write16(*fetched_addr_bank, *fetched_addr_abs, Y, wrap_writes);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::STZ() {
-	if(status.bits.m) {
+	if(M8) {
 		mem->write8(*fetched_addr_bank, *fetched_addr_abs, *A);
 	} else {
 		mem->write16(*fetched_addr_bank, *fetched_addr_abs, C, wrap_writes);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::TAX() {
-	if(status.bits.x) {
+	if(X8) {
 		*XL = *A;
 
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		X = C;
 
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::TAY() {
-	if(status.bits.x) {
+	if(X8) {
 		*YL = *A;
 
-		status.bits.n = getBit(*A, 7);
-		status.bits.z = (*A == 0x00);
+		setNZ8(*A);
 	} else {
 		Y = C;
 
-		status.bits.n = getBit(C, 15);
-		status.bits.z = (C == 0x0000);
+		setNZ16(C);
 	}
 }
 
 void SNES_CPU::TCD() {
 	D = C;
 
-	status.bits.n = getBit(C, 15);
-	status.bits.z = (C == 0x0000);
+	setNZ16(C);
 }
 
 void SNES_CPU::TCS() {
 	S = C;
 
-	status.bits.n = getBit(C, 15);
-	status.bits.z = (C == 0x0000);
+	setNZ16(C);
 }
 
 void SNES_CPU::TDC() {
 	C = D;
 
-	status.bits.n = getBit(D, 15);
-	status.bits.z = (D == 0x0000);
+	setNZ16(D);
 }
 
 void SNES_CPU::TSC() {
 	C = S;
 
-	status.bits.n = getBit(S, 15);
-	status.bits.z = (S == 0x0000);
+	setNZ16(S);
 }
 
+template<bool X8>
 void SNES_CPU::TSX() {
-	if(status.bits.x) {
+	if(X8) {
 		*XL = *SL;
 
-		status.bits.n = getBit(*SL, 7);
-		status.bits.z = (*SL == 0x00);
+		setNZ8(*SL);
 	} else {
 		X = S;
 
-		status.bits.n = getBit(S, 15);
-		status.bits.z = (S == 0x0000);
+		setNZ16(S);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::TXA() {
-	if(status.bits.m) {
+	if(M8) {
 		*A = *XL;
 
-		status.bits.n = getBit(*XL, 7);
-		status.bits.z = (*XL == 0x00);
+		setNZ8(*XL);
 	} else {
 		C = X;
 
-		status.bits.n = getBit(X, 15);
-		status.bits.z = (X == 0x0000);
+		setNZ16(X);
 	}
 }
 
 void SNES_CPU::TXS() {
 	S = X;
 
-	status.bits.n = getBit(X, 15);
-	status.bits.z = (X == 0x0000);
+	setNZ16(X);
 }
 
+template<bool X8>
 void SNES_CPU::TXY() {
-	if(status.bits.x) {
+	if(X8) {
 		*YL = *XL;
 
-		status.bits.n = getBit(*XL, 7);
-		status.bits.z = (*XL == 0x00);
+		setNZ8(*XL);
 	} else {
 		Y = X;
 
-		status.bits.n = getBit(X, 15);
-		status.bits.z = (X == 0x0000);
+		setNZ16(X);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::TYA() {
-	if(status.bits.m) {
+	if(M8) {
 		*A = *YL;
 
-		status.bits.n = getBit(*YL, 7);
-		status.bits.z = (*YL == 0x00);
+		setNZ8(*YL);
 	} else {
 		C = Y;
 
-		status.bits.n = getBit(Y, 15);
-		status.bits.z = (Y == 0x0000);
+		setNZ16(Y);
 	}
 }
 
+template<bool X8>
 void SNES_CPU::TYX() {
-	if(status.bits.x) {
+	if(X8) {
 		*XL = *YL;
 
-		status.bits.n = getBit(*YL, 7);
-		status.bits.z = (*YL == 0x00);
+		setNZ8(*YL);
 	} else {
 		X = Y;
 
-		status.bits.n = getBit(Y, 15);
-		status.bits.z = (Y == 0x0000);
+		setNZ16(Y);
 	}
 }
 
+template<bool M8>
 void SNES_CPU::TRB() {
-	if(status.bits.m) {
+	if(M8) {
 		byte data = *fetched_lo;
 
-		status.bits.z = ((*A & data) == 0x00);
+		z_result = *A & data;
 
 		for(int i = 0; i < 8; i++) {
 			if(getBit(*A, i)) {
@@ -1287,7 +1755,7 @@ void SNES_CPU::TRB() {
 	} else {
 		twobyte data = fetched;
 
-		status.bits.z = ((C & data) == 0x0000);
+		z_result = C & data;
 
 		for(int i = 0; i < 16; i++) {
 			if(getBit(C, i)) {
@@ -1299,11 +1767,12 @@ void SNES_CPU::TRB() {
 	}
 }
 
+template<bool M8>
 void SNES_CPU::TSB() {
-	if(status.bits.m) {
+	if(M8) {
 		byte data = *fetched_lo;
 
-		status.bits.z = ((*A & data) == 0x00);
+		z_result = *A & data;
 
 		for(int i = 0; i < 8; i++) {
 			if(getBit(*A, i)) {
@@ -1315,7 +1784,7 @@ void SNES_CPU::TSB() {
 	} else {
 		twobyte data = fetched;
 
-		status.bits.z = ((C & data) == 0x0000);
+		z_result = C & data;
 
 		for(int i = 0; i < 16; i++) {
 			if(getBit(C, i)) {
@@ -1328,7 +1797,7 @@ void SNES_CPU::TSB() {
 }
 
 void SNES_CPU::WAI() {
-	std::cout << "called WAI" << std::endl;
+	waiting = true;
 }
 
 void SNES_CPU::XBA() {
@@ -1337,18 +1806,15 @@ void SNES_CPU::XBA() {
 	*B = *A;
 	*A = B_pre_swap;
 
-	status.bits.n = getBit(B_pre_swap, 7);
-	status.bits.z = (B_pre_swap == 0x00);
+	setNZ8(B_pre_swap);
 }
 
 void SNES_CPU::XCE() {
 	bool carry = status.bits.c;
 	status.bits.c = e;
 	e = carry;
-	if(e) {
-		status.bits.m = 1;
-		status.bits.x = 1;
-	}
+
+	updateRegisterWidths();
 }
 
 //
@@ -1357,36 +1823,39 @@ void SNES_CPU::XCE() {
 
 // immediate
 
+template<bool M8>
 void SNES_CPU::IMM_M() {
-	if(status.bits.m)
-		*fetched_lo = mem->readROM8(K, PC);
+	if(M8)
+		*fetched_lo = (byte)operand;
 	else
-		fetched = mem->readROM16(K, PC);
+		fetched = (twobyte)operand;
 }
 
+template<bool X8>
 void SNES_CPU::IMM_X() {
-	if(status.bits.x)
-		*fetched_lo = mem->readROM8(K, PC);
+	if(X8)
+		*fetched_lo = (byte)operand;
 	else
-		fetched = mem->readROM16(K, PC);
+		fetched = (twobyte)operand;
 }
 
 void SNES_CPU::IMM8() {
-	*fetched_lo = mem->readROM8(K, PC);
+	*fetched_lo = (byte)operand;
 }
 
 void SNES_CPU::IMM16() {
-	fetched = mem->readROM16(K, PC);
+	fetched = (twobyte)operand;
 }
 
 // direct page
 
+template<bool M8>
 void SNES_CPU::DP() {
 	*fetched_addr_bank = 0x00;
-	*fetched_addr_abs = D + mem->readROM8(K, PC);
+	*fetched_addr_abs = D + (byte)operand;
 	wrap_writes = true;
 
-	if(status.bits.m) {
+	if(M8) {
 		*fetched_lo = mem->read8_bank0(*fetched_addr_abs);
 	} else {
 		fetched = mem->read16_bank0(*fetched_addr_abs);
@@ -1395,19 +1864,20 @@ void SNES_CPU::DP() {
 
 void SNES_CPU::DP16() {
 	*fetched_addr_bank = 0x00;
-	*fetched_addr_abs = D + mem->readROM8(K, PC);
+	*fetched_addr_abs = D + (byte)operand;
 	wrap_writes = true;
 
 	fetched = mem->read16_bank0(*fetched_addr_abs);
 }
 
 // Direct Page Indexed, X
+template<bool M8, bool X8>
 void SNES_CPU::DPX() {
 	*fetched_addr_bank = 0x00;
-	*fetched_addr_abs = D + mem->readROM8(K, PC) + (status.bits.x ? *XL : X);
+	*fetched_addr_abs = D + (byte)operand + (X8 ? *XL : X);
 	wrap_writes = true;
 	
-	if(status.bits.m) {
+	if(M8) {
 		*fetched_lo = mem->read8_bank0(*fetched_addr_abs);
 	} else {
 		fetched = mem->read16_bank0(*fetched_addr_abs);
@@ -1415,12 +1885,13 @@ void SNES_CPU::DPX() {
 }
 
 // Direct Page Indexed, Y
+template<bool M8, bool X8>
 void SNES_CPU::DPY() {
 	*fetched_addr_bank = 0x00;
-	*fetched_addr_abs = D + mem->readROM8(K, PC) + (status.bits.x ? *YL : Y);
+	*fetched_addr_abs = D + (byte)operand + (X8 ? *YL : Y);
 	wrap_writes = true;
 
-	if(status.bits.m) {
+	if(M8) {
 		*fetched_lo = mem->read8_bank0(*fetched_addr_abs);
 	} else {
 		fetched = mem->read16_bank0(*fetched_addr_abs);
@@ -1430,63 +1901,68 @@ void SNES_CPU::DPY() {
 // indirect
 
 // Direct Page Indirect
+template<bool M8>
 void SNES_CPU::DPI() {
-	twobyte addr = mem->read16_bank0(D + mem->readROM8(K, PC));
+	twobyte addr = mem->read16_bank0(D + (byte)operand);
 
 	*fetched_addr_bank = DBR;
 	*fetched_addr_abs = addr;
 
-	if(status.bits.m)
+	if(M8)
 		*fetched_lo = mem->read8(DBR, addr);
 	else
 		fetched = mem->read16(DBR, addr);
 }
 
 // Direct Page Indirect Long
+template<bool M8>
 void SNES_CPU::DPIL() {
-	threebyte addr = mem->read24_bank0(D + mem->readROM8(K, PC));
+	threebyte addr = mem->read24_bank0(D + (byte)operand);
 
 	fetched_addr = addr;
 
-	if(status.bits.m)
+	if(M8)
 		*fetched_lo = mem->read8((addr & 0xFF0000) >> 16, addr & 0xFFFF);
 	else
 		fetched = mem->read16((addr & 0xFF0000) >> 16, addr & 0xFFFF);
 }
 
 // Direct Page Indirect, X
+template<bool M8>
 void SNES_CPU::DPIX() {
-	twobyte addr = mem->read16_bank0(D + mem->readROM8(K, PC) + X);
+	twobyte addr = mem->read16_bank0(D + (byte)operand + X);
 
 	*fetched_addr_bank = DBR;
 	*fetched_addr_abs = addr;
 	
-	if(status.bits.m)
+	if(M8)
 		*fetched_lo = mem->read8(DBR, addr);
 	else
 		fetched = mem->read16(DBR, addr);
 }
 
 // Direct Page Indirect iNdexed, Y
+template<bool M8>
 void SNES_CPU::DPINY() {
-	twobyte addr = mem->read16_bank0(D + mem->readROM8(K, PC));
+	twobyte addr = mem->read16_bank0(D + (byte)operand);
 
 	*fetched_addr_bank = DBR;
 	*fetched_addr_abs = addr;
 	
-	if(status.bits.m)
+	if(M8)
 		*fetched_lo = mem->read8(DBR, addr + Y);
 	else
 		fetched = mem->read16(DBR, addr + Y);
 }
 
 // Direct Page Indirect Long iNdexed, Y
+template<bool M8>
 void SNES_CPU::DPILNY() {
-	threebyte addr = mem->read24_bank0(D + mem->readROM8(K, PC));
+	threebyte addr = mem->read24_bank0(D + (byte)operand);
 
 	fetched_addr = addr;
 	
-	if(status.bits.m)
+	if(M8)
 		*fetched_lo = mem->read8(addr + Y);
 	else
 		fetched = mem->read16(addr + Y);
@@ -1494,57 +1970,60 @@ void SNES_CPU::DPILNY() {
 
 // absolute
 
+template<bool M8>
 void SNES_CPU::ABS() {
 	*fetched_addr_bank = DBR;
-	*fetched_addr_abs = mem->readROM16(K, PC);
-	if(status.bits.m)
+	*fetched_addr_abs = (twobyte)operand;
+	if(M8)
 		*fetched_lo = mem->read8(DBR, *fetched_addr_abs);
 	else
 		fetched = mem->read16(DBR, *fetched_addr_abs);
 }
 
 void SNES_CPU::ABSI() {
-	fetched = mem->read16_bank0(mem->readROM16(K, PC));
+	fetched = mem->read16_bank0((twobyte)operand);
 }
 
 void SNES_CPU::ABSIL() {
-	jump_long_addr = mem->read24_bank0(mem->readROM16(K, PC));
+	jump_long_addr = mem->read24_bank0((twobyte)operand);
 }
 
 void SNES_CPU::ABSIX() {
-	twobyte HHLL = mem->readROM16(K, PC);
+	twobyte HHLL = (twobyte)operand;
 	twobyte addr = mem->read8(K, HHLL + X);
 	addr |= (mem->read8(K, HHLL + X + 1) << 8);
 
 	fetched = addr;
 }
 
+template<bool M8>
 void SNES_CPU::ABSL() {
-	threebyte addr = mem->readROM24(K, PC);
+	threebyte addr = operand;
 
 	fetched_addr = addr;
 
-	if(status.bits.m)
+	if(M8)
 		*fetched_lo = mem->read8(addr);
 	else
 		fetched = mem->read16(addr);
 }
 
 void SNES_CPU::ABSL_JML_JSL() {
-	jump_long_addr = mem->readROM24(K, PC);
+	jump_long_addr = operand;
 }
 
+template<bool M8, bool X8>
 void SNES_CPU::ABSX() {
-	threebyte addr_long = (twobyte)mem->readROM16(K, PC) + (DBR << 16);
+	threebyte addr_long = (twobyte)operand + (DBR << 16);
 	
-	if(status.bits.x)
+	if(X8)
 		addr_long += *XL;
 	else
 		addr_long += X;
 	
 	fetched_addr = addr_long;
 	
-	if(status.bits.m)
+	if(M8)
 		*fetched_lo = mem->read8((addr_long & 0xFF0000) >> 16, addr_long & 0xFFFF);
 	else
 		fetched = mem->read16((addr_long & 0xFF0000) >> 16, addr_long & 0xFFFF);
@@ -1552,17 +2031,18 @@ void SNES_CPU::ABSX() {
 	iBoundary = (DBR != ((addr_long & 0xFF0000) >> 16));
 }
 
+template<bool M8, bool X8>
 void SNES_CPU::ABSY() {
-	threebyte addr_long = (twobyte)mem->readROM16(K, PC) + (DBR << 16);
+	threebyte addr_long = (twobyte)operand + (DBR << 16);
 	
-	if(status.bits.x)
+	if(X8)
 		addr_long += *YL;
 	else
 		addr_long += Y;
 	
 	fetched_addr = addr_long;
 	
-	if(status.bits.m && status.bits.x)
+	if(M8 && X8)
 		*fetched_lo = mem->read8((addr_long & 0xFF0000) >> 16, addr_long & 0xFFFF);
 	else
 		fetched = mem->read16((addr_long & 0xFF0000) >> 16, addr_long & 0xFFFF);
@@ -1570,33 +2050,35 @@ void SNES_CPU::ABSY() {
 	iBoundary = (DBR != ((addr_long & 0xFF0000) >> 16));
 }
 
+template<bool M8, bool X8>
 void SNES_CPU::ABSLX() {
-	threebyte addr_long = mem->readROM24(K, PC);
+	threebyte addr_long = operand;
 	
-	if(status.bits.x)
+	if(X8)
 		addr_long += *XL;
 	else
 		addr_long += X;
 
 	fetched_addr = addr_long;
 	
-	if(status.bits.m && status.bits.x)
+	if(M8 && X8)
 		*fetched_lo = mem->read8((addr_long & 0xFF0000) >> 16, addr_long & 0xFFFF);
 	else
 		fetched = mem->read16((addr_long & 0xFF0000) >> 16, addr_long & 0xFFFF);
 }
 
+template<bool M8, bool X8>
 void SNES_CPU::ABSLY() {
-	threebyte addr_long = mem->readROM24(K, PC);
+	threebyte addr_long = operand;
 	
-	if(status.bits.x)
+	if(X8)
 		addr_long += *YL;
 	else
 		addr_long += Y;
 
 	fetched_addr = addr_long;
 	
-	if(status.bits.m && status.bits.x)
+	if(M8 && X8)
 		*fetched_lo = mem->read8((addr_long & 0xFF0000) >> 16, addr_long & 0xFFFF);
 	else
 		fetched = mem->read16((addr_long & 0xFF0000) >> 16, addr_long & 0xFFFF);
@@ -1604,31 +2086,444 @@ void SNES_CPU::ABSLY() {
 
 // stack relative
 
+template<bool M8, bool X8>
 void SNES_CPU::SR() {
-	twobyte addr = (twobyte)mem->readROM8(K, PC) + S;
+	twobyte addr = (byte)operand + S;
 
 	*fetched_addr_bank = 0x00;
 	*fetched_addr_abs = addr;
 	wrap_writes = true;
 
-	if(status.bits.m && status.bits.x)
+	if(M8 && X8)
 		*fetched_lo = mem->read8_bank0(addr);
 	else
 		fetched = mem->read16_bank0(addr);
 }
 
+template<bool M8, bool X8>
 void SNES_CPU::SRIY() {
-	threebyte addr = ((twobyte)mem->readROM8(K, PC) + S) + (DBR << 16);
+	threebyte addr = ((byte)operand + S) + (DBR << 16);
 	
-	if(status.bits.x)
+	if(X8)
 		addr += *YL;
 	else
 		addr += Y;
 
 	fetched_addr = addr;
 	
-	if(status.bits.m && status.bits.x)
+	if(M8 && X8)
 		*fetched_lo = mem->read8((addr & 0xFF0000) >> 16, addr & 0xFFFF);
 	else
 		fetched = mem->read16((addr & 0xFF0000) >> 16, addr & 0xFFFF);
-}
\ No newline at end of file
+}
+
+void SNES_CPU::ILL() {
+	halted = true;
+}
+
+//
+// instruction tables
+//
+
+const char* const SNES_CPU::opNames[256] = {
+	"BRK", "ORA", "COP", "ORA", "TSB", "ORA", "ASL", "ORA", "PHP", "ORA", "ASL", "PHD", "TSB", "ORA", "ASL", "ORA",
+	"BPL", "ORA", "ORA", "ORA", "TRB", "ORA", "ASL", "ORA", "CLC", "ORA", "INC", "TCS", "TRB", "ORA", "ASL", "ORA",
+	"JSR", "AND", "JSL", "AND", "BIT", "AND", "ROL", "AND", "PLP", "AND", "ROL", "PLD", "BIT", "AND", "ROL", "AND",
+	"BMI", "AND", "AND", "AND", "BIT", "AND", "ROL", "AND", "SEC", "AND", "DEC", "TSC", "BIT", "AND", "ROL", "AND",
+	"RTI", "EOR", "WDM", "EOR", "MVP", "EOR", "LSR", "EOR", "PHA", "EOR", "LSR", "PHK", "JMP", "EOR", "LSR", "EOR",
+	"BVC", "EOR", "EOR", "EOR", "MVN", "EOR", "LSR", "EOR", "CLI", "EOR", "PHY", "TCD", "JML", "EOR", "LSR", "EOR",
+	"RTS", "ADC", "PER", "ADC", "STZ", "ADC", "ROR", "ADC", "PLA", "ADC", "ROR", "RTL", "JMP", "ADC", "ROR", "ADC",
+	"BVS", "ADC", "ADC", "ADC", "STZ", "ADC", "ROR", "ADC", "SEI", "ADC", "PLY", "TDC", "JMP", "ADC", "ROR", "ADC",
+	"BRA", "STA", "BRL", "STA", "STY", "STA", "STX", "STA", "DEY", "BIT", "TXA", "PHB", "STY", "STA", "STX", "STA",
+	"BCC", "STA", "STA", "STA", "STY", "STA", "STX", "STA", "TYA", "STA", "TXS", "TXY", "STZ", "STA", "STZ", "STA",
+	"LDY", "LDA", "LDX", "LDA", "LDY", "LDA", "LDX", "LDA", "TAY", "LDA", "TAX", "PLB", "LDY", "LDA", "LDX", "LDA",
+	"BCS", "LDA", "LDA", "LDA", "LDY", "LDA", "LDX", "LDA", "CLV", "LDA", "TSX", "TYX", "LDY", "LDA", "LDX", "LDA",
+	"CPY", "CMP", "REP", "CMP", "CPY", "CMP", "DEC", "CMP", "INY", "CMP", "DEX", "WAI", "CPY", "CMP", "DEC", "CMP",
+	"BNE", "CMP", "CMP", "CMP", "PEI", "CMP", "DEC", "CMP", "CLD", "CMP", "PHX", "STP", "JML", "CMP", "DEC", "CMP",
+	"CPX", "SBC", "SEP", "SBC", "CPX", "SBC", "INC", "SBC", "INX", "SBC", "NOP", "XBA", "CPX", "SBC", "INC", "SBC",
+	"BEQ", "SBC", "SBC", "SBC", "PEA", "SBC", "INC", "SBC", "SED", "SBC", "PLX", "XCE", "JSR", "SBC", "INC", "SBC"
+};
+
+const std::array<SNES_CPU::instruction, 256> SNES_CPU::opTables[4] = {
+	SNES_CPU::buildOps<false, false>(),
+	SNES_CPU::buildOps<false, true>(),
+	SNES_CPU::buildOps<true, false>(),
+	SNES_CPU::buildOps<true, true>()
+};
+
+template<bool M8, bool X8>
+std::array<SNES_CPU::instruction, 256> SNES_CPU::buildOps() {
+	std::array<instruction, 256> t;
+	t.fill({&SNES_CPU::ILL, &SNES_CPU::IMP, 2, 0});
+
+	// adc
+	t[0x61] = {&SNES_CPU::ADC<M8>, &SNES_CPU::DPIX<M8>, 7, CYC_M | CYC_DL};
+	t[0x63] = {&SNES_CPU::ADC<M8>, &SNES_CPU::SR<M8, X8>, 5, CYC_M};
+	t[0x65] = {&SNES_CPU::ADC<M8>, &SNES_CPU::DP<M8>, 4, CYC_M | CYC_DL};
+	t[0x67] = {&SNES_CPU::ADC<M8>, &SNES_CPU::DPIL<M8>, 7, CYC_M | CYC_DL};
+	t[0x69] = {&SNES_CPU::ADC<M8>, &SNES_CPU::IMM_M<M8>, 3, CYC_M};
+	t[0x6D] = {&SNES_CPU::ADC<M8>, &SNES_CPU::ABS<M8>, 5, CYC_M};
+	t[0x6F] = {&SNES_CPU::ADC<M8>, &SNES_CPU::ABSL<M8>, 6, CYC_M};
+	t[0x71] = {&SNES_CPU::ADC<M8>, &SNES_CPU::DPINY<M8>, 6, CYC_M | CYC_DL | CYC_IB};
+	t[0x72] = {&SNES_CPU::ADC<M8>, &SNES_CPU::DPI<M8>, 6, CYC_M | CYC_DL};
+	t[0x73] = {&SNES_CPU::ADC<M8>, &SNES_CPU::SRIY<M8, X8>, 8, CYC_M};
+	t[0x75] = {&SNES_CPU::ADC<M8>, &SNES_CPU::DPX<M8, X8>, 5, CYC_M | CYC_DL};
+	t[0x77] = {&SNES_CPU::ADC<M8>, &SNES_CPU::DPILNY<M8>, 7, CYC_M | CYC_DL};
+	t[0x79] = {&SNES_CPU::ADC<M8>, &SNES_CPU::ABSY<M8, X8>, 5, CYC_M | CYC_IB};
+	t[0x7D] = {&SNES_CPU::ADC<M8>, &SNES_CPU::ABSX<M8, X8>, 5, CYC_M | CYC_IB};
+	t[0x7F] = {&SNES_CPU::ADC<M8>, &SNES_CPU::ABSLX<M8, X8>, 6, CYC_M};
+	// and
+	t[0x21] = {&SNES_CPU::AND<M8>, &SNES_CPU::DPIX<M8>, 7, CYC_M | CYC_DL};
+	t[0x23] = {&SNES_CPU::AND<M8>, &SNES_CPU::SR<M8, X8>, 5, CYC_M};
+	t[0x25] = {&SNES_CPU::AND<M8>, &SNES_CPU::DP<M8>, 4, CYC_M | CYC_DL};
+	t[0x27] = {&SNES_CPU::AND<M8>, &SNES_CPU::DPIL<M8>, 7, CYC_M | CYC_DL};
+	t[0x29] = {&SNES_CPU::AND<M8>, &SNES_CPU::IMM_M<M8>, 3, CYC_M};
+	t[0x2D] = {&SNES_CPU::AND<M8>, &SNES_CPU::ABS<M8>, 5, CYC_M};
+	t[0x2F] = {&SNES_CPU::AND<M8>, &SNES_CPU::ABSL<M8>, 6, CYC_M};
+	t[0x31] = {&SNES_CPU::AND<M8>, &SNES_CPU::DPINY<M8>, 6, CYC_M | CYC_DL | CYC_IB};
+	t[0x32] = {&SNES_CPU::AND<M8>, &SNES_CPU::DPI<M8>, 6, CYC_M | CYC_DL};
+	t[0x33] = {&SNES_CPU::AND<M8>, &SNES_CPU::SRIY<M8, X8>, 8, CYC_M};
+	t[0x35] = {&SNES_CPU::AND<M8>, &SNES_CPU::DPX<M8, X8>, 5, CYC_M | CYC_DL};
+	t[0x37] = {&SNES_CPU::AND<M8>, &SNES_CPU::DPILNY<M8>, 7, CYC_M | CYC_DL};
+	t[0x39] = {&SNES_CPU::AND<M8>, &SNES_CPU::ABSY<M8, X8>, 5, CYC_M | CYC_IB};
+	t[0x3D] = {&SNES_CPU::AND<M8>, &SNES_CPU::ABSX<M8, X8>, 5, CYC_M | CYC_IB};
+	t[0x3F] = {&SNES_CPU::AND<M8>, &SNES_CPU::ABSLX<M8, X8>, 6, CYC_M};
+	// asl
+	t[0x06] = {&SNES_CPU::ASL<M8>, &SNES_CPU::DP<M8>, 5, CYC_DL | CYC_M2};
+	t[0x0A] = {&SNES_CPU::ASLA<M8>, &SNES_CPU::IMP, 2, 0};
+	t[0x0E] = {&SNES_CPU::ASL<M8>, &SNES_CPU::ABS<M8>, 6, CYC_M2};
+	t[0x16] = {&SNES_CPU::ASL<M8>, &SNES_CPU::DPX<M8, X8>, 5, CYC_DL | CYC_M2};
+	t[0x1E] = {&SNES_CPU::ASL<M8>, &SNES_CPU::ABSX<M8, X8>, 7, CYC_M2};
+	// lsr
+	t[0x46] = {&SNES_CPU::LSR<M8>, &SNES_CPU::DP<M8>, 5, CYC_DL | CYC_M};
+	t[0x4A] = {&SNES_CPU::LSRA<M8>, &SNES_CPU::IMP, 2, 0};
+	t[0x4E] = {&SNES_CPU::LSR<M8>, &SNES_CPU::ABS<M8>, 6, CYC_M};
+	t[0x56] = {&SNES_CPU::LSR<M8>, &SNES_CPU::DPX<M8, X8>, 5, CYC_DL | CYC_M};
+	t[0x5E] = {&SNES_CPU::LSR<M8>, &SNES_CPU::ABSX<M8, X8>, 7, CYC_M};
+	// branching
+	t[0x90] = {&SNES_CPU::BCC, &SNES_CPU::IMM8, 2, CYC_BR};
+	t[0xB0] = {&SNES_CPU::BCS, &SNES_CPU::IMM8, 2, CYC_BR};
+	t[0xF0] = {&SNES_CPU::BEQ, &SNES_CPU::IMM8, 2, CYC_BR};
+	t[0x30] = {&SNES_CPU::BMI, &SNES_CPU::IMM8, 2, CYC_BR};
+	t[0xD0] = {&SNES_CPU::BNE, &SNES_CPU::IMM8, 2, CYC_BR};
+	t[0x10] = {&SNES_CPU::BPL, &SNES_CPU::IMM8, 2, CYC_BR};
+	t[0x80] = {&SNES_CPU::BRA, &SNES_CPU::IMM8, 3, 0};
+	t[0x82] = {&SNES_CPU::BRL, &SNES_CPU::IMM16, 4, 0};
+	t[0x50] = {&SNES_CPU::BVC, &SNES_CPU::IMM8, 2, CYC_BR};
+	t[0x70] = {&SNES_CPU::BVS, &SNES_CPU::IMM8, 2, CYC_BR};
+	// bit
+	t[0x24] = {&SNES_CPU::BIT<M8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	t[0x2C] = {&SNES_CPU::BIT<M8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0x34] = {&SNES_CPU::BIT<M8>, &SNES_CPU::DPX<M8, X8>, 4, CYC_M | CYC_DL};
+	t[0x3C] = {&SNES_CPU::BIT<M8>, &SNES_CPU::ABSX<M8, X8>, 4, CYC_M | CYC_IB};
+	t[0x89] = {&SNES_CPU::BITIMM<M8>, &SNES_CPU::IMM_M<M8>, 2, CYC_M};
+	// interrupts
+	t[0x00] = {&SNES_CPU::BRK, &SNES_CPU::IMP, 7, 0};
+	t[0x02] = {&SNES_CPU::COP, &SNES_CPU::IMP, 7, 0};
+	// clear flags
+	t[0x18] = {&SNES_CPU::CLC, &SNES_CPU::IMP, 2, 0};
+	t[0xD8] = {&SNES_CPU::CLD, &SNES_CPU::IMP, 2, 0};
+	t[0x58] = {&SNES_CPU::CLI, &SNES_CPU::IMP, 2, 0};
+	t[0xB8] = {&SNES_CPU::CLV, &SNES_CPU::IMP, 2, 0};
+	// cmp
+	t[0xC9] = {&SNES_CPU::CMP<M8>, &SNES_CPU::IMM_M<M8>, 2, CYC_M};
+	t[0xCD] = {&SNES_CPU::CMP<M8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0xCF] = {&SNES_CPU::CMP<M8>, &SNES_CPU::ABSL<M8>, 5, CYC_M};
+	t[0xC5] = {&SNES_CPU::CMP<M8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	t[0xD2] = {&SNES_CPU::CMP<M8>, &SNES_CPU::DPI<M8>, 5, CYC_M | CYC_DL};
+	t[0xC7] = {&SNES_CPU::CMP<M8>, &SNES_CPU::DPIL<M8>, 6, CYC_M | CYC_DL};
+	t[0xDD] = {&SNES_CPU::CMP<M8>, &SNES_CPU::ABSX<M8, X8>, 4, CYC_M | CYC_IB};
+	t[0xDF] = {&SNES_CPU::CMP<M8>, &SNES_CPU::ABSLX<M8, X8>, 5, CYC_M};
+	t[0xD9] = {&SNES_CPU::CMP<M8>, &SNES_CPU::ABSY<M8, X8>, 4, CYC_M | CYC_IB};
+	t[0xD5] = {&SNES_CPU::CMP<M8>, &SNES_CPU::DPX<M8, X8>, 4, CYC_M | CYC_DL};
+	t[0xC1] = {&SNES_CPU::CMP<M8>, &SNES_CPU::DPIX<M8>, 6, CYC_M | CYC_DL};
+	t[0xD1] = {&SNES_CPU::CMP<M8>, &SNES_CPU::DPINY<M8>, 5, CYC_M | CYC_DL | CYC_IB};
+	t[0xD7] = {&SNES_CPU::CMP<M8>, &SNES_CPU::DPILNY<M8>, 6, CYC_M | CYC_DL};
+	t[0xC3] = {&SNES_CPU::CMP<M8>, &SNES_CPU::SR<M8, X8>, 4, CYC_M};
+	t[0xD3] = {&SNES_CPU::CMP<M8>, &SNES_CPU::SRIY<M8, X8>, 7, CYC_M};
+	// cpx
+	t[0xE0] = {&SNES_CPU::CPX<X8>, &SNES_CPU::IMM_X<X8>, 2, CYC_M};
+	t[0xEC] = {&SNES_CPU::CPX<X8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0xE4] = {&SNES_CPU::CPX<X8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	// cpy
+	t[0xC0] = {&SNES_CPU::CPY<X8>, &SNES_CPU::IMM_X<X8>, 2, CYC_M};
+	t[0xCC] = {&SNES_CPU::CPY<X8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0xC4] = {&SNES_CPU::CPY<X8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	// dec, dex, dey
+	t[0x3A] = {&SNES_CPU::DECA<M8>, &SNES_CPU::IMP, 2, 0};
+	t[0xC6] = {&SNES_CPU::DEC<M8>, &SNES_CPU::DP<M8>, 5, CYC_DL | CYC_M2};
+	t[0xCE] = {&SNES_CPU::DEC<M8>, &SNES_CPU::ABS<M8>, 6, CYC_M2};
+	t[0xD6] = {&SNES_CPU::DEC<M8>, &SNES_CPU::DPX<M8, X8>, 6, CYC_DL | CYC_M2};
+	t[0xDE] = {&SNES_CPU::DEC<M8>, &SNES_CPU::ABSX<M8, X8>, 7, CYC_M2};
+	t[0xCA] = {&SNES_CPU::DEX<X8>, &SNES_CPU::IMP, 2, 0};
+	t[0x88] = {&SNES_CPU::DEY<X8>, &SNES_CPU::IMP, 2, 0};
+	// eor
+	t[0x49] = {&SNES_CPU::EOR<M8>, &SNES_CPU::IMM_M<M8>, 2, CYC_M};
+	t[0x4D] = {&SNES_CPU::EOR<M8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0x4F] = {&SNES_CPU::EOR<M8>, &SNES_CPU::ABSL<M8>, 5, CYC_M};
+	t[0x45] = {&SNES_CPU::EOR<M8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	t[0x52] = {&SNES_CPU::EOR<M8>, &SNES_CPU::DPI<M8>, 5, CYC_M | CYC_DL};
+	t[0x47] = {&SNES_CPU::EOR<M8>, &SNES_CPU::DPIL<M8>, 6, CYC_M | CYC_DL};
+	t[0x5D] = {&SNES_CPU::EOR<M8>, &SNES_CPU::ABSX<M8, X8>, 4, CYC_M | CYC_IB};
+	t[0x5F] = {&SNES_CPU::EOR<M8>, &SNES_CPU::ABSLX<M8, X8>, 5, CYC_M};
+	t[0x59] = {&SNES_CPU::EOR<M8>, &SNES_CPU::ABSY<M8, X8>, 4, CYC_M | CYC_IB};
+	t[0x55] = {&SNES_CPU::EOR<M8>, &SNES_CPU::DPX<M8, X8>, 4, CYC_M | CYC_DL};
+	t[0x41] = {&SNES_CPU::EOR<M8>, &SNES_CPU::DPIX<M8>, 6, CYC_M | CYC_DL};
+	t[0x51] = {&SNES_CPU::EOR<M8>, &SNES_CPU::DPINY<M8>, 5, CYC_M | CYC_DL | CYC_IB};
+	t[0x57] = {&SNES_CPU::EOR<M8>, &SNES_CPU::DPILNY<M8>, 6, CYC_M | CYC_DL};
+	t[0x43] = {&SNES_CPU::EOR<M8>, &SNES_CPU::SR<M8, X8>, 4, CYC_M};
+	t[0x53] = {&SNES_CPU::EOR<M8>, &SNES_CPU::SRIY<M8, X8>, 7, CYC_M};
+	// inc, inx, iny
+	t[0x1A] = {&SNES_CPU::INCA<M8>, &SNES_CPU::IMP, 2, 0};
+	t[0xEE] = {&SNES_CPU::INC<M8>, &SNES_CPU::DP<M8>, 5, CYC_DL | CYC_M2};
+	t[0xE6] = {&SNES_CPU::INC<M8>, &SNES_CPU::ABS<M8>, 6, CYC_M2};
+	t[0xFE] = {&SNES_CPU::INC<M8>, &SNES_CPU::ABSX<M8, X8>, 7, CYC_M2};
+	t[0xF6] = {&SNES_CPU::INC<M8>, &SNES_CPU::DPX<M8, X8>, 6, CYC_DL | CYC_M2};
+	t[0xE8] = {&SNES_CPU::INX<X8>, &SNES_CPU::IMP, 2, 0};
+	t[0xC8] = {&SNES_CPU::INY<X8>, &SNES_CPU::IMP, 2, 0};
+	// jmp, jml
+	t[0x4C] = {&SNES_CPU::JMP, &SNES_CPU::IMM16, 3, 0};
+	t[0x6C] = {&SNES_CPU::JMP, &SNES_CPU::ABSI, 5, 0};
+	t[0x7C] = {&SNES_CPU::JMP, &SNES_CPU::ABSIX, 6, 0};
+	t[0x5C] = {&SNES_CPU::JML, &SNES_CPU::ABSL_JML_JSL, 4, 0};
+	t[0xDC] = {&SNES_CPU::JML, &SNES_CPU::ABSIL, 6, 0};
+	// jsr, jsl
+	t[0x20] = {&SNES_CPU::JSR, &SNES_CPU::IMM16, 6, 0};
+	t[0xFC] = {&SNES_CPU::JSR, &SNES_CPU::ABSIX, 8, 0};
+	t[0x22] = {&SNES_CPU::JSL, &SNES_CPU::ABSL_JML_JSL, 8, 0};
+	// lda
+	t[0xA9] = {&SNES_CPU::LDA<M8>, &SNES_CPU::IMM_M<M8>, 2, CYC_M};
+	t[0xAD] = {&SNES_CPU::LDA<M8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0xAF] = {&SNES_CPU::LDA<M8>, &SNES_CPU::ABSL<M8>, 5, CYC_M};
+	t[0xA5] = {&SNES_CPU::LDA<M8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	t[0xB2] = {&SNES_CPU::LDA<M8>, &SNES_CPU::DPI<M8>, 5, CYC_M | CYC_DL};
+	t[0xA7] = {&SNES_CPU::LDA<M8>, &SNES_CPU::DPIL<M8>, 6, CYC_M | CYC_DL};
+	t[0xBD] = {&SNES_CPU::LDA<M8>, &SNES_CPU::ABSX<M8, X8>, 4, CYC_M | CYC_IB};
+	t[0xBF] = {&SNES_CPU::LDA<M8>, &SNES_CPU::ABSLX<M8, X8>, 5, CYC_M};
+	t[0xB9] = {&SNES_CPU::LDA<M8>, &SNES_CPU::ABSY<M8, X8>, 4, CYC_M | CYC_IB};
+	t[0xB5] = {&SNES_CPU::LDA<M8>, &SNES_CPU::DPX<M8, X8>, 4, CYC_M | CYC_DL};
+	t[0xA1] = {&SNES_CPU::LDA<M8>, &SNES_CPU::DPIX<M8>, 6, CYC_M | CYC_DL};
+	t[0xB1] = {&SNES_CPU::LDA<M8>, &SNES_CPU::DPINY<M8>, 5, CYC_M | CYC_DL | CYC_IB};
+	t[0xB7] = {&SNES_CPU::LDA<M8>, &SNES_CPU::DPILNY<M8>, 6, CYC_M | CYC_DL};
+	t[0xA3] = {&SNES_CPU::LDA<M8>, &SNES_CPU::SR<M8, X8>, 4, CYC_M};
+	t[0xB3] = {&SNES_CPU::LDA<M8>, &SNES_CPU::SRIY<M8, X8>, 7, CYC_M};
+	// ldx
+	t[0xA2] = {&SNES_CPU::LDX<X8>, &SNES_CPU::IMM_X<X8>, 2, CYC_X};
+	t[0xAE] = {&SNES_CPU::LDX<X8>, &SNES_CPU::ABS<M8>, 4, CYC_X};
+	t[0xA6] = {&SNES_CPU::LDX<X8>, &SNES_CPU::DP<M8>, 3, CYC_X | CYC_DL};
+	t[0xBE] = {&SNES_CPU::LDX<X8>, &SNES_CPU::ABSY<M8, X8>, 4, CYC_X | CYC_IB};
+	t[0xB6] = {&SNES_CPU::LDX<X8>, &SNES_CPU::DPY<M8, X8>, 4, CYC_X | CYC_DL};
+	// ldy
+	t[0xA0] = {&SNES_CPU::LDY<X8>, &SNES_CPU::IMM_X<X8>, 2, CYC_X};
+	t[0xAC] = {&SNES_CPU::LDY<X8>, &SNES_CPU::ABS<M8>, 4, CYC_X};
+	t[0xA4] = {&SNES_CPU::LDY<X8>, &SNES_CPU::DP<M8>, 3, CYC_X | CYC_DL};
+	t[0xBC] = {&SNES_CPU::LDY<X8>, &SNES_CPU::ABSX<M8, X8>, 4, CYC_X | CYC_DL};
+	t[0xB4] = {&SNES_CPU::LDY<X8>, &SNES_CPU::DPX<M8, X8>, 4, CYC_X | CYC_DL};
+	// mvn, mvp
+	t[0x54] = {&SNES_CPU::MVN, &SNES_CPU::IMM16, 7, CYC_MV};
+	t[0x44] = {&SNES_CPU::MVP, &SNES_CPU::IMM16, 7, CYC_MV};
+	// nop
+	t[0xEA] = {&SNES_CPU::NOP, &SNES_CPU::IMP, 2, 0};
+	// ora
+	t[0x09] = {&SNES_CPU::ORA<M8>, &SNES_CPU::IMM_M<M8>, 2, CYC_M};
+	t[0x0D] = {&SNES_CPU::ORA<M8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0x0F] = {&SNES_CPU::ORA<M8>, &SNES_CPU::ABSL<M8>, 5, CYC_M};
+	t[0x05] = {&SNES_CPU::ORA<M8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	t[0x12] = {&SNES_CPU::ORA<M8>, &SNES_CPU::DPI<M8>, 5, CYC_M | CYC_DL};
+	t[0x07] = {&SNES_CPU::ORA<M8>, &SNES_CPU::DPIL<M8>, 6, CYC_M | CYC_DL};
+	t[0x1D] = {&SNES_CPU::ORA<M8>, &SNES_CPU::ABSX<M8, X8>, 4, CYC_M | CYC_IB};
+	t[0x1F] = {&SNES_CPU::ORA<M8>, &SNES_CPU::ABSLX<M8, X8>, 5, CYC_M};
+	t[0x19] = {&SNES_CPU::ORA<M8>, &SNES_CPU::ABSY<M8, X8>, 4, CYC_M | CYC_IB};
+	t[0x15] = {&SNES_CPU::ORA<M8>, &SNES_CPU::DPX<M8, X8>, 4, CYC_M | CYC_DL};
+	t[0x01] = {&SNES_CPU::ORA<M8>, &SNES_CPU::DPIX<M8>, 6, CYC_M | CYC_DL};
+	t[0x11] = {&SNES_CPU::ORA<M8>, &SNES_CPU::DPINY<M8>, 5, CYC_M | CYC_DL | CYC_IB};
+	t[0x17] = {&SNES_CPU::ORA<M8>, &SNES_CPU::DPILNY<M8>, 6, CYC_M | CYC_DL};
+	t[0x03] = {&SNES_CPU::ORA<M8>, &SNES_CPU::SR<M8, X8>, 4, CYC_M};
+	t[0x13] = {&SNES_CPU::ORA<M8>, &SNES_CPU::SRIY<M8, X8>, 7, CYC_M};
+	// pea, pei, per
+	t[0xF4] = {&SNES_CPU::PEA, &SNES_CPU::IMM16, 5, 0};
+	t[0xD4] = {&SNES_CPU::PEI, &SNES_CPU::DP16, 6, CYC_DL};
+	t[0x62] = {&SNES_CPU::PER, &SNES_CPU::IMM16, 6, 0};
+	// push to stack
+	t[0x48] = {&SNES_CPU::PHA<M8>, &SNES_CPU::IMP, 3, CYC_M};
+	t[0x8B] = {&SNES_CPU::PHB, &SNES_CPU::IMP, 3, 0};
+	t[0x0B] = {&SNES_CPU::PHD, &SNES_CPU::IMP, 4, 0};
+	t[0x4B] = {&SNES_CPU::PHK, &SNES_CPU::IMP, 3, 0};
+	t[0x08] = {&SNES_CPU::PHP, &SNES_CPU::IMP, 3, 0};
+	t[0xDA] = {&SNES_CPU::PHX<X8>, &SNES_CPU::IMP, 3, CYC_X};
+	t[0x5A] = {&SNES_CPU::PHY<X8>, &SNES_CPU::IMP, 3, CYC_X};
+	// pull from stack
+	t[0x68] = {&SNES_CPU::PLA<M8>, &SNES_CPU::IMP, 4, CYC_M};
+	t[0xAB] = {&SNES_CPU::PLB, &SNES_CPU::IMP, 4, 0};
+	t[0x2B] = {&SNES_CPU::PLD, &SNES_CPU::IMP, 5, 0};
+	t[0x28] = {&SNES_CPU::PLP, &SNES_CPU::IMP, 4, 0};
+	t[0xFA] = {&SNES_CPU::PLX<M8>, &SNES_CPU::IMP, 4, CYC_X};
+	t[0x7A] = {&SNES_CPU::PLY<M8>, &SNES_CPU::IMP, 4, CYC_X};
+	// rep
+	t[0xC2] = {&SNES_CPU::REP, &SNES_CPU::IMM8, 3, 0};
+	// rol
+	t[0x2A] = {&SNES_CPU::ROLA<M8>, &SNES_CPU::IMP, 2, 0};
+	t[0x2E] = {&SNES_CPU::ROL<M8>, &SNES_CPU::ABS<M8>, 6, CYC_M};
+	t[0x26] = {&SNES_CPU::ROL<M8>, &SNES_CPU::DP<M8>, 5, CYC_M | CYC_DL};
+	t[0x3E] = {&SNES_CPU::ROL<M8>, &SNES_CPU::ABSX<M8, X8>, 7, CYC_M};
+	t[0x36] = {&SNES_CPU::ROL<M8>, &SNES_CPU::DPX<M8, X8>, 6, CYC_M | CYC_DL};
+	// ror
+	t[0x6A] = {&SNES_CPU::RORA<M8>, &SNES_CPU::IMP, 2, 0};
+	t[0x6E] = {&SNES_CPU::ROR<M8>, &SNES_CPU::ABS<M8>, 6, CYC_M};
+	t[0x66] = {&SNES_CPU::ROR<M8>, &SNES_CPU::DP<M8>, 5, CYC_M | CYC_DL};
+	t[0x7E] = {&SNES_CPU::ROR<M8>, &SNES_CPU::ABSX<M8, X8>, 7, CYC_M};
+	t[0x76] = {&SNES_CPU::ROR<M8>, &SNES_CPU::DPX<M8, X8>, 6, CYC_M | CYC_DL};
+	// rti, rts, rtl
+	t[0x40] = {&SNES_CPU::RTI, &SNES_CPU::IMP, 6, CYC_E};
+	t[0x60] = {&SNES_CPU::RTS, &SNES_CPU::IMP, 6, 0};
+	t[0x6B] = {&SNES_CPU::RTL, &SNES_CPU::IMP, 6, 0};
+	// sbc
+	t[0xE9] = {&SNES_CPU::SBC<M8>, &SNES_CPU::IMM_M<M8>, 2, CYC_M};
+	t[0xED] = {&SNES_CPU::SBC<M8>, &SNES_CPU::ABS<M8>, 2, CYC_M};
+	t[0xEF] = {&SNES_CPU::SBC<M8>, &SNES_CPU::ABSL<M8>, 2, CYC_M};
+	t[0xE5] = {&SNES_CPU::SBC<M8>, &SNES_CPU::DP<M8>, 2, CYC_M};
+	t[0xF2] = {&SNES_CPU::SBC<M8>, &SNES_CPU::DPI<M8>, 2, CYC_M};
+	t[0xE7] = {&SNES_CPU::SBC<M8>, &SNES_CPU::DPIL<M8>, 2, CYC_M};
+	t[0xFD] = {&SNES_CPU::SBC<M8>, &SNES_CPU::ABSX<M8, X8>, 2, CYC_M};
+	t[0xFF] = {&SNES_CPU::SBC<M8>, &SNES_CPU::ABSLX<M8, X8>, 2, CYC_M};
+	t[0xF9] = {&SNES_CPU::SBC<M8>, &SNES_CPU::ABSY<M8, X8>, 2, CYC_M};
+	t[0xF5] = {&SNES_CPU::SBC<M8>, &SNES_CPU::DPX<M8, X8>, 2, CYC_M};
+	t[0xE1] = {&SNES_CPU::SBC<M8>, &SNES_CPU::DPIX<M8>, 2, CYC_M};
+	t[0xF1] = {&SNES_CPU::SBC<M8>, &SNES_CPU::DPINY<M8>, 2, CYC_M};
+	t[0xF7] = {&SNES_CPU::SBC<M8>, &SNES_CPU::DPILNY<M8>, 2, CYC_M};
+	t[0xE3] = {&SNES_CPU::SBC<M8>, &SNES_CPU::SR<M8, X8>, 2, CYC_M};
+	t[0xF3] = {&SNES_CPU::SBC<M8>, &SNES_CPU::SRIY<M8, X8>, 2, CYC_M};
+	// sec, sed, sei
+	t[0x38] = {&SNES_CPU::SEC, &SNES_CPU::IMP, 2, 0};
+	t[0x78] = {&SNES_CPU::SEI, &SNES_CPU::IMP, 2, 0};
+	t[0xF8] = {&SNES_CPU::SED, &SNES_CPU::IMP, 2, 0};
+	// sep
+	t[0xE2] = {&SNES_CPU::SEP, &SNES_CPU::IMM8, 3, 0};
+	// sta
+	t[0x8D] = {&SNES_CPU::STA<M8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0x8F] = {&SNES_CPU::STA<M8>, &SNES_CPU::ABSL<M8>, 5, CYC_M};
+	t[0x85] = {&SNES_CPU::STA<M8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	t[0x92] = {&SNES_CPU::STA<M8>, &SNES_CPU::DPI<M8>, 5, CYC_M | CYC_DL};
+	t[0x87] = {&SNES_CPU::STA<M8>, &SNES_CPU::DPIL<M8>, 6, CYC_M | CYC_DL};
+	t[0x9D] = {&SNES_CPU::STA<M8>, &SNES_CPU::ABSX<M8, X8>, 5, CYC_M};
+	t[0x9F] = {&SNES_CPU::STA<M8>, &SNES_CPU::ABSLX<M8, X8>, 5, CYC_M};
+	t[0x99] = {&SNES_CPU::STA<M8>, &SNES_CPU::ABSY<M8, X8>, 5, CYC_M};
+	t[0x95] = {&SNES_CPU::STA<M8>, &SNES_CPU::DPX<M8, X8>, 4, CYC_M | CYC_DL};
+	t[0x81] = {&SNES_CPU::STA<M8>, &SNES_CPU::DPIX<M8>, 6, CYC_M | CYC_DL};
+	t[0x91] = {&SNES_CPU::STA<M8>, &SNES_CPU::DPINY<M8>, 6, CYC_M | CYC_DL};
+	t[0x97] = {&SNES_CPU::STA<M8>, &SNES_CPU::DPILNY<M8>, 6, CYC_M | CYC_DL};
+	t[0x83] = {&SNES_CPU::STA<M8>, &SNES_CPU::SR<M8, X8>, 4, CYC_M};
+	t[0x93] = {&SNES_CPU::STA<M8>, &SNES_CPU::SRIY<M8, X8>, 7, CYC_M};
+	// stx
+	t[0x8E] = {&SNES_CPU::STX<X8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0x86] = {&SNES_CPU::STX<X8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	t[0x96] = {&SNES_CPU::STX<X8>, &SNES_CPU::DPY<M8, X8>, 4, CYC_M | CYC_DL};
+	// sty
+	t[0x8C] = {&SNES_CPU::STY<X8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0x84] = {&SNES_CPU::STY<X8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	t[0x94] = {&SNES_CPU::STY<X8>, &SNES_CPU::DPX<M8, X8>, 4, CYC_M | CYC_DL};
+	// stz
+	t[0x9C] = {&SNES_CPU::STZ<M8>, &SNES_CPU::ABS<M8>, 4, CYC_M};
+	t[0x64] = {&SNES_CPU::STZ<M8>, &SNES_CPU::DP<M8>, 3, CYC_M | CYC_DL};
+	t[0x9E] = {&SNES_CPU::STZ<M8>, &SNES_CPU::ABSX<M8, X8>, 5, CYC_M};
+	t[0x74] = {&SNES_CPU::STZ<M8>, &SNES_CPU::DPX<M8, X8>, 4, CYC_M | CYC_DL};
+	// transfer registers
+	t[0xAA] = {&SNES_CPU::TAX<X8>, &SNES_CPU::IMP, 2, 0};
+	t[0xA8] = {&SNES_CPU::TAY<X8>, &SNES_CPU::IMP, 2, 0};
+	t[0x5B] = {&SNES_CPU::TCD, &SNES_CPU::IMP, 2, 0};
+	t[0x1B] = {&SNES_CPU::TCS, &SNES_CPU::IMP, 2, 0};
+	t[0x7B] = {&SNES_CPU::TDC, &SNES_CPU::IMP, 2, 0};
+	t[0x3B] = {&SNES_CPU::TSC, &SNES_CPU::IMP, 2, 0};
+	t[0xBA] = {&SNES_CPU::TSX<X8>, &SNES_CPU::IMP, 2, 0};
+	t[0x8A] = {&SNES_CPU::TXA<M8>, &SNES_CPU::IMP, 2, 0};
+	t[0x9A] = {&SNES_CPU::TXS, &SNES_CPU::IMP, 2, 0};
+	t[0x9B] = {&SNES_CPU::TXY<X8>, &SNES_CPU::IMP, 2, 0};
+	t[0x98] = {&SNES_CPU::TYA<M8>, &SNES_CPU::IMP, 2, 0};
+	t[0xBB] = {&SNES_CPU::TYX<X8>, &SNES_CPU::IMP, 2, 0};
+	// trb, tsb
+	t[0x1C] = {&SNES_CPU::TRB<M8>, &SNES_CPU::ABS<M8>, 6, CYC_M2};
+	t[0x14] = {&SNES_CPU::TRB<M8>, &SNES_CPU::DP<M8>, 5, CYC_M2 | CYC_DL};
+	t[0x0C] = {&SNES_CPU::TSB<M8>, &SNES_CPU::ABS<M8>, 6, CYC_M2};
+	t[0x04] = {&SNES_CPU::TSB<M8>, &SNES_CPU::DP<M8>, 5, CYC_M2 | CYC_DL};
+	// wai, stp
+	t[0xCB] = {&SNES_CPU::WAI, &SNES_CPU::IMP, 3, 0};
+	t[0xDB] = {&SNES_CPU::STP, &SNES_CPU::IMP, 3, 0};
+	// xba, xce
+	t[0xEB] = {&SNES_CPU::XBA, &SNES_CPU::IMP, 3, 0};
+	t[0xFB] = {&SNES_CPU::XCE, &SNES_CPU::IMP, 2, 0};
+
+	// fold the width-dependent cycles into the base count so only
+	// the modifiers that can change per instruction are left
+	for(instruction& inst : t) {
+		inst.length = operandLength<M8, X8>(inst.mode);
+		inst.endsBlock = isBlockEnd(inst.op);
+		inst.readOnly = isReadOnly<M8, X8>(inst.op);
+		if(inst.cycleMods & CYC_M) inst.cycles += M8 ? 0 : 1;
+		if(inst.cycleMods & CYC_M2) inst.cycles += M8 ? 0 : 2;
+		if(inst.cycleMods & CYC_X) inst.cycles += X8 ? 0 : 1;
+		inst.cycleMods &= ~(CYC_M | CYC_M2 | CYC_X);
+	}
+
+	return t;
+}
+
+template<bool M8, bool X8>
+byte SNES_CPU::operandLength(handler mode) {
+	if(mode == &SNES_CPU::IMP) return 0;
+	if(mode == &SNES_CPU::IMM_M<M8>) return M8 ? 1 : 2;
+	if(mode == &SNES_CPU::IMM_X<X8>) return X8 ? 1 : 2;
+
+	const handler word_modes[] = {
+		&SNES_CPU::IMM16, &SNES_CPU::ABS<M8>, &SNES_CPU::ABSX<M8, X8>, &SNES_CPU::ABSY<M8, X8>,
+		&SNES_CPU::ABSI, &SNES_CPU::ABSIX, &SNES_CPU::ABSIL
+	};
+	const handler long_modes[] = {
+		&SNES_CPU::ABSL<M8>, &SNES_CPU::ABSL_JML_JSL, &SNES_CPU::ABSLX<M8, X8>, &SNES_CPU::ABSLY<M8, X8>
+	};
+	for(handler word : word_modes)
+		if(mode == word) return 2;
+	for(handler full : long_modes)
+		if(mode == full) return 3;
+	// direct page, stack relative and the 8-bit immediates
+	return 1;
+}
+
+// loads, compares, register arithmetic and transfers, flag changes and the
+// branches and jumps, as far as idle loops go
+template<bool M8, bool X8>
+bool SNES_CPU::isReadOnly(handler op) {
+	const handler reads[] = {
+		&SNES_CPU::LDA<M8>, &SNES_CPU::LDX<X8>, &SNES_CPU::LDY<X8>,
+		&SNES_CPU::CMP<M8>, &SNES_CPU::CPX<X8>, &SNES_CPU::CPY<X8>, &SNES_CPU::BIT<M8>, &SNES_CPU::BITIMM<M8>,
+		&SNES_CPU::AND<M8>, &SNES_CPU::ORA<M8>, &SNES_CPU::EOR<M8>, &SNES_CPU::ADC<M8>, &SNES_CPU::SBC<M8>,
+		&SNES_CPU::INCA<M8>, &SNES_CPU::DECA<M8>, &SNES_CPU::INX<X8>, &SNES_CPU::INY<X8>, &SNES_CPU::DEX<X8>, &SNES_CPU::DEY<X8>,
+		&SNES_CPU::ASLA<M8>, &SNES_CPU::LSRA<M8>, &SNES_CPU::ROLA<M8>, &SNES_CPU::RORA<M8>,
+		&SNES_CPU::TAX<X8>, &SNES_CPU::TAY<X8>, &SNES_CPU::TXA<M8>, &SNES_CPU::TYA<M8>, &SNES_CPU::TXY<X8>, &SNES_CPU::TYX<X8>,
+		&SNES_CPU::TDC, &SNES_CPU::TSC, &SNES_CPU::TSX<X8>, &SNES_CPU::XBA, &SNES_CPU::NOP,
+		&SNES_CPU::CLC, &SNES_CPU::CLD, &SNES_CPU::CLV, &SNES_CPU::SEC, &SNES_CPU::SED,
+		&SNES_CPU::BCC, &SNES_CPU::BCS, &SNES_CPU::BEQ, &SNES_CPU::BMI, &SNES_CPU::BNE, &SNES_CPU::BPL,
+		&SNES_CPU::BRA, &SNES_CPU::BRL, &SNES_CPU::BVC, &SNES_CPU::BVS, &SNES_CPU::JMP, &SNES_CPU::JML
+	};
+	for(handler read : reads)
+		if(op == read) return true;
+	return false;
+}
+
+bool SNES_CPU::isBlockEnd(handler op) {
+	const handler enders[] = {
+		&SNES_CPU::BCC, &SNES_CPU::BCS, &SNES_CPU::BEQ, &SNES_CPU::BMI, &SNES_CPU::BNE, &SNES_CPU::BPL,
+		&SNES_CPU::BRA, &SNES_CPU::BRL, &SNES_CPU::BVC, &SNES_CPU::BVS,
+		&SNES_CPU::JMP, &SNES_CPU::JML, &SNES_CPU::JSR, &SNES_CPU::JSL,
+		&SNES_CPU::RTI, &SNES_CPU::RTS, &SNES_CPU::RTL, &SNES_CPU::BRK, &SNES_CPU::COP,
+		// width changes
+		&SNES_CPU::REP, &SNES_CPU::SEP, &SNES_CPU::PLP, &SNES_CPU::XCE,
+		// repeat themselves by moving PC back
+		&SNES_CPU::MVN, &SNES_CPU::MVP,
+		// interrupts are taken between blocks
+		&SNES_CPU::CLI, &SNES_CPU::WAI, &SNES_CPU::STP,
+		&SNES_CPU::ILL
+	};
+	for(handler ender : enders)
+		if(op == ender) return true;
+	return false;
+}
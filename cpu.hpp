@@ -6,118 +6,196 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <iostream>
-#include <map>
-#include <utility>
-#include <functional>
+#include <array>
+#include <unordered_map>
+#include <vector>
 
 class SNES_MEMORY;
+class SNES_JIT;
+class SNES_STATE;
+class SNES_PROFILER;
 #include "ram.hpp"
+#include "scheduler.hpp"
 
 #define DLNONZERO			(*DL != 0x00)
-#define MZERO				(status.bits.m ? 0 : 1)
-#define XZERO				(status.bits.x ? 0 : 1)
 #define EZERO				(e ? 0 : 1)
 
-class SNES_CPU {
+// longest run of instructions decoded into one cached block
+#define CPU_MAX_BLOCK		32
+
+// the programmer-visible registers
+struct SNES_CPU_REGISTERS {
+	twobyte C, X, Y, S, D, PC;
+	byte DBR, K, P;
+	bool e;
+};
+
+class SNES_CPU : public SNES_CLOCKED {
 public:
 	SNES_CPU(CPU_APU_IO* apu_io);
 	~SNES_CPU();
 
 	void init();
-	bool clock();
+	// executes one whole instruction and returns the cycles it took (0 once halted)
+	uint32_t step();
+	// batch execution for the scheduler, advancing time in master cycles
+	bool runUntil(uint64_t target) override;
+	// runs instructions back to back for cycle_budget master cycles, or until
+	// the batch is ended early (an interrupt line changing, a halt), and
+	// returns the master cycles that took. the last instruction can go past
+	// the budget, by its own cycles
+	uint64_t run(uint64_t cycle_budget);
 
 	// hardware interrupts
 	void abort();
 	void reset();
 	void irq();
 	void nmi();
+	// the interrupt controller's lines. an nmi is taken once each time it is
+	// raised, an irq for as long as the line is held and I is clear. they are
+	// taken between blocks, and raising one ends the current batch there
+	void raiseNMI() {nmi_pending = true; endBatch();};
+	void setIRQ(bool level) {irq_line = level; endBatch();};
+	// runUntil() returns after the current instruction
+	void endBatch() {run_target = time;};
+	// waiting in WAI, stopped by STP, or spinning in an idle loop: nothing
+	// changes until the next interrupt, unless one is already due
+	bool idle() override {return stopped || ((waiting || idle_spin) && !nmi_pending && !irq_line);};
 
 	SNES_MEMORY* mem;
+	CPU_APU_IO* apu_io;
+	// executed instructions are traced under TRACE_CPU at TRACE_INFO when set
+	SNES_TRACER* tracer = nullptr;
+	// counts and samples the code that runs while set. cached blocks count
+	// their own passes, so the block cache, the jit and idle skipping run as
+	// they do without it
+	SNES_PROFILER* profiler = nullptr;
+	// hands what the cached blocks counted to the profiler, whose opcode
+	// counts are only complete after this
+	void flushProfile();
 	
 	twobyte debugAccum() {return C;};
+	static const char* mnemonic(byte opcode) {return opNames[opcode];};
 	void debugPrint();
-	byte getCycles() {return cyclesRemaining;};
+
+	// runUntil() executes blocks of instructions decoded once and cached by
+	// K:PC and register width, instead of decoding every instruction. on by
+	// default, both ways give the same results
+	void setBlockCache(bool enabled);
+	bool getBlockCache() {return block_cache;};
+	// drops the blocks cached from one page of the address space (the memory
+	// calls this when a page holding code is written), or all of them
+	void invalidateCode(size_t page);
+	void flushCode();
+
+	// hot blocks run as x86-64 compiled by SNES_JIT, on top of the block
+	// cache. the interpreter stays the reference, both give the same results.
+	// returns false on hosts without a code generator, or that refuse it
+	// executable memory (said on the log)
+	bool setJIT(bool enabled);
+	bool getJIT() {return jit != nullptr;};
+
+	// idle loops (a block that reads nothing but plain memory and spins in
+	// place, e.g. waiting for the nmi handler to clear a flag) have their
+	// passes up to the next event skipped, their cycles and instructions
+	// counted as if they ran. needs the block cache, on by default, both
+	// ways give the same results
+	void setIdleSkip(bool enabled) {idle_skip = enabled; idle_spin = false;};
+	bool getIdleSkip() {return idle_skip;};
+	// master cycles skipped so far
+	uint64_t getSkippedCycles() {return skipped_cycles;};
+
+	uint64_t getInstructions() {return instructions;};
+	SNES_CPU_REGISTERS getRegisters();
+
+	// registers and timing, then the memory. loading drops the block cache
+	void serialize(SNES_STATE& state);
 	
 private:
+	friend class SNES_JIT;
+
 	// utils
 	void updateRegisterWidths();
 
 	//
 	// operations
 	//
+
+	// handlers templated on M8/X8 are instantiated once per accumulator/index
+	// width (true = 8-bit), so the width checks resolve at compile time
 	
-	void ADC();
+	template<bool M8> void ADC();
 	
-	void AND();
+	template<bool M8> void AND();
 	
-	void ASL(); void ASLA();
+	template<bool M8> void ASL(); template<bool M8> void ASLA();
 	
 	void BCC(); void BCS(); void BEQ(); void BMI();
 	void BNE(); void BPL(); void BRA(); void BRL();
 	void BVC(); void BVS();
 	
-	void BIT(); void BITIMM();
+	template<bool M8> void BIT(); template<bool M8> void BITIMM();
 
 	void BRK(); void COP();
 	
 	void CLC(); void CLD();
 	void CLI(); void CLV();
 
-	void CMP();
-	void CPX();
-	void CPY();
+	template<bool M8> void CMP();
+	template<bool X8> void CPX();
+	template<bool X8> void CPY();
 
-	void DEC();
-	void DECA();
-	void DEX();
-	void DEY();
+	template<bool M8> void DEC();
+	template<bool M8> void DECA();
+	template<bool X8> void DEX();
+	template<bool X8> void DEY();
 
-	void EOR();
+	template<bool M8> void EOR();
 
-	void INC();
-	void INCA();
-	void INX();
-	void INY();
+	template<bool M8> void INC();
+	template<bool M8> void INCA();
+	template<bool X8> void INX();
+	template<bool X8> void INY();
 
 	void JMP();
 	void JML();
 	void JSR();
 	void JSL();
 
-	void LDA();
-	void LDX();
-	void LDY();
+	template<bool M8> void LDA();
+	template<bool X8> void LDX();
+	template<bool X8> void LDY();
 
-	void LSR(); void LSRA();
+	template<bool M8> void LSR(); template<bool M8> void LSRA();
 
 	void MVN();
 	void MVP();
 
 	void NOP() {return;};
 
-	void ORA();
+	template<bool M8> void ORA();
 
 	void PEA();
 	void PEI();
 	void PER();
 
-	void PHA(); void PHB(); void PHD(); void PHK();
-	void PHP(); void PHX(); void PHY();
+	template<bool M8> void PHA(); void PHB(); void PHD(); void PHK();
+	void PHP(); template<bool X8> void PHX(); template<bool X8> void PHY();
 
-	void PLA(); void PLB(); void PLD();
-	void PLP(); void PLX(); void PLY();
+	template<bool M8> void PLA(); void PLB(); void PLD();
+	void PLP(); template<bool M8> void PLX(); template<bool M8> void PLY();
 
 	void REP();
 
-	void ROL(); void ROLA();
-	void ROR(); void RORA();
+	template<bool M8> void ROL(); template<bool M8> void ROLA();
+	template<bool M8> void ROR(); template<bool M8> void RORA();
 
 	void RTI();
 
 	void RTS();
 	void RTL();
 
-	void SBC();
+	template<bool M8> void SBC();
 
 	void SEC();
 	void SEI();
@@ -125,17 +203,18 @@ private:
 
 	void SEP();
 
-	void STA();
-	void STX();
-	void STY();
-	void STZ();
+	template<bool M8> void STA();
+	void STP();
+	template<bool X8> void STX();
+	template<bool X8> void STY();
+	template<bool M8> void STZ();
 
-	void TAX(); void TAY(); void TCD(); void TCS();
-	void TDC(); void TSC(); void TSX(); void TXA();
-	void TXS(); void TXY(); void TYA(); void TYX();
+	template<bool X8> void TAX(); template<bool X8> void TAY(); void TCD(); void TCS();
+	void TDC(); void TSC(); template<bool X8> void TSX(); template<bool M8> void TXA();
+	void TXS(); template<bool X8> void TXY(); template<bool M8> void TYA(); template<bool X8> void TYX();
 
-	void TRB();
-	void TSB();
+	template<bool M8> void TRB();
+	template<bool M8> void TSB();
 
 	void WAI();
 
@@ -150,41 +229,41 @@ private:
 	void IMP() {return;};
 	
 	// immediate
-	void IMM_M(); void IMM_X();
+	template<bool M8> void IMM_M(); template<bool X8> void IMM_X();
 	
 	void IMM8(); void IMM16();
 	
 	// direct page
-	void DP(); void DP16();
+	template<bool M8> void DP(); void DP16();
 	
-	void DPX(); void DPY();
+	template<bool M8, bool X8> void DPX(); template<bool M8, bool X8> void DPY();
 	
 	// indirect
-	void DPI();
+	template<bool M8> void DPI();
 	
-	void DPIL();
+	template<bool M8> void DPIL();
 
-	void DPIX();
+	template<bool M8> void DPIX();
 	
-	void DPINY(); void DPILNY();
+	template<bool M8> void DPINY(); template<bool M8> void DPILNY();
 	
 	// absolute
-	void ABS(); void ABS_JMP_JSR();
+	template<bool M8> void ABS(); void ABS_JMP_JSR();
 	
-	void ABSL(); void ABSL_JML_JSL();
+	template<bool M8> void ABSL(); void ABSL_JML_JSL();
 	
-	void ABSX(); void ABSY();
+	template<bool M8, bool X8> void ABSX(); template<bool M8, bool X8> void ABSY();
 	
-	void ABSLX(); void ABSLY();
+	template<bool M8, bool X8> void ABSLX(); template<bool M8, bool X8> void ABSLY();
 
 	void ABSI(); void ABSIX();
 
 	void ABSIL();
 	
 	// stack relative
-	void SR();
+	template<bool M8, bool X8> void SR();
 	
-	void SRIY();
+	template<bool M8, bool X8> void SRIY();
 
 	// accumulator
 	twobyte C = 0x0000;
@@ -256,9 +335,21 @@ private:
 		char full;
 	} status;
 
+	// n and z are kept as the results that last set them and only worked
+	// out when read: n is bit 15 of n_result, z is set when z_result is 0.
+	// 8-bit results are stored shifted up. the n and z bits of status.full
+	// are stale, getStatus() and setStatus() fold them in and out
+	twobyte n_result = 0;
+	twobyte z_result = 1;
+	void setNZ8(byte value) {n_result = z_result = value << 8;};
+	void setNZ16(twobyte value) {n_result = z_result = value;};
+	bool flagN() {return n_result >> 15;};
+	bool flagZ() {return z_result == 0;};
+	byte getStatus() {return (status.full & 0x7D) | (flagN() << 7) | (flagZ() << 1);};
+	void setStatus(byte value);
+
 	bool e;
 	
-	byte cyclesRemaining = 0;
 	
 	twobyte fetched = 0x0000;
 	//byte* fetched_hi = (byte*)&fetched;
@@ -266,7 +357,7 @@ private:
 	byte* fetched_lo = (byte*)&fetched;
 	byte* fetched_hi = fetched_lo + 1;
 	
-	threebyte fetched_addr;
+	threebyte fetched_addr = 0;
 	byte* fetched_addr_lo = (byte*)&fetched_addr;
 	byte* fetched_addr_page = fetched_addr_lo + 1;
 	byte* fetched_addr_bank = fetched_addr_page + 1;
@@ -279,307 +370,151 @@ private:
 	bool branchBoundary = false;
 	bool wrap_writes = false;
 	
+	// extra cycles added on top of an instruction's base cycle count
+	enum : byte {
+		CYC_M  = 1 << 0,	// +1 if m = 0, folded into the per-width tables
+		CYC_M2 = 1 << 1,	// +2 if m = 0, folded into the per-width tables
+		CYC_X  = 1 << 2,	// +1 if x = 0, folded into the per-width tables
+		CYC_E  = 1 << 3,	// +1 if e = 0
+		CYC_DL = 1 << 4,	// +1 if low byte of D is nonzero
+		CYC_IB = 1 << 5,	// +1 if indexing crossed a boundary
+		CYC_BR = 1 << 6,	// +1 if branch taken
+		CYC_MV = 1 << 7		// +7 for each byte moved after the first
+	};
+
+	typedef void (SNES_CPU::*handler)();
+
 	typedef struct {
-		std::string name;
-		std::function<void()> op;
-		std::function<void()> mode;
-		std::function<byte()> cycleCount;
+		handler op;
+		handler mode;
+		byte cycles;
+		byte cycleMods;
+		// operand bytes after the opcode, filled in by buildOps()
+		byte length;
+		// can jump, or change the register widths
+		bool endsBlock;
+		// reads memory at most and only changes registers
+		bool readOnly;
 	} instruction;
-	
-	std::map<byte, instruction> ops {
-		// adc
-		{0x61, {"ADC", bind_fn(ADC), bind_fn(DPIX), [=]() -> byte {return 7 + MZERO + DLNONZERO;}}},
-		{0x63, {"ADC", bind_fn(ADC), bind_fn(SR), [=]() -> byte {return 5 + MZERO;}}},
-		{0x65, {"ADC", bind_fn(ADC), bind_fn(DP), [=]() -> byte {return 4 + MZERO + DLNONZERO;}}},
-		{0x67, {"ADC", bind_fn(ADC), bind_fn(DPIL), [=]() -> byte {return 7 + MZERO + DLNONZERO;}}},
-		{0x69, {"ADC", bind_fn(ADC), bind_fn(IMM_M), [=]() -> byte {return 3 + MZERO;}}},
-		{0x6D, {"ADC", bind_fn(ADC), bind_fn(ABS), [=]() -> byte {return 5 + MZERO;}}},
-		{0x6F, {"ADC", bind_fn(ADC), bind_fn(ABSL), [=]() -> byte {return 6 + MZERO;}}},
-		{0x71, {"ADC", bind_fn(ADC), bind_fn(DPINY), [=]() -> byte {return 6 + MZERO + DLNONZERO + iBoundary;}}},
-		{0x72, {"ADC", bind_fn(ADC), bind_fn(DPI), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x73, {"ADC", bind_fn(ADC), bind_fn(SRIY), [=]() -> byte {return 8 + MZERO;}}},
-		{0x75, {"ADC", bind_fn(ADC), bind_fn(DPX), [=]() -> byte {return 5 + MZERO + DLNONZERO;}}},
-		{0x77, {"ADC", bind_fn(ADC), bind_fn(DPILNY), [=]() -> byte {return 7 + MZERO + DLNONZERO;}}},
-		{0x79, {"ADC", bind_fn(ADC), bind_fn(ABSY), [=]() -> byte {return 5 + MZERO + iBoundary;}}},
-		{0x7D, {"ADC", bind_fn(ADC), bind_fn(ABSX), [=]() -> byte {return 5 + MZERO + iBoundary;}}},
-		{0x7F, {"ADC", bind_fn(ADC), bind_fn(ABSLX), [=]() -> byte {return 6 + MZERO;}}},
-		// and
-		{0x21, {"AND", bind_fn(AND), bind_fn(DPIX), [=]() -> byte {return 7 + MZERO + DLNONZERO;}}},
-		{0x23, {"AND", bind_fn(AND), bind_fn(SR), [=]() -> byte {return 5 + MZERO;}}},
-		{0x25, {"AND", bind_fn(AND), bind_fn(DP), [=]() -> byte {return 4 + MZERO + DLNONZERO;}}},
-		{0x27, {"AND", bind_fn(AND), bind_fn(DPIL), [=]() -> byte {return 7 + MZERO + DLNONZERO;}}},
-		{0x29, {"AND", bind_fn(AND), bind_fn(IMM_M), [=]() -> byte {return 3 + MZERO;}}},
-		{0x2D, {"AND", bind_fn(AND), bind_fn(ABS), [=]() -> byte {return 5 + MZERO;}}},
-		{0x2F, {"AND", bind_fn(AND), bind_fn(ABSL), [=]() -> byte {return 6 + MZERO;}}},
-		{0x31, {"AND", bind_fn(AND), bind_fn(DPINY), [=]() -> byte {return 6 + MZERO + DLNONZERO + iBoundary;}}},
-		{0x32, {"AND", bind_fn(AND), bind_fn(DPI), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x33, {"AND", bind_fn(AND), bind_fn(SRIY), [=]() -> byte {return 8 + MZERO;}}},
-		{0x35, {"AND", bind_fn(AND), bind_fn(DPX), [=]() -> byte {return 5 + MZERO + DLNONZERO;}}},
-		{0x37, {"AND", bind_fn(AND), bind_fn(DPILNY), [=]() -> byte {return 7 + MZERO + DLNONZERO;}}},
-		{0x39, {"AND", bind_fn(AND), bind_fn(ABSY), [=]() -> byte {return 5 + MZERO + iBoundary;}}},
-		{0x3D, {"AND", bind_fn(AND), bind_fn(ABSX), [=]() -> byte {return 5 + MZERO + iBoundary;}}},
-		{0x3F, {"AND", bind_fn(AND), bind_fn(ABSLX), [=]() -> byte {return 6 + MZERO;}}},
-		// asl
-		{0x06, {"ASL", bind_fn(ASL), bind_fn(DP), [=]() -> byte {return 5 + DLNONZERO + (2 * MZERO);}}},
-		{0x0A, {"ASL", bind_fn(ASLA), bind_fn(IMP), [=]() -> byte {return 2;}}},
-		{0x0E, {"ASL", bind_fn(ASL), bind_fn(ABS), [=]() -> byte {return 6 + (2 * MZERO);}}},
-		{0x16, {"ASL", bind_fn(ASL), bind_fn(DPX), [=]() -> byte {return 5 + DLNONZERO + (2 * MZERO);}}},
-		{0x1E, {"ASL", bind_fn(ASL), bind_fn(ABSX), [=]() -> byte {return 7 + (2 * MZERO);}}},
-		// lsr
-		{0x46, {"LSR", bind_fn(LSR), bind_fn(DP), [=]() -> byte {return 5 + DLNONZERO + MZERO;}}},
-		{0x4A, {"LSR", bind_fn(LSRA), bind_fn(IMP), [=]() -> byte {return 2;}}},
-		{0x4E, {"LSR", bind_fn(LSR), bind_fn(ABS), [=]() -> byte {return 6 + MZERO;}}},
-		{0x56, {"LSR", bind_fn(LSR), bind_fn(DPX), [=]() -> byte {return 5 + DLNONZERO + MZERO;}}},
-		{0x5E, {"LSR", bind_fn(LSR), bind_fn(ABSX), [=]() -> byte {return 7 + MZERO;}}},
-		// branching
-		{0x90, {"BCC", bind_fn(BCC), bind_fn(IMM8), [=]() -> byte {return 2 + branchTaken;}}},
-		{0xB0, {"BCS", bind_fn(BCS), bind_fn(IMM8), [=]() -> byte {return 2 + branchTaken;}}},
-		{0xF0, {"BEQ", bind_fn(BEQ), bind_fn(IMM8), [=]() -> byte {return 2 + branchTaken;}}},
-		{0x30, {"BMI", bind_fn(BMI), bind_fn(IMM8), [=]() -> byte {return 2 + branchTaken;}}},
-		{0xD0, {"BNE", bind_fn(BNE), bind_fn(IMM8), [=]() -> byte {return 2 + branchTaken;}}},
-		{0x10, {"BPL", bind_fn(BPL), bind_fn(IMM8), [=]() -> byte {return 2 + branchTaken;}}},
-		{0x80, {"BRA", bind_fn(BRA), bind_fn(IMM8), [=]() -> byte {return 3;}}},
-		{0x82, {"BRL", bind_fn(BRL), bind_fn(IMM16), [=]() -> byte {return 4;}}},
-		{0x50, {"BVC", bind_fn(BVC), bind_fn(IMM8), [=]() -> byte {return 2 + branchTaken;}}},
-		{0x70, {"BVS", bind_fn(BVS), bind_fn(IMM8), [=]() -> byte {return 2 + branchTaken;}}},
-		// bit
-		{0x24, {"BIT", bind_fn(BIT), bind_fn(DP), [=]() -> byte {return 4 - status.bits.m + DLNONZERO;}}},
-		{0x2C, {"BIT", bind_fn(BIT), bind_fn(ABS), [=]() -> byte {return 5 - status.bits.m;}}},
-		{0x34, {"BIT", bind_fn(BIT), bind_fn(DPX), [=]() -> byte {return 5 - status.bits.m + DLNONZERO;}}},
-		{0x3C, {"BIT", bind_fn(BIT), bind_fn(ABSX), [=]() -> byte {return 5 - status.bits.m + iBoundary;}}},
-		{0x89, {"BIT", bind_fn(BITIMM), bind_fn(IMM_M), [=]() -> byte {return 3 - status.bits.m;}}},
-		// interrupts
-		{0x00, {"BRK", bind_fn(BRK), bind_fn(IMP), []() -> byte {return 7;}}},
-		{0x02, {"COP", bind_fn(COP), bind_fn(IMP), []() -> byte {return 7;}}},
-		// clear flags
-		{0x18, {"CLC", bind_fn(CLC), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0xD8, {"CLD", bind_fn(CLD), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x58, {"CLI", bind_fn(CLI), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0xB8, {"CLV", bind_fn(CLV), bind_fn(IMP), []() -> byte {return 2;}}},
-		// cmp
-		{0xC9, {"CMP", bind_fn(CMP), bind_fn(IMM_M), [=]() -> byte {return 2 + MZERO;}}},
-		{0xCD, {"CMP", bind_fn(CMP), bind_fn(ABS), [=]() -> byte {return 4 + MZERO;}}},
-		{0xCF, {"CMP", bind_fn(CMP), bind_fn(ABSL), [=]() -> byte {return 5 + MZERO;}}},
-		{0xC5, {"CMP", bind_fn(CMP), bind_fn(DP), [=]() -> byte {return 3 + MZERO + DLNONZERO;}}},
-		{0xD2, {"CMP", bind_fn(CMP), bind_fn(DPI), [=]() -> byte {return 5 + MZERO + DLNONZERO;}}},
-		{0xC7, {"CMP", bind_fn(CMP), bind_fn(DPIL), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0xDD, {"CMP", bind_fn(CMP), bind_fn(ABSX), [=]() -> byte {return 4 + MZERO + iBoundary;}}},
-		{0xDF, {"CMP", bind_fn(CMP), bind_fn(ABSLX), [=]() -> byte {return 5 + MZERO;}}},
-		{0xD9, {"CMP", bind_fn(CMP), bind_fn(ABSY), [=]() -> byte {return 4 + MZERO + iBoundary;}}},
-		{0xD5, {"CMP", bind_fn(CMP), bind_fn(DPX), [=]() -> byte {return 4 + MZERO + DLNONZERO;}}},
-		{0xC1, {"CMP", bind_fn(CMP), bind_fn(DPIX), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0xD1, {"CMP", bind_fn(CMP), bind_fn(DPINY), [=]() -> byte {return 5 + MZERO + DLNONZERO + iBoundary;}}},
-		{0xD7, {"CMP", bind_fn(CMP), bind_fn(DPILNY), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0xC3, {"CMP", bind_fn(CMP), bind_fn(SR), [=]() -> byte {return 4 + MZERO;}}},
-		{0xD3, {"CMP", bind_fn(CMP), bind_fn(SRIY), [=]() -> byte {return 7 + MZERO;}}},
-		// cpx
-		{0xE0, {"CPX", bind_fn(CPX), bind_fn(IMM_X), [=]() -> byte {return 2 + MZERO;}}},
-		{0xEC, {"CPX", bind_fn(CPX), bind_fn(ABS), [=]() -> byte {return 4 + MZERO;}}},
-		{0xE4, {"CPX", bind_fn(CPX), bind_fn(DP), [=]() -> byte {return 3 + MZERO + DLNONZERO;}}},
-		// cpy
-		{0xC0, {"CPY", bind_fn(CPY), bind_fn(IMM_X), [=]() -> byte {return 2 + MZERO;}}},
-		{0xCC, {"CPY", bind_fn(CPY), bind_fn(ABS), [=]() -> byte {return 4 + MZERO;}}},
-		{0xC4, {"CPY", bind_fn(CPY), bind_fn(DP), [=]() -> byte {return 3 + MZERO + DLNONZERO;}}},
-		// dec, dex, dey
-		{0x3A, {"DEC", bind_fn(DECA), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0xC6, {"DEC", bind_fn(DEC), bind_fn(DP), [=]() -> byte {return 5 + DLNONZERO + (2 * MZERO);}}},
-		{0xCE, {"DEC", bind_fn(DEC), bind_fn(ABS), [=]() -> byte {return 6 + (2 * MZERO);}}},
-		{0xD6, {"DEC", bind_fn(DEC), bind_fn(DPX), [=]() -> byte {return 6 + DLNONZERO + (2 * MZERO);}}},
-		{0xDE, {"DEC", bind_fn(DEC), bind_fn(ABSX), [=]() -> byte {return 7 + (2 * MZERO);}}},
-		{0xCA, {"DEX", bind_fn(DEX), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x88, {"DEY", bind_fn(DEY), bind_fn(IMP), []() -> byte {return 2;}}},
-		// eor
-		{0x49, {"EOR", bind_fn(EOR), bind_fn(IMM_M), [=]() -> byte {return 2 + MZERO;}}},
-		{0x4D, {"EOR", bind_fn(EOR), bind_fn(ABS), [=]() -> byte {return 4 + MZERO;}}},
-		{0x4F, {"EOR", bind_fn(EOR), bind_fn(ABSL), [=]() -> byte {return 5 + MZERO;}}},
-		{0x45, {"EOR", bind_fn(EOR), bind_fn(DP), [=]() -> byte {return 3 + MZERO + DLNONZERO;}}},
-		{0x52, {"EOR", bind_fn(EOR), bind_fn(DPI), [=]() -> byte {return 5 + MZERO + DLNONZERO;}}},
-		{0x47, {"EOR", bind_fn(EOR), bind_fn(DPIL), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x5D, {"EOR", bind_fn(EOR), bind_fn(ABSX), [=]() -> byte {return 4 + MZERO + iBoundary;}}},
-		{0x5F, {"EOR", bind_fn(EOR), bind_fn(ABSLX), [=]() -> byte {return 5 + MZERO;}}},
-		{0x59, {"EOR", bind_fn(EOR), bind_fn(ABSY), [=]() -> byte {return 4 + MZERO + iBoundary;}}},
-		{0x55, {"EOR", bind_fn(EOR), bind_fn(DPX), [=]() -> byte {return 4 + MZERO + DLNONZERO;}}},
-		{0x41, {"EOR", bind_fn(EOR), bind_fn(DPIX), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x51, {"EOR", bind_fn(EOR), bind_fn(DPINY), [=]() -> byte {return 5 + MZERO + DLNONZERO + iBoundary;}}},
-		{0x57, {"EOR", bind_fn(EOR), bind_fn(DPILNY), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x43, {"EOR", bind_fn(EOR), bind_fn(SR), [=]() -> byte {return 4 + MZERO;}}},
-		{0x53, {"EOR", bind_fn(EOR), bind_fn(SRIY), [=]() -> byte {return 7 + MZERO;}}},
-		// inc, inx, iny
-		{0x1A, {"INC", bind_fn(INCA), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0xEE, {"INC", bind_fn(INC), bind_fn(DP), [=]() -> byte {return 5 + DLNONZERO + (2 * MZERO);}}},
-		{0xE6, {"INC", bind_fn(INC), bind_fn(ABS), [=]() -> byte {return 6 + (2 * MZERO);}}},
-		{0xFE, {"INC", bind_fn(INC), bind_fn(ABSX), [=]() -> byte {return 7 + (2 * MZERO);}}},
-		{0xF6, {"INC", bind_fn(INC), bind_fn(DPX), [=]() -> byte {return 6 + DLNONZERO + (2 * MZERO);}}},
-		{0xE8, {"INC", bind_fn(INX), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0xC8, {"INC", bind_fn(INY), bind_fn(IMP), []() -> byte {return 2;}}},
-		// jmp, jml
-		{0x4C, {"JMP", bind_fn(JMP), bind_fn(IMM16), []() -> byte {return 3;}}},
-		{0x6C, {"JMP", bind_fn(JMP), bind_fn(ABSI), []() -> byte {return 5;}}},
-		{0x7C, {"JMP", bind_fn(JMP), bind_fn(ABSIX), []() -> byte {return 6;}}},
-		{0x5C, {"JML", bind_fn(JML), bind_fn(ABSL_JML_JSL), []() -> byte {return 4;}}},
-		{0xDC, {"JML", bind_fn(JML), bind_fn(ABSIL), []() -> byte {return 6;}}},
-		// jsr, jsl
-		{0x20, {"JSR", bind_fn(JSR), bind_fn(IMM16), []() -> byte {return 6;}}},
-		{0xFC, {"JSR", bind_fn(JSR), bind_fn(ABSIX), []() -> byte {return 8;}}},
-		{0x22, {"JSL", bind_fn(JSL), bind_fn(ABSL_JML_JSL), []() -> byte {return 8;}}},
-		// lda
-		{0xA9, {"LDA", bind_fn(LDA), bind_fn(IMM_M), [=]() -> byte {return 2 + MZERO;}}},
-		{0xAD, {"LDA", bind_fn(LDA), bind_fn(ABS), [=]() -> byte {return 4 + MZERO;}}},
-		{0xAF, {"LDA", bind_fn(LDA), bind_fn(ABSL), [=]() -> byte {return 5 + MZERO;}}},
-		{0xA5, {"LDA", bind_fn(LDA), bind_fn(DP), [=]() -> byte {return 3 + MZERO + DLNONZERO;}}},
-		{0xB2, {"LDA", bind_fn(LDA), bind_fn(DPI), [=]() -> byte {return 5 + MZERO + DLNONZERO;}}},
-		{0xA7, {"LDA", bind_fn(LDA), bind_fn(DPIL), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0xBD, {"LDA", bind_fn(LDA), bind_fn(ABSX), [=]() -> byte {return 4 + MZERO + iBoundary;}}},
-		{0xBF, {"LDA", bind_fn(LDA), bind_fn(ABSLX), [=]() -> byte {return 5 + MZERO;}}},
-		{0xB9, {"LDA", bind_fn(LDA), bind_fn(ABSY), [=]() -> byte {return 4 + MZERO + iBoundary;}}},
-		{0xB5, {"LDA", bind_fn(LDA), bind_fn(DPX), [=]() -> byte {return 4 + MZERO + DLNONZERO;}}},
-		{0xA1, {"LDA", bind_fn(LDA), bind_fn(DPIX), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0xB1, {"LDA", bind_fn(LDA), bind_fn(DPINY), [=]() -> byte {return 5 + MZERO + DLNONZERO + iBoundary;}}},
-		{0xB7, {"LDA", bind_fn(LDA), bind_fn(DPILNY), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0xA3, {"LDA", bind_fn(LDA), bind_fn(SR), [=]() -> byte {return 4 + MZERO;}}},
-		{0xB3, {"LDA", bind_fn(LDA), bind_fn(SRIY), [=]() -> byte {return 7 + MZERO;}}},
-		// ldx
-		{0xA2, {"LDX", bind_fn(LDX), bind_fn(IMM_X), [=]() -> byte {return 2 + XZERO;}}},
-		{0xAE, {"LDX", bind_fn(LDX), bind_fn(ABS), [=]() -> byte {return 4 + XZERO;}}},
-		{0xA6, {"LDX", bind_fn(LDX), bind_fn(DP), [=]() -> byte {return 3 + XZERO + DLNONZERO;}}},
-		{0xBE, {"LDX", bind_fn(LDX), bind_fn(ABSY), [=]() -> byte {return 4 + XZERO + iBoundary;}}},
-		{0xB6, {"LDX", bind_fn(LDX), bind_fn(DPY), [=]() -> byte {return 4 + XZERO + DLNONZERO;}}},
-		// ldy
-		{0xA0, {"LDY", bind_fn(LDY), bind_fn(IMM_X), [=]() -> byte {return 2 + XZERO;}}},
-		{0xAC, {"LDY", bind_fn(LDY), bind_fn(ABS), [=]() -> byte {return 4 + XZERO;}}},
-		{0xA4, {"LDY", bind_fn(LDY), bind_fn(DP), [=]() -> byte {return 3 + XZERO + DLNONZERO;}}},
-		{0xBC, {"LDY", bind_fn(LDY), bind_fn(ABSX), [=]() -> byte {return 4 + XZERO + DLNONZERO;}}},
-		{0xB4, {"LDY", bind_fn(LDY), bind_fn(DPX), [=]() -> byte {return 4 + XZERO + DLNONZERO;}}},
-		// mvn, mvp
-		{0x54, {"MVN", bind_fn(MVN), bind_fn(IMM16), []() -> byte {return 7;}}},
-		{0x44, {"MVP", bind_fn(MVP), bind_fn(IMM16), []() -> byte {return 7;}}},
-		// nop
-		{0xEA, {"NOP", bind_fn(NOP), bind_fn(IMP), []() -> byte {return 2;}}},
-		// ora
-		{0x09, {"ORA", bind_fn(ORA), bind_fn(IMM_M), [=]() -> byte {return 2 + MZERO;}}},
-		{0x0D, {"ORA", bind_fn(ORA), bind_fn(ABS), [=]() -> byte {return 4 + MZERO;}}},
-		{0x0F, {"ORA", bind_fn(ORA), bind_fn(ABSL), [=]() -> byte {return 5 + MZERO;}}},
-		{0x05, {"ORA", bind_fn(ORA), bind_fn(DP), [=]() -> byte {return 3 + MZERO + DLNONZERO;}}},
-		{0x12, {"ORA", bind_fn(ORA), bind_fn(DPI), [=]() -> byte {return 5 + MZERO + DLNONZERO;}}},
-		{0x07, {"ORA", bind_fn(ORA), bind_fn(DPIL), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x1D, {"ORA", bind_fn(ORA), bind_fn(ABSX), [=]() -> byte {return 4 + MZERO + iBoundary;}}},
-		{0x1F, {"ORA", bind_fn(ORA), bind_fn(ABSLX), [=]() -> byte {return 5 + MZERO;}}},
-		{0x19, {"ORA", bind_fn(ORA), bind_fn(ABSY), [=]() -> byte {return 4 + MZERO + iBoundary;}}},
-		{0x15, {"ORA", bind_fn(ORA), bind_fn(DPX), [=]() -> byte {return 4 + MZERO + DLNONZERO;}}},
-		{0x01, {"ORA", bind_fn(ORA), bind_fn(DPIX), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x11, {"ORA", bind_fn(ORA), bind_fn(DPINY), [=]() -> byte {return 5 + MZERO + DLNONZERO + iBoundary;}}},
-		{0x17, {"ORA", bind_fn(ORA), bind_fn(DPILNY), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x03, {"ORA", bind_fn(ORA), bind_fn(SR), [=]() -> byte {return 4 + MZERO;}}},
-		{0x13, {"ORA", bind_fn(ORA), bind_fn(SRIY), [=]() -> byte {return 7 + MZERO;}}},
-		// pea, pei, per
-		{0xF4, {"PEA", bind_fn(PEA), bind_fn(IMM16), []() -> byte {return 5;}}},
-		{0xD4, {"PEI", bind_fn(PEI), bind_fn(DP16), [=]() -> byte {return 6 + DLNONZERO;}}},
-		{0x62, {"PER", bind_fn(PER), bind_fn(IMM16), []() -> byte {return 6;}}},
-		// push to stack
-		{0x48, {"PHA", bind_fn(PHA), bind_fn(IMP), [=]() -> byte {return 3 + MZERO;}}},
-		{0x8B, {"PHB", bind_fn(PHB), bind_fn(IMP), []() -> byte {return 3;}}},
-		{0x0B, {"PHD", bind_fn(PHD), bind_fn(IMP), []() -> byte {return 4;}}},
-		{0x4B, {"PHK", bind_fn(PHK), bind_fn(IMP), []() -> byte {return 3;}}},
-		{0x08, {"PHP", bind_fn(PHP), bind_fn(IMP), []() -> byte {return 3;}}},
-		{0xDA, {"PHX", bind_fn(PHX), bind_fn(IMP), [=]() -> byte {return 3 + XZERO;}}},
-		{0x5A, {"PHY", bind_fn(PHY), bind_fn(IMP), [=]() -> byte {return 3 + XZERO;}}},
-		// pull from stack
-		{0x68, {"PLA", bind_fn(PLA), bind_fn(IMP), [=]() -> byte {return 4 + MZERO;}}},
-		{0xAB, {"PLB", bind_fn(PLB), bind_fn(IMP), []() -> byte {return 4;}}},
-		{0x2B, {"PLD", bind_fn(PLD), bind_fn(IMP), []() -> byte {return 5;}}},
-		{0x28, {"PLP", bind_fn(PLP), bind_fn(IMP), []() -> byte {return 4;}}},
-		{0xFA, {"PLX", bind_fn(PLX), bind_fn(IMP), [=]() -> byte {return 4 + XZERO;}}},
-		{0x7A, {"PLY", bind_fn(PLY), bind_fn(IMP), [=]() -> byte {return 4 + XZERO;}}},
-		// rep
-		{0xC2, {"REP", bind_fn(REP), bind_fn(IMM8), []() -> byte {return 3;}}},
-		// rol
-		{0x2A, {"ROL", bind_fn(ROLA), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x2E, {"ROL", bind_fn(ROL), bind_fn(ABS), [=]() -> byte {return 6 + MZERO;}}},
-		{0x26, {"ROL", bind_fn(ROL), bind_fn(DP), [=]() -> byte {return 5 + MZERO + DLNONZERO;}}},
-		{0x3E, {"ROL", bind_fn(ROL), bind_fn(ABSX), [=]() -> byte {return 7 + MZERO;}}},
-		{0x36, {"ROL", bind_fn(ROL), bind_fn(DPX), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		// ror
-		{0x6A, {"ROR", bind_fn(RORA), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x6E, {"ROR", bind_fn(ROR), bind_fn(ABS), [=]() -> byte {return 6 + MZERO;}}},
-		{0x66, {"ROR", bind_fn(ROR), bind_fn(DP), [=]() -> byte {return 5 + MZERO + DLNONZERO;}}},
-		{0x7E, {"ROR", bind_fn(ROR), bind_fn(ABSX), [=]() -> byte {return 7 + MZERO;}}},
-		{0x76, {"ROR", bind_fn(ROR), bind_fn(DPX), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		// rti, rts, rtl
-		{0x40, {"RTI", bind_fn(RTI), bind_fn(IMP), [=]() -> byte {return 6 + EZERO;}}},
-		{0x60, {"RTS", bind_fn(RTS), bind_fn(IMP), []() -> byte {return 6;}}},
-		{0x6B, {"RTL", bind_fn(RTL), bind_fn(IMP), []() -> byte {return 6;}}},
-		// sbc
-		{0xE9, {"SBC", bind_fn(SBC), bind_fn(IMM_M), [=]() -> byte {return 2 + MZERO;}}},
-		{0xED, {"SBC", bind_fn(SBC), bind_fn(ABS), [=]() -> byte {return 2 + MZERO;}}},
-		{0xEF, {"SBC", bind_fn(SBC), bind_fn(ABSL), [=]() -> byte {return 2 + MZERO;}}},
-		{0xE5, {"SBC", bind_fn(SBC), bind_fn(DP), [=]() -> byte {return 2 + MZERO;}}},
-		{0xF2, {"SBC", bind_fn(SBC), bind_fn(DPI), [=]() -> byte {return 2 + MZERO;}}},
-		{0xE7, {"SBC", bind_fn(SBC), bind_fn(DPIL), [=]() -> byte {return 2 + MZERO;}}},
-		{0xFD, {"SBC", bind_fn(SBC), bind_fn(ABSX), [=]() -> byte {return 2 + MZERO;}}},
-		{0xFF, {"SBC", bind_fn(SBC), bind_fn(ABSLX), [=]() -> byte {return 2 + MZERO;}}},
-		{0xF9, {"SBC", bind_fn(SBC), bind_fn(ABSY), [=]() -> byte {return 2 + MZERO;}}},
-		{0xF5, {"SBC", bind_fn(SBC), bind_fn(DPX), [=]() -> byte {return 2 + MZERO;}}},
-		{0xE1, {"SBC", bind_fn(SBC), bind_fn(DPIX), [=]() -> byte {return 2 + MZERO;}}},
-		{0xF1, {"SBC", bind_fn(SBC), bind_fn(DPINY), [=]() -> byte {return 2 + MZERO;}}},
-		{0xF7, {"SBC", bind_fn(SBC), bind_fn(DPILNY), [=]() -> byte {return 2 + MZERO;}}},
-		{0xE3, {"SBC", bind_fn(SBC), bind_fn(SR), [=]() -> byte {return 2 + MZERO;}}},
-		{0xF3, {"SBC", bind_fn(SBC), bind_fn(SRIY), [=]() -> byte {return 2 + MZERO;}}},
-		// sec, sed, sei
-		{0x38, {"SEC", bind_fn(SEC), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x78, {"SEI", bind_fn(SEI), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0xF8, {"SED", bind_fn(SED), bind_fn(IMP), []() -> byte {return 2;}}},
-		// sep
-		{0xE2, {"SEP", bind_fn(SEP), bind_fn(IMM8), []() -> byte {return 3;}}},
-		// sta
-		{0x8D, {"STA", bind_fn(STA), bind_fn(ABS), [=]() -> byte {return 4 + MZERO;}}},
-		{0x8F, {"STA", bind_fn(STA), bind_fn(ABSL), [=]() -> byte {return 5 + MZERO;}}},
-		{0x85, {"STA", bind_fn(STA), bind_fn(DP), [=]() -> byte {return 3 + MZERO + DLNONZERO;}}},
-		{0x92, {"STA", bind_fn(STA), bind_fn(DPI), [=]() -> byte {return 5 + MZERO + DLNONZERO;}}},
-		{0x87, {"STA", bind_fn(STA), bind_fn(DPIL), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x9D, {"STA", bind_fn(STA), bind_fn(ABSX), [=]() -> byte {return 5 + MZERO;}}},
-		{0x9F, {"STA", bind_fn(STA), bind_fn(ABSLX), [=]() -> byte {return 5 + MZERO;}}},
-		{0x99, {"STA", bind_fn(STA), bind_fn(ABSY), [=]() -> byte {return 5 + MZERO;}}},
-		{0x95, {"STA", bind_fn(STA), bind_fn(DPX), [=]() -> byte {return 4 + MZERO + DLNONZERO;}}},
-		{0x81, {"STA", bind_fn(STA), bind_fn(DPIX), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x91, {"STA", bind_fn(STA), bind_fn(DPINY), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x97, {"STA", bind_fn(STA), bind_fn(DPILNY), [=]() -> byte {return 6 + MZERO + DLNONZERO;}}},
-		{0x83, {"STA", bind_fn(STA), bind_fn(SR), [=]() -> byte {return 4 + MZERO;}}},
-		{0x93, {"STA", bind_fn(STA), bind_fn(SRIY), [=]() -> byte {return 7 + MZERO;}}},
-		// stx
-		{0x8E, {"STX", bind_fn(STX), bind_fn(ABS), [=]() -> byte {return 4 + MZERO;}}},
-		{0x86, {"STX", bind_fn(STX), bind_fn(DP), [=]() -> byte {return 3 + MZERO + DLNONZERO;}}},
-		{0x96, {"STX", bind_fn(STX), bind_fn(DPY), [=]() -> byte {return 4 + MZERO + DLNONZERO;}}},
-		// sty
-		{0x8C, {"STY", bind_fn(STY), bind_fn(ABS), [=]() -> byte {return 4 + MZERO;}}},
-		{0x84, {"STY", bind_fn(STY), bind_fn(DP), [=]() -> byte {return 3 + MZERO + DLNONZERO;}}},
-		{0x94, {"STY", bind_fn(STY), bind_fn(DPX), [=]() -> byte {return 4 + MZERO + DLNONZERO;}}},
-		// stz
-		{0x9C, {"STZ", bind_fn(STZ), bind_fn(ABS), [=]() -> byte {return 4 + MZERO;}}},
-		{0x64, {"STZ", bind_fn(STZ), bind_fn(DP), [=]() -> byte {return 3 + MZERO + DLNONZERO;}}},
-		{0x9E, {"STZ", bind_fn(STZ), bind_fn(ABSX), [=]() -> byte {return 5 + MZERO;}}},
-		{0x74, {"STZ", bind_fn(STZ), bind_fn(DPX), [=]() -> byte {return 4 + MZERO + DLNONZERO;}}},
-		// transfer registers
-		{0xAA, {"TAX", bind_fn(TAX), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0xA8, {"TAY", bind_fn(TAY), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x5B, {"TCD", bind_fn(TCD), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x1B, {"TCS", bind_fn(TCS), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x7B, {"TDC", bind_fn(TDC), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x3B, {"TSC", bind_fn(TSC), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0xBA, {"TSX", bind_fn(TSX), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x8A, {"TXA", bind_fn(TXA), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x9A, {"TXS", bind_fn(TXS), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x9B, {"TXY", bind_fn(TXY), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0x98, {"TYA", bind_fn(TYA), bind_fn(IMP), []() -> byte {return 2;}}},
-		{0xBB, {"TYX", bind_fn(TYX), bind_fn(IMP), []() -> byte {return 2;}}},
-		// trb, tsb
-		{0x1C, {"TRB", bind_fn(TRB), bind_fn(ABS), [=]() -> byte {return 6 + (2 * MZERO);}}},
-		{0x14, {"TRB", bind_fn(TRB), bind_fn(DP), [=]() -> byte {return 5 + (2 * MZERO) + DLNONZERO;}}},
-		{0x0C, {"TSB", bind_fn(TSB), bind_fn(ABS), [=]() -> byte {return 6 + (2 * MZERO);}}},
-		{0x04, {"TSB", bind_fn(TSB), bind_fn(DP), [=]() -> byte {return 5 + (2 * MZERO) + DLNONZERO;}}},
-		// xba, xce
-		{0xEB, {"XBA", bind_fn(XBA), bind_fn(IMP), []() -> byte {return 3;}}},
-		{0xFB, {"XCE", bind_fn(XCE), bind_fn(IMP), []() -> byte {return 2;}}}
+
+	uint32_t cycleCount(const instruction& inst);
+
+	// an instruction with its operand already fetched
+	typedef struct {
+		const instruction* inst;
+		threebyte operand;
+		twobyte pc;
+		twobyte next;
+		byte opcode;
+	} decoded_op;
+
+	// straight-line code from one K:PC at one register width, up to and
+	// including the first instruction that ends a block. blocks never reach
+	// into the next page, so a write only has to drop the page it hit
+	// compiled code returns how many of the block's instructions it ran
+	typedef uint32_t (*native_code)(SNES_CPU* cpu);
+
+	struct code_block {
+		std::vector<decoded_op> code;
+		// runs so far, the block is compiled when this reaches JIT_THRESHOLD
+		uint32_t hits = 0;
+		// the block (or the start of it) as x86-64, built for one value of
+		// DLNONZERO and taking at most native_cycles
+		native_code native = nullptr;
+		byte native_dl = 0;
+		uint32_t native_cycles = 0;
+		// read only, ending in a branch or jump that may go back to the start
+		bool idle = false;
+		// while profiling, the passes that ended after each instruction and
+		// the cycles past its base cost each instruction took in them. the
+		// native code's passes are kept apart with the cycles they took, the
+		// extras they can take are the D cycle native_dl and a taken branch
+		// at the end, which are worked out when they are counted
+		std::vector<uint64_t> exits;
+		std::vector<uint64_t> extras;
+		std::vector<uint64_t> native_exits;
+		uint64_t native_profile_cycles = 0;
 	};
+	typedef std::unordered_map<uint32_t, code_block> code_page;
+
+	decoded_op decode(twobyte& pc);
+	// k is the bank the op was fetched from, K may change as it runs
+	uint32_t execute(const decoded_op& op, byte k);
+	code_block* findBlock();
+	void runBlock(uint64_t target);
+	// where the current runUntil() stops, so block moves stop there too
+	uint64_t run_target = 0;
+	// runs block's native code if it has some, compiling it once it is hot.
+	// false leaves the block to the interpreter
+	bool runNative(code_block& block, uint64_t target);
+
+	// a pass over block, entered at addr, that ran its first executed
+	// instructions in cycles
+	void profilePass(code_block& block, threebyte addr, size_t executed, uint64_t cycles);
+	// the same for a pass of block's native code
+	void profileNative(code_block& block, threebyte addr, size_t executed, uint64_t cycles);
+	void profileAlloc(code_block& block);
+	// the cycles past its base cost each instruction of the last pass took,
+	// for the idle passes skipped after it
+	std::vector<uint32_t> pass_extras;
+	// turns the passes block counted into opcode counts for the profiler
+	void profileCounts(code_block& block);
+	void profileRetired();
+
+	bool block_cache = true;
+	// blocks by page of the address space, keyed by K:PC and width
+	std::vector<code_page> code_pages;
+	// dropped pages, kept until the block that may be running from them ends
+	std::vector<code_page> retired_code;
+	uint64_t code_invalidations = 0;
+	// index of the current dispatch table, part of the block key
+	byte widths = 3;
+
+	SNES_JIT* jit = nullptr;
+
+	bool idle_skip = true;
+	uint64_t skipped_cycles = 0;
+	// the last pass over an idle loop changed nothing, anything else running
+	// clears it
+	bool idle_spin = false;
+	// after a pass over an idle block that started at time start with the
+	// registers before, when the memory had taken slow_reads slow path reads
+	void skipIdle(code_block& block, const SNES_CPU_REGISTERS& before, uint64_t start, uint64_t slow_reads);
+	uint64_t instructions = 0;
+
+	// the current instruction's operand bytes
+	threebyte operand = 0;
+
+	// MVN/MVP move a chunk that stays inside one page on both sides, and
+	// move PC back to run again until C runs out, so interrupts and the
+	// other chips get their turn between chunks like between instructions
+	void moveBlock(int step);
+	twobyte moved = 0;
+
+	// halts the cpu on opcodes missing from the table
+	void ILL();
+	bool halted = false;
+
+	// pushes K (in native mode), PC and the status and jumps to vector
+	void interrupt(twobyte vector);
+	bool nmi_pending = false;
+	bool irq_line = false;
+	// WAI until an interrupt, STP until reset
+	bool waiting = false;
+	bool stopped = false;
+
+	// flat dispatch tables indexed by opcode, one per m/x combination
+	// (emulation mode uses the 8-bit/8-bit table). ops points at the one
+	// matching the current flags and is only swapped by updateRegisterWidths().
+	// mnemonics are kept separately since only tracing needs them
+	static const std::array<instruction, 256> opTables[4];
+	static const char* const opNames[256];
+	template<bool M8, bool X8> static std::array<instruction, 256> buildOps();
+	template<bool M8, bool X8> static byte operandLength(handler mode);
+	static bool isBlockEnd(handler op);
+	template<bool M8, bool X8> static bool isReadOnly(handler op);
+
+	const instruction* ops = opTables[3].data();
 };
 
 #endif
\ No newline at end of file
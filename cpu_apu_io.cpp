@@ -1,17 +1,102 @@
 #include "cpu_apu_io.hpp"
+#include "state.hpp"
+
+#include <thread>
+
+void CPU_APU_IO::connect(SNES_SCHEDULER* scheduler, SNES_CLOCKED* cpu, SNES_CLOCKED* apu) {
+    this->scheduler = scheduler;
+    this->cpu = cpu;
+    this->apu = apu;
+}
 
 void CPU_APU_IO::writeAPU(size_t port, byte data) {
-    ports[port][0] = data;
+    TRACE(tracer, TRACE_APU, TRACE_INFO, TRACE_EV_PORT_WRITE, 1, port, data);
+    // caught up on the cpu's thread, the apu is always behind the cpu
+    if(!scheduler || !scheduler->isThreaded()) {
+        cpu_view[port] = data;
+        return;
+    }
+
+    // the cpu drains after every batch, and the sync interval and window limits
+    // keep the apu from writing anywhere near a full queue in between
+    while(!to_cpu.push({apu->time, (byte)port, data}))
+        std::this_thread::yield();
 }
 
 byte CPU_APU_IO::readAPU(size_t port) {
-    return ports[port][1];
+    updateAPU();
+    TRACE(tracer, TRACE_APU, TRACE_VERBOSE, TRACE_EV_PORT_READ, 1, port, apu_view[port]);
+    return apu_view[port];
+}
+
+void CPU_APU_IO::clearAPU(size_t port) {
+    updateAPU();
+    apu_view[port] = 0;
 }
 
 void CPU_APU_IO::writeCPU(size_t port, byte data) {
-    ports[port][1] = data;
+    TRACE(tracer, TRACE_APU, TRACE_INFO, TRACE_EV_PORT_WRITE, 0, port, data);
+    if(!scheduler) {
+        apu_view[port] = data;
+        return;
+    }
+
+    while(!to_apu.push({cpu->time, (byte)port, data})) {
+        // let the apu catch up and drain
+        scheduler->sync();
+    }
 }
 
 byte CPU_APU_IO::readCPU(size_t port) {
-    return ports[port][0];
-}
\ No newline at end of file
+    if(scheduler) scheduler->sync();
+    updateCPU();
+    TRACE(tracer, TRACE_APU, TRACE_VERBOSE, TRACE_EV_PORT_READ, 0, port, cpu_view[port]);
+    return cpu_view[port];
+}
+
+void CPU_APU_IO::updateAPU() {
+    if(!scheduler) return;
+    while(const PORT_QUEUE::entry* e = to_apu.peek(apu->time)) {
+        apu_view[e->port] = e->data;
+        to_apu.pop();
+    }
+}
+
+void CPU_APU_IO::updateCPU() {
+    if(!scheduler) return;
+    while(const PORT_QUEUE::entry* e = to_cpu.peek(cpu->time)) {
+        cpu_view[e->port] = e->data;
+        to_cpu.pop();
+    }
+}
+
+void PORT_QUEUE::serialize(SNES_STATE& state) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    uint32_t count = head.load(std::memory_order_relaxed) - t;
+    state.value(count);
+    if(count > CAPACITY) {
+        state.fail();
+        return;
+    }
+
+    if(state.loading()) t = 0;
+    for(size_t i = t; i < t + count; i++) {
+        entry& e = ring[i % CAPACITY];
+        state.value(e.time);
+        state.value(e.port);
+        state.value(e.data);
+    }
+    if(state.loading()) {
+        tail.store(0, std::memory_order_relaxed);
+        head.store(count, std::memory_order_release);
+    }
+}
+
+void CPU_APU_IO::serialize(SNES_STATE& state) {
+    if(!state.begin(STATE_TAG('P', 'O', 'R', 'T'), 1)) return;
+    state.value(cpu_view);
+    state.value(apu_view);
+    to_apu.serialize(state);
+    to_cpu.serialize(state);
+    state.end();
+}
@@ -2,21 +2,93 @@
 #define _CPU_APU_IO_H
 
 #include "common.h"
+#include "scheduler.hpp"
+#include "trace.hpp"
+
+#include <atomic>
 #include <iostream>
 
+class SNES_STATE;
+
+// single-producer/single-consumer queue of timestamped port writes
+class PORT_QUEUE {
+public:
+    struct entry {
+        uint64_t time;
+        byte port;
+        byte data;
+    };
+
+    bool push(const entry& e);
+    // front entry, if there is one written before time
+    const entry* peek(uint64_t time);
+    void pop() {tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);};
+
+    // pending entries, with both sides stopped
+    void serialize(SNES_STATE& state);
+private:
+    static const size_t CAPACITY = 1024;
+
+    entry ring[CAPACITY];
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+// the four ports between the 65816 and the spc700. every write is stamped
+// with the writer's master clock time and a side only sees writes made
+// before its own current time, so reads give the same answer whether the
+// apu runs behind on its own thread or is caught up on the cpu's
 class CPU_APU_IO {
 public:
+    // apu side, called from the apu's thread when it has one
     void writeAPU(size_t port, byte data);
     byte readAPU(size_t port);
+    // the spc700 can zero the ports it reads through CONTROL
+    void clearAPU(size_t port);
 
+    // cpu side
     void writeCPU(size_t port, byte data);
     byte readCPU(size_t port);
 
+    // apply the other side's writes made before the side's current time
+    void updateAPU();
+    void updateCPU();
+
+    // without a scheduler writes are visible immediately
+    void connect(SNES_SCHEDULER* scheduler, SNES_CLOCKED* cpu, SNES_CLOCKED* apu);
+
+    void serialize(SNES_STATE& state);
+
+    // port writes are traced under TRACE_APU at TRACE_INFO and reads at
+    // TRACE_VERBOSE when set. both sides record into it, so it takes an apu
+    // caught up on the cpu's thread
+    SNES_TRACER* tracer = nullptr;
 private:
-    // in the following ports,
-    // byte 0 is APU -> CPU (APU writes, CPU reads)
-    // byte 1 is CPU -> APU (CPU writes, APU reads)
-    byte ports[4][2];
+    SNES_SCHEDULER* scheduler = nullptr;
+    SNES_CLOCKED* cpu = nullptr;
+    SNES_CLOCKED* apu = nullptr;
+
+    PORT_QUEUE to_apu;
+    PORT_QUEUE to_cpu;
+
+    // port values as currently seen by each side
+    byte cpu_view[4] = {};
+    byte apu_view[4] = {};
 };
 
-#endif // _CPU_APU_IO_H
\ No newline at end of file
+inline bool PORT_QUEUE::push(const entry& e) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if(h - tail.load(std::memory_order_acquire) == CAPACITY) return false;
+    ring[h % CAPACITY] = e;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+inline const PORT_QUEUE::entry* PORT_QUEUE::peek(uint64_t time) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(t == head.load(std::memory_order_acquire)) return nullptr;
+    const entry* e = &ring[t % CAPACITY];
+    return e->time < time ? e : nullptr;
+}
+
+#endif // _CPU_APU_IO_H
@@ -0,0 +1,219 @@
+#include "common.h"
+
+#include "dma.hpp"
+#include "ram.hpp"
+#include "cpu.hpp"
+#include "state.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// B bus register for each byte of a unit, by transfer mode
+static const byte dma_offsets[8][4] = {
+	{0, 0, 0, 0}, {0, 1, 0, 1}, {0, 0, 0, 0}, {0, 0, 1, 1},
+	{0, 1, 2, 3}, {0, 1, 0, 1}, {0, 0, 0, 0}, {0, 0, 1, 1}
+};
+// bytes hdma moves per line, by transfer mode
+static const byte hdma_lengths[8] = {1, 2, 2, 4, 4, 4, 2, 4};
+
+void SNES_DMA::reset() {
+	hdma_running = 0;
+	hdma_transfer = 0;
+}
+
+byte* SNES_DMA::channel(int c) {
+	return mem->io.data() + 0x2300 + (c << 4);
+}
+
+void SNES_DMA::steal(uint64_t cycles) {
+	if(mem->cpu) mem->cpu->time += cycles;
+}
+
+uint64_t SNES_DMA::transfer(byte mask) {
+	if(!mask) return 0;
+
+	uint64_t cycles = DMA_CYCLES_STARTUP;
+	for(int c = 0; c < DMA_CHANNELS; c++) {
+		if(mask & (1 << c))
+			cycles += transferChannel(c);
+	}
+	steal(cycles);
+	return cycles;
+}
+
+uint64_t SNES_DMA::transferChannel(int c) {
+	byte* r = channel(c);
+	byte dmap = r[0];
+	byte bbad = r[1];
+	twobyte addr = r[2] | (r[3] << 8);
+	byte bank = r[4];
+	size_t size = r[5] | (r[6] << 8);
+	if(!size) size = 0x10000;
+
+	bool to_b = !(dmap & 0x80);
+	bool fixed = dmap & 0x08;
+	bool down = !fixed && (dmap & 0x10);
+	size_t done = 0;
+	if(fast_paths && to_b && !down) {
+		// a page at a time from the page table, until a page without one.
+		// a fixed source is the same byte over and over
+		byte fill[MEM_PAGE_SIZE];
+		while(done < size) {
+			const byte* page = mem->getReadPages()[((bank << 16) | addr) >> MEM_PAGE_BITS];
+			if(!page) break;
+			const byte* data = page + (addr & MEM_PAGE_MASK);
+			size_t chunk;
+			if(fixed) {
+				chunk = std::min(size - done, (size_t)MEM_PAGE_SIZE);
+				memset(fill, *data, chunk);
+				data = fill;
+			} else {
+				chunk = std::min(size - done, (size_t)(MEM_PAGE_SIZE - (addr & MEM_PAGE_MASK)));
+				addr += chunk;
+			}
+			writeBlock(data, chunk, bbad, dmap & 7, done);
+			done += chunk;
+		}
+		block_bytes += done;
+	}
+
+	// the rest a byte at a time
+	const byte* offsets = dma_offsets[dmap & 7];
+	int step = fixed ? 0 : (down ? -1 : 1);
+	for(size_t i = done; i < size; i++) {
+		byte reg = bbad + offsets[i & 3];
+		if(to_b) mem->writeB(reg, mem->read8(bank, addr));
+		else mem->write8(bank, addr, mem->readB(reg));
+		addr += step;
+	}
+	bytes += size;
+
+	// the registers are left as the transfer ends
+	r[2] = addr;
+	r[3] = addr >> 8;
+	r[5] = 0;
+	r[6] = 0;
+	return DMA_CYCLES_PER_CHANNEL + size * DMA_CYCLES_PER_BYTE;
+}
+
+void SNES_DMA::writeBlock(const byte* data, size_t n, byte bbad, byte mode, size_t i) {
+	// words to $2118/$2119, starting with a low byte
+	if(bbad == 0x18 && (mode == 1 || mode == 5) && mem->ppu) {
+		if(i & 1) {
+			mem->writeB(0x19, *data++);
+			n--;
+		}
+		mem->ppu->writeVRAMBlock(data, n);
+		return;
+	}
+	// everything to the WRAM port
+	if(bbad == 0x80 && (mode == 0 || mode == 2 || mode == 6)) {
+		mem->writeWRAMBlock(data, n);
+		return;
+	}
+
+	const byte* offsets = dma_offsets[mode];
+	for(size_t j = 0; j < n; j++)
+		mem->writeB(bbad + offsets[(i + j) & 3], data[j]);
+}
+
+//
+// hdma
+//
+
+bool SNES_DMA::hdmaWritesMemory() {
+	byte enabled = mem->io[0x220C];
+	for(int c = 0; c < DMA_CHANNELS; c++) {
+		if(!(enabled & (1 << c))) continue;
+		byte* r = channel(c);
+		byte mode = r[0] & 0x07;
+		if(r[0] & 0x80) return true;
+		for(int i = 0; i < hdma_lengths[mode]; i++)
+			if((byte)(r[1] + dma_offsets[mode][i]) == 0x80) return true;
+	}
+	return false;
+}
+
+void SNES_DMA::frameStart() {
+	hdma_running = 0;
+	hdma_transfer = 0;
+	byte enabled = mem->io[0x220C];
+	if(!enabled) return;
+
+	uint64_t cycles = HDMA_CYCLES_PER_LINE;
+	for(int c = 0; c < DMA_CHANNELS; c++) {
+		if(!(enabled & (1 << c))) continue;
+		// the table starts over from A1T
+		byte* r = channel(c);
+		r[8] = r[2];
+		r[9] = r[3];
+		hdma_running |= 1 << c;
+		cycles += DMA_CYCLES_PER_CHANNEL + hdmaLoad(c);
+	}
+	steal(cycles);
+}
+
+uint64_t SNES_DMA::hdmaLoad(int c) {
+	byte* r = channel(c);
+	twobyte table = r[8] | (r[9] << 8);
+	uint64_t cycles = DMA_CYCLES_PER_BYTE;
+
+	r[0xA] = mem->read8(r[4], table++);
+	if(r[0] & 0x40) {
+		r[5] = mem->read8(r[4], table++);
+		r[6] = mem->read8(r[4], table++);
+		cycles += 2 * DMA_CYCLES_PER_BYTE;
+	}
+	r[8] = table;
+	r[9] = table >> 8;
+
+	// a line count of 0 ends the table
+	if(!r[0xA]) hdma_running &= ~(1 << c);
+	hdma_transfer |= 1 << c;
+	return cycles;
+}
+
+void SNES_DMA::hblank() {
+	byte active = hdma_running & mem->io[0x220C];
+	if(!active) return;
+
+	uint64_t cycles = HDMA_CYCLES_PER_LINE;
+	for(int c = 0; c < DMA_CHANNELS; c++) {
+		byte bit = 1 << c;
+		if(!(active & bit)) continue;
+		byte* r = channel(c);
+		cycles += DMA_CYCLES_PER_CHANNEL;
+
+		if(hdma_transfer & bit) {
+			byte mode = r[0] & 7;
+			bool indirect = r[0] & 0x40;
+			// indirect tables point at the data, in the bank from $43c7
+			byte* pointer = indirect ? r + 5 : r + 8;
+			byte bank = indirect ? r[7] : r[4];
+			twobyte addr = pointer[0] | (pointer[1] << 8);
+			for(int i = 0; i < hdma_lengths[mode]; i++, addr++) {
+				byte reg = r[1] + dma_offsets[mode][i];
+				if(r[0] & 0x80) mem->write8(bank, addr, mem->readB(reg));
+				else mem->writeB(reg, mem->read8(bank, addr));
+			}
+			pointer[0] = addr;
+			pointer[1] = addr >> 8;
+			cycles += hdma_lengths[mode] * DMA_CYCLES_PER_BYTE;
+			bytes += hdma_lengths[mode];
+		}
+
+		// bit 7 of the line count repeats the transfer on every line
+		r[0xA]--;
+		if(r[0xA] & 0x80) hdma_transfer |= bit;
+		else hdma_transfer &= ~bit;
+		if(!(r[0xA] & 0x7F)) cycles += hdmaLoad(c);
+	}
+	steal(cycles);
+}
+
+void SNES_DMA::serialize(SNES_STATE& state) {
+	if(!state.begin(STATE_TAG('D', 'M', 'A', ' '), 1)) return;
+	state.value(hdma_running);
+	state.value(hdma_transfer);
+	state.end();
+}
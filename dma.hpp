@@ -0,0 +1,79 @@
+#ifndef _DMA_H
+#define _DMA_H
+
+#include "common.h"
+
+#define DMA_CHANNELS		8
+
+// master cycles taken from the cpu. a transfer costs 8 per byte and per
+// channel, plus the startup; hdma costs its overhead on every line it runs
+#define DMA_CYCLES_PER_BYTE			8
+#define DMA_CYCLES_PER_CHANNEL		8
+#define DMA_CYCLES_STARTUP			16
+#define HDMA_CYCLES_PER_LINE		18
+
+class SNES_MEMORY;
+class SNES_STATE;
+
+// the eight channels behind $420B (general purpose dma), $420C (hdma) and
+// $4300-$437F. the channel registers live in the memory's I/O area like the
+// other registers, so they are saved and snapshotted with it; the hdma
+// counters are written back to $43x8-$43xA as the hardware does.
+//
+// transfers move bytes between the A bus (the memory map) and the B bus
+// ($21xx). where the source is plain memory read upwards, it is taken a page
+// at a time straight from the page table, and VRAM and WRAM port
+// destinations are written in blocks instead of a register access per byte.
+// both ways give the same results
+class SNES_DMA {
+public:
+	SNES_DMA(SNES_MEMORY* mem) : mem(mem) {};
+
+	void reset();
+
+	// $420B: runs the transfers of the channels in mask in order, with the
+	// cpu stopped, and returns the master cycles that took
+	uint64_t transfer(byte mask);
+
+	// the ppu calls these at the start of each frame, and in the hblank at the
+	// end of each visible line (and the one before the first). the cycles
+	// hdma takes are added to the cpu's time
+	void frameStart();
+	void hblank();
+	// whether hdma can change plain memory this frame: a running channel
+	// that reads the B bus into the A bus, or writes the WRAM port
+	bool hdmaWritesMemory();
+
+	void setFastPaths(bool enabled) {fast_paths = enabled;};
+	bool getFastPaths() {return fast_paths;};
+
+	// bytes moved so far, and how many of them went through a block copy
+	uint64_t getBytes() {return bytes;};
+	uint64_t getBlockBytes() {return block_bytes;};
+
+	// the hdma channels still running and the ones transferring this line
+	void serialize(SNES_STATE& state);
+private:
+	SNES_MEMORY* mem;
+	bool fast_paths = true;
+
+	// channel c's registers, $43c0-$43cF
+	byte* channel(int c);
+	uint64_t transferChannel(int c);
+	// n bytes from host memory to the B bus, the ith to the channel's
+	// register for that position of the pattern
+	void writeBlock(const byte* data, size_t n, byte bbad, byte mode, size_t i);
+	void steal(uint64_t cycles);
+
+	// the hdma channels that haven't ended this frame, and the ones that
+	// transfer on the next line
+	byte hdma_running = 0;
+	byte hdma_transfer = 0;
+	// reads the next line count (and indirect address) from a channel's table
+	uint64_t hdmaLoad(int c);
+
+	uint64_t bytes = 0;
+	uint64_t block_bytes = 0;
+};
+
+#endif //_DMA_H
@@ -1,5 +1,681 @@
 #include "dsp.hpp"
+#include "state.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DSP_X86
+#endif
+
+// global registers
+#define R_MVOLL     0x0C
+#define R_MVOLR     0x1C
+#define R_EVOLL     0x2C
+#define R_EVOLR     0x3C
+#define R_KON       0x4C
+#define R_KOFF      0x5C
+#define R_FLG       0x6C
+#define R_ENDX      0x7C
+#define R_EFB       0x0D
+#define R_PMON      0x2D
+#define R_NON       0x3D
+#define R_EON       0x4D
+#define R_DIR       0x5D
+#define R_ESA       0x6D
+#define R_EDL       0x7D
+
+// voice registers, at (voice << 4) | r
+#define V_VOLL      0x00
+#define V_VOLR      0x01
+#define V_PITCHL    0x02
+#define V_PITCHH    0x03
+#define V_SRCN      0x04
+#define V_ADSR1     0x05
+#define V_ADSR2     0x06
+#define V_GAIN      0x07
+#define V_ENVX      0x08
+#define V_OUTX      0x09
+
+// FIR coefficients, at (tap << 4) | R_FIR
+#define R_FIR       0x0F
+
+#define COUNTER_RANGE   (2048 * 5 * 3)
+
+static inline int clamp16(int value) {
+    if(value > 32767) return 32767;
+    if(value < -32768) return -32768;
+    return value;
+}
+
+// envelope and noise rates: how many samples between steps, rate 0 never steps
+static const int counter_rates[32] = {
+    COUNTER_RANGE + 1, 2048, 1536,
+    1280, 1024, 768,
+    640, 512, 384,
+    320, 256, 192,
+    160, 128, 96,
+    80, 64, 48,
+    40, 32, 24,
+    20, 16, 12,
+    10, 8, 6,
+    5, 4, 3,
+    2, 1
+};
+
+static const int counter_offsets[32] = {
+    1, 0, 1040,
+    536, 0, 1040,
+    536, 0, 1040,
+    536, 0, 1040,
+    536, 0, 1040,
+    536, 0, 1040,
+    536, 0, 1040,
+    536, 0, 1040,
+    536, 0, 1040,
+    536, 0, 1040,
+    0, 0
+};
+
+// interpolation kernel. this is the usual generated approximation of the
+// hardware table, normalized so every set of 4 taps sums to 2048
+static std::array<int16_t, 512> buildGauss() {
+    double table[512];
+    for(int i = 0; i < 512; i++) {
+        double k = 0.5 + i;
+        double s = sin(M_PI * k * 1.280 / 1024);
+        double t = (cos(M_PI * k * 2.000 / 1023) - 1) * 0.50;
+        double u = (cos(M_PI * k * 4.000 / 1023) - 1) * 0.08;
+        table[511 - i] = s * (t + u + 1.0) / k;
+    }
+
+    std::array<int16_t, 512> gauss;
+    for(int phase = 0; phase < 128; phase++) {
+        double sum = table[phase] + table[phase + 256] + table[511 - phase] + table[255 - phase];
+        double scale = 2048.0 / sum;
+        gauss[phase] = (int16_t)(table[phase] * scale + 0.5);
+        gauss[phase + 256] = (int16_t)(table[phase + 256] * scale + 0.5);
+        gauss[511 - phase] = (int16_t)(table[511 - phase] * scale + 0.5);
+        gauss[255 - phase] = (int16_t)(table[255 - phase] * scale + 0.5);
+    }
+    return gauss;
+}
+
+static const std::array<int16_t, 512> gauss = buildGauss();
 
 SNES_DSP::SNES_DSP() {
-    
-}
\ No newline at end of file
+    reset();
+
+    if(supported(DSP_AVX2)) path = DSP_AVX2;
+    else if(supported(DSP_SSE2)) path = DSP_SSE2;
+}
+
+void SNES_DSP::reset() {
+    regs.fill(0);
+    // powers on muted, with echo writes off and every voice released
+    regs[R_FLG] = 0xE0;
+
+    memset(voices, 0, sizeof(voices));
+    memset(&lanes, 0, sizeof(lanes));
+    memset(echo_hist, 0, sizeof(echo_hist));
+
+    kon = 0;
+    counter = 0;
+    noise = 0x4000;
+    echo_offset = 0;
+    echo_hist_pos = 0;
+
+    output_buffer.fill(0);
+    output_pos = 0;
+    output_count = 0;
+}
+
+void SNES_DSP::serialize(SNES_STATE& state) {
+    if(!state.begin(STATE_TAG('D', 'S', 'P', ' '), 1)) return;
+    state.value(regs);
+    state.value(voices);
+    state.value(lanes);
+    state.value(kon);
+    state.value(counter);
+    state.value(noise);
+    state.value(echo_offset);
+    state.value(echo_hist);
+    state.value(echo_hist_pos);
+    state.end();
+
+    if(state.loading()) {
+        output_pos = 0;
+        output_count = 0;
+    }
+}
+
+bool SNES_DSP::supported(SNES_DSP_PATH path) {
+    switch(path) {
+        case DSP_SCALAR:
+            return true;
+#ifdef DSP_X86
+        case DSP_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case DSP_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+bool SNES_DSP::setPath(SNES_DSP_PATH path) {
+    if(!supported(path)) return false;
+    this->path = path;
+    return true;
+}
+
+void SNES_DSP::write(byte addr, byte data) {
+    if(addr >= 0x80) return;
+
+    switch(addr) {
+        case R_KON:
+            // picked up on the next sample
+            kon = data;
+            break;
+        case R_ENDX:
+            // any write clears it
+            data = 0;
+            break;
+    }
+    regs[addr] = data;
+}
+
+size_t SNES_DSP::readSamples(int16_t* out, size_t max_frames) {
+    size_t frames = std::min(max_frames, output_count);
+    size_t start = (output_pos + DSP_OUTPUT_FRAMES - output_count) % DSP_OUTPUT_FRAMES;
+
+    for(size_t i = 0; i < frames; i++) {
+        size_t frame = (start + i) % DSP_OUTPUT_FRAMES;
+        out[i * 2] = output_buffer[frame * 2];
+        out[i * 2 + 1] = output_buffer[frame * 2 + 1];
+    }
+    output_count -= frames;
+    return frames;
+}
+
+void SNES_DSP::output(int16_t l, int16_t r) {
+    output_buffer[output_pos * 2] = l;
+    output_buffer[output_pos * 2 + 1] = r;
+    output_pos = (output_pos + 1) % DSP_OUTPUT_FRAMES;
+    if(output_count < DSP_OUTPUT_FRAMES) output_count++;
+}
+
+bool SNES_DSP::readCounter(int rate) {
+    return (counter + counter_offsets[rate]) % counter_rates[rate] == 0;
+}
+
+//
+// sample generation
+//
+
+void SNES_DSP::sample() {
+    if(--counter < 0) counter = COUNTER_RANGE - 1;
+
+    byte flg = regs[R_FLG];
+    if(readCounter(flg & 0x1F)) {
+        int feedback = (noise << 13) ^ (noise << 14);
+        noise = (feedback & 0x4000) ^ (noise >> 1);
+    }
+
+    if(kon) {
+        for(int v = 0; v < DSP_VOICES; v++) {
+            if(kon & (1 << v)) keyOn(v);
+        }
+        kon = 0;
+    }
+
+    byte koff = regs[R_KOFF];
+    byte non = regs[R_NON];
+    byte eon = regs[R_EON];
+
+    // gather the voice loop inputs
+    for(int v = 0; v < DSP_VOICES; v++) {
+        voice& vo = voices[v];
+
+        if((flg & 0x80) || (koff & (1 << v))) {
+            vo.env_mode = ENV_RELEASE;
+            if(flg & 0x80) vo.env = 0;
+        }
+        if(vo.kon_delay == 0) runEnvelope(v);
+
+        int index = vo.interp_pos >> 12;
+        int frac = (vo.interp_pos >> 4) & 0xFF;
+        for(int tap = 0; tap < 4; tap++)
+            lanes.taps[tap][v] = vo.brr[index + tap];
+
+        // oldest sample first
+        lanes.gauss[0][v] = gauss[255 - frac];
+        lanes.gauss[1][v] = gauss[511 - frac];
+        lanes.gauss[2][v] = gauss[256 + frac];
+        lanes.gauss[3][v] = gauss[frac];
+
+        lanes.env[v] = vo.kon_delay ? 0 : vo.env;
+        lanes.vol_l[v] = (signedbyte)reg(v, V_VOLL);
+        lanes.vol_r[v] = (signedbyte)reg(v, V_VOLR);
+        lanes.noise[v] = (non & (1 << v)) ? -1 : 0;
+        lanes.echo[v] = (eon & (1 << v)) ? -1 : 0;
+    }
+    lanes.noise_out = (int16_t)(noise << 1);
+
+    switch(path) {
+        case DSP_AVX2: mixAVX2(lanes); break;
+        case DSP_SSE2: mixSSE2(lanes); break;
+        default: mixScalar(lanes); break;
+    }
+
+    // pitch modulation needs the output of the voice before, so the
+    // counters only move once every output is known
+    byte pmon = regs[R_PMON];
+    for(int v = 0; v < DSP_VOICES; v++) {
+        voice& vo = voices[v];
+        regs[(v << 4) | V_OUTX] = lanes.out[v] >> 8;
+        regs[(v << 4) | V_ENVX] = vo.env >> 4;
+
+        if(vo.kon_delay) {
+            vo.kon_delay--;
+            continue;
+        }
+
+        int step = ((reg(v, V_PITCHH) << 8) | reg(v, V_PITCHL)) & 0x3FFF;
+        if(v > 0 && (pmon & (1 << v)))
+            step += ((lanes.out[v - 1] >> 5) * step) >> 10;
+
+        vo.interp_pos += step;
+        if(vo.interp_pos >= (16 << 12)) {
+            vo.interp_pos -= 16 << 12;
+            nextBlock(vo, v);
+        }
+    }
+
+    echo(clamp16(lanes.main_l), clamp16(lanes.main_r));
+}
+
+void SNES_DSP::echo(int main_l, int main_r) {
+    byte flg = regs[R_FLG];
+    twobyte addr = (regs[R_ESA] << 8) + echo_offset;
+
+    echo_hist_pos = (echo_hist_pos + 1) & 7;
+    for(int ch = 0; ch < 2; ch++) {
+        twobyte a = addr + ch * 2;
+        echo_hist[ch][echo_hist_pos] = (int16_t)(ram[a] | (ram[(twobyte)(a + 1)] << 8)) >> 1;
+    }
+
+    int fir[2];
+    for(int ch = 0; ch < 2; ch++) {
+        // C0 applies to the oldest sample, the first 7 taps wrap, only the last one clamps
+        int sum = 0;
+        for(int tap = 0; tap < 7; tap++)
+            sum += (echo_hist[ch][(echo_hist_pos + 1 + tap) & 7] * (signedbyte)regs[(tap << 4) | R_FIR]) >> 6;
+        sum = (int16_t)sum;
+        sum += (echo_hist[ch][echo_hist_pos] * (signedbyte)regs[(7 << 4) | R_FIR]) >> 6;
+        fir[ch] = clamp16(sum) & ~1;
+    }
+
+    int l = clamp16(((main_l * (signedbyte)regs[R_MVOLL]) >> 7) + ((fir[0] * (signedbyte)regs[R_EVOLL]) >> 7));
+    int r = clamp16(((main_r * (signedbyte)regs[R_MVOLR]) >> 7) + ((fir[1] * (signedbyte)regs[R_EVOLR]) >> 7));
+    if(flg & 0x40) l = r = 0;
+    output(l, r);
+
+    if(!(flg & 0x20)) {
+        int feedback[2] = {lanes.echo_l, lanes.echo_r};
+        for(int ch = 0; ch < 2; ch++) {
+            int e = clamp16(clamp16(feedback[ch]) + ((fir[ch] * (signedbyte)regs[R_EFB]) >> 7)) & ~1;
+            twobyte a = addr + ch * 2;
+            ram[a] = e & 0xFF;
+            ram[(twobyte)(a + 1)] = e >> 8;
+        }
+    }
+
+    echo_offset += 4;
+    int length = (regs[R_EDL] & 0x0F) * 0x800;
+    if(echo_offset >= length) echo_offset = 0;
+}
+
+//
+// envelopes
+//
+
+void SNES_DSP::keyOn(int v) {
+    voice& vo = voices[v];
+
+    twobyte dir = (regs[R_DIR] << 8) + (reg(v, V_SRCN) << 2);
+    vo.brr_addr = ram[dir] | (ram[(twobyte)(dir + 1)] << 8);
+    memset(vo.brr, 0, sizeof(vo.brr));
+    decodeBlock(vo);
+
+    vo.interp_pos = 0;
+    vo.env = 0;
+    vo.hidden_env = 0;
+    vo.env_mode = ENV_ATTACK;
+    vo.kon_delay = 5;
+    regs[R_ENDX] &= ~(1 << v);
+}
+
+void SNES_DSP::runEnvelope(int v) {
+    voice& vo = voices[v];
+    int env = vo.env;
+
+    if(vo.env_mode == ENV_RELEASE) {
+        env -= 8;
+        vo.env = env < 0 ? 0 : env;
+        return;
+    }
+
+    int rate;
+    int env_data = reg(v, V_ADSR2);
+    byte adsr1 = reg(v, V_ADSR1);
+
+    if(adsr1 & 0x80) {
+        if(vo.env_mode >= ENV_DECAY) {
+            // exponential
+            env--;
+            env -= env >> 8;
+            rate = env_data & 0x1F;
+            if(vo.env_mode == ENV_DECAY)
+                rate = ((adsr1 >> 3) & 0x0E) + 0x10;
+        } else {
+            rate = (adsr1 & 0x0F) * 2 + 1;
+            env += rate < 31 ? 0x20 : 0x400;
+        }
+    } else {
+        env_data = reg(v, V_GAIN);
+        int mode = env_data >> 5;
+        if(mode < 4) {
+            // direct
+            env = env_data * 0x10;
+            rate = 31;
+        } else {
+            rate = env_data & 0x1F;
+            if(mode == 4) {
+                // linear decrease
+                env -= 0x20;
+            } else if(mode < 6) {
+                // exponential decrease
+                env--;
+                env -= env >> 8;
+            } else {
+                // linear increase, bent line slows down past 3/4
+                env += 0x20;
+                if(mode > 6 && (unsigned)vo.hidden_env >= 0x600)
+                    env += 0x8 - 0x20;
+            }
+        }
+    }
+
+    if((env >> 8) == (env_data >> 5) && vo.env_mode == ENV_DECAY)
+        vo.env_mode = ENV_SUSTAIN;
+
+    vo.hidden_env = env;
+
+    if((unsigned)env > 0x7FF) {
+        env = env < 0 ? 0 : 0x7FF;
+        if(vo.env_mode == ENV_ATTACK) vo.env_mode = ENV_DECAY;
+    }
+
+    if(readCounter(rate)) vo.env = env;
+}
+
+//
+// BRR decoding
+//
+
+void SNES_DSP::nextBlock(voice& vo, int v) {
+    byte header = ram[vo.brr_addr];
+
+    if(header & 0x01) {
+        regs[R_ENDX] |= 1 << v;
+        // without the loop flag the voice still plays on from the loop point, silenced
+        if(!(header & 0x02)) {
+            vo.env_mode = ENV_RELEASE;
+            vo.env = 0;
+        }
+        twobyte dir = (regs[R_DIR] << 8) + (reg(v, V_SRCN) << 2) + 2;
+        vo.brr_addr = ram[dir] | (ram[(twobyte)(dir + 1)] << 8);
+    } else {
+        vo.brr_addr += 9;
+    }
+
+    // the filters need the end of the previous block
+    vo.brr[0] = vo.brr[16];
+    vo.brr[1] = vo.brr[17];
+    vo.brr[2] = vo.brr[18];
+    decodeBlock(vo);
+}
+
+void SNES_DSP::decodeBlock(voice& vo) {
+    byte header = ram[vo.brr_addr];
+    byte data[8];
+    for(int i = 0; i < 8; i++)
+        data[i] = ram[(twobyte)(vo.brr_addr + 1 + i)];
+
+    int16_t* out = vo.brr + 3;
+    int shift = header >> 4;
+    if(path == DSP_SCALAR) {
+        decodeNibblesScalar(data, shift, out);
+    } else {
+        decodeNibblesSSE2(data, shift, out);
+    }
+
+    int filter = (header >> 2) & 3;
+    if(filter == 0) {
+        for(int i = 0; i < 16; i++)
+            out[i] = (int16_t)(out[i] << 1);
+        return;
+    }
+
+    // the filters are recursive, so this part stays scalar
+    for(int i = 0; i < 16; i++) {
+        int s = out[i];
+        int p1 = out[i - 1];
+        int p2 = out[i - 2] >> 1;
+
+        if(filter == 1) {
+            s += p1 >> 1;
+            s += (-p1) >> 5;
+        } else {
+            s += p1;
+            s -= p2;
+            if(filter == 2) {
+                s += p2 >> 4;
+                s += (p1 * -3) >> 6;
+            } else {
+                s += (p1 * -13) >> 7;
+                s += (p2 * 3) >> 4;
+            }
+        }
+
+        out[i] = (int16_t)(clamp16(s) << 1);
+    }
+}
+
+// 16 4-bit samples, high nibble first, scaled by the block's range
+void SNES_DSP::decodeNibblesScalar(const byte* data, int shift, int16_t* out) {
+    for(int i = 0; i < 16; i++) {
+        byte b = data[i >> 1];
+        int s = (int16_t)((i & 1 ? b << 12 : b << 8) & 0xF000) >> 12;
+        if(shift <= 12) {
+            s = (s << shift) >> 1;
+        } else {
+            s = s < 0 ? -2048 : 0;
+        }
+        out[i] = s;
+    }
+}
+
+void SNES_DSP::decodeNibblesSSE2(const byte* data, int shift, int16_t* out) {
+#ifdef DSP_X86
+    const __m128i nibble_mask = _mm_set1_epi8((char)0xF0);
+    __m128i bytes = _mm_loadl_epi64((const __m128i*)data);
+    __m128i high = _mm_and_si128(bytes, nibble_mask);
+    __m128i low = _mm_and_si128(_mm_slli_epi16(bytes, 4), nibble_mask);
+    // nibbles in sample order, each in the top 4 bits of a byte
+    __m128i ordered = _mm_unpacklo_epi8(high, low);
+
+    // then in the top 4 bits of a 16-bit lane, which is the sample << 12
+    __m128i zero = _mm_setzero_si128();
+    __m128i s0 = _mm_unpacklo_epi8(zero, ordered);
+    __m128i s1 = _mm_unpackhi_epi8(zero, ordered);
+
+    if(shift <= 12) {
+        __m128i count = _mm_cvtsi32_si128(13 - shift);
+        s0 = _mm_sra_epi16(s0, count);
+        s1 = _mm_sra_epi16(s1, count);
+    } else {
+        s0 = _mm_slli_epi16(_mm_srai_epi16(s0, 15), 11);
+        s1 = _mm_slli_epi16(_mm_srai_epi16(s1, 15), 11);
+    }
+
+    _mm_storeu_si128((__m128i*)out, s0);
+    _mm_storeu_si128((__m128i*)(out + 8), s1);
+#else
+    decodeNibblesScalar(data, shift, out);
+#endif
+}
+
+//
+// voice loop: interpolation, noise, envelope and volume for all 8 voices
+//
+
+void SNES_DSP::mixScalar(voice_lanes& l) {
+    l.main_l = l.main_r = l.echo_l = l.echo_r = 0;
+
+    for(int v = 0; v < DSP_VOICES; v++) {
+        int out = ((l.gauss[0][v] * l.taps[0][v]) >> 11)
+            + ((l.gauss[1][v] * l.taps[1][v]) >> 11)
+            + ((l.gauss[2][v] * l.taps[2][v]) >> 11);
+        out = (int16_t)out;
+        out += (l.gauss[3][v] * l.taps[3][v]) >> 11;
+        out = clamp16(out) & ~1;
+
+        if(l.noise[v]) out = l.noise_out;
+        out = ((out * l.env[v]) >> 11) & ~1;
+        l.out[v] = out;
+
+        int left = (out * l.vol_l[v]) >> 7;
+        int right = (out * l.vol_r[v]) >> 7;
+        l.main_l += left;
+        l.main_r += right;
+        if(l.echo[v]) {
+            l.echo_l += left;
+            l.echo_r += right;
+        }
+    }
+}
+
+#ifdef DSP_X86
+
+// 8 signed 16x16 products as two vectors of 4 32-bit lanes, arithmetic shifted
+static inline void mul32(__m128i a, __m128i b, int shift, __m128i& low, __m128i& high) {
+    __m128i lo = _mm_mullo_epi16(a, b);
+    __m128i hi = _mm_mulhi_epi16(a, b);
+    low = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), shift);
+    high = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), shift);
+}
+
+static inline int hsum32(__m128i v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+static inline __m128i wrap16(__m128i v) {
+    return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+void SNES_DSP::mixSSE2(voice_lanes& l) {
+    const __m128i even = _mm_set1_epi16((short)0xFFFE);
+    __m128i lo, hi, plo, phi;
+
+    mul32(_mm_load_si128((__m128i*)l.gauss[0]), _mm_load_si128((__m128i*)l.taps[0]), 11, lo, hi);
+    mul32(_mm_load_si128((__m128i*)l.gauss[1]), _mm_load_si128((__m128i*)l.taps[1]), 11, plo, phi);
+    lo = _mm_add_epi32(lo, plo);
+    hi = _mm_add_epi32(hi, phi);
+    mul32(_mm_load_si128((__m128i*)l.gauss[2]), _mm_load_si128((__m128i*)l.taps[2]), 11, plo, phi);
+    lo = wrap16(_mm_add_epi32(lo, plo));
+    hi = wrap16(_mm_add_epi32(hi, phi));
+    mul32(_mm_load_si128((__m128i*)l.gauss[3]), _mm_load_si128((__m128i*)l.taps[3]), 11, plo, phi);
+    lo = _mm_add_epi32(lo, plo);
+    hi = _mm_add_epi32(hi, phi);
+    // the pack saturates, which is the clamp
+    __m128i out = _mm_and_si128(_mm_packs_epi32(lo, hi), even);
+
+    __m128i noise = _mm_load_si128((__m128i*)l.noise);
+    out = _mm_or_si128(_mm_andnot_si128(noise, out), _mm_and_si128(noise, _mm_set1_epi16(l.noise_out)));
+
+    mul32(out, _mm_load_si128((__m128i*)l.env), 11, lo, hi);
+    out = _mm_and_si128(_mm_packs_epi32(lo, hi), even);
+    _mm_store_si128((__m128i*)l.out, out);
+
+    __m128i echo = _mm_load_si128((__m128i*)l.echo);
+    __m128i echo_lo = _mm_unpacklo_epi16(echo, echo);
+    __m128i echo_hi = _mm_unpackhi_epi16(echo, echo);
+
+    mul32(out, _mm_load_si128((__m128i*)l.vol_l), 7, lo, hi);
+    l.main_l = hsum32(_mm_add_epi32(lo, hi));
+    l.echo_l = hsum32(_mm_add_epi32(_mm_and_si128(lo, echo_lo), _mm_and_si128(hi, echo_hi)));
+
+    mul32(out, _mm_load_si128((__m128i*)l.vol_r), 7, lo, hi);
+    l.main_r = hsum32(_mm_add_epi32(lo, hi));
+    l.echo_r = hsum32(_mm_add_epi32(_mm_and_si128(lo, echo_lo), _mm_and_si128(hi, echo_hi)));
+}
+
+// one 32-bit lane per voice
+__attribute__((target("avx2")))
+static inline __m256i load32(const int16_t* lanes) {
+    return _mm256_cvtepi16_epi32(_mm_load_si128((const __m128i*)lanes));
+}
+
+__attribute__((target("avx2")))
+static inline int hsum256(__m256i v) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return hsum32(sum);
+}
+
+__attribute__((target("avx2")))
+void SNES_DSP::mixAVX2(voice_lanes& l) {
+    const __m256i even = _mm256_set1_epi32(~1);
+    const __m256i max = _mm256_set1_epi32(32767);
+    const __m256i min = _mm256_set1_epi32(-32768);
+
+    __m256i out = _mm256_srai_epi32(_mm256_mullo_epi32(load32(l.gauss[0]), load32(l.taps[0])), 11);
+    out = _mm256_add_epi32(out, _mm256_srai_epi32(_mm256_mullo_epi32(load32(l.gauss[1]), load32(l.taps[1])), 11));
+    out = _mm256_add_epi32(out, _mm256_srai_epi32(_mm256_mullo_epi32(load32(l.gauss[2]), load32(l.taps[2])), 11));
+    out = _mm256_srai_epi32(_mm256_slli_epi32(out, 16), 16);
+    out = _mm256_add_epi32(out, _mm256_srai_epi32(_mm256_mullo_epi32(load32(l.gauss[3]), load32(l.taps[3])), 11));
+    out = _mm256_and_si256(_mm256_max_epi32(_mm256_min_epi32(out, max), min), even);
+
+    out = _mm256_blendv_epi8(out, _mm256_set1_epi32(l.noise_out), load32(l.noise));
+
+    out = _mm256_srai_epi32(_mm256_mullo_epi32(out, load32(l.env)), 11);
+    out = _mm256_and_si256(out, even);
+    __m256i packed = _mm256_packs_epi32(out, out);
+    _mm_store_si128((__m128i*)l.out, _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0))));
+
+    __m256i echo = load32(l.echo);
+    __m256i left = _mm256_srai_epi32(_mm256_mullo_epi32(out, load32(l.vol_l)), 7);
+    __m256i right = _mm256_srai_epi32(_mm256_mullo_epi32(out, load32(l.vol_r)), 7);
+    l.main_l = hsum256(left);
+    l.main_r = hsum256(right);
+    l.echo_l = hsum256(_mm256_and_si256(left, echo));
+    l.echo_r = hsum256(_mm256_and_si256(right, echo));
+}
+
+#else
+
+void SNES_DSP::mixSSE2(voice_lanes& l) {
+    mixScalar(l);
+}
+
+void SNES_DSP::mixAVX2(voice_lanes& l) {
+    mixScalar(l);
+}
+
+#endif
@@ -3,9 +3,129 @@
 
 #include "common.h"
 
+#include <array>
+
+// one stereo sample every 32 spc700 cycles (32 kHz)
+#define DSP_CYCLES_PER_SAMPLE   32
+#define DSP_VOICES              8
+// frames kept for the frontend, the oldest are overwritten when nobody drains them
+#define DSP_OUTPUT_FRAMES       8192
+
+// how the voice loop and BRR decode are computed. every path produces
+// bit-identical output, the scalar one is the reference
+enum SNES_DSP_PATH {
+    DSP_SCALAR,
+    DSP_SSE2,
+    DSP_AVX2
+};
+
+// the S-DSP: 8 BRR voices with gaussian interpolation and ADSR/GAIN envelopes,
+// noise, pitch modulation and an 8-tap FIR echo in audio RAM.
+//
+// runs one output sample at a time. the voice loop is split so everything
+// that depends on the previous voice (pitch modulation) happens after the
+// outputs of all 8 voices are computed side by side
+class SNES_STATE;
+
 class SNES_DSP {
 public:
     SNES_DSP();
+
+    void reset();
+    // sample data and the echo buffer live in audio RAM
+    void setRAM(byte* ram) {this->ram = ram;};
+
+    // register file, reached through $F2/$F3 on the spc700 side.
+    // $80-$FF mirror $00-$7F for reads and ignore writes
+    byte read(byte addr) {return regs[addr & 0x7F];};
+    void write(byte addr, byte data);
+
+    // generates the next stereo sample
+    void sample();
+
+    // picks the fastest path this cpu supports unless told otherwise
+    bool setPath(SNES_DSP_PATH path);
+    SNES_DSP_PATH getPath() {return path;};
+    static bool supported(SNES_DSP_PATH path);
+
+    // copies out up to max_frames interleaved L/R frames, returns how many
+    size_t readSamples(int16_t* out, size_t max_frames);
+    size_t available() {return output_count;};
+
+    // registers and voice state. samples not yet read out are dropped
+    void serialize(SNES_STATE& state);
+private:
+    enum envelope_mode {ENV_RELEASE, ENV_ATTACK, ENV_DECAY, ENV_SUSTAIN};
+
+    // per voice state. the current BRR block is decoded into brr with the
+    // last 3 samples of the previous block in front, so the 4 interpolation
+    // taps for sample i are always brr[i..i+3]
+    struct voice {
+        int16_t brr[3 + 16];
+        twobyte brr_addr;
+        // pitch counter, 12 fractional bits into the current block
+        int interp_pos;
+        int env;
+        // env before clamping, for the bent line GAIN mode
+        int hidden_env;
+        envelope_mode env_mode;
+        // samples left before a keyed on voice starts
+        int kon_delay;
+    };
+    voice voices[DSP_VOICES];
+
+    // voice loop inputs and outputs, one lane per voice
+    struct voice_lanes {
+        alignas(32) int16_t taps[4][DSP_VOICES];
+        alignas(32) int16_t gauss[4][DSP_VOICES];
+        alignas(32) int16_t env[DSP_VOICES];
+        alignas(32) int16_t vol_l[DSP_VOICES];
+        alignas(32) int16_t vol_r[DSP_VOICES];
+        // 0 or -1, picks the noise sample over the interpolated one
+        alignas(32) int16_t noise[DSP_VOICES];
+        // -1 for voices feeding the echo
+        alignas(32) int16_t echo[DSP_VOICES];
+        alignas(32) int16_t out[DSP_VOICES];
+        int16_t noise_out;
+        int main_l, main_r, echo_l, echo_r;
+    };
+    voice_lanes lanes;
+
+    void mixScalar(voice_lanes& l);
+    void mixSSE2(voice_lanes& l);
+    void mixAVX2(voice_lanes& l);
+    // moves voice v on to its next block, following the loop point at the end
+    void nextBlock(voice& vo, int v);
+    void decodeBlock(voice& vo);
+    void decodeNibblesScalar(const byte* data, int shift, int16_t* out);
+    void decodeNibblesSSE2(const byte* data, int shift, int16_t* out);
+
+    void keyOn(int v);
+    void runEnvelope(int v);
+    bool readCounter(int rate);
+    void echo(int main_l, int main_r);
+    void output(int16_t l, int16_t r);
+
+    byte reg(int v, int r) {return regs[(v << 4) | r];};
+
+    std::array<byte, 128> regs;
+    byte* ram = nullptr;
+
+    SNES_DSP_PATH path = DSP_SCALAR;
+
+    // KON bits waiting for the next sample
+    byte kon;
+    // counts down through the 30720 sample envelope/noise period
+    int counter;
+    int noise;
+
+    twobyte echo_offset;
+    int16_t echo_hist[2][8];
+    int echo_hist_pos;
+
+    std::array<int16_t, DSP_OUTPUT_FRAMES * 2> output_buffer;
+    size_t output_pos;
+    size_t output_count;
 };
 
-#endif //_DSP_H
\ No newline at end of file
+#endif //_DSP_H
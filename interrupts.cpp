@@ -0,0 +1,111 @@
+#include "common.h"
+
+#include "interrupts.hpp"
+#include "ram.hpp"
+#include "cpu.hpp"
+#include "ppu.hpp"
+#include "state.hpp"
+
+#include <algorithm>
+
+// HTIME and VTIME past these never match
+#define IRQ_DOTS		340
+
+void SNES_INTERRUPTS::reset() {
+	time_up = false;
+	if(mem->cpu) mem->cpu->setIRQ(false);
+}
+
+byte SNES_INTERRUPTS::reg(twobyte addr) {
+	return mem->io[addr - 0x2000];
+}
+
+bool SNES_INTERRUPTS::runUntil(uint64_t target) {
+	while(true) {
+		uint64_t nmi = nextNMI();
+		uint64_t irq = nextIRQ();
+		uint64_t next = std::min(nmi, irq);
+		if(next > target) break;
+
+		time = next;
+		if(nmi == next) {
+			nmis++;
+			mem->cpu->raiseNMI();
+		}
+		if(irq == next) {
+			irqs++;
+			setTimeUp(true);
+		}
+	}
+	if(target > time) time = target;
+	return true;
+}
+
+uint64_t SNES_INTERRUPTS::nextEvent() {
+	return std::min(nextNMI(), nextIRQ());
+}
+
+uint64_t SNES_INTERRUPTS::nextNMI() {
+	if(!mem->ppu || !(reg(0x4200) & 0x80)) return UINT64_MAX;
+	return nextDot(mem->ppu->getHeight() + 1, 0);
+}
+
+uint64_t SNES_INTERRUPTS::nextIRQ() {
+	if(!mem->ppu) return UINT64_MAX;
+	twobyte htime = (reg(0x4207) | (reg(0x4208) << 8)) & 0x1FF;
+	twobyte vtime = (reg(0x4209) | (reg(0x420A) << 8)) & 0x1FF;
+	bool h = htime < IRQ_DOTS;
+	bool v = vtime < PPU_LINES_PER_FRAME;
+
+	switch((reg(0x4200) >> 4) & 3) {
+		case 1: return h ? nextDot(-1, htime) : UINT64_MAX;
+		case 2: return v ? nextDot(vtime, 0) : UINT64_MAX;
+		case 3: return h && v ? nextDot(vtime, htime) : UINT64_MAX;
+	}
+	return UINT64_MAX;
+}
+
+uint64_t SNES_INTERRUPTS::nextDot(int line, int dot) {
+	// frames are all the same length, so any frame start gives the phase
+	int64_t period = line < 0 ? PPU_CYCLES_PER_LINE : (int64_t)PPU_CYCLES_PER_LINE * PPU_LINES_PER_FRAME;
+	int64_t now = time;
+	int64_t phase = ((now - (int64_t)mem->ppu->frameStart()) % period + period) % period;
+
+	int64_t at = now - phase + std::max(line, 0) * PPU_CYCLES_PER_LINE + dot * PPU_CYCLES_PER_DOT;
+	if(at <= now) at += period;
+	return at;
+}
+
+void SNES_INTERRUPTS::write(twobyte addr, byte data) {
+	runUntil(mem->cpu->time);
+
+	if(addr == 0x4200) {
+		// turning the nmi on in vblank, before $4210 is read, raises it at once
+		if((data & 0x80) && !(reg(0x4200) & 0x80) && mem->ppu && mem->ppu->nmiFlag()) {
+			nmis++;
+			mem->cpu->raiseNMI();
+		}
+		if(!(data & 0x30)) setTimeUp(false);
+	}
+	// the next event may come before the end of the cpu's batch
+	mem->cpu->endBatch();
+}
+
+byte SNES_INTERRUPTS::readTimeUp() {
+	runUntil(mem->cpu->time);
+	byte value = time_up ? 0x80 : 0x00;
+	setTimeUp(false);
+	return value;
+}
+
+void SNES_INTERRUPTS::setTimeUp(bool flag) {
+	time_up = flag;
+	mem->cpu->setIRQ(flag);
+}
+
+void SNES_INTERRUPTS::serialize(SNES_STATE& state) {
+	if(!state.begin(STATE_TAG('I', 'R', 'Q', ' '), 1)) return;
+	state.value(time);
+	state.value(time_up);
+	state.end();
+}
@@ -0,0 +1,60 @@
+#ifndef _INTERRUPTS_H
+#define _INTERRUPTS_H
+
+#include "common.h"
+#include "scheduler.hpp"
+
+class SNES_MEMORY;
+class SNES_STATE;
+
+// the nmi at the start of vblank and the h/v timer irq, set up through
+// $4200 (NMITIMEN) and $4207-$420A (HTIME, VTIME), with the timer's flag at
+// $4211 (TIMEUP). the vblank flag at $4210 stays with the ppu, and the
+// registers live in the memory's I/O area like the dma's.
+//
+// nothing is polled. the controller works out from the ppu's line timing
+// when it next raises something, the scheduler ends the cpu's batches there,
+// and catching the controller up sets the cpu's interrupt lines, which the
+// cpu looks at between blocks. without a ppu there is nothing to time from
+// and nothing is raised
+class SNES_INTERRUPTS : public SNES_CLOCKED {
+public:
+	SNES_INTERRUPTS(SNES_MEMORY* mem) : mem(mem) {};
+
+	void reset();
+
+	// raises what falls due up to target
+	bool runUntil(uint64_t target) override;
+	uint64_t nextEvent() override;
+
+	// before data is stored to $4200 or $4207-$420A, catches up under the old
+	// settings
+	void write(twobyte reg, byte data);
+	// $4211, reading it drops the irq
+	byte readTimeUp();
+
+	// raised so far
+	uint64_t getNMIs() {return nmis;};
+	uint64_t getIRQs() {return irqs;};
+
+	// the timer's flag
+	void serialize(SNES_STATE& state);
+private:
+	SNES_MEMORY* mem;
+
+	byte reg(twobyte addr);
+	uint64_t nextNMI();
+	uint64_t nextIRQ();
+	// the first time after now that the ppu reaches dot of line, or of any
+	// line when line is negative
+	uint64_t nextDot(int line, int dot);
+
+	// the cpu's irq line follows it
+	bool time_up = false;
+	void setTimeUp(bool flag);
+
+	uint64_t nmis = 0;
+	uint64_t irqs = 0;
+};
+
+#endif //_INTERRUPTS_H
@@ -0,0 +1,680 @@
+#include "common.h"
+
+#include "jit.hpp"
+#include "ram.hpp"
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+// host registers
+#define RAX		0
+#define RCX		1
+#define RDX		2
+#define RSI		6
+#define RDI		7
+// C, X and Y
+#define RA		8
+#define RX		9
+#define RY		10
+// the last result, for n and z
+#define RNZ		11
+
+// x86 ALU opcodes (reg to r/m form) and group 1 extensions
+#define X86_ADD		0x01
+#define X86_OR		0x09
+#define X86_AND		0x21
+#define X86_SUB		0x29
+#define X86_XOR		0x31
+#define X86_CMP		0x39
+#define X86_TEST	0x85
+#define X86_MOV		0x89
+#define EXT_ADD		0
+#define EXT_OR		1
+#define EXT_AND		4
+#define EXT_SUB		5
+#define EXT_XOR		6
+#define EXT_CMP		7
+#define EXT_SHL		4
+#define EXT_SHR		5
+
+// condition codes
+#define CC_B		0x2
+#define CC_AE		0x3
+#define CC_E		0x4
+#define CC_NE		0x5
+#define CC_A		0x7
+#define CC_G		0xF
+
+// status register bits
+#define FLAG_C		0x01
+#define FLAG_Z		0x02
+#define FLAG_V		0x40
+#define FLAG_N		0x80
+
+SNES_JIT::SNES_JIT() {
+#if defined(__x86_64__)
+	void* buffer = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(buffer == MAP_FAILED) return;
+	// hosts enforcing W^X may refuse to make it executable at all
+	if(mprotect(buffer, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0) {
+		munmap(buffer, JIT_CODE_SIZE);
+		return;
+	}
+	code = (byte*)buffer;
+#endif
+}
+
+SNES_JIT::~SNES_JIT() {
+	if(code)
+		munmap(code, JIT_CODE_SIZE);
+}
+
+bool SNES_JIT::supported() {
+#if defined(__x86_64__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool SNES_JIT::protect(size_t from, size_t to, bool writable) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	from &= ~(page - 1);
+	to = std::min((to + page - 1) & ~(page - 1), (size_t)JIT_CODE_SIZE);
+	return mprotect(code + from, to - from, PROT_READ | (writable ? PROT_WRITE : PROT_EXEC)) == 0;
+}
+
+bool SNES_JIT::compile(SNES_CPU* cpu, SNES_CPU::code_block& block) {
+	if(!code) return true;
+	// the longest an instruction and its exit can get
+	size_t limit = used + (block.code.size() + 2) * 256;
+	if(limit > JIT_CODE_SIZE) return false;
+
+	// nothing runs from these pages while they're written, the block stays
+	// with the interpreter if they can't be flipped
+	size_t start = used;
+	if(!protect(start, limit, true)) return true;
+	bool compiled = emitBlock(cpu, block);
+	if(!protect(start, limit, false)) {
+		block.native = nullptr;
+		used = start;
+		return true;
+	}
+	if(!compiled) used = start;
+	return true;
+}
+
+bool SNES_JIT::emitBlock(SNES_CPU* cpu, SNES_CPU::code_block& block) {
+	this->cpu = cpu;
+	size_t start = used;
+	byte dl = (cpu->D & 0xFF) != 0;
+	nz_pending = false;
+	nz_wide = false;
+
+	loadField(RA, &cpu->C, 16);
+	loadField(RX, &cpu->X, 16);
+	loadField(RY, &cpu->Y, 16);
+
+	std::vector<exit_stub> stubs;
+	uint32_t cycles = 0;
+	uint32_t max_cycles = 0;
+	byte compiled = 0;
+	bool jumped = false;
+	for(const decoded_op& op : block.code) {
+		op_info info = classify(op);
+		if(info.kind == JIT_NONE) break;
+
+		const SNES_CPU::instruction& inst = *op.inst;
+		uint32_t op_cycles = inst.cycles + ((inst.cycleMods & SNES_CPU::CYC_DL) ? dl : 0);
+		exit_stub stub = {{}, compiled, op.pc, cycles, nz_pending, nz_wide};
+		compiled++;
+
+		if(info.kind == JIT_BRANCH || info.kind == JIT_JMP) {
+			emitBranch(op, info, stub, op_cycles);
+			max_cycles = cycles + op_cycles + ((inst.cycleMods & SNES_CPU::CYC_BR) ? 1 : 0);
+			jumped = true;
+			break;
+		}
+
+		emitInstruction(op, info, stub);
+		if(!stub.jumps.empty())
+			stubs.push_back(stub);
+		cycles += op_cycles;
+		max_cycles = cycles;
+	}
+
+	// nothing worth running natively, the block stays with the interpreter
+	if(compiled == 0) return false;
+
+	if(!jumped)
+		emitExit({{}, compiled, block.code[compiled - 1].next, cycles, nz_pending, nz_wide});
+	for(const exit_stub& stub : stubs)
+		emitExit(stub);
+
+	block.native = (SNES_CPU::native_code)(code + start);
+	block.native_dl = dl;
+	block.native_cycles = max_cycles * MASTER_CYCLES_PER_CPU_CYCLE;
+	return true;
+}
+
+SNES_JIT::op_info SNES_JIT::classify(const decoded_op& op) {
+	typedef SNES_CPU::handler handler;
+	struct op_entry {
+		handler op8, op16;
+		op_kind kind;
+		int src, dst;
+	};
+	static const op_entry table[] = {
+		{&SNES_CPU::LDA<true>, &SNES_CPU::LDA<false>, JIT_LOAD, 0, RA},
+		{&SNES_CPU::LDX<true>, &SNES_CPU::LDX<false>, JIT_LOAD, 0, RX},
+		{&SNES_CPU::LDY<true>, &SNES_CPU::LDY<false>, JIT_LOAD, 0, RY},
+		{&SNES_CPU::STA<true>, &SNES_CPU::STA<false>, JIT_STORE, 0, RA},
+		{&SNES_CPU::STX<true>, &SNES_CPU::STX<false>, JIT_STORE, 0, RX},
+		{&SNES_CPU::STY<true>, &SNES_CPU::STY<false>, JIT_STORE, 0, RY},
+		// STZ stores A, like the interpreter
+		{&SNES_CPU::STZ<true>, &SNES_CPU::STZ<false>, JIT_STORE, 0, RA},
+		{&SNES_CPU::AND<true>, &SNES_CPU::AND<false>, JIT_AND, 0, RA},
+		{&SNES_CPU::ORA<true>, &SNES_CPU::ORA<false>, JIT_ORA, 0, RA},
+		{&SNES_CPU::EOR<true>, &SNES_CPU::EOR<false>, JIT_EOR, 0, RA},
+		{&SNES_CPU::ADC<true>, &SNES_CPU::ADC<false>, JIT_ADC, 0, RA},
+		{&SNES_CPU::SBC<true>, &SNES_CPU::SBC<false>, JIT_SBC, 0, RA},
+		{&SNES_CPU::CMP<true>, &SNES_CPU::CMP<false>, JIT_COMPARE, 0, RA},
+		{&SNES_CPU::CPX<true>, &SNES_CPU::CPX<false>, JIT_COMPARE, 0, RX},
+		{&SNES_CPU::CPY<true>, &SNES_CPU::CPY<false>, JIT_COMPARE, 0, RY},
+		{&SNES_CPU::INCA<true>, &SNES_CPU::INCA<false>, JIT_INC, 0, RA},
+		{&SNES_CPU::INX<true>, &SNES_CPU::INX<false>, JIT_INC, 0, RX},
+		{&SNES_CPU::INY<true>, &SNES_CPU::INY<false>, JIT_INC, 0, RY},
+		{&SNES_CPU::DECA<true>, &SNES_CPU::DECA<false>, JIT_DEC, 0, RA},
+		{&SNES_CPU::DEX<true>, &SNES_CPU::DEX<false>, JIT_DEC, 0, RX},
+		{&SNES_CPU::DEY<true>, &SNES_CPU::DEY<false>, JIT_DEC, 0, RY},
+		{&SNES_CPU::TAX<true>, &SNES_CPU::TAX<false>, JIT_TRANSFER, RA, RX},
+		{&SNES_CPU::TAY<true>, &SNES_CPU::TAY<false>, JIT_TRANSFER, RA, RY},
+		{&SNES_CPU::TXA<true>, &SNES_CPU::TXA<false>, JIT_TRANSFER, RX, RA},
+		{&SNES_CPU::TYA<true>, &SNES_CPU::TYA<false>, JIT_TRANSFER, RY, RA},
+		{&SNES_CPU::TXY<true>, &SNES_CPU::TXY<false>, JIT_TRANSFER, RX, RY},
+		{&SNES_CPU::TYX<true>, &SNES_CPU::TYX<false>, JIT_TRANSFER, RY, RX},
+		{&SNES_CPU::ASLA<true>, &SNES_CPU::ASLA<false>, JIT_ASL, 0, RA},
+		{&SNES_CPU::LSRA<true>, &SNES_CPU::LSRA<false>, JIT_LSR, 0, RA},
+		{&SNES_CPU::CLC, &SNES_CPU::CLC, JIT_CLC, 0, 0},
+		{&SNES_CPU::SEC, &SNES_CPU::SEC, JIT_SEC, 0, 0},
+		{&SNES_CPU::CLV, &SNES_CPU::CLV, JIT_CLV, 0, 0},
+		{&SNES_CPU::NOP, &SNES_CPU::NOP, JIT_NOP, 0, 0},
+		{&SNES_CPU::JMP, &SNES_CPU::JMP, JIT_JMP, 0, 0}
+	};
+	// flag tested and the value that takes the branch, 0 for always
+	static const struct {
+		handler op;
+		byte flag;
+		bool taken_if_set;
+	} branches[] = {
+		{&SNES_CPU::BCC, FLAG_C, false}, {&SNES_CPU::BCS, FLAG_C, true},
+		{&SNES_CPU::BNE, FLAG_Z, false}, {&SNES_CPU::BEQ, FLAG_Z, true},
+		{&SNES_CPU::BPL, FLAG_N, false}, {&SNES_CPU::BMI, FLAG_N, true},
+		{&SNES_CPU::BVC, FLAG_V, false}, {&SNES_CPU::BVS, FLAG_V, true},
+		{&SNES_CPU::BRA, 0, false}, {&SNES_CPU::BRL, 0, false}
+	};
+
+	const SNES_CPU::instruction& inst = *op.inst;
+	op_info info;
+	// the +1 cycle outside native mode isn't known when compiling
+	if(inst.cycleMods & SNES_CPU::CYC_E) return info;
+
+	for(const auto& branch : branches) {
+		if(inst.op != branch.op) continue;
+		info.kind = JIT_BRANCH;
+		info.flag = branch.flag;
+		info.taken_if_set = branch.taken_if_set;
+		return info;
+	}
+
+	const op_entry* entry = nullptr;
+	for(const op_entry& e : table) {
+		if(inst.op == e.op8 || inst.op == e.op16) {
+			entry = &e;
+			break;
+		}
+	}
+	if(!entry) return info;
+
+	bool imp = false;
+	if(inst.mode == &SNES_CPU::IMP) {
+		imp = true;
+	} else if(inst.mode == &SNES_CPU::IMM_M<true> || inst.mode == &SNES_CPU::IMM_X<true>) {
+		info.operand = op_info::OPERAND_IMM;
+	} else if(inst.mode == &SNES_CPU::IMM_M<false> || inst.mode == &SNES_CPU::IMM_X<false>) {
+		info.operand = op_info::OPERAND_IMM;
+		info.mem_wide = true;
+	} else if(inst.mode == &SNES_CPU::DP<true> || inst.mode == &SNES_CPU::DP<false>) {
+		info.operand = op_info::OPERAND_DP;
+		info.mem_wide = inst.mode == &SNES_CPU::DP<false>;
+	} else if(inst.mode == &SNES_CPU::ABS<true> || inst.mode == &SNES_CPU::ABS<false>) {
+		info.operand = op_info::OPERAND_ABS;
+		info.mem_wide = inst.mode == &SNES_CPU::ABS<false>;
+	} else if(entry->kind == JIT_JMP && inst.mode == &SNES_CPU::IMM16) {
+		info.kind = JIT_JMP;
+		return info;
+	} else {
+		return info;
+	}
+
+	info.wide = inst.op == entry->op16 && entry->op8 != entry->op16;
+	info.src = entry->src;
+	info.dst = entry->dst;
+
+	switch(entry->kind) {
+		case JIT_INC: case JIT_DEC: case JIT_TRANSFER: case JIT_ASL: case JIT_LSR:
+		case JIT_CLC: case JIT_SEC: case JIT_CLV: case JIT_NOP:
+			if(!imp) return info;
+			break;
+		case JIT_STORE:
+			if(imp || info.operand == op_info::OPERAND_IMM) return info;
+			break;
+		case JIT_JMP:
+			return info;
+		default:
+			// the index ops reading memory at the accumulator's width would
+			// see a stale high byte when only 8 bits are fetched
+			if(imp || info.mem_wide != info.wide) return info;
+			break;
+	}
+	info.kind = entry->kind;
+	return info;
+}
+
+//
+// code generation
+//
+
+void SNES_JIT::emitInstruction(const decoded_op& op, const op_info& info, exit_stub& stub) {
+	int size = info.wide ? 16 : 8;
+	int top = info.wide ? 15 : 7;
+
+	switch(info.kind) {
+		case JIT_LOAD:
+			emitLoad(op, info, stub);
+			aluRR(X86_MOV, size, info.dst, RAX);
+			break;
+		case JIT_STORE:
+			emitStore(op, info, stub);
+			return;
+		case JIT_AND:
+		case JIT_ORA:
+		case JIT_EOR:
+			emitLoad(op, info, stub);
+			aluRR(info.kind == JIT_AND ? X86_AND : info.kind == JIT_ORA ? X86_OR : X86_XOR, size, RA, RAX);
+			break;
+		case JIT_ADC:
+			// binary mode only, decimal mode blocks don't run natively.
+			// the carry bit reads as -1 (it is a signed 1-bit field), which
+			// the interpreter adds as is
+			emitLoad(op, info, stub);
+			loadField(RDX, &cpu->status.full, 8);
+			aluRI(EXT_AND, 32, RDX, FLAG_C);
+			// neg edx
+			prefix(32, 0, 0, RDX);
+			emit8(0xF7);
+			emit8(0xD8 | (RDX & 7));
+			aluRR(X86_ADD, 32, RAX, RDX);
+			movzx(RSI, RA, size);
+			aluRR(X86_MOV, 32, RDX, RSI);
+			aluRR(X86_ADD, 32, RSI, RAX);
+			// v = the operand plus carry has A's sign and the result doesn't
+			aluRI(EXT_XOR, 32, RAX, 0xFFFFFFFF);
+			aluRR(X86_XOR, 32, RAX, RDX);
+			aluRR(X86_XOR, 32, RDX, RSI);
+			aluRR(X86_AND, 32, RAX, RDX);
+			shift(EXT_SHR, 32, RAX, top);
+			aluRI(EXT_AND, 32, RAX, 1);
+			shift(EXT_SHL, 32, RAX, 6);
+			// the 8-bit sum is compared as an int, the 16-bit one unsigned
+			aluRI(EXT_CMP, 32, RSI, info.wide ? 0xFFFF : 0xFF);
+			setcc(info.wide ? CC_A : CC_G, RDX);
+			aluRR(X86_OR, 8, RAX, RDX);
+			aluRR(X86_MOV, size, RA, RSI);
+			statusOp(EXT_AND, (byte)~(FLAG_C | FLAG_V));
+			statusOr(RAX);
+			break;
+		case JIT_SBC:
+			emitLoad(op, info, stub);
+			loadField(RDX, &cpu->status.full, 8);
+			aluRI(EXT_AND, 32, RDX, FLAG_C);
+			aluRI(EXT_XOR, 32, RDX, FLAG_C);
+			movzx(RSI, RA, size);
+			aluRR(X86_CMP, 32, RSI, RAX);
+			setcc(CC_AE, RCX);
+			aluRR(X86_ADD, 32, RAX, RDX);
+			aluRR(X86_MOV, 32, RDX, RSI);
+			aluRR(X86_SUB, 32, RSI, RAX);
+			// v = A's sign differs from the operand plus borrow and the result
+			aluRR(X86_XOR, 32, RAX, RDX);
+			aluRR(X86_XOR, 32, RDX, RSI);
+			aluRR(X86_AND, 32, RAX, RDX);
+			shift(EXT_SHR, 32, RAX, top);
+			aluRI(EXT_AND, 32, RAX, 1);
+			shift(EXT_SHL, 32, RAX, 6);
+			aluRR(X86_OR, 8, RAX, RCX);
+			aluRR(X86_MOV, size, RA, RSI);
+			statusOp(EXT_AND, (byte)~(FLAG_C | FLAG_V));
+			statusOr(RAX);
+			break;
+		case JIT_COMPARE:
+			emitLoad(op, info, stub);
+			movzx(RSI, info.dst, size);
+			aluRR(X86_CMP, 32, RSI, RAX);
+			setcc(CC_AE, RDX);
+			aluRR(X86_SUB, 32, RSI, RAX);
+			setCarry(RDX);
+			movzx(RNZ, RSI, size);
+			nz_pending = true;
+			nz_wide = info.wide;
+			return;
+		case JIT_INC:
+		case JIT_DEC:
+			aluRI(info.kind == JIT_INC ? EXT_ADD : EXT_SUB, size, info.dst, 1);
+			break;
+		case JIT_TRANSFER:
+			aluRR(X86_MOV, size, info.dst, info.src);
+			break;
+		case JIT_ASL:
+		case JIT_LSR:
+			// the bit shifted out lands in the host carry
+			shift(info.kind == JIT_ASL ? EXT_SHL : EXT_SHR, size, RA, 1);
+			setcc(CC_B, RDX);
+			setCarry(RDX);
+			break;
+		case JIT_CLC:
+			statusOp(EXT_AND, (byte)~FLAG_C);
+			return;
+		case JIT_SEC:
+			statusOp(EXT_OR, FLAG_C);
+			return;
+		case JIT_CLV:
+			statusOp(EXT_AND, (byte)~FLAG_V);
+			return;
+		default:
+			return;
+	}
+
+	// everything that got here set n and z from the register it wrote
+	movzx(RNZ, info.dst, size);
+	nz_pending = true;
+	nz_wide = info.wide;
+}
+
+// ends the block, falling through to the not taken exit
+void SNES_JIT::emitBranch(const decoded_op& op, const op_info& info, const exit_stub& stub, uint32_t op_cycles) {
+	const SNES_CPU::instruction& inst = *op.inst;
+	twobyte target;
+	if(info.kind == JIT_JMP) {
+		target = (twobyte)op.operand;
+	} else if(inst.op == &SNES_CPU::BRL) {
+		target = op.next + (signedtwobyte)op.operand;
+	} else if(inst.op == &SNES_CPU::BCC || inst.op == &SNES_CPU::BCS || inst.op == &SNES_CPU::BEQ) {
+		// these add the offset unsigned in the interpreter
+		target = op.next + (byte)op.operand;
+	} else {
+		target = op.next + (signedbyte)op.operand;
+	}
+
+	// the operand as the interpreter's fetch leaves it
+	movImm(RAX, op.operand);
+	storeField(RAX, &cpu->fetched, inst.mode == &SNES_CPU::IMM16 ? 16 : 8);
+
+	uint32_t cycles = stub.cycles + op_cycles;
+	exit_stub taken = {{}, (byte)(stub.executed + 1), target, cycles, nz_pending, nz_wide};
+	if(inst.cycleMods & SNES_CPU::CYC_BR) taken.cycles++;
+	if(info.flag == 0) {
+		emitExit(taken);
+		return;
+	}
+
+	// n and z can be tested on the last result without writing them back
+	bool set_is_nonzero;
+	if(nz_pending && info.flag == FLAG_Z) {
+		testRI(32, RNZ, nz_wide ? 0xFFFF : 0xFF);
+		set_is_nonzero = false;
+	} else if(nz_pending && info.flag == FLAG_N) {
+		testRI(32, RNZ, nz_wide ? 0x8000 : 0x80);
+		set_is_nonzero = true;
+	} else {
+		testStatus(info.flag);
+		set_is_nonzero = true;
+	}
+	taken.jumps.push_back(jcc(info.taken_if_set == set_is_nonzero ? CC_NE : CC_E));
+
+	emitExit({{}, (byte)(stub.executed + 1), op.next, cycles, nz_pending, nz_wide});
+	emitExit(taken);
+}
+
+// writes everything back and returns the instructions executed
+void SNES_JIT::emitExit(const exit_stub& stub) {
+	for(size_t at : stub.jumps)
+		patch(at, used);
+
+	if(stub.nz_pending)
+		emitNZ(stub.nz_wide);
+	storeField(RA, &cpu->C, 16);
+	storeField(RX, &cpu->X, 16);
+	storeField(RY, &cpu->Y, 16);
+	// mov word [PC], imm16
+	prefix(16, 0, 0, RDI);
+	emit8(0xC7);
+	field(0, offset(&cpu->PC));
+	emit16(stub.pc);
+	// add qword [time], imm32
+	prefix(64, 0, 0, RDI);
+	emit8(0x81);
+	field(EXT_ADD, offset(&cpu->time));
+	emit32(stub.cycles * MASTER_CYCLES_PER_CPU_CYCLE);
+	movImm(RAX, stub.executed);
+	emit8(0xC3);
+}
+
+void SNES_JIT::emitNZ(bool wide) {
+	statusOp(EXT_AND, (byte)~(FLAG_N | FLAG_Z));
+	testRI(32, RNZ, wide ? 0xFFFF : 0xFF);
+	// jnz over the 7 byte or
+	emit8(0x75);
+	emit8(7);
+	statusOp(EXT_OR, FLAG_Z);
+	testRI(32, RNZ, wide ? 0x8000 : 0x80);
+	emit8(0x74);
+	emit8(7);
+	statusOp(EXT_OR, FLAG_N);
+}
+
+// the operand's address into ecx
+void SNES_JIT::emitAddress(const decoded_op& op, const op_info& info) {
+	if(info.operand == op_info::OPERAND_DP) {
+		// bank 0, D + offset wrapping at 16 bits
+		loadField(RCX, &cpu->D, 16);
+		aluRI(EXT_ADD, 32, RCX, (byte)op.operand);
+		movzx(RCX, RCX, 16);
+	} else {
+		loadField(RCX, &cpu->DBR, 8);
+		shift(EXT_SHL, 32, RCX, 16);
+		aluRI(EXT_OR, 32, RCX, (twobyte)op.operand);
+	}
+}
+
+// rsi = the page of ecx, eax = the offset into it. exits when there is no
+// pointer or a 16-bit access would run into the next page
+void SNES_JIT::emitPageCheck(byte* const* pages, bool wide, exit_stub& stub) {
+	aluRR(X86_MOV, 32, RDX, RCX);
+	shift(EXT_SHR, 32, RDX, MEM_PAGE_BITS);
+	movImm64(RSI, (uint64_t)pages);
+	// mov rsi, [rsi + rdx * 8]
+	emit8(0x48);
+	emit8(0x8B);
+	emit8(0x34);
+	emit8(0xD6);
+	aluRR(X86_TEST, 64, RSI, RSI);
+	stub.jumps.push_back(jcc(CC_E));
+	aluRR(X86_MOV, 32, RAX, RCX);
+	aluRI(EXT_AND, 32, RAX, MEM_PAGE_MASK);
+	if(wide) {
+		aluRI(EXT_CMP, 32, RAX, MEM_PAGE_MASK);
+		stub.jumps.push_back(jcc(CC_E));
+	}
+}
+
+// the operand into eax, and into fetched like the interpreter's addressing modes
+void SNES_JIT::emitLoad(const decoded_op& op, const op_info& info, exit_stub& stub) {
+	int size = info.mem_wide ? 16 : 8;
+	if(info.operand == op_info::OPERAND_IMM) {
+		movImm(RAX, info.mem_wide ? (twobyte)op.operand : (byte)op.operand);
+	} else {
+		emitAddress(op, info);
+		emitPageCheck(cpu->mem->getReadPages(), info.mem_wide, stub);
+		// movzx eax, byte/word [rsi + rax]
+		emit8(0x0F);
+		emit8(info.mem_wide ? 0xB7 : 0xB6);
+		emit8(0x04);
+		emit8(0x06);
+	}
+	storeField(RAX, &cpu->fetched, size);
+}
+
+// stores read the address first too
+void SNES_JIT::emitStore(const decoded_op& op, const op_info& info, exit_stub& stub) {
+	emitLoad(op, info, stub);
+	emitPageCheck(cpu->mem->getWritePages(), info.wide, stub);
+	// mov [rsi + rax], reg
+	prefix(info.wide ? 16 : 8, info.dst, RAX, RSI);
+	emit8(info.wide ? 0x89 : 0x88);
+	emit8(0x04 | ((info.dst & 7) << 3));
+	emit8(0x06);
+}
+
+// c = the low bit of reg
+void SNES_JIT::setCarry(int reg) {
+	statusOp(EXT_AND, (byte)~FLAG_C);
+	statusOr(reg);
+}
+
+//
+// x86-64 encoding
+//
+
+void SNES_JIT::prefix(int size, int reg, int index, int base) {
+	if(size == 16) emit8(0x66);
+	byte rex = 0x40 | (size == 64 ? 0x08 : 0) | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3);
+	if(rex != 0x40 || size == 8) emit8(rex);
+}
+
+void SNES_JIT::field(int reg, int32_t disp) {
+	emit8(0x80 | ((reg & 7) << 3) | RDI);
+	emit32(disp);
+}
+
+// zero extends 8 and 16-bit fields
+void SNES_JIT::loadField(int reg, const void* member, int size) {
+	prefix(size == 64 ? 64 : 32, reg, 0, RDI);
+	if(size == 8 || size == 16) {
+		emit8(0x0F);
+		emit8(size == 8 ? 0xB6 : 0xB7);
+	} else {
+		emit8(0x8B);
+	}
+	field(reg, offset(member));
+}
+
+void SNES_JIT::storeField(int reg, const void* member, int size) {
+	prefix(size, reg, 0, RDI);
+	emit8(size == 8 ? 0x88 : 0x89);
+	field(reg, offset(member));
+}
+
+void SNES_JIT::aluRR(byte op, int size, int dst, int src) {
+	prefix(size, src, 0, dst);
+	emit8(size == 8 ? op - 1 : op);
+	emit8(0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+void SNES_JIT::aluRI(byte ext, int size, int reg, uint32_t imm) {
+	prefix(size, 0, 0, reg);
+	emit8(size == 8 ? 0x80 : 0x81);
+	emit8(0xC0 | (ext << 3) | (reg & 7));
+	if(size == 8) emit8(imm);
+	else if(size == 16) emit16(imm);
+	else emit32(imm);
+}
+
+void SNES_JIT::testRI(int size, int reg, uint32_t imm) {
+	prefix(size, 0, 0, reg);
+	emit8(size == 8 ? 0xF6 : 0xF7);
+	emit8(0xC0 | (reg & 7));
+	if(size == 8) emit8(imm);
+	else if(size == 16) emit16(imm);
+	else emit32(imm);
+}
+
+// movzx dst32, src8/src16
+void SNES_JIT::movzx(int dst, int src, int size) {
+	prefix(size == 8 ? 8 : 32, dst, 0, src);
+	emit8(0x0F);
+	emit8(size == 8 ? 0xB6 : 0xB7);
+	emit8(0xC0 | ((dst & 7) << 3) | (src & 7));
+}
+
+void SNES_JIT::shift(byte ext, int size, int reg, byte count) {
+	prefix(size, 0, 0, reg);
+	emit8(size == 8 ? 0xC0 : 0xC1);
+	emit8(0xC0 | (ext << 3) | (reg & 7));
+	emit8(count);
+}
+
+void SNES_JIT::movImm(int reg, uint32_t imm) {
+	prefix(32, 0, 0, reg);
+	emit8(0xB8 | (reg & 7));
+	emit32(imm);
+}
+
+void SNES_JIT::movImm64(int reg, uint64_t imm) {
+	prefix(64, 0, 0, reg);
+	emit8(0xB8 | (reg & 7));
+	emit64(imm);
+}
+
+void SNES_JIT::setcc(byte cc, int reg) {
+	prefix(8, 0, 0, reg);
+	emit8(0x0F);
+	emit8(0x90 | cc);
+	emit8(0xC0 | (reg & 7));
+}
+
+// and/or byte [status], imm8
+void SNES_JIT::statusOp(byte ext, byte imm) {
+	emit8(0x80);
+	field(ext, offset(&cpu->status.full));
+	emit8(imm);
+}
+
+// or byte [status], reg8
+void SNES_JIT::statusOr(int reg) {
+	prefix(8, reg, 0, RDI);
+	emit8(0x08);
+	field(reg, offset(&cpu->status.full));
+}
+
+void SNES_JIT::testStatus(byte imm) {
+	emit8(0xF6);
+	field(0, offset(&cpu->status.full));
+	emit8(imm);
+}
+
+// rel32 jump, patched once the target is known
+size_t SNES_JIT::jcc(byte cc) {
+	emit8(0x0F);
+	emit8(0x80 | cc);
+	emit32(0);
+	return used - 4;
+}
+
+void SNES_JIT::patch(size_t at, size_t target) {
+	uint32_t rel = (uint32_t)(target - (at + 4));
+	for(int i = 0; i < 4; i++)
+		code[at + i] = rel >> (i * 8);
+}
@@ -0,0 +1,140 @@
+#ifndef _JIT_H
+#define _JIT_H
+
+#include "common.h"
+#include "cpu.hpp"
+
+#include <vector>
+
+// room for generated code, everything is dropped when it fills up
+#define JIT_CODE_SIZE		(8 * 1024 * 1024)
+// interpreted runs of a block before it is compiled
+#define JIT_THRESHOLD		16
+
+// compiles cached 65816 blocks to x86-64. only the common load/store/ALU,
+// transfer and branch instructions with immediate, direct page and absolute
+// operands are translated, a block is compiled up to its first instruction
+// outside that set and the interpreter carries on from there.
+//
+// the generated code keeps C, X and Y in host registers. carry and overflow
+// are written to the status register as they are computed, n and z are only
+// worked out from the last result when the code exits or branches on them.
+// memory goes through the cpu's page tables: a page without a pointer (MMIO,
+// or a watched code page on the write side) exits before the instruction
+// touching it, which then runs in the interpreter.
+//
+// the code buffer is never writable and executable at once: it is mapped
+// read/execute, and the pages a block is emitted into are made writable for
+// as long as it takes to compile it
+class SNES_JIT {
+public:
+	SNES_JIT();
+	~SNES_JIT();
+
+	// x86-64 hosts only
+	static bool supported();
+	// false when the host wouldn't give it executable memory
+	bool ready() {return code != nullptr;};
+
+	// fills in block's native code, false when the code buffer is full
+	bool compile(SNES_CPU* cpu, SNES_CPU::code_block& block);
+	// drops all generated code
+	void reset() {used = 0;};
+private:
+	typedef SNES_CPU::decoded_op decoded_op;
+
+	enum op_kind {
+		JIT_NONE,
+		JIT_LOAD, JIT_STORE,
+		JIT_AND, JIT_ORA, JIT_EOR, JIT_ADC, JIT_SBC,
+		JIT_COMPARE,
+		JIT_INC, JIT_DEC,
+		JIT_TRANSFER,
+		JIT_ASL, JIT_LSR,
+		JIT_CLC, JIT_SEC, JIT_CLV, JIT_NOP,
+		JIT_BRANCH, JIT_JMP
+	};
+
+	// what one decoded instruction turns into
+	struct op_info {
+		op_kind kind = JIT_NONE;
+		// host registers, dst is also the register compared or stored
+		int src = 0, dst = 0;
+		bool wide = false;
+		// memory operand: none, direct page or absolute, and its width
+		enum {OPERAND_IMM, OPERAND_DP, OPERAND_ABS} operand = OPERAND_IMM;
+		bool mem_wide = false;
+		// branches: the status bit tested and the value that takes it
+		byte flag = 0;
+		bool taken_if_set = false;
+	};
+	op_info classify(const decoded_op& op);
+
+	// where the code for one instruction exits, with what it knows at that point
+	struct exit_stub {
+		std::vector<size_t> jumps;
+		byte executed;
+		twobyte pc;
+		uint32_t cycles;
+		bool nz_pending;
+		bool nz_wide;
+	};
+
+	// the block being compiled
+	SNES_CPU* cpu;
+	bool nz_pending;
+	bool nz_wide;
+
+	// the native code for block at used, false if none of it compiles
+	bool emitBlock(SNES_CPU* cpu, SNES_CPU::code_block& block);
+	// flips the pages under [from, to) of the buffer between writable and executable
+	bool protect(size_t from, size_t to, bool writable);
+
+	void emitInstruction(const decoded_op& op, const op_info& info, exit_stub& stub);
+	void emitBranch(const decoded_op& op, const op_info& info, const exit_stub& stub, uint32_t op_cycles);
+	void emitExit(const exit_stub& stub);
+	void emitNZ(bool wide);
+	// the operand into eax, exiting through stub if memory needs the interpreter
+	void emitAddress(const decoded_op& op, const op_info& info);
+	void emitPageCheck(byte* const* pages, bool wide, exit_stub& stub);
+	void emitLoad(const decoded_op& op, const op_info& info, exit_stub& stub);
+	void emitStore(const decoded_op& op, const op_info& info, exit_stub& stub);
+	void setCarry(int reg);
+
+	//
+	// x86-64 encoding
+	//
+
+	void emit8(byte value) {code[used++] = value;};
+	void emit16(twobyte value) {emit8(value); emit8(value >> 8);};
+	void emit32(uint32_t value) {emit16(value); emit16(value >> 16);};
+	void emit64(uint64_t value) {emit32(value); emit32(value >> 32);};
+
+	// operand size prefix and REX for an instruction with the given register
+	// fields, 8-bit operations always get a REX so 4-7 are sil/dil and not ah-bh
+	void prefix(int size, int reg, int index, int base);
+	// reg, [rdi + field]
+	void field(int reg, int32_t disp);
+	int32_t offset(const void* member) {return (int32_t)((const byte*)member - (const byte*)cpu);};
+
+	void loadField(int reg, const void* member, int size);
+	void storeField(int reg, const void* member, int size);
+	void aluRR(byte op, int size, int dst, int src);
+	void aluRI(byte ext, int size, int reg, uint32_t imm);
+	void testRI(int size, int reg, uint32_t imm);
+	void movzx(int dst, int src, int size);
+	void shift(byte ext, int size, int reg, byte count);
+	void movImm(int reg, uint32_t imm);
+	void movImm64(int reg, uint64_t imm);
+	void setcc(byte cc, int reg);
+	void statusOp(byte ext, byte imm);
+	void statusOr(int reg);
+	void testStatus(byte imm);
+	size_t jcc(byte cc);
+	void patch(size_t at, size_t target);
+
+	byte* code = nullptr;
+	size_t used = 0;
+};
+
+#endif //_JIT_H
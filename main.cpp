@@ -0,0 +1,84 @@
+#include "common.h"
+
+#include "snes.hpp"
+#include "batch.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char** argv) {
+	// --cpu=interp|jit picks how the 65816 runs, --batch=manifest runs the
+	// ROMs listed there on --threads=n threads (all cores by default)
+	bool jit = false;
+	const char* manifest = nullptr;
+	int threads = 0;
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--cpu=interp") {
+			jit = false;
+		} else if(arg == "--cpu=jit") {
+			jit = true;
+		} else if(arg.compare(0, 8, "--batch=") == 0) {
+			manifest = argv[i] + 8;
+		} else if(arg.compare(0, 10, "--threads=") == 0) {
+			threads = atoi(argv[i] + 10);
+		} else {
+			std::cout << "usage: " << argv[0] << " [--cpu=interp|jit] [--batch=manifest [--threads=n]]" << std::endl;
+			return 1;
+		}
+	}
+
+	if(manifest) {
+		std::ifstream file(manifest);
+		SNES_BATCH batch;
+		if(!file || !batch.load(file, std::cerr)) {
+			std::cerr << "could not read batch manifest " << manifest << std::endl;
+			return 1;
+		}
+		batch.run(threads, jit, std::cout);
+		return 0;
+	}
+
+	SNES s;
+	if(jit && !s.setJIT(true))
+		std::cout << "no jit for this host, interpreting" << std::endl;
+
+	std::cout << "running it!" << std::endl;
+	std::string filename;
+	std::cin >> filename;
+	std::cout << "reading ROM file: " << filename << std::endl;
+	bool ready = s.loadROM(filename);
+	std::cout << "finished reading file" << std::endl;
+
+	// SNES_APU_THREAD=1 runs the apu on a second core
+	const char* apu_thread = getenv("SNES_APU_THREAD");
+	if(apu_thread && atoi(apu_thread))
+		s.setThreadedAPU(true);
+	// SNES_PPU_THREADS=n draws the picture on n worker threads
+	const char* ppu_threads = getenv("SNES_PPU_THREADS");
+	if(ppu_threads)
+		s.setPPUThreads(atoi(ppu_threads));
+	// e.g. SNES_TRACE=cpu=1,mem=2, decoded afterwards with tracefmt
+	const char* trace_spec = getenv("SNES_TRACE");
+	if(trace_spec) {
+		const char* trace_file = getenv("SNES_TRACE_FILE");
+		s.startTrace(trace_spec, trace_file ? trace_file : "snes.trace");
+	}
+	// SNES_PROFILE=file prints a profile at the end and writes the sampled
+	// call stacks to file, for flamegraph.pl
+	const char* profile_file = getenv("SNES_PROFILE");
+	if(profile_file)
+		s.startProfile();
+
+	// same budget as the old 10000 cpu clocks
+	if(ready) s.run(10000 * MASTER_CYCLES_PER_CPU_CYCLE);
+	std::cout << "completed execution!" << std::endl;
+	if(profile_file) {
+		std::ofstream folded(profile_file);
+		s.writeProfile(std::cout, &folded);
+	}
+	
+	return 0;
+}
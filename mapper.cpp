@@ -0,0 +1,200 @@
+#include "common.h"
+
+#include "mapper.hpp"
+#include "ram.hpp"
+
+#include <iostream>
+
+// header candidates, as offsets into the ROM image
+#define LOROM_HEADER		0x007FC0
+#define HIROM_HEADER		0x00FFC0
+#define EXHIROM_HEADER		0x40FFC0
+
+static SNES_CART_HEADER readHeader(const byte* rom, size_t offset) {
+	const byte* h = rom + offset;
+	SNES_CART_HEADER header;
+
+	for(int i = 0; i < 21 && h[i] >= 0x20 && h[i] < 0x7F; i++)
+		header.title += (char)h[i];
+	while(!header.title.empty() && header.title.back() == ' ')
+		header.title.pop_back();
+
+	header.map_mode = h[0x15];
+	header.chipset = h[0x16];
+	header.rom_size = h[0x17];
+	header.sram_size = h[0x18];
+	header.checksum_complement = h[0x1C] | (h[0x1D] << 8);
+	header.checksum = h[0x1E] | (h[0x1F] << 8);
+	header.reset_vector = h[0x3C] | (h[0x3D] << 8);
+	return header;
+}
+
+// rates how plausible it is that a real header lives at offset.
+// bank_size is 0x8000 for loROM layouts and 0x10000 for hiROM layouts
+static int scoreHeader(const byte* rom, size_t size, size_t offset, size_t bank_size, byte mode_nybble) {
+	if(offset + 0x40 > size) return -1;
+
+	const byte* h = rom + offset;
+	SNES_CART_HEADER header = readHeader(rom, offset);
+	int score = 0;
+
+	// map mode is 001smmmm, with mmmm identifying the layout
+	if((header.map_mode & 0xE0) == 0x20) {
+		byte mode = header.map_mode & 0x0F;
+		if(mode == mode_nybble || (mode_nybble == 0x0 && (mode == 0x2 || mode == 0x3)))
+			score += 2;
+	}
+
+	if((twobyte)(header.checksum + header.checksum_complement) == 0xFFFF)
+		score += 4;
+
+	if(header.rom_size >= 0x07 && header.rom_size <= 0x0D)
+		score += 1;
+
+	bool printable = true;
+	for(int i = 0; i < 21; i++)
+		printable &= (h[i] >= 0x20 && h[i] < 0x7F);
+	if(printable)
+		score += 1;
+
+	// the reset vector has to point at ROM, and usually lands on a typical first instruction
+	if(header.reset_vector < 0x8000) {
+		score -= 4;
+	} else {
+		size_t reset_offset = (offset & ~(bank_size - 1)) + (header.reset_vector & (bank_size - 1));
+		if(reset_offset < size) {
+			switch(rom[reset_offset]) {
+				case 0x78:	// SEI
+				case 0x18:	// CLC
+				case 0x38:	// SEC
+				case 0x9C:	// STZ abs
+				case 0x4C:	// JMP abs
+				case 0x5C:	// JML long
+				case 0xC2:	// REP
+				case 0xE2:	// SEP
+					score += 2;
+					break;
+				case 0x00:	// BRK
+				case 0xFF:	// SBC long,X
+					score -= 2;
+					break;
+			}
+		}
+	}
+
+	return score;
+}
+
+size_t SNES_MAPPER::copierHeaderSize(size_t file_size) {
+	return (file_size % 1024) == 512 ? 512 : 0;
+}
+
+size_t SNES_MAPPER::sramSize() {
+	if(header.sram_size == 0 || header.sram_size > 0x08) return 0;
+	return 1024 << header.sram_size;
+}
+
+SNES_MAPPER* SNES_MAPPER::detect(const byte* rom, size_t size) {
+	int lo = scoreHeader(rom, size, LOROM_HEADER, 0x8000, 0x0);
+	int hi = scoreHeader(rom, size, HIROM_HEADER, 0x10000, 0x1);
+	int exhi = scoreHeader(rom, size, EXHIROM_HEADER, 0x10000, 0x5);
+
+	// nothing that looks like a header: treat it as a bare loROM image
+	if(lo <= 0 && hi <= 0 && exhi <= 0) {
+		SNES_CART_HEADER header = {};
+		return new MAPPER_LOROM(header);
+	}
+
+	if(exhi > lo && exhi > hi)
+		return new MAPPER_EXHIROM(readHeader(rom, EXHIROM_HEADER));
+
+	if(hi > lo)
+		return new MAPPER_HIROM(readHeader(rom, HIROM_HEADER));
+
+	SNES_CART_HEADER header = readHeader(rom, LOROM_HEADER);
+	if(header.map_mode == 0x23 || header.chipset == 0x34 || header.chipset == 0x35)
+		return new MAPPER_SA1(header);
+	if(header.chipset == 0x13 || header.chipset == 0x14 || header.chipset == 0x15 || header.chipset == 0x1A)
+		return new MAPPER_SUPERFX(header);
+	return new MAPPER_LOROM(header);
+}
+
+//
+// mappers
+//
+
+void MAPPER_LOROM::map(SNES_MEMORY& mem) {
+	// 32 KB of ROM in the upper half of every bank, mirrored at 80-FF
+	mem.mapROM(0x00, 0x7D, 0x8000, 0xFFFF, 0x000000, 0x8000);
+	mem.mapROM(0x80, 0xFF, 0x8000, 0xFFFF, 0x000000, 0x8000);
+
+	// the lower half of banks 40-6F mirrors the upper half
+	mem.mapROM(0x40, 0x6F, 0x0000, 0x7FFF, 0x40 * 0x8000, 0x8000);
+	mem.mapROM(0xC0, 0xEF, 0x0000, 0x7FFF, 0x40 * 0x8000, 0x8000);
+
+	if(sramSize()) {
+		mem.mapSRAM(0x70, 0x7D, 0x0000, 0x7FFF, 0, 0x8000);
+		mem.mapSRAM(0xF0, 0xFF, 0x0000, 0x7FFF, 0, 0x8000);
+	}
+}
+
+void MAPPER_HIROM::map(SNES_MEMORY& mem) {
+	// 64 KB of ROM per bank at C0-FF, mirrored at 40-7D
+	mem.mapROM(0xC0, 0xFF, 0x0000, 0xFFFF, 0x000000, 0x10000);
+	mem.mapROM(0x40, 0x7D, 0x0000, 0xFFFF, 0x000000, 0x10000);
+
+	// the system banks only see the upper half of each ROM bank
+	mem.mapROM(0x00, 0x3F, 0x8000, 0xFFFF, 0x008000, 0x10000);
+	mem.mapROM(0x80, 0xBF, 0x8000, 0xFFFF, 0x008000, 0x10000);
+
+	if(sramSize()) {
+		mem.mapSRAM(0x20, 0x3F, 0x6000, 0x7FFF, 0, 0x2000);
+		mem.mapSRAM(0xA0, 0xBF, 0x6000, 0x7FFF, 0, 0x2000);
+	}
+}
+
+void MAPPER_EXHIROM::map(SNES_MEMORY& mem) {
+	// first 4 MB at C0-FF (and the upper halves of 80-BF),
+	// the rest at 40-7D (and the upper halves of 00-3F)
+	mem.mapROM(0xC0, 0xFF, 0x0000, 0xFFFF, 0x000000, 0x10000);
+	mem.mapROM(0x80, 0xBF, 0x8000, 0xFFFF, 0x008000, 0x10000);
+	mem.mapROM(0x40, 0x7D, 0x0000, 0xFFFF, 0x400000, 0x10000);
+	mem.mapROM(0x00, 0x3F, 0x8000, 0xFFFF, 0x408000, 0x10000);
+
+	if(sramSize()) {
+		mem.mapSRAM(0x80, 0xBF, 0x6000, 0x7FFF, 0, 0x2000);
+	}
+}
+
+void MAPPER_SA1::map(SNES_MEMORY& mem) {
+	*mem.log << "mapper: SA-1 coprocessor is not emulated, mapping ROM only" << std::endl;
+
+	// default super MMC layout: 1 MB blocks at 00-1F, 20-3F, 80-9F, A0-BF
+	// and the whole ROM linearly at C0-FF
+	mem.mapROM(0x00, 0x3F, 0x8000, 0xFFFF, 0x000000, 0x8000);
+	mem.mapROM(0x80, 0xBF, 0x8000, 0xFFFF, 0x200000, 0x8000);
+	mem.mapROM(0xC0, 0xFF, 0x0000, 0xFFFF, 0x000000, 0x10000);
+
+	// BW-RAM
+	if(sramSize()) {
+		mem.mapSRAM(0x40, 0x4F, 0x0000, 0xFFFF, 0, 0x10000);
+		mem.mapSRAM(0x00, 0x3F, 0x6000, 0x7FFF, 0, 0);
+		mem.mapSRAM(0x80, 0xBF, 0x6000, 0x7FFF, 0, 0);
+	}
+}
+
+void MAPPER_SUPERFX::map(SNES_MEMORY& mem) {
+	*mem.log << "mapper: SuperFX coprocessor is not emulated, mapping ROM only" << std::endl;
+
+	mem.mapROM(0x00, 0x3F, 0x8000, 0xFFFF, 0x000000, 0x8000);
+	mem.mapROM(0x80, 0xBF, 0x8000, 0xFFFF, 0x000000, 0x8000);
+	mem.mapROM(0x40, 0x5F, 0x0000, 0xFFFF, 0x000000, 0x10000);
+	mem.mapROM(0xC0, 0xDF, 0x0000, 0xFFFF, 0x000000, 0x10000);
+
+	// game pak RAM
+	if(sramSize()) {
+		mem.mapSRAM(0x70, 0x71, 0x0000, 0xFFFF, 0, 0x10000);
+		mem.mapSRAM(0x00, 0x3F, 0x6000, 0x7FFF, 0, 0);
+		mem.mapSRAM(0x80, 0xBF, 0x6000, 0x7FFF, 0, 0);
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef _MAPPER_H
+#define _MAPPER_H
+
+#include "common.h"
+
+#include <string>
+
+class SNES_MEMORY;
+
+// internal cartridge header, found at $FFC0 in the mapped address space
+struct SNES_CART_HEADER {
+	std::string title;
+	byte map_mode;
+	byte chipset;
+	byte rom_size;
+	byte sram_size;
+	twobyte checksum;
+	twobyte checksum_complement;
+	twobyte reset_vector;
+};
+
+// a mapper decides where cartridge ROM and SRAM appear in the 24-bit
+// address space. it runs once at ROM load and writes host pointers straight
+// into SNES_MEMORY's page tables, so the choice of mapper costs nothing per access
+class SNES_MAPPER {
+public:
+	SNES_MAPPER(const SNES_CART_HEADER& header) : header(header) {};
+	virtual ~SNES_MAPPER() {};
+
+	virtual const char* name() = 0;
+	virtual void map(SNES_MEMORY& mem) = 0;
+
+	size_t sramSize();
+	const SNES_CART_HEADER& getHeader() {return header;};
+
+	// scores the candidate header locations and builds the best-matching mapper.
+	// rom must already have any copier header stripped
+	static SNES_MAPPER* detect(const byte* rom, size_t size);
+
+	// size of the copier (SMC/SWC) header in front of the ROM image, if any
+	static size_t copierHeaderSize(size_t file_size);
+protected:
+	SNES_CART_HEADER header;
+};
+
+class MAPPER_LOROM : public SNES_MAPPER {
+public:
+	using SNES_MAPPER::SNES_MAPPER;
+	const char* name() {return "LoROM";};
+	void map(SNES_MEMORY& mem);
+};
+
+class MAPPER_HIROM : public SNES_MAPPER {
+public:
+	using SNES_MAPPER::SNES_MAPPER;
+	const char* name() {return "HiROM";};
+	void map(SNES_MEMORY& mem);
+};
+
+class MAPPER_EXHIROM : public SNES_MAPPER {
+public:
+	using SNES_MAPPER::SNES_MAPPER;
+	const char* name() {return "ExHiROM";};
+	void map(SNES_MEMORY& mem);
+};
+
+// coprocessor boards: only the plain ROM/SRAM layout is mapped for now,
+// the coprocessors themselves are not emulated
+class MAPPER_SA1 : public SNES_MAPPER {
+public:
+	using SNES_MAPPER::SNES_MAPPER;
+	const char* name() {return "SA-1 (stub)";};
+	void map(SNES_MEMORY& mem);
+};
+
+class MAPPER_SUPERFX : public SNES_MAPPER {
+public:
+	using SNES_MAPPER::SNES_MAPPER;
+	const char* name() {return "SuperFX (stub)";};
+	void map(SNES_MEMORY& mem);
+};
+
+#endif //_MAPPER_H
@@ -0,0 +1,1152 @@
+#include "ppu.hpp"
+#include "state.hpp"
+#include "dma.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PPU_X86
+#endif
+
+// one bitplane byte spread over 8 pixels, leftmost pixel (bit 7) in the lowest byte
+static std::array<uint64_t, 256> buildPlaneTable() {
+    std::array<uint64_t, 256> table;
+    for(int value = 0; value < 256; value++) {
+        uint64_t row = 0;
+        for(int x = 0; x < 8; x++) {
+            if(value & (0x80 >> x)) row |= (uint64_t)1 << (x * 8);
+        }
+        table[value] = row;
+    }
+    return table;
+}
+
+static const std::array<uint64_t, 256> plane_table = buildPlaneTable();
+
+// small and large sprite sizes for each OBSEL setting: width, height
+static const byte obj_sizes[8][2][2] = {
+    {{8, 8}, {16, 16}}, {{8, 8}, {32, 32}}, {{8, 8}, {64, 64}}, {{16, 16}, {32, 32}},
+    {{16, 16}, {64, 64}}, {{32, 32}, {64, 64}}, {{16, 32}, {32, 64}}, {{16, 32}, {32, 32}}
+};
+
+static inline int sext13(int value) {
+    return (value & 0x1000) ? (value | ~0x1FFF) : (value & 0x1FFF);
+}
+
+struct PPU_POOL {
+    std::vector<std::unique_ptr<SNES_PPU>> renderers;
+    std::vector<std::thread> threads;
+
+    std::mutex lock;
+    std::condition_variable start;
+    std::condition_variable done;
+    // the log being replayed, and the line it ends on
+    std::vector<PPU_COMMAND> batch;
+    twobyte batch_end = 0;
+    uint64_t batch_id = 0;
+    // workers still replaying the current batch
+    size_t busy = 0;
+    bool quit = false;
+};
+
+SNES_PPU::SNES_PPU() {
+    output = framebuffer.data();
+
+    const int bpps[3] = {2, 4, 8};
+    for(int depth = 0; depth < 3; depth++) {
+        size_t count = 0x8000 >> (3 + depth);
+        tiles[depth].bpp = bpps[depth];
+        tiles[depth].pixels.assign(count * 64, 0);
+        tiles[depth].dirty.assign(count, 1);
+    }
+
+    simd = supportsSIMD();
+    reset();
+}
+
+SNES_PPU::~SNES_PPU() {
+    setThreads(0);
+}
+
+void SNES_PPU::reset() {
+    // the workers start over from the new state
+    int threads = getThreads();
+    setThreads(0);
+
+    time = 0;
+    line = 0;
+    line_start = 0;
+    frame = 0;
+    overscan = false;
+
+    vram.fill(0);
+    cgram.fill(0);
+    oam.fill(0);
+    framebuffer.fill(0);
+    for(TILE_CACHE& cache : tiles)
+        std::fill(cache.dirty.begin(), cache.dirty.end(), 1);
+
+    inidisp = 0x80;
+    obsel = 0;
+    oam_addr = oam_reload = 0;
+    oam_latch = 0;
+    oam_priority = false;
+    bgmode = 0;
+    mosaic = 0;
+    memset(bgsc, 0, sizeof(bgsc));
+    memset(bgnba, 0, sizeof(bgnba));
+    memset(hofs, 0, sizeof(hofs));
+    memset(vofs, 0, sizeof(vofs));
+    ofs_latch = hofs_latch = 0;
+    vmain = 0;
+    vram_addr = 0;
+    vram_latch = 0;
+    m7sel = 0;
+    m7a = m7b = m7c = m7d = m7x = m7y = 0;
+    m7hofs = m7vofs = 0;
+    m7_latch = 0;
+    mpy_b = 0;
+    cgram_addr = 0;
+    cgram_latch = 0;
+    w12sel = w34sel = wobjsel = 0;
+    wh0 = wh1 = wh2 = wh3 = 0;
+    wbglog = wobjlog = 0;
+    tm = ts = tmw = tsw = 0;
+    cgwsel = cgadsub = 0;
+    fixed_color = 0;
+    setini = 0;
+
+    stat77 = 0;
+    counter_latched = false;
+    hcounter = vcounter = 0;
+    hcounter_high = vcounter_high = false;
+    nmi_flag = false;
+    open_bus = 0;
+
+    setThreads(threads);
+}
+
+bool SNES_PPU::supportsSIMD() {
+#ifdef PPU_X86
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+
+bool SNES_PPU::setSIMD(bool simd) {
+    if(simd && !supportsSIMD()) return false;
+    this->simd = simd;
+    if(pool) {
+        finish();
+        for(auto& renderer : pool->renderers)
+            renderer->simd = simd;
+    }
+    return true;
+}
+
+void SNES_PPU::serialize(SNES_STATE& state) {
+    if(!state.begin(STATE_TAG('P', 'P', 'U', ' '), 1)) return;
+
+    // the workers copy the loaded state when they start again
+    int threads = 0;
+    if(state.loading()) {
+        threads = getThreads();
+        setThreads(0);
+    }
+
+    state.value(time);
+    state.value(line);
+    state.value(line_start);
+    state.value(frame);
+    state.value(overscan);
+
+    state.value(vram);
+    state.value(cgram);
+    state.value(oam);
+
+    state.value(inidisp);
+    state.value(obsel);
+    state.value(oam_addr); state.value(oam_reload);
+    state.value(oam_latch);
+    state.value(oam_priority);
+    state.value(bgmode);
+    state.value(mosaic);
+    state.value(bgsc);
+    state.value(bgnba);
+    state.value(hofs); state.value(vofs);
+    state.value(ofs_latch); state.value(hofs_latch);
+    state.value(vmain);
+    state.value(vram_addr);
+    state.value(vram_latch);
+    state.value(m7sel);
+    state.value(m7a); state.value(m7b); state.value(m7c); state.value(m7d); state.value(m7x); state.value(m7y);
+    state.value(m7hofs); state.value(m7vofs);
+    state.value(m7_latch);
+    state.value(mpy_b);
+    state.value(cgram_addr);
+    state.value(cgram_latch);
+    state.value(w12sel); state.value(w34sel); state.value(wobjsel);
+    state.value(wh0); state.value(wh1); state.value(wh2); state.value(wh3);
+    state.value(wbglog); state.value(wobjlog);
+    state.value(tm); state.value(ts); state.value(tmw); state.value(tsw);
+    state.value(cgwsel); state.value(cgadsub);
+    state.value(fixed_color);
+    state.value(setini);
+
+    state.value(stat77);
+    state.value(counter_latched);
+    state.value(hcounter); state.value(vcounter);
+    state.value(hcounter_high); state.value(vcounter_high);
+    state.value(nmi_flag);
+    state.value(open_bus);
+    state.end();
+
+    if(state.loading()) {
+        for(TILE_CACHE& cache : tiles)
+            std::fill(cache.dirty.begin(), cache.dirty.end(), 1);
+        setThreads(threads);
+    }
+}
+
+//
+// render workers
+//
+
+int SNES_PPU::getThreads() {
+    return pool ? pool->renderers.size() : 0;
+}
+
+void SNES_PPU::setThreads(int threads) {
+    if(pool) {
+        // the workers catch up to now, then this side draws again
+        submit();
+        finish();
+        {
+            std::lock_guard<std::mutex> guard(pool->lock);
+            pool->quit = true;
+        }
+        pool->start.notify_all();
+        for(std::thread& thread : pool->threads)
+            thread.join();
+        pool.reset();
+    }
+    band_first = 1;
+    band_last = PPU_MAX_HEIGHT;
+    if(threads <= 0) return;
+
+    pool = std::make_shared<PPU_POOL>();
+    for(int i = 0; i < threads; i++) {
+        SNES_PPU* renderer = new SNES_PPU(*this);
+        renderer->pool.reset();
+        renderer->clock = nullptr;
+        renderer->dma = nullptr;
+        renderer->output = framebuffer.data();
+        // bands split the usual 224 lines, the last one takes overscan too
+        renderer->band_first = 1 + i * PPU_HEIGHT / threads;
+        renderer->band_last = i == threads - 1 ? PPU_MAX_HEIGHT : (i + 1) * PPU_HEIGHT / threads;
+        pool->renderers.emplace_back(renderer);
+    }
+    for(auto& renderer : pool->renderers)
+        pool->threads.emplace_back(workerLoop, pool.get(), renderer.get());
+
+    band_last = 0;
+}
+
+void SNES_PPU::submit() {
+    std::unique_lock<std::mutex> guard(pool->lock);
+    pool->done.wait(guard, [this] {return pool->busy == 0;});
+    pool->batch.swap(commands);
+    commands.clear();
+    pool->batch_end = line;
+    pool->busy = pool->renderers.size();
+    pool->batch_id++;
+    pool->start.notify_all();
+}
+
+void SNES_PPU::finish() {
+    if(!pool) return;
+    std::unique_lock<std::mutex> guard(pool->lock);
+    pool->done.wait(guard, [this] {return pool->busy == 0;});
+}
+
+void SNES_PPU::replay(const std::vector<PPU_COMMAND>& batch, twobyte end_line) {
+    for(const PPU_COMMAND& command : batch) {
+        while(line != command.line) startLine();
+        if(command.reg < 0x34) {
+            write(0x2100 | command.reg, command.data);
+        } else {
+            read(0x2100 | command.reg);
+        }
+    }
+    while(line != end_line) startLine();
+}
+
+void SNES_PPU::workerLoop(PPU_POOL* pool, SNES_PPU* renderer) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> guard(pool->lock);
+    while(true) {
+        pool->start.wait(guard, [&] {return pool->quit || pool->batch_id != seen;});
+        if(pool->quit) return;
+        seen = pool->batch_id;
+        twobyte end_line = pool->batch_end;
+
+        // the batch stays put until every worker is done with it
+        guard.unlock();
+        renderer->replay(pool->batch, end_line);
+        guard.lock();
+
+        if(--pool->busy == 0) pool->done.notify_all();
+    }
+}
+
+bool SNES_PPU::runUntil(uint64_t target) {
+    if(running) return true;
+    running = true;
+    while(line_start + PPU_CYCLES_PER_LINE <= target) {
+        line_start += PPU_CYCLES_PER_LINE;
+        startLine();
+    }
+    if(target > time) time = target;
+    running = false;
+    return true;
+}
+
+void SNES_PPU::startLine() {
+    // hdma runs in the hblank at the end of the line before, so its writes
+    // are logged on that line and show up on the next
+    if(dma && line <= getHeight()) dma->hblank();
+
+    if(++line == PPU_LINES_PER_FRAME) {
+        line = 0;
+        frame++;
+        // end of vblank
+        nmi_flag = false;
+        stat77 &= ~0xC0;
+        overscan = setini & 0x04;
+        if(dma) dma->frameStart();
+        return;
+    }
+
+    int height = getHeight();
+    if(line <= height) {
+        if(line >= band_first && line <= band_last) renderLine(line);
+    } else if(line == height + 1) {
+        nmi_flag = true;
+        if(!(inidisp & 0x80)) oam_addr = oam_reload;
+        // the frame's lines are all logged
+        if(pool) submit();
+    }
+}
+
+//
+// registers
+//
+
+twobyte SNES_PPU::vramAddress() {
+    twobyte addr = vram_addr;
+    switch((vmain >> 2) & 3) {
+        case 1: addr = (addr & 0xFF00) | ((addr & 0x001F) << 3) | ((addr >> 5) & 7); break;
+        case 2: addr = (addr & 0xFE00) | ((addr & 0x003F) << 3) | ((addr >> 6) & 7); break;
+        case 3: addr = (addr & 0xFC00) | ((addr & 0x007F) << 3) | ((addr >> 7) & 7); break;
+    }
+    return addr & 0x7FFF;
+}
+
+void SNES_PPU::vramStep(bool high) {
+    static const twobyte increments[4] = {1, 32, 128, 128};
+    if(high == (bool)(vmain & 0x80))
+        vram_addr += increments[vmain & 3];
+}
+
+void SNES_PPU::writeVRAM(twobyte addr, twobyte value) {
+    vram[addr] = value;
+    tiles[0].dirty[addr >> 3] = 1;
+    tiles[1].dirty[addr >> 4] = 1;
+    tiles[2].dirty[addr >> 5] = 1;
+}
+
+void SNES_PPU::writeVRAMBlock(const byte* data, size_t size) {
+    // whole words only when the address moves on after the high byte and
+    // isn't remapped, and the workers need every write logged
+    if(pool || (vmain & 0x8C) != 0x80) {
+        for(size_t i = 0; i < size; i++)
+            write(0x2118 | (i & 1), data[i]);
+        return;
+    }
+
+    sync();
+    size_t i = 0;
+    for(; i + 1 < size; i += 2) {
+        writeVRAM(vram_addr & 0x7FFF, data[i] | (data[i + 1] << 8));
+        vramStep(true);
+    }
+    if(i < size) write(0x2118, data[i]);
+}
+
+void SNES_PPU::write(twobyte reg, byte data) {
+    sync();
+    if(pool && (reg & 0xFF) < 0x34) commands.push_back({line, (byte)reg, data});
+
+    switch(reg & 0xFF) {
+        case 0x00: inidisp = data; break;
+        case 0x01: obsel = data; break;
+        case 0x02:
+            oam_reload = (oam_reload & 0x200) | (data << 1);
+            oam_addr = oam_reload;
+            break;
+        case 0x03:
+            oam_reload = ((data & 0x01) << 9) | (oam_reload & 0x1FE);
+            oam_priority = data & 0x80;
+            oam_addr = oam_reload;
+            break;
+        case 0x04:
+            // the low table is written a word at a time
+            if(oam_addr < 0x200) {
+                if(!(oam_addr & 1)) {
+                    oam_latch = data;
+                } else {
+                    oam[oam_addr - 1] = oam_latch;
+                    oam[oam_addr] = data;
+                }
+            } else {
+                oam[0x200 | (oam_addr & 0x1F)] = data;
+            }
+            oam_addr = (oam_addr + 1) & 0x3FF;
+            break;
+        case 0x05: bgmode = data; break;
+        case 0x06: mosaic = data; break;
+        case 0x07: case 0x08: case 0x09: case 0x0A:
+            bgsc[(reg & 0xFF) - 0x07] = data;
+            break;
+        case 0x0B: bgnba[0] = data; break;
+        case 0x0C: bgnba[1] = data; break;
+        case 0x0D:
+            m7hofs = (data << 8) | m7_latch;
+            m7_latch = data;
+            // fall through
+        case 0x0F: case 0x11: case 0x13: {
+            int bg = ((reg & 0xFF) - 0x0D) >> 1;
+            hofs[bg] = ((data << 8) | (ofs_latch & ~7) | (hofs_latch & 7)) & 0x3FF;
+            ofs_latch = hofs_latch = data;
+            break;
+        }
+        case 0x0E:
+            m7vofs = (data << 8) | m7_latch;
+            m7_latch = data;
+            // fall through
+        case 0x10: case 0x12: case 0x14: {
+            int bg = ((reg & 0xFF) - 0x0E) >> 1;
+            vofs[bg] = ((data << 8) | ofs_latch) & 0x3FF;
+            ofs_latch = data;
+            break;
+        }
+        case 0x15: vmain = data; break;
+        case 0x16:
+            vram_addr = (vram_addr & 0xFF00) | data;
+            vram_latch = vram[vramAddress()];
+            break;
+        case 0x17:
+            vram_addr = (vram_addr & 0x00FF) | (data << 8);
+            vram_latch = vram[vramAddress()];
+            break;
+        case 0x18: {
+            twobyte addr = vramAddress();
+            writeVRAM(addr, (vram[addr] & 0xFF00) | data);
+            vramStep(false);
+            break;
+        }
+        case 0x19: {
+            twobyte addr = vramAddress();
+            writeVRAM(addr, (vram[addr] & 0x00FF) | (data << 8));
+            vramStep(true);
+            break;
+        }
+        case 0x1A: m7sel = data; break;
+        case 0x1B: m7a = (data << 8) | m7_latch; m7_latch = data; break;
+        case 0x1C: m7b = (data << 8) | m7_latch; m7_latch = data; mpy_b = data; break;
+        case 0x1D: m7c = (data << 8) | m7_latch; m7_latch = data; break;
+        case 0x1E: m7d = (data << 8) | m7_latch; m7_latch = data; break;
+        case 0x1F: m7x = sext13((data << 8) | m7_latch); m7_latch = data; break;
+        case 0x20: m7y = sext13((data << 8) | m7_latch); m7_latch = data; break;
+        case 0x21: cgram_addr = data << 1; break;
+        case 0x22:
+            if(!(cgram_addr & 1)) {
+                cgram_latch = data;
+            } else {
+                cgram[cgram_addr >> 1] = ((data & 0x7F) << 8) | cgram_latch;
+            }
+            cgram_addr = (cgram_addr + 1) & 0x1FF;
+            break;
+        case 0x23: w12sel = data; break;
+        case 0x24: w34sel = data; break;
+        case 0x25: wobjsel = data; break;
+        case 0x26: wh0 = data; break;
+        case 0x27: wh1 = data; break;
+        case 0x28: wh2 = data; break;
+        case 0x29: wh3 = data; break;
+        case 0x2A: wbglog = data; break;
+        case 0x2B: wobjlog = data; break;
+        case 0x2C: tm = data; break;
+        case 0x2D: ts = data; break;
+        case 0x2E: tmw = data; break;
+        case 0x2F: tsw = data; break;
+        case 0x30: cgwsel = data; break;
+        case 0x31: cgadsub = data; break;
+        case 0x32:
+            if(data & 0x20) fixed_color = (fixed_color & ~0x001F) | (data & 0x1F);
+            if(data & 0x40) fixed_color = (fixed_color & ~0x03E0) | ((data & 0x1F) << 5);
+            if(data & 0x80) fixed_color = (fixed_color & ~0x7C00) | ((data & 0x1F) << 10);
+            break;
+        case 0x33: setini = data; break;
+    }
+}
+
+byte SNES_PPU::read(twobyte reg) {
+    sync();
+
+    // reads that move an address happen on the workers' copies too
+    if(pool && (reg & 0xFF) >= 0x38 && (reg & 0xFF) <= 0x3B)
+        commands.push_back({line, (byte)reg, 0});
+
+    byte value = open_bus;
+    switch(reg & 0xFF) {
+        case 0x34: case 0x35: case 0x36: {
+            int32_t product = m7a * (signedbyte)mpy_b;
+            value = product >> (((reg & 0xFF) - 0x34) * 8);
+            break;
+        }
+        case 0x37:
+            hcounter = (time - line_start) / PPU_CYCLES_PER_DOT;
+            vcounter = line;
+            counter_latched = true;
+            return open_bus;
+        case 0x38:
+            value = oam[oam_addr < 0x200 ? oam_addr : 0x200 | (oam_addr & 0x1F)];
+            oam_addr = (oam_addr + 1) & 0x3FF;
+            break;
+        case 0x39:
+            value = vram_latch & 0xFF;
+            if(!(vmain & 0x80)) {
+                vram_latch = vram[vramAddress()];
+                vramStep(false);
+            }
+            break;
+        case 0x3A:
+            value = vram_latch >> 8;
+            if(vmain & 0x80) {
+                vram_latch = vram[vramAddress()];
+                vramStep(true);
+            }
+            break;
+        case 0x3B:
+            if(!(cgram_addr & 1)) {
+                value = cgram[cgram_addr >> 1] & 0xFF;
+            } else {
+                value = (cgram[cgram_addr >> 1] >> 8) | (open_bus & 0x80);
+            }
+            cgram_addr = (cgram_addr + 1) & 0x1FF;
+            break;
+        case 0x3C:
+            value = hcounter_high ? (hcounter >> 8) & 1 : hcounter & 0xFF;
+            hcounter_high = !hcounter_high;
+            break;
+        case 0x3D:
+            value = vcounter_high ? (vcounter >> 8) & 1 : vcounter & 0xFF;
+            vcounter_high = !vcounter_high;
+            break;
+        case 0x3E:
+            value = stat77 | 0x01;
+            // range and time over come from drawing the sprites
+            if(pool) {
+                submit();
+                finish();
+                for(auto& renderer : pool->renderers)
+                    value |= renderer->stat77;
+            }
+            break;
+        case 0x3F:
+            value = (frame & 1 ? 0x80 : 0x00) | (counter_latched ? 0x40 : 0x00) | 0x03;
+            counter_latched = false;
+            hcounter_high = vcounter_high = false;
+            break;
+        default:
+            // write-only
+            return open_bus;
+    }
+
+    open_bus = value;
+    return value;
+}
+
+byte SNES_PPU::readStatus(twobyte reg) {
+    sync();
+
+    if(reg == 0x4210) {
+        // RDNMI, cleared by reading it. cpu version 2
+        byte value = (nmi_flag ? 0x80 : 0x00) | 0x02;
+        nmi_flag = false;
+        return value;
+    }
+
+    // HVBJOY
+    byte value = 0;
+    if(inVBlank()) value |= 0x80;
+    if(time - line_start >= PPU_HBLANK_START) value |= 0x40;
+    return value;
+}
+
+//
+// tile cache
+//
+
+const byte* SNES_PPU::getTile(int depth, twobyte word_addr) {
+    TILE_CACHE& cache = tiles[depth];
+    size_t index = (word_addr & 0x7FFF) >> (3 + depth);
+    byte* pixels = &cache.pixels[index * 64];
+
+    if(cache.dirty[index]) {
+        twobyte base = index << (3 + depth);
+        if(simd) {
+            decodeTileSSE2(base, cache.bpp, pixels);
+        } else {
+            decodeTileScalar(base, cache.bpp, pixels);
+        }
+        cache.dirty[index] = 0;
+    }
+    return pixels;
+}
+
+// planes come in pairs: a word per row holds planes 2n and 2n+1,
+// and each pair of planes takes 8 words
+void SNES_PPU::decodeTileScalar(twobyte base, int bpp, byte* out) {
+    for(int row = 0; row < 8; row++) {
+        uint64_t pixels = 0;
+        for(int pair = 0; pair < bpp / 2; pair++) {
+            twobyte planes = vram[base + pair * 8 + row];
+            pixels |= plane_table[planes & 0xFF] << (pair * 2);
+            pixels |= plane_table[planes >> 8] << (pair * 2 + 1);
+        }
+        memcpy(out + row * 8, &pixels, 8);
+    }
+}
+
+void SNES_PPU::decodeTileSSE2(twobyte base, int bpp, byte* out) {
+#ifdef PPU_X86
+    const __m128i bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+    __m128i rows[8];
+    for(int row = 0; row < 8; row++)
+        rows[row] = _mm_setzero_si128();
+
+    for(int pair = 0; pair < bpp / 2; pair++) {
+        // rows 0-7 of both planes, interleaved
+        __m128i planes = _mm_loadu_si128((const __m128i*)&vram[base + pair * 8]);
+        __m128i weights = _mm_unpacklo_epi64(_mm_set1_epi8(1 << (pair * 2)), _mm_set1_epi8(1 << (pair * 2 + 1)));
+
+        // spread every byte over 8 lanes: each vector ends up holding one
+        // row, the low plane in lanes 0-7 and the high one in lanes 8-15
+        __m128i a = _mm_unpacklo_epi8(planes, planes);
+        __m128i b = _mm_unpackhi_epi8(planes, planes);
+        __m128i quads[4] = {_mm_unpacklo_epi16(a, a), _mm_unpackhi_epi16(a, a),
+            _mm_unpacklo_epi16(b, b), _mm_unpackhi_epi16(b, b)};
+
+        for(int q = 0; q < 4; q++) {
+            __m128i spread[2] = {_mm_unpacklo_epi32(quads[q], quads[q]), _mm_unpackhi_epi32(quads[q], quads[q])};
+            for(int half = 0; half < 2; half++) {
+                __m128i set = _mm_cmpeq_epi8(_mm_and_si128(spread[half], bits), bits);
+                set = _mm_and_si128(set, weights);
+                set = _mm_or_si128(set, _mm_srli_si128(set, 8));
+                rows[q * 2 + half] = _mm_or_si128(rows[q * 2 + half], set);
+            }
+        }
+    }
+
+    for(int row = 0; row < 8; row++)
+        _mm_storel_epi64((__m128i*)(out + row * 8), rows[row]);
+#else
+    decodeTileScalar(base, bpp, out);
+#endif
+}
+
+//
+// rendering
+//
+
+void SNES_PPU::setupPriorities() {
+    int mode = bgmode & 7;
+    memset(bg_z, 0, sizeof(bg_z));
+
+    static const int bpps[8][4] = {
+        {2, 2, 2, 2}, {4, 4, 2, 0}, {4, 4, 0, 0}, {8, 4, 0, 0},
+        {8, 2, 0, 0}, {4, 2, 0, 0}, {4, 0, 0, 0}, {8, 0, 0, 0}
+    };
+    for(int bg = 0; bg < 4; bg++)
+        bg_bpp[bg] = bpps[mode][bg];
+    // EXTBG: bg2 shows the mode 7 picture again, with bit 7 as priority
+    if(mode == 7 && (setini & 0x40)) bg_bpp[1] = 7;
+
+    // higher is closer to the front
+    switch(mode) {
+        case 0: {
+            static const byte obj[4] = {3, 6, 9, 12};
+            static const byte bg[4][2] = {{8, 11}, {7, 10}, {2, 5}, {1, 4}};
+            memcpy(obj_z, obj, 4);
+            memcpy(bg_z, bg, 8);
+            break;
+        }
+        case 1:
+            if(bgmode & 0x08) {
+                // bg3 priority 1 in front of everything
+                static const byte obj[4] = {2, 3, 6, 9};
+                static const byte bg[3][2] = {{5, 8}, {4, 7}, {1, 10}};
+                memcpy(obj_z, obj, 4);
+                memcpy(bg_z, bg, 6);
+            } else {
+                static const byte obj[4] = {2, 4, 7, 10};
+                static const byte bg[3][2] = {{6, 9}, {5, 8}, {1, 3}};
+                memcpy(obj_z, obj, 4);
+                memcpy(bg_z, bg, 6);
+            }
+            break;
+        case 7: {
+            static const byte obj[4] = {2, 4, 6, 7};
+            static const byte bg[2][2] = {{3, 3}, {1, 5}};
+            memcpy(obj_z, obj, 4);
+            memcpy(bg_z, bg, 4);
+            break;
+        }
+        default: {
+            static const byte obj[4] = {2, 4, 6, 8};
+            static const byte bg[2][2] = {{3, 7}, {1, 5}};
+            memcpy(obj_z, obj, 4);
+            memcpy(bg_z, bg, 4);
+            break;
+        }
+    }
+}
+
+void SNES_PPU::renderLine(int y) {
+    uint32_t* out = &output[(y - 1) * PPU_WIDTH];
+    if(inidisp & 0x80) {
+        memset(out, 0, PPU_WIDTH * sizeof(uint32_t));
+        return;
+    }
+
+    setupPriorities();
+
+    for(int x = 0; x < PPU_WIDTH; x++) {
+        main_screen.color[x] = cgram[0];
+        main_screen.z[x] = 0;
+        main_screen.layer[x] = 5;
+        // a transparent sub screen pixel adds the fixed color
+        sub_screen.color[x] = fixed_color;
+        sub_screen.z[x] = 0;
+        sub_screen.layer[x] = 5;
+    }
+
+    byte enabled = tm | ts;
+    for(int bg = 0; bg < 4; bg++) {
+        if(!bg_bpp[bg] || !(enabled & (1 << bg))) continue;
+
+        if((bgmode & 7) == 7) {
+            renderMode7(bg, y);
+        } else {
+            renderBG(bg, y);
+        }
+        applyMosaic(bg);
+        mergeLayer(bg);
+    }
+
+    if(enabled & 0x10) {
+        renderOBJ(y);
+        mergeLayer(4);
+    }
+
+    colorMath(out);
+}
+
+static inline twobyte mapAddress(twobyte base, byte size, int tx, int ty) {
+    twobyte addr = base + ((ty & 31) << 5) + (tx & 31);
+    if((tx & 32) && (size & 1)) addr += 0x400;
+    if((ty & 32) && (size & 2)) addr += (size & 1) ? 0x800 : 0x400;
+    return addr & 0x7FFF;
+}
+
+void SNES_PPU::renderBG(int bg, int y) {
+    memset(layer_line.priority, 0, sizeof(layer_line.priority));
+
+    int mode = bgmode & 7;
+    int bpp = bg_bpp[bg];
+    int depth = bpp == 2 ? 0 : bpp == 4 ? 1 : 2;
+    // hires modes are rendered 512 wide and the main screen keeps the odd pixels
+    bool hires = mode == 5 || mode == 6;
+    bool big = bgmode & (0x10 << bg);
+    int tile_w = (big || hires) ? 16 : 8;
+    int tile_h = big ? 16 : 8;
+    int width = hires ? PPU_WIDTH * 2 : PPU_WIDTH;
+
+    twobyte map_base = (bgsc[bg] & 0xFC) << 8;
+    byte map_size = bgsc[bg] & 0x03;
+    twobyte char_base = ((bgnba[bg >> 1] >> ((bg & 1) * 4)) & 0x0F) << 12;
+    int palette_base = mode == 0 ? bg * 32 : 0;
+    bool direct = bpp == 8 && (cgwsel & 0x01);
+
+    // offset per tile: bg3's map holds a scroll value for every column of bg1 and bg2
+    bool opt = (mode == 2 || mode == 4 || mode == 6) && bg < 2;
+    twobyte opt_base = (bgsc[2] & 0xFC) << 8;
+    byte opt_size = bgsc[2] & 0x03;
+
+    if(mosaic & (1 << bg)) y -= (y - 1) % ((mosaic >> 4) + 1);
+
+    int hscroll = hires ? hofs[bg] << 1 : hofs[bg];
+    int fine = hscroll & 7;
+
+    for(int sx = -fine; sx < width; sx += 8) {
+        int hs = hscroll;
+        int vs = vofs[bg];
+
+        int column = (sx + fine) >> 3;
+        if(opt && column > 0) {
+            int tx = ((column - 1) + (hofs[2] >> 3)) & 63;
+            int ty = (vofs[2] >> 3) & 63;
+            twobyte h = vram[mapAddress(opt_base, opt_size, tx, ty)];
+            twobyte v = mode == 4 ? h : vram[mapAddress(opt_base, opt_size, tx, ty + 1)];
+            twobyte enable = 0x2000 << bg;
+
+            if(mode == 4) {
+                if(h & enable) {
+                    if(h & 0x8000) vs = h & 0x3FF;
+                    else hs = (h & 0x3F8) | (hscroll & 7);
+                }
+            } else {
+                if(h & enable) hs = (h & 0x3F8) | (hscroll & 7);
+                if(v & enable) vs = v & 0x3FF;
+            }
+        }
+
+        int px = sx + hs;
+        int py = y + vs;
+        twobyte entry = vram[mapAddress(map_base, map_size, px / tile_w, py / tile_h)];
+
+        twobyte ch = entry & 0x3FF;
+        int palette = (entry >> 10) & 7;
+        byte priority = ((entry >> 13) & 1) + 1;
+        bool hflip = entry & 0x4000;
+
+        int ry = py % tile_h;
+        if(entry & 0x8000) ry = tile_h - 1 - ry;
+        int sub_column = (px % tile_w) >> 3;
+        if(hflip && tile_w == 16) sub_column ^= 1;
+        ch = (ch + (ry >> 3) * 16 + sub_column) & 0x3FF;
+
+        const byte* row = getTile(depth, char_base + ch * (bpp * 4)) + (ry & 7) * 8;
+        const twobyte* palette_colors = &cgram[bpp == 8 ? 0 : palette_base + (palette << bpp)];
+
+        for(int i = 0; i < 8; i++) {
+            int x = sx + i;
+            if(x < 0 || x >= width) continue;
+            if(hires) {
+                if(!(x & 1)) continue;
+                x >>= 1;
+            }
+
+            byte index = row[hflip ? 7 - i : i];
+            if(!index) continue;
+
+            layer_line.color[x] = direct ? directColor(index, palette) : palette_colors[index];
+            layer_line.priority[x] = priority;
+        }
+    }
+}
+
+void SNES_PPU::renderMode7(int bg, int y) {
+    memset(layer_line.priority, 0, sizeof(layer_line.priority));
+
+    if(mosaic & (1 << bg)) y -= (y - 1) % ((mosaic >> 4) + 1);
+
+    int a = m7a, b = m7b, c = m7c, d = m7d;
+    int cx = m7x, cy = m7y;
+    int yy = (m7sel & 0x02) ? 255 - y : y;
+
+    // offsets wrap at 10 bits, keeping the sign
+    auto clip = [](int n) {return (n & 0x2000) ? (n | ~1023) : (n & 1023);};
+    int hoff = clip(sext13(m7hofs) - cx);
+    int voff = clip(sext13(m7vofs) - cy);
+
+    int ox = ((a * hoff) & ~63) + ((b * voff) & ~63) + ((b * yy) & ~63) + (cx << 8);
+    int oy = ((c * hoff) & ~63) + ((d * voff) & ~63) + ((d * yy) & ~63) + (cy << 8);
+
+    int over = m7sel >> 6;
+    bool direct = bg == 0 && (cgwsel & 0x01);
+
+    for(int x = 0; x < PPU_WIDTH; x++) {
+        int sx = (m7sel & 0x01) ? 255 - x : x;
+        int px = (ox + a * sx) >> 8;
+        int py = (oy + c * sx) >> 8;
+
+        bool outside = (px | py) & ~1023;
+        // 2: transparent outside the map, 3: filled with tile 0
+        if(outside && over == 2) continue;
+
+        byte tile = (outside && over == 3) ? 0 : vram[((py & 1023) >> 3) * 128 + ((px & 1023) >> 3)] & 0xFF;
+        byte index = vram[tile * 64 + (py & 7) * 8 + (px & 7)] >> 8;
+
+        byte priority = 1;
+        if(bg == 1) {
+            priority = (index >> 7) + 1;
+            index &= 0x7F;
+        }
+        if(!index) continue;
+
+        layer_line.color[x] = direct ? directColor(index, 0) : cgram[index];
+        layer_line.priority[x] = priority;
+    }
+}
+
+void SNES_PPU::renderOBJ(int y) {
+    memset(layer_line.priority, 0, sizeof(layer_line.priority));
+
+    // sprite y is one line above where it shows up
+    int row = y - 1;
+    twobyte base = (obsel & 0x07) << 13;
+    twobyte gap = (((obsel >> 3) & 0x03) + 1) << 12;
+    int first = oam_priority ? (oam_reload >> 2) & 0x7F : 0;
+
+    // range: the first 32 sprites on the line
+    int found[32];
+    int count = 0;
+    for(int i = 0; i < 128; i++) {
+        int n = (first + i) & 0x7F;
+        byte high = oam[0x200 + (n >> 2)] >> ((n & 3) * 2);
+        const byte* size = obj_sizes[obsel >> 5][(high >> 1) & 1];
+        int x = oam[n * 4] | ((high & 1) << 8);
+        if(x >= 256) x -= 512;
+
+        if(((row - oam[n * 4 + 1]) & 0xFF) >= size[1]) continue;
+        if(x <= -size[0]) continue;
+
+        if(count == 32) {
+            stat77 |= 0x40;
+            break;
+        }
+        found[count++] = n;
+    }
+
+    // time: 34 tiles of 8 pixels. earlier sprites win where they overlap
+    int tiles_used = 0;
+    for(int k = 0; k < count; k++) {
+        int n = found[k];
+        byte high = oam[0x200 + (n >> 2)] >> ((n & 3) * 2);
+        const byte* size = obj_sizes[obsel >> 5][(high >> 1) & 1];
+        int w = size[0], h = size[1];
+        int x = oam[n * 4] | ((high & 1) << 8);
+        if(x >= 256) x -= 512;
+        byte tile = oam[n * 4 + 2];
+        byte attr = oam[n * 4 + 3];
+        bool hflip = attr & 0x40;
+
+        int ry = (row - oam[n * 4 + 1]) & 0xFF;
+        if(attr & 0x80) ry = h - 1 - ry;
+
+        const twobyte* palette = &cgram[128 + ((attr >> 1) & 7) * 16];
+        byte priority = ((attr >> 4) & 3) + 1;
+        byte math = ((attr >> 1) & 7) >= 4;
+
+        for(int column = 0; column < w / 8; column++) {
+            int sx = x + column * 8;
+            if(sx <= -8 || sx >= PPU_WIDTH) continue;
+            if(++tiles_used > 34) {
+                stat77 |= 0x80;
+                return;
+            }
+
+            int tc = hflip ? w / 8 - 1 - column : column;
+            byte t = ((((tile >> 4) + (ry >> 3)) & 0x0F) << 4) | ((tile + tc) & 0x0F);
+            twobyte addr = (base + ((attr & 0x01) ? gap : 0) + t * 16) & 0x7FFF;
+            const byte* pixels = getTile(1, addr) + (ry & 7) * 8;
+
+            for(int i = 0; i < 8; i++) {
+                int px = sx + i;
+                if(px < 0 || px >= PPU_WIDTH || layer_line.priority[px]) continue;
+                byte index = pixels[hflip ? 7 - i : i];
+                if(!index) continue;
+
+                layer_line.color[px] = palette[index];
+                layer_line.priority[px] = priority;
+                layer_line.math[px] = math;
+            }
+        }
+    }
+}
+
+void SNES_PPU::applyMosaic(int bg) {
+    if(!(mosaic & (1 << bg))) return;
+    int size = (mosaic >> 4) + 1;
+    if(size == 1) return;
+
+    for(int x = 0; x < PPU_WIDTH; x++) {
+        int source = x - x % size;
+        layer_line.color[x] = layer_line.color[source];
+        layer_line.priority[x] = layer_line.priority[source];
+    }
+}
+
+void SNES_PPU::buildWindow(byte settings, byte logic, bool* mask) {
+    bool w1 = settings & 0x02, w2 = settings & 0x08;
+    for(int x = 0; x < PPU_WIDTH; x++) {
+        bool in1 = (x >= wh0 && x <= wh1) != (bool)(settings & 0x01);
+        bool in2 = (x >= wh2 && x <= wh3) != (bool)(settings & 0x04);
+
+        if(w1 && w2) {
+            switch(logic) {
+                case 0: mask[x] = in1 || in2; break;
+                case 1: mask[x] = in1 && in2; break;
+                case 2: mask[x] = in1 != in2; break;
+                default: mask[x] = in1 == in2; break;
+            }
+        } else {
+            mask[x] = w1 ? in1 : w2 ? in2 : false;
+        }
+    }
+}
+
+void SNES_PPU::mergeLayer(int layer) {
+    byte bit = 1 << layer;
+    bool main_on = tm & bit, sub_on = ts & bit;
+
+    bool window[PPU_WIDTH];
+    bool windowed = (tmw | tsw) & bit;
+    if(windowed) {
+        byte settings = layer == 4 ? wobjsel : (layer < 2 ? w12sel : w34sel) >> ((layer & 1) * 4);
+        byte logic = layer == 4 ? wobjlog : wbglog >> (layer * 2);
+        buildWindow(settings & 0x0F, logic & 0x03, window);
+    }
+    bool main_window = windowed && (tmw & bit);
+    bool sub_window = windowed && (tsw & bit);
+
+    for(int x = 0; x < PPU_WIDTH; x++) {
+        byte priority = layer_line.priority[x];
+        if(!priority) continue;
+
+        byte z = layer == 4 ? obj_z[priority - 1] : bg_z[layer][priority - 1];
+        byte id = (layer == 4 && !layer_line.math[x]) ? 6 : layer;
+
+        if(main_on && !(main_window && window[x]) && z > main_screen.z[x]) {
+            main_screen.color[x] = layer_line.color[x];
+            main_screen.z[x] = z;
+            main_screen.layer[x] = id;
+        }
+        if(sub_on && !(sub_window && window[x]) && z > sub_screen.z[x]) {
+            sub_screen.color[x] = layer_line.color[x];
+            sub_screen.z[x] = z;
+            sub_screen.layer[x] = id;
+        }
+    }
+}
+
+twobyte SNES_PPU::directColor(byte index, byte palette) {
+    return ((index << 2) & 0x001C) | ((index << 4) & 0x0380) | ((index << 7) & 0x6000)
+        | ((palette << 1) & 0x0002) | ((palette << 5) & 0x0040) | ((palette << 10) & 0x1000);
+}
+
+// decides per pixel what gets added to or subtracted from the main screen,
+// the arithmetic and the conversion to XRGB8888 run over the whole line at once
+void SNES_PPU::colorMath(uint32_t* out) {
+    bool window[PPU_WIDTH];
+    buildWindow(wobjsel >> 4, (wobjlog >> 2) & 0x03, window);
+
+    int black_mode = cgwsel >> 6;
+    int math_mode = (cgwsel >> 4) & 0x03;
+    bool use_sub = cgwsel & 0x02;
+    bool halve = cgadsub & 0x40;
+
+    alignas(16) twobyte other[PPU_WIDTH];
+    alignas(16) byte math[PPU_WIDTH];
+    alignas(16) byte half[PPU_WIDTH];
+
+    for(int x = 0; x < PPU_WIDTH; x++) {
+        bool inside = window[x];
+        bool black = black_mode == 3 || (black_mode == 1 && !inside) || (black_mode == 2 && inside);
+        if(black) main_screen.color[x] = 0;
+
+        bool allowed = math_mode == 0 || (math_mode == 1 && inside) || (math_mode == 2 && !inside);
+        byte layer = main_screen.layer[x];
+        bool sub_backdrop = use_sub && sub_screen.layer[x] == 5;
+
+        other[x] = use_sub ? sub_screen.color[x] : fixed_color;
+        math[x] = (allowed && layer != 6 && (cgadsub & (1 << layer))) ? 0xFF : 0x00;
+        half[x] = (halve && !black && !sub_backdrop) ? 0xFF : 0x00;
+    }
+
+    if(simd) {
+        colorMathSSE2(other, math, half, out);
+    } else {
+        colorMathScalar(other, math, half, out);
+    }
+}
+
+void SNES_PPU::colorMathScalar(const twobyte* other, const byte* math, const byte* half, uint32_t* out) {
+    bool subtract = cgadsub & 0x80;
+    int brightness = (inidisp & 0x0F) + 1;
+
+    for(int x = 0; x < PPU_WIDTH; x++) {
+        twobyte color = main_screen.color[x];
+        int channels[3];
+        for(int ch = 0; ch < 3; ch++) {
+            int value = (color >> (ch * 5)) & 0x1F;
+            if(math[x]) {
+                int operand = (other[x] >> (ch * 5)) & 0x1F;
+                value = subtract ? std::max(value - operand, 0) : value + operand;
+                if(half[x]) value >>= 1;
+                if(value > 31) value = 31;
+            }
+            value = (value * brightness) >> 4;
+            channels[ch] = (value << 3) | (value >> 2);
+        }
+        out[x] = (channels[0] << 16) | (channels[1] << 8) | channels[2];
+    }
+}
+
+void SNES_PPU::colorMathSSE2(const twobyte* other, const byte* math, const byte* half, uint32_t* out) {
+#ifdef PPU_X86
+    bool subtract = cgadsub & 0x80;
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i max5 = _mm_set1_epi16(31);
+    const __m128i brightness = _mm_set1_epi16((inidisp & 0x0F) + 1);
+
+    for(int x = 0; x < PPU_WIDTH; x += 8) {
+        __m128i main_color = _mm_loadu_si128((const __m128i*)&main_screen.color[x]);
+        __m128i other_color = _mm_load_si128((const __m128i*)&other[x]);
+        __m128i math_mask = _mm_loadl_epi64((const __m128i*)&math[x]);
+        math_mask = _mm_unpacklo_epi8(math_mask, math_mask);
+        __m128i half_mask = _mm_loadl_epi64((const __m128i*)&half[x]);
+        half_mask = _mm_unpacklo_epi8(half_mask, half_mask);
+
+        __m128i channels[3];
+        for(int ch = 0; ch < 3; ch++) {
+            __m128i a = _mm_and_si128(_mm_srli_epi16(main_color, ch * 5), mask5);
+            __m128i b = _mm_and_si128(_mm_srli_epi16(other_color, ch * 5), mask5);
+
+            __m128i result = subtract ? _mm_subs_epu16(a, b) : _mm_add_epi16(a, b);
+            result = _mm_or_si128(_mm_and_si128(half_mask, _mm_srli_epi16(result, 1)), _mm_andnot_si128(half_mask, result));
+            result = _mm_min_epi16(result, max5);
+            result = _mm_or_si128(_mm_and_si128(math_mask, result), _mm_andnot_si128(math_mask, a));
+
+            result = _mm_srli_epi16(_mm_mullo_epi16(result, brightness), 4);
+            channels[ch] = _mm_or_si128(_mm_slli_epi16(result, 3), _mm_srli_epi16(result, 2));
+        }
+
+        // blue | green << 8 in the low half of each pixel, red in the high half
+        __m128i low = _mm_or_si128(channels[2], _mm_slli_epi16(channels[1], 8));
+        _mm_storeu_si128((__m128i*)&out[x], _mm_unpacklo_epi16(low, channels[0]));
+        _mm_storeu_si128((__m128i*)&out[x + 4], _mm_unpackhi_epi16(low, channels[0]));
+    }
+#else
+    colorMathScalar(other, math, half, out);
+#endif
+}
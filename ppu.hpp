@@ -1,11 +1,240 @@
-#ifndef _PPU_H
-#define _PPU_H
-
-#include "common.h"
-
-class SNES_PPU {
-public:
-    void clock();
-};
-
-#endif //_SPC700_H
\ No newline at end of file
+#ifndef _PPU_H
+#define _PPU_H
+
+#include "common.h"
+#include "scheduler.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+// NTSC timing, in master cycles
+#define PPU_CYCLES_PER_DOT      4
+#define PPU_CYCLES_PER_LINE     1364
+#define PPU_LINES_PER_FRAME     262
+// hblank starts at dot 274
+#define PPU_HBLANK_START        (274 * PPU_CYCLES_PER_DOT)
+
+#define PPU_WIDTH               256
+#define PPU_HEIGHT              224
+#define PPU_MAX_HEIGHT          239
+
+// a register access on its way to the render workers, stamped with the line
+// it happened on. reg is the low byte of $21xx, the reads logged are the ones
+// that move an address ($2138-$213B)
+struct PPU_COMMAND {
+    twobyte line;
+    byte reg;
+    byte data;
+};
+
+// the render workers, only the ppu on the cpu's side has one
+struct PPU_POOL;
+class SNES_STATE;
+class SNES_DMA;
+
+// the S-PPU, rendered a scanline at a time as the first cycle of each visible
+// line goes by. register accesses catch it up to the cpu's clock first, so
+// anything written before a line starts shows up on that line.
+//
+// with worker threads, the ppu on the cpu's side keeps the registers and
+// memories up to date for reads and timing but draws nothing. every access is
+// logged with its line instead, and at the start of vblank the frame's log is
+// handed to the workers. each worker owns a copy of the ppu and a band of
+// lines: it replays the whole log, drawing only the lines in its band, while
+// the cpu carries on with the next frame. reads of rendering results ($213E)
+// hand over what has been logged so far and wait for it
+class SNES_PPU : public SNES_CLOCKED {
+public:
+    SNES_PPU();
+    ~SNES_PPU();
+
+    void reset();
+
+    bool runUntil(uint64_t target) override;
+
+    // the cpu's timestamp, register accesses run the ppu up to it
+    void setClock(const uint64_t* clock) {this->clock = clock;};
+    // runs hdma as the lines go by
+    void setDMA(SNES_DMA* dma) {this->dma = dma;};
+
+    // $2100-$213F
+    byte read(twobyte reg);
+    void write(twobyte reg, byte data);
+    // the vblank and hblank flags at $4210 and $4212
+    byte readStatus(twobyte reg);
+    // size bytes for $2118 and $2119 in turn, the way a dma writes them
+    void writeVRAMBlock(const byte* data, size_t size);
+
+    // XRGB8888, PPU_WIDTH pixels per row, getHeight() rows. with workers it
+    // holds every line up to the last vblank (or $213E read) once they finish
+    const uint32_t* getFramebuffer() {finish(); return framebuffer.data();};
+    int getHeight() {return overscan ? 239 : 224;};
+    uint64_t getFrame() {return frame;};
+
+    bool inVBlank() {return line > (twobyte)getHeight();};
+    // when the current frame started, the interrupt timers go by it
+    uint64_t frameStart() {return line_start - line * PPU_CYCLES_PER_LINE;};
+    // $4210's vblank flag, without reading (and clearing) it
+    bool nmiFlag() {sync(); return nmi_flag;};
+
+    // tile decode, color math and output conversion with SSE2 or scalar code,
+    // both give the same picture
+    bool setSIMD(bool simd);
+    static bool supportsSIMD();
+
+    // renders on this many worker threads, 0 draws on the caller's thread.
+    // every setting draws the same picture
+    void setThreads(int threads);
+    int getThreads();
+
+    // timing, memories and registers. the picture isn't saved, it is drawn
+    // again from the next line on. loading restarts the workers
+    void serialize(SNES_STATE& state);
+private:
+    // only the workers' copies are made this way
+    SNES_PPU(const SNES_PPU&) = default;
+    SNES_PPU& operator=(const SNES_PPU&) = delete;
+
+    void sync() {if(clock && *clock > time) runUntil(*clock);};
+    void startLine();
+
+    // hands the log so far to the workers, after they are done with the last one
+    void submit();
+    // waits for the workers to finish what they were given
+    void finish();
+    // applies a log on a worker's copy, drawing its band until line end_line
+    void replay(const std::vector<PPU_COMMAND>& batch, twobyte end_line);
+    static void workerLoop(PPU_POOL* pool, SNES_PPU* renderer);
+
+    // vram address translation and increment from VMAIN
+    twobyte vramAddress();
+    void vramStep(bool high);
+    void writeVRAM(twobyte addr, twobyte value);
+
+    //
+    // rendering
+    //
+
+    // decoded tiles, one palette index per byte, for 2, 4 and 8 bpp.
+    // tiles are decoded on first use and marked dirty again by vram writes
+    struct TILE_CACHE {
+        int bpp;
+        std::vector<byte> pixels;
+        std::vector<byte> dirty;
+    };
+    TILE_CACHE tiles[3];
+    const byte* getTile(int depth, twobyte word_addr);
+    void decodeTileScalar(twobyte base, int bpp, byte* out);
+    void decodeTileSSE2(twobyte base, int bpp, byte* out);
+
+    // one layer's pixels for the current line, before priorities are resolved
+    struct LAYER_LINE {
+        twobyte color[PPU_WIDTH];
+        // 0 for transparent, otherwise the priority bit + 1 (bgs) or
+        // priority + 1 (sprites)
+        byte priority[PPU_WIDTH];
+        // sprites with palettes 0-3 never take part in color math
+        byte math[PPU_WIDTH];
+    };
+    LAYER_LINE layer_line;
+
+    // main and sub screen after priorities: color, depth, and which layer
+    // (0-3 bgs, 4 obj, 5 backdrop, 6 obj exempt from color math)
+    struct SCREEN_LINE {
+        twobyte color[PPU_WIDTH];
+        byte z[PPU_WIDTH];
+        byte layer[PPU_WIDTH];
+    };
+    SCREEN_LINE main_screen;
+    SCREEN_LINE sub_screen;
+
+    void renderLine(int y);
+    void setupPriorities();
+    void renderBG(int bg, int y);
+    void renderMode7(int bg, int y);
+    void renderOBJ(int y);
+    void applyMosaic(int bg);
+    void mergeLayer(int layer);
+    // bit per pixel of a window setting, for the current line
+    void buildWindow(byte settings, byte logic, bool* mask);
+    void colorMath(uint32_t* out);
+    void colorMathScalar(const twobyte* other, const byte* math, const byte* half, uint32_t* out);
+    void colorMathSSE2(const twobyte* other, const byte* math, const byte* half, uint32_t* out);
+
+    twobyte directColor(byte index, byte palette);
+
+    // depth of every bg priority and sprite priority in the current mode
+    byte bg_z[4][2];
+    byte obj_z[4];
+    int bg_bpp[4];
+
+    //
+    // state
+    //
+
+    const uint64_t* clock = nullptr;
+    SNES_DMA* dma = nullptr;
+    // hdma writes registers from inside runUntil(), which mustn't start over
+    bool running = false;
+    bool simd = false;
+
+    std::shared_ptr<PPU_POOL> pool;
+    std::vector<PPU_COMMAND> commands;
+    // the lines drawn here, none while workers do it
+    int band_first = 1;
+    int band_last = PPU_MAX_HEIGHT;
+    // the framebuffer drawn into, a worker's is the main ppu's
+    uint32_t* output;
+
+    // current line and when it started
+    twobyte line;
+    uint64_t line_start;
+    uint64_t frame;
+    bool overscan;
+
+    std::array<twobyte, 0x8000> vram;
+    std::array<twobyte, 256> cgram;
+    std::array<byte, 544> oam;
+    std::array<uint32_t, PPU_WIDTH * PPU_MAX_HEIGHT> framebuffer;
+
+    // registers
+    byte inidisp;
+    byte obsel;
+    twobyte oam_addr, oam_reload;
+    byte oam_latch;
+    bool oam_priority;
+    byte bgmode;
+    byte mosaic;
+    byte bgsc[4];
+    byte bgnba[2];
+    twobyte hofs[4], vofs[4];
+    byte ofs_latch, hofs_latch;
+    byte vmain;
+    twobyte vram_addr;
+    twobyte vram_latch;
+    byte m7sel;
+    signedtwobyte m7a, m7b, m7c, m7d, m7x, m7y;
+    twobyte m7hofs, m7vofs;
+    byte m7_latch;
+    byte mpy_b;
+    twobyte cgram_addr;
+    byte cgram_latch;
+    byte w12sel, w34sel, wobjsel;
+    byte wh0, wh1, wh2, wh3;
+    byte wbglog, wobjlog;
+    byte tm, ts, tmw, tsw;
+    byte cgwsel, cgadsub;
+    twobyte fixed_color;
+    byte setini;
+
+    // status
+    byte stat77;
+    bool counter_latched;
+    twobyte hcounter, vcounter;
+    bool hcounter_high, vcounter_high;
+    bool nmi_flag;
+    byte open_bus;
+};
+
+#endif //_PPU_H
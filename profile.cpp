@@ -0,0 +1,174 @@
+#include "common.h"
+
+#include "profile.hpp"
+#include "cpu.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iomanip>
+
+static const char* mode_names[PROFILE_MODES] = {
+	"implied", "accumulator", "immediate", "relative", "relative long", "stack", "block move",
+	"dp", "dp,x", "dp,y", "(dp)", "[dp]", "(dp,x)", "(dp),y", "[dp],y",
+	"abs", "abs,x", "abs,y", "long", "long,x", "(abs)", "(abs,x)", "[abs]",
+	"sr,s", "(sr,s),y"
+};
+
+const profile_mode SNES_PROFILER::modes[256] = {
+	PROFILE_STK, PROFILE_DPIX, PROFILE_STK, PROFILE_SR, PROFILE_DP, PROFILE_DP, PROFILE_DP, PROFILE_DPIL,
+	PROFILE_STK, PROFILE_IMM, PROFILE_ACC, PROFILE_STK, PROFILE_ABS, PROFILE_ABS, PROFILE_ABS, PROFILE_ABSL,
+	PROFILE_REL, PROFILE_DPINY, PROFILE_DPI, PROFILE_SRIY, PROFILE_DP, PROFILE_DPX, PROFILE_DPX, PROFILE_DPILNY,
+	PROFILE_IMP, PROFILE_ABSY, PROFILE_ACC, PROFILE_IMP, PROFILE_ABS, PROFILE_ABSX, PROFILE_ABSX, PROFILE_ABSLX,
+	PROFILE_ABS, PROFILE_DPIX, PROFILE_ABSL, PROFILE_SR, PROFILE_DP, PROFILE_DP, PROFILE_DP, PROFILE_DPIL,
+	PROFILE_STK, PROFILE_IMM, PROFILE_ACC, PROFILE_STK, PROFILE_ABS, PROFILE_ABS, PROFILE_ABS, PROFILE_ABSL,
+	PROFILE_REL, PROFILE_DPINY, PROFILE_DPI, PROFILE_SRIY, PROFILE_DPX, PROFILE_DPX, PROFILE_DPX, PROFILE_DPILNY,
+	PROFILE_IMP, PROFILE_ABSY, PROFILE_ACC, PROFILE_IMP, PROFILE_ABSX, PROFILE_ABSX, PROFILE_ABSX, PROFILE_ABSLX,
+	PROFILE_STK, PROFILE_DPIX, PROFILE_IMM, PROFILE_SR, PROFILE_MOV, PROFILE_DP, PROFILE_DP, PROFILE_DPIL,
+	PROFILE_STK, PROFILE_IMM, PROFILE_ACC, PROFILE_STK, PROFILE_ABS, PROFILE_ABS, PROFILE_ABS, PROFILE_ABSL,
+	PROFILE_REL, PROFILE_DPINY, PROFILE_DPI, PROFILE_SRIY, PROFILE_MOV, PROFILE_DPX, PROFILE_DPX, PROFILE_DPILNY,
+	PROFILE_IMP, PROFILE_ABSY, PROFILE_STK, PROFILE_IMP, PROFILE_ABSL, PROFILE_ABSX, PROFILE_ABSX, PROFILE_ABSLX,
+	PROFILE_STK, PROFILE_DPIX, PROFILE_STK, PROFILE_SR, PROFILE_DP, PROFILE_DP, PROFILE_DP, PROFILE_DPIL,
+	PROFILE_STK, PROFILE_IMM, PROFILE_ACC, PROFILE_STK, PROFILE_ABSI, PROFILE_ABS, PROFILE_ABS, PROFILE_ABSL,
+	PROFILE_REL, PROFILE_DPINY, PROFILE_DPI, PROFILE_SRIY, PROFILE_DPX, PROFILE_DPX, PROFILE_DPX, PROFILE_DPILNY,
+	PROFILE_IMP, PROFILE_ABSY, PROFILE_STK, PROFILE_IMP, PROFILE_ABSIX, PROFILE_ABSX, PROFILE_ABSX, PROFILE_ABSLX,
+	PROFILE_REL, PROFILE_DPIX, PROFILE_RELL, PROFILE_SR, PROFILE_DP, PROFILE_DP, PROFILE_DP, PROFILE_DPIL,
+	PROFILE_IMP, PROFILE_IMM, PROFILE_IMP, PROFILE_STK, PROFILE_ABS, PROFILE_ABS, PROFILE_ABS, PROFILE_ABSL,
+	PROFILE_REL, PROFILE_DPINY, PROFILE_DPI, PROFILE_SRIY, PROFILE_DPX, PROFILE_DPX, PROFILE_DPY, PROFILE_DPILNY,
+	PROFILE_IMP, PROFILE_ABSY, PROFILE_IMP, PROFILE_IMP, PROFILE_ABS, PROFILE_ABSX, PROFILE_ABSX, PROFILE_ABSLX,
+	PROFILE_IMM, PROFILE_DPIX, PROFILE_IMM, PROFILE_SR, PROFILE_DP, PROFILE_DP, PROFILE_DP, PROFILE_DPIL,
+	PROFILE_IMP, PROFILE_IMM, PROFILE_IMP, PROFILE_STK, PROFILE_ABS, PROFILE_ABS, PROFILE_ABS, PROFILE_ABSL,
+	PROFILE_REL, PROFILE_DPINY, PROFILE_DPI, PROFILE_SRIY, PROFILE_DPX, PROFILE_DPX, PROFILE_DPY, PROFILE_DPILNY,
+	PROFILE_IMP, PROFILE_ABSY, PROFILE_IMP, PROFILE_IMP, PROFILE_ABSX, PROFILE_ABSX, PROFILE_ABSY, PROFILE_ABSLX,
+	PROFILE_IMM, PROFILE_DPIX, PROFILE_IMM, PROFILE_SR, PROFILE_DP, PROFILE_DP, PROFILE_DP, PROFILE_DPIL,
+	PROFILE_IMP, PROFILE_IMM, PROFILE_IMP, PROFILE_IMP, PROFILE_ABS, PROFILE_ABS, PROFILE_ABS, PROFILE_ABSL,
+	PROFILE_REL, PROFILE_DPINY, PROFILE_DPI, PROFILE_SRIY, PROFILE_STK, PROFILE_DPX, PROFILE_DPX, PROFILE_DPILNY,
+	PROFILE_IMP, PROFILE_ABSY, PROFILE_STK, PROFILE_IMP, PROFILE_ABSIL, PROFILE_ABSX, PROFILE_ABSX, PROFILE_ABSLX,
+	PROFILE_IMM, PROFILE_DPIX, PROFILE_IMM, PROFILE_SR, PROFILE_DP, PROFILE_DP, PROFILE_DP, PROFILE_DPIL,
+	PROFILE_IMP, PROFILE_IMM, PROFILE_IMP, PROFILE_IMP, PROFILE_ABS, PROFILE_ABS, PROFILE_ABS, PROFILE_ABSL,
+	PROFILE_REL, PROFILE_DPINY, PROFILE_DPI, PROFILE_SRIY, PROFILE_STK, PROFILE_DPX, PROFILE_DPX, PROFILE_DPILNY,
+	PROFILE_IMP, PROFILE_ABSY, PROFILE_STK, PROFILE_IMP, PROFILE_ABSIX, PROFILE_ABSX, PROFILE_ABSX, PROFILE_ABSLX
+};
+
+// calls are BRK, COP, JSR, JSL and JSR (abs,x), returns RTI, RTS and RTL
+const signed char SNES_PROFILER::flows[256] = {
+	1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0
+};
+
+SNES_PROFILER::SNES_PROFILER(uint32_t sample_period) {
+	setPeriod(sample_period);
+}
+
+void SNES_PROFILER::setPeriod(uint32_t sample_period) {
+	period = std::max(1u, sample_period);
+	clear();
+}
+
+void SNES_PROFILER::clear() {
+	memset(opcodes, 0, sizeof(opcodes));
+	until_sample = period;
+	samples = 0;
+	hot.clear();
+	calls.clear();
+	lost_calls = 0;
+	stacks.clear();
+	stack_samples = nullptr;
+}
+
+void SNES_PROFILER::flow(byte opcode, threebyte next) {
+	if(flows[opcode] > 0) {
+		if(calls.size() < PROFILE_MAX_DEPTH) calls.push_back(next);
+		else lost_calls++;
+	} else if(lost_calls) {
+		lost_calls--;
+	} else if(!calls.empty()) {
+		calls.pop_back();
+	}
+	stack_samples = nullptr;
+}
+
+void SNES_PROFILER::sample(threebyte addr, uint64_t n) {
+	samples += n;
+	hot[addr] += n;
+	if(!stack_samples) stack_samples = &stacks[calls];
+	*stack_samples += n;
+}
+
+static std::string address(threebyte addr) {
+	char text[12];
+	snprintf(text, sizeof(text), "%02X:%04X", (addr >> 16) & 0xFF, addr & 0xFFFF);
+	return text;
+}
+
+void SNES_PROFILER::report(std::ostream& out, size_t hot_spots) {
+	uint64_t total_count = 0, total_cycles = 0;
+	uint64_t mode_counts[PROFILE_MODES] = {}, mode_cycles[PROFILE_MODES] = {};
+	std::vector<int> executed;
+	for(int op = 0; op < 256; op++) {
+		total_count += opcodes[op].count;
+		total_cycles += opcodes[op].cycles;
+		mode_counts[modes[op]] += opcodes[op].count;
+		mode_cycles[modes[op]] += opcodes[op].cycles;
+		if(opcodes[op].count) executed.push_back(op);
+	}
+	if(!total_cycles) {
+		out << "profile: nothing executed" << std::endl;
+		return;
+	}
+	std::sort(executed.begin(), executed.end(), [&](int a, int b) {return opcodes[a].cycles > opcodes[b].cycles;});
+
+	out << "profile: " << total_count << " instructions, " << total_cycles << " cycles, " << samples << " samples" << std::endl;
+	out << std::fixed << std::setprecision(1);
+	out << "opcode                         count      cycles  cycles%" << std::endl;
+	for(int op : executed) {
+		out << "  " << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << op << std::dec << std::setfill(' ')
+		<< " " << SNES_CPU::mnemonic(op) << " " << std::left << std::setw(14) << mode_names[modes[op]] << std::right
+		<< std::setw(12) << opcodes[op].count << std::setw(12) << opcodes[op].cycles
+		<< std::setw(9) << 100.0 * opcodes[op].cycles / total_cycles << std::endl;
+	}
+
+	out << "addressing mode                count      cycles  cycles%" << std::endl;
+	for(int m = 0; m < PROFILE_MODES; m++) {
+		if(!mode_counts[m]) continue;
+		out << "  " << std::left << std::setw(21) << mode_names[m] << std::right
+		<< std::setw(12) << mode_counts[m] << std::setw(12) << mode_cycles[m]
+		<< std::setw(9) << 100.0 * mode_cycles[m] / total_cycles << std::endl;
+	}
+
+	std::vector<std::pair<threebyte, uint64_t>> spots(hot.begin(), hot.end());
+	std::sort(spots.begin(), spots.end(), [](const std::pair<threebyte, uint64_t>& a, const std::pair<threebyte, uint64_t>& b) {
+		return a.second > b.second || (a.second == b.second && a.first < b.first);
+	});
+	if(spots.size() > hot_spots) spots.resize(hot_spots);
+	out << "hot spot (block start)       samples  samples%" << std::endl;
+	for(const std::pair<threebyte, uint64_t>& spot : spots) {
+		out << "  " << address(spot.first) << std::setw(27) << spot.second
+		<< std::setw(10) << 100.0 * spot.second / samples << std::endl;
+	}
+	out << std::defaultfloat;
+}
+
+void SNES_PROFILER::writeFolded(std::ostream& out) {
+	for(const std::pair<const std::vector<threebyte>, uint64_t>& stack : stacks) {
+		out << "reset";
+		for(threebyte entry : stack.first)
+			out << ";" << address(entry);
+		out << " " << stack.second << "\n";
+	}
+	out.flush();
+}
@@ -0,0 +1,122 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "common.h"
+
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// deepest call stack followed, calls past it are only counted
+#define PROFILE_MAX_DEPTH	256
+
+enum profile_mode : byte {
+	PROFILE_IMP, PROFILE_ACC, PROFILE_IMM, PROFILE_REL, PROFILE_RELL, PROFILE_STK, PROFILE_MOV,
+	PROFILE_DP, PROFILE_DPX, PROFILE_DPY, PROFILE_DPI, PROFILE_DPIL, PROFILE_DPIX, PROFILE_DPINY, PROFILE_DPILNY,
+	PROFILE_ABS, PROFILE_ABSX, PROFILE_ABSY, PROFILE_ABSL, PROFILE_ABSLX, PROFILE_ABSI, PROFILE_ABSIX, PROFILE_ABSIL,
+	PROFILE_SR, PROFILE_SRIY,
+	PROFILE_MODES
+};
+
+// where the emulated program spends its time, by opcode (and from that, by
+// addressing mode) with counts and cycles, and every sample period cpu
+// cycles a K:PC and the call stack. the call stack is followed through
+// JSR/JSL/BRK/COP, interrupts and RTS/RTL/RTI, so code that returns some
+// other way leaves it off until the stack unwinds.
+//
+// the cpu calls instruction() after each instruction it steps on its own.
+// its cached blocks count their own passes instead, and only tell the
+// profiler the cycles each pass took (for the samples, at the pass's first
+// K:PC) and the call or return that ended it; their opcode counts come in
+// through count() when the cpu flushes them
+class SNES_PROFILER {
+public:
+	SNES_PROFILER(uint32_t sample_period = 1000);
+
+	// both start over
+	void setPeriod(uint32_t sample_period);
+	void clear();
+	void instruction(byte opcode, threebyte addr, uint32_t cycles, threebyte next);
+	// cycles spent in code entered at addr, only sampled
+	void elapse(threebyte addr, uint64_t cycles);
+	// the call or return opcode made, to next
+	void jump(byte opcode, threebyte next);
+	// n executions of opcode that took cycles in all
+	void count(byte opcode, uint64_t n, uint64_t cycles);
+	// an nmi or irq entering its handler, followed like a call
+	void interrupt(threebyte handler);
+
+	uint64_t getCount(byte opcode) {return opcodes[opcode].count;};
+	uint64_t getCycles(byte opcode) {return opcodes[opcode].cycles;};
+	uint64_t getSamples() {return samples;};
+	static profile_mode mode(byte opcode) {return modes[opcode];};
+
+	// opcodes and addressing modes by cycles, and the hot_spots most
+	// sampled K:PC. a sample in a cached block lands on the K:PC the block
+	// starts at, not the instruction it fell in
+	void report(std::ostream& out, size_t hot_spots = 20);
+	// one line per sampled call stack, "reset;00:8123;00:9400 57", as
+	// flamegraph.pl takes them
+	void writeFolded(std::ostream& out);
+private:
+	void flow(byte opcode, threebyte next);
+	// n samples at once, for spans longer than the period
+	void sample(threebyte addr, uint64_t n);
+
+	// side by side, an instruction touches one cache line
+	struct OPCODE_STATS {
+		uint64_t count;
+		uint64_t cycles;
+	};
+	OPCODE_STATS opcodes[256];
+
+	uint32_t period;
+	int64_t until_sample;
+	uint64_t samples = 0;
+	std::unordered_map<threebyte, uint64_t> hot;
+
+	// entry points of the calls in progress
+	std::vector<threebyte> calls;
+	size_t lost_calls = 0;
+	std::map<std::vector<threebyte>, uint64_t> stacks;
+	// the entry of calls, until they change
+	uint64_t* stack_samples = nullptr;
+
+	static const profile_mode modes[256];
+	// 1 for calls, -1 for returns
+	static const signed char flows[256];
+};
+
+inline void SNES_PROFILER::instruction(byte opcode, threebyte addr, uint32_t cycles, threebyte next) {
+	opcodes[opcode].count++;
+	opcodes[opcode].cycles += cycles;
+	jump(opcode, next);
+	elapse(addr, cycles);
+}
+
+inline void SNES_PROFILER::elapse(threebyte addr, uint64_t cycles) {
+	until_sample -= cycles;
+	if(until_sample <= 0) {
+		uint64_t n = -until_sample / period + 1;
+		until_sample += n * period;
+		sample(addr, n);
+	}
+}
+
+inline void SNES_PROFILER::jump(byte opcode, threebyte next) {
+	if(flows[opcode]) flow(opcode, next);
+}
+
+inline void SNES_PROFILER::count(byte opcode, uint64_t n, uint64_t cycles) {
+	opcodes[opcode].count += n;
+	opcodes[opcode].cycles += cycles;
+}
+
+inline void SNES_PROFILER::interrupt(threebyte handler) {
+	if(calls.size() < PROFILE_MAX_DEPTH) calls.push_back(handler);
+	else lost_calls++;
+	stack_samples = nullptr;
+}
+
+#endif //_PROFILE_H
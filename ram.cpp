@@ -2,191 +2,268 @@
 
 #include "ram.hpp"
 #include "cpu.hpp"
+#include "state.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <iomanip>
-#include <fstream>
 
-void SNES_MEMORY::apply_mirrors(byte& bank, twobyte addr) {
-	// mirror low RAM
-	if(addr <= 0x1FFF && (bank <= 0x3F || (bank >= 0x80 && bank <= 0xBF))) bank = 0x7E;
-	// mirror ROM
-	if(addr >= 0x8000 && bank <= 0x7D) bank += 0x80;
-	// mirror PPU registers
-	if(addr >= 0x2100 && addr <= 0x21FF && (bank <= 0x3F || (bank >= 0x80 && bank <= 0xBF))) bank = 0x00;
-	// CPU registers
-	if(addr >= 0x4200 && addr <= 0x43FF && (bank <= 0x3F || (bank >= 0x80 && bank <= 0xBF))) bank = 0x00;
+SNES_MEMORY::SNES_MEMORY(CPU_APU_IO* apu_io) : apu_io(apu_io) {
+	wram.fill(0);
+	io.fill(0);
+	open_bus_page.fill(0);
+	buildPageTable();
 }
 
-// todo: rename "addr" either in these functions or down in the readROM functions
-byte SNES_MEMORY::read8(byte bank, twobyte addr) {
-	apply_mirrors(bank, addr);
-	
-	byte value = data[addr + (bank << 16)];
-#ifdef DEBUG_MEMORY
-	std::cout << "read8: read byte $" << std::hex << HEX_BYTE_PRINT(value) <<
-	" at 0x" << (addr + (bank << 16)) << std::dec << std::endl;
-#endif
-	return value;
+SNES_MEMORY::~SNES_MEMORY() {
+	delete mapper;
 }
 
-byte SNES_MEMORY::read8(threebyte addr) {
-	return read8((addr & 0xFF0000) >> 16, addr & 0xFFFF);
+void SNES_MEMORY::buildPageTable() {
+	// anything not mapped below reads as zero and ignores writes
+	readPages.fill(open_bus_page.data());
+	writePages.fill(write_sink.data());
+	watchedPages.fill(nullptr);
+	cleanPages.fill(nullptr);
+	sram_pages.clear();
+
+	for(size_t bank = 0x00; bank <= 0xFF; bank++) {
+		bool system_bank = bank <= 0x3F || (bank >= 0x80 && bank <= 0xBF);
+		if(!system_bank) continue;
+
+		// low RAM mirrors the first 8 KB of WRAM
+		mapRange(bank, bank, 0x0000, 0x1FFF, 0, 0, wram.data(), wram.size(), true);
+		// expansion area and unused register space
+		mapRange(bank, bank, 0x2000, 0x7FFF, 0, 0, io.data(), io.size(), true);
+
+		// MMIO registers only cover part of their page, leave those to the slow path
+		size_t page = bank << (16 - MEM_PAGE_BITS);
+		readPages[page | (0x2000 >> MEM_PAGE_BITS)] = nullptr;
+		writePages[page | (0x2000 >> MEM_PAGE_BITS)] = nullptr;
+		readPages[page | (0x4000 >> MEM_PAGE_BITS)] = nullptr;
+		writePages[page | (0x4000 >> MEM_PAGE_BITS)] = nullptr;
+	}
+
+	mapRange(0x7E, 0x7F, 0x0000, 0xFFFF, 0, 0x10000, wram.data(), wram.size(), true);
+
+	// cartridge regions
+	if(mapper) mapper->map(*this);
+
+	mirrors.clear();
+	for(size_t page = 0; page < MEM_PAGE_COUNT; page++) {
+		if(writePages[page] && writePages[page] != write_sink.data())
+			mirrors[writePages[page]].push_back(page);
+	}
+
+	// nothing has been snapshotted yet
+	snapshot_base.assign(snapshotPages(), nullptr);
+	snapshot_dirty.assign(snapshotPages(), 1);
 }
 
-twobyte SNES_MEMORY::read16(byte bank, twobyte addr) {
-	apply_mirrors(bank, addr);
-	
-	threebyte full_addr = addr + (bank << 16);
+void SNES_MEMORY::mapRange(byte bank_lo, byte bank_hi, twobyte addr_lo, twobyte addr_hi, size_t offset, size_t bank_stride,
+	byte* source, size_t source_size, bool writable) {
+	if(source_size == 0) return;
 
-	twobyte value = (twobyte)data[full_addr] | (data[full_addr + 1] << 8);
-#ifdef DEBUG_MEMORY
-	std::cout << "read16: read twobyte $" << std::hex << value <<
-	" at 0x" << full_addr << std::dec << std::endl;
-#endif
-	return value;
+	for(size_t bank = bank_lo; bank <= bank_hi; bank++) {
+		for(size_t addr = addr_lo; addr <= addr_hi; addr += MEM_PAGE_SIZE) {
+			size_t page = (bank << (16 - MEM_PAGE_BITS)) | (addr >> MEM_PAGE_BITS);
+			size_t source_offset = (offset + (bank - bank_lo) * bank_stride + (addr - addr_lo)) % source_size;
+
+			readPages[page] = source + source_offset;
+			writePages[page] = writable ? source + source_offset : write_sink.data();
+		}
+	}
 }
 
-twobyte SNES_MEMORY::read16(threebyte addr) {
-	return read16((addr & 0xFF0000) >> 16, addr & 0xFFFF);
+void SNES_MEMORY::mapROM(byte bank_lo, byte bank_hi, twobyte addr_lo, twobyte addr_hi, size_t offset, size_t bank_stride) {
+	mapRange(bank_lo, bank_hi, addr_lo, addr_hi, offset, bank_stride, rom.data(), rom.size(), false);
 }
 
-threebyte SNES_MEMORY::read24(byte bank, twobyte addr) {
-	apply_mirrors(bank, addr);
-
-	threebyte full_addr = addr + (bank << 16);
-	
-	threebyte value = (threebyte)data[full_addr];
-	value |= (data[full_addr + 1] << 8);
-	value |= (data[full_addr + 2] << 16);
-#ifdef DEBUG_MEMORY
-	std::cout << "read24: read threebyte $" << std::hex << value <<
-	" at 0x" << full_addr << std::dec << std::endl;
-#endif
-	return value;
+void SNES_MEMORY::mapSRAM(byte bank_lo, byte bank_hi, twobyte addr_lo, twobyte addr_hi, size_t offset, size_t bank_stride) {
+	size_t size = mapper->sramSize();
+	if(size >= MEM_PAGE_SIZE) {
+		mapRange(bank_lo, bank_hi, addr_lo, addr_hi, offset, bank_stride, sram.data(), sram.size(), true);
+		return;
+	}
+
+	// a page pointer can't repeat it, games that probe the size through the
+	// mirrors have to see them
+	if(sram_pages.empty()) sram_pages.assign(MEM_PAGE_COUNT, nullptr);
+	for(size_t bank = bank_lo; bank <= bank_hi; bank++) {
+		for(size_t addr = addr_lo; addr <= addr_hi; addr += MEM_PAGE_SIZE) {
+			size_t page = (bank << (16 - MEM_PAGE_BITS)) | (addr >> MEM_PAGE_BITS);
+			sram_pages[page] = sram.data() + (offset + (bank - bank_lo) * bank_stride + (addr - addr_lo)) % size;
+			readPages[page] = nullptr;
+			writePages[page] = nullptr;
+		}
+	}
 }
 
-threebyte SNES_MEMORY::read24(threebyte addr) {
-	return read24((addr & 0xFF0000) >> 16, addr & 0xFFFF);
+byte* SNES_MEMORY::mirroredSRAM(threebyte addr) {
+	if(sram_pages.empty()) return nullptr;
+	byte* start = sram_pages[addr >> MEM_PAGE_BITS];
+	if(!start) return nullptr;
+	return sram.data() + (start - sram.data() + (addr & MEM_PAGE_MASK)) % mapper->sramSize();
 }
 
-byte SNES_MEMORY::read8_bank0(twobyte addr) {
-	byte bank = 0x00;
-	apply_mirrors(bank, addr);
+// accesses to pages without a direct mapping, i.e. the ones holding MMIO registers.
+// registers without a device behind them are plain storage shared by all system banks
+byte SNES_MEMORY::readSlow(threebyte addr) {
+	// plain memory, it doesn't count as a register read
+	if(byte* data = mirroredSRAM(addr)) return *data;
+	slow_reads++;
+	twobyte reg = addr & 0xFFFF;
+	// $2140-$217F mirror the four APU ports
+	if((reg & 0xFFC0) == 0x2140)
+		return apu_io->readCPU(reg & 0x03);
+	if(reg == 0x2180) {
+		byte value = read8(0x7E | (wram_port >> 16), wram_port & 0xFFFF);
+		wram_port = (wram_port + 1) & 0x1FFFF;
+		return value;
+	}
+	if(ppu) {
+		if((reg & 0xFFC0) == 0x2100)
+			return ppu->read(reg);
+		if(reg == 0x4210 || reg == 0x4212)
+			return ppu->readStatus(reg);
+	}
+	if(reg == 0x4211)
+		return interrupts.readTimeUp();
+	return io[reg - 0x2000];
+}
 
-	byte value = data[addr + (bank << 16)];
-#ifdef DEBUG_MEMORY
-	std::cout << "read8_bank0: read byte $" << std::hex << HEX_BYTE_PRINT(value) <<
-	" at 0x00" << addr << std::dec << std::endl;
-#endif
-	return value;
+void SNES_MEMORY::writeSlow(threebyte addr, byte entry) {
+	byte* clean = cleanPages[addr >> MEM_PAGE_BITS];
+	if(clean) markDirty(clean);
+
+	byte* watched = watchedPages[addr >> MEM_PAGE_BITS];
+	if(watched) {
+		unwatchCode(watched);
+		watched[addr & MEM_PAGE_MASK] = entry;
+		return;
+	}
+	if(clean) {
+		clean[addr & MEM_PAGE_MASK] = entry;
+		return;
+	}
+	if(byte* data = mirroredSRAM(addr)) {
+		*data = entry;
+		snapshot_dirty[snapshotIndex(sram.data())] = 1;
+		return;
+	}
+
+	twobyte reg = addr & 0xFFFF;
+	if((reg & 0xFFC0) == 0x2140) {
+		apu_io->writeCPU(reg & 0x03, entry);
+		return;
+	}
+	if(ppu && (reg & 0xFFC0) == 0x2100) {
+		ppu->write(reg, entry);
+		return;
+	}
+	switch(reg) {
+		case 0x2180:
+			write8(0x7E | (wram_port >> 16), wram_port & 0xFFFF, entry);
+			wram_port = (wram_port + 1) & 0x1FFFF;
+			return;
+		case 0x2181: wram_port = (wram_port & 0x1FF00) | entry; return;
+		case 0x2182: wram_port = (wram_port & 0x100FF) | (entry << 8); return;
+		case 0x2183: wram_port = (wram_port & 0x0FFFF) | ((entry & 1) << 16); return;
+	}
+	if(reg == 0x4200 || (reg >= 0x4207 && reg <= 0x420A))
+		interrupts.write(reg, entry);
+	io[reg - 0x2000] = entry;
+	snapshot_dirty[(wram.size() + reg - 0x2000) >> MEM_PAGE_BITS] = 1;
+	if(reg == 0x420B) dma.transfer(entry);
 }
 
-twobyte SNES_MEMORY::read16_bank0(twobyte addr) {
-	byte bank = 0x00;
-	apply_mirrors(bank, addr);
-	
-	threebyte lo_addr = addr + (bank << 16);
-	threebyte hi_addr = (addr + 1) + (bank << 16);
-	
-	twobyte value = (twobyte)data[lo_addr] | (data[hi_addr] << 8);
-#ifdef DEBUG_MEMORY
-	std::cout << "read16_bank0: read twobyte $" << std::hex << value <<
-	" at 0x00" << addr << std::dec << std::endl;
-#endif
-	return value;
+void SNES_MEMORY::writeWRAMBlock(const byte* data, size_t size) {
+	while(size) {
+		threebyte addr = 0x7E0000 + wram_port;
+		size_t chunk = std::min(size, (size_t)(MEM_PAGE_SIZE - (addr & MEM_PAGE_MASK)));
+		// the first byte takes the slow path if the page is watched or clean,
+		// which leaves it writable for the rest
+		write8(addr >> 16, addr & 0xFFFF, data[0]);
+		byte* page = writePages[addr >> MEM_PAGE_BITS];
+		memmove(page + (addr & MEM_PAGE_MASK) + 1, data + 1, chunk - 1);
+
+		wram_port = (wram_port + chunk) & 0x1FFFF;
+		data += chunk;
+		size -= chunk;
+	}
 }
 
-threebyte SNES_MEMORY::read24_bank0(twobyte addr) {
-	byte bank = 0x00;
-	apply_mirrors(bank, addr);
-
-	threebyte lo_addr = addr + (bank << 16);
-	threebyte mid_addr = (addr + 1) + (bank << 16);
-	threebyte hi_addr = (addr + 2) + (bank << 16);
-	
-	threebyte value = (threebyte)data[lo_addr];
-	value |= (data[mid_addr] << 8);
-	value |= (data[hi_addr] << 16);
-#ifdef DEBUG_MEMORY
-	std::cout << "read24_bank0: read threebyte $" << std::hex << value <<
-	" at 0x00" << addr << std::dec << std::endl;
-#endif
-	return value;
+bool SNES_MEMORY::watchCode(threebyte addr) {
+	size_t page = addr >> MEM_PAGE_BITS;
+	if(!readPages[page]) return false;
+
+	// ROM, or already watched
+	byte* host_page = writePages[page];
+	if(!host_page) host_page = cleanPages[page];
+	if(!host_page || host_page == write_sink.data()) return true;
+
+	for(twobyte mirror : mirrors[host_page]) {
+		watchedPages[mirror] = host_page;
+		writePages[mirror] = nullptr;
+	}
+	return true;
+}
+
+void SNES_MEMORY::unwatchCode(byte* host_page) {
+	for(twobyte mirror : mirrors[host_page]) {
+		// still clean, the next write goes through markDirty()
+		if(!cleanPages[mirror]) writePages[mirror] = host_page;
+		watchedPages[mirror] = nullptr;
+		if(cpu) cpu->invalidateCode(mirror);
+	}
 }
 
-byte SNES_MEMORY::readROM8(byte K, twobyte& PC) {
-	apply_mirrors(K, PC);
-	threebyte addr = PC | (K << 16);
-	
-	byte value = data[addr];
-#ifdef DEBUG_MEMORY
-	std::cout << "readROM8: read byte $" << std::hex << HEX_BYTE_PRINT(value) <<
-	" at 0x" << addr << std::dec << std::endl;
-#endif
-	PC++;
+// todo: rename "addr" either in these functions or down in the readROM functions
+threebyte SNES_MEMORY::read24(byte bank, twobyte addr) {
+	threebyte full_addr = addr | (bank << 16);
+	byte* page = readPages[full_addr >> MEM_PAGE_BITS];
+
+	threebyte value;
+	if(page && (full_addr & MEM_PAGE_MASK) < MEM_PAGE_MASK - 1) {
+		byte* p = page + (full_addr & MEM_PAGE_MASK);
+		value = (threebyte)p[0] | (p[1] << 8) | (p[2] << 16);
+	} else {
+		value = (threebyte)read8(full_addr);
+		value |= (read8((full_addr + 1) & 0xFFFFFF) << 8);
+		value |= (read8((full_addr + 2) & 0xFFFFFF) << 16);
+	}
+	TRACE(tracer, TRACE_MEM, TRACE_VERBOSE, TRACE_EV_READ24, 0, full_addr, value);
 	return value;
 }
 
 twobyte SNES_MEMORY::readROM16(byte K, twobyte& PC) {
-	apply_mirrors(K, PC);
-	threebyte addr = PC | (K << 16);
-	
-	twobyte value = (twobyte)data[addr];
-	PC++;
-	addr = PC | (K << 16);
-	value |= (data[addr] << 8);
-#ifdef DEBUG_MEMORY
-	std::cout << "readROM16: read twobyte $" << std::hex << value <<
-	" at 0x" << addr << std::dec << std::endl;
-#endif
-	PC++;
+	twobyte value = (twobyte)read8(K, PC++);
+	value |= (read8(K, PC++) << 8);
 	return value;
 }
 
 threebyte SNES_MEMORY::readROM24(byte K, twobyte& PC) {
-	apply_mirrors(K, PC);
-	threebyte addr = PC | (K << 16);
-	
-	threebyte value = (threebyte)data[addr];
-	PC++;
-	addr = PC | (K << 16);
-	value |= (data[addr] << 8);
-	PC++;
-	addr = PC | (K << 16);
-	value |= (data[addr] << 16);
-#ifdef DEBUG_MEMORY
-	std::cout << "readROM24: read threebyte $" << std::hex << value <<
-	" at 0x" << addr << std::dec << std::endl;
-#endif
-	PC++;
+	threebyte value = (threebyte)read8(K, PC++);
+	value |= (read8(K, PC++) << 8);
+	value |= (read8(K, PC++) << 16);
 	return value;
 }
 
-void SNES_MEMORY::write8(byte bank, twobyte addr, byte entry) {
-	apply_mirrors(bank, addr);
-
-	threebyte complete_addr = addr + (bank << 16);
-
-	data[complete_addr] = entry;
-#ifdef DEBUG_MEMORY
-	std::cout << "write8: wrote byte $" << std::hex << HEX_BYTE_PRINT(entry) <<
-	" to 0x" << complete_addr << std::dec << std::endl;
-#endif
-}
-
 void SNES_MEMORY::write16(byte bank, twobyte addr, twobyte entry, bool wrap) {
-	apply_mirrors(bank, addr);
-	
-	threebyte complete_addr = (threebyte)addr + (bank << 16);
-
-	data[complete_addr] = (byte)(entry & 0x00FF);
-	data[complete_addr+1] = (byte)((entry & 0xFF00) >> 8);
-#ifdef DEBUG_MEMORY
-	std::cout << "write16: wrote twobyte $" << std::hex << entry <<
-	" to 0x" << std::setw(6) << complete_addr << std::dec << std::endl;
-#endif
+	threebyte full_addr = addr | (bank << 16);
+	byte* page = writePages[full_addr >> MEM_PAGE_BITS];
+
+	if(page && (full_addr & MEM_PAGE_MASK) != MEM_PAGE_MASK) {
+		byte* p = page + (full_addr & MEM_PAGE_MASK);
+		p[0] = (byte)(entry & 0x00FF);
+		p[1] = (byte)((entry & 0xFF00) >> 8);
+	} else {
+		write8(bank, addr, (byte)(entry & 0x00FF));
+		threebyte next = (full_addr + 1) & 0xFFFFFF;
+		write8(next >> 16, next & 0xFFFF, (byte)((entry & 0xFF00) >> 8));
+	}
+	TRACE(tracer, TRACE_MEM, TRACE_VERBOSE, TRACE_EV_WRITE16, 0, full_addr, entry);
 }
 
 twobyte SNES_MEMORY::brk_vector() {
@@ -197,45 +274,178 @@ twobyte SNES_MEMORY::cop_vector() {
 	return read16_bank0(0xFFE4);
 }
 
+twobyte SNES_MEMORY::nmi_vector(bool emulation) {
+	return read16_bank0(emulation ? 0xFFFA : 0xFFEA);
+}
+
+twobyte SNES_MEMORY::irq_vector(bool emulation) {
+	return read16_bank0(emulation ? 0xFFFE : 0xFFEE);
+}
+
 twobyte SNES_MEMORY::reset_vector() {
 	return m_reset_vector;
 }
 
-bool SNES_MEMORY::openROM(std::string filename) {
-	std::memset(&data, 0, SNES_RAM_SIZE);
-
-	std::ifstream f (filename);
-	char c;
-	byte bank = 0x80;
-	twobyte addr = 0x8000;
-	size_t count = 0;
-	while(f.get(c)) {
-		count++;
-		threebyte final_addr = (bank << 16) | addr;
-		data[final_addr] = c;
-#ifdef DEBUG_ROM
-		std::cout << "openROM: stored byte $" << std::hex << HEX_BYTE_PRINT(c)
-		<< " at 0x" << final_addr << std::dec << std::endl;
-#endif
-		// detect overflow, jump to 0x8000 if needed
-		if(addr == 0xFFFF) {
-			if(bank == 0xFF) {
-				std::cout << "openROM: ran out of memory, exiting" << std::endl;
-				return false;
+void SNES_MEMORY::serialize(SNES_STATE& state) {
+	if(!state.begin(STATE_TAG('M', 'E', 'M', ' '), 1)) return;
+
+	uint32_t rom_size = rom.size();
+	uint32_t sram_size = sram.size();
+	uint64_t rom_hash = rom.hash();
+	state.value(rom_size);
+	state.value(sram_size);
+	state.value(rom_hash);
+	// a state taken with another game, even one of the same size
+	if(rom_size != rom.size() || sram_size != sram.size() || rom_hash != rom.hash()) {
+		state.fail();
+		return;
+	}
+
+	state.value(wram);
+	state.value(io);
+	state.bytes(sram.data(), sram.size());
+	state.value(wram_port);
+	state.end();
+
+	dma.serialize(state);
+	interrupts.serialize(state);
+	if(state.loading()) forgetSnapshots();
+}
+
+//
+// copy-on-write snapshots
+//
+
+byte* SNES_MEMORY::snapshotPage(size_t index) {
+	size_t offset = index << MEM_PAGE_BITS;
+	if(offset < wram.size()) return wram.data() + offset;
+	offset -= wram.size();
+	if(offset < io.size()) return io.data() + offset;
+	return sram.data() + offset - io.size();
+}
+
+size_t SNES_MEMORY::snapshotIndex(const byte* host_page) {
+	if(host_page >= wram.data() && host_page < wram.data() + wram.size())
+		return (host_page - wram.data()) >> MEM_PAGE_BITS;
+	if(host_page >= io.data() && host_page < io.data() + io.size())
+		return (wram.size() + (host_page - io.data())) >> MEM_PAGE_BITS;
+	return (wram.size() + io.size() + (host_page - sram.data())) >> MEM_PAGE_BITS;
+}
+
+// pulls the page's write pointers so the next write to it is seen
+void SNES_MEMORY::protectPage(byte* host_page) {
+	auto found = mirrors.find(host_page);
+	if(found == mirrors.end()) return;
+	for(twobyte mirror : found->second) {
+		cleanPages[mirror] = host_page;
+		writePages[mirror] = nullptr;
+	}
+}
+
+void SNES_MEMORY::markDirty(byte* host_page) {
+	snapshot_dirty[snapshotIndex(host_page)] = 1;
+	for(twobyte mirror : mirrors[host_page]) {
+		cleanPages[mirror] = nullptr;
+		if(!watchedPages[mirror]) writePages[mirror] = host_page;
+	}
+}
+
+// memory changed behind the tracking, e.g. a state was loaded
+void SNES_MEMORY::forgetSnapshots() {
+	for(size_t page = 0; page < MEM_PAGE_COUNT; page++) {
+		if(!cleanPages[page]) continue;
+		if(!watchedPages[page]) writePages[page] = cleanPages[page];
+		cleanPages[page] = nullptr;
+	}
+	snapshot_base.assign(snapshot_base.size(), nullptr);
+	snapshot_dirty.assign(snapshot_dirty.size(), 1);
+}
+
+SNES_MEMORY_SNAPSHOT SNES_MEMORY::snapshot() {
+	SNES_MEMORY_SNAPSHOT snapshot;
+	snapshot.pages.resize(snapshot_base.size());
+
+	for(size_t i = 0; i < snapshot_base.size(); i++) {
+		if(snapshot_dirty[i]) {
+			byte* host_page = snapshotPage(i);
+			auto copy = std::make_shared<SNES_MEMORY_SNAPSHOT::page>();
+			memcpy(copy->data(), host_page, MEM_PAGE_SIZE);
+			snapshot_base[i] = copy;
+			snapshot_dirty[i] = 0;
+			protectPage(host_page);
+		}
+		snapshot.pages[i] = snapshot_base[i];
+	}
+	return snapshot;
+}
+
+bool SNES_MEMORY::restore(const SNES_MEMORY_SNAPSHOT& snapshot) {
+	if(snapshot.pages.size() != snapshot_base.size()) return false;
+
+	for(size_t i = 0; i < snapshot_base.size(); i++) {
+		// unchanged since it was taken or restored from the same page
+		if(!snapshot_dirty[i] && snapshot_base[i] == snapshot.pages[i]) continue;
+
+		byte* host_page = snapshotPage(i);
+		// code cached from the page is out of date
+		auto found = mirrors.find(host_page);
+		if(found != mirrors.end()) {
+			for(twobyte mirror : found->second) {
+				if(!watchedPages[mirror]) continue;
+				unwatchCode(host_page);
+				break;
 			}
+		}
 
-			addr = 0x8000;
-			bank++;
-		} else {
-			addr++;
+		memcpy(host_page, snapshot.pages[i]->data(), MEM_PAGE_SIZE);
+		snapshot_base[i] = snapshot.pages[i];
+		if(snapshot_dirty[i]) {
+			snapshot_dirty[i] = 0;
+			protectPage(host_page);
 		}
 	}
+	return true;
+}
+
+// opening drops the previous image first, so after a failure its pages
+// have to come out of the page table before anything reads them
+void SNES_MEMORY::unloadROM() {
+	rom.close();
+	delete mapper;
+	mapper = nullptr;
+	buildPageTable();
+	if(cpu) cpu->flushCode();
+}
+
+bool SNES_MEMORY::openROM(std::string filename) {
+	if(!rom.open(filename, *log)) {
+		unloadROM();
+		return false;
+	}
 
-	if(count == 0) {
-		std::cout << "openROM: file empty" << std::endl;
+	if(rom.size() > 0x800000) {
+		*log << "openROM: ROM larger than 8 MB, exiting" << std::endl;
+		unloadROM();
 		return false;
 	}
 
+	wram.fill(0);
+	io.fill(0);
+	wram_port = 0;
+	dma.reset();
+	interrupts.reset();
+
+	delete mapper;
+	mapper = SNES_MAPPER::detect(rom.data(), rom.size());
+	sram.assign((mapper->sramSize() + MEM_PAGE_MASK) & ~MEM_PAGE_MASK, 0);
+
+	*log << "openROM: " << mapper->name() << " cartridge \"" << mapper->getHeader().title << "\", "
+	<< (rom.fileSize() - rom.headerSize()) / 1024 << " KB ROM" << (rom.isMapped() ? " (mapped)" : "")
+	<< ", " << mapper->sramSize() / 1024 << " KB SRAM"
+	<< (rom.headerSize() ? ", copier header skipped" : "") << std::endl;
+
+	buildPageTable();
+
 	m_reset_vector = read16_bank0(0xFFFC);
 	return true;
-}
\ No newline at end of file
+}
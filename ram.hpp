@@ -3,16 +3,51 @@
 
 #include "common.h"
 #include "cpu_apu_io.hpp"
+#include "mapper.hpp"
+#include "rom.hpp"
+#include "trace.hpp"
+#include "ppu.hpp"
+#include "dma.hpp"
+#include "interrupts.hpp"
 
 #include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include <string>
 #include <iostream>
+#include <iomanip>
 
-// loROM implementation for now
-// to do: turn into abstract class and implement multiple mappers
+// page table granularity: 4 KB pages, 16 per bank
+#define MEM_PAGE_BITS		12
+#define MEM_PAGE_SIZE		(1 << MEM_PAGE_BITS)
+#define MEM_PAGE_MASK		(MEM_PAGE_SIZE - 1)
+#define MEM_PAGE_COUNT		(1 << (24 - MEM_PAGE_BITS))
+
+class SNES_CPU;
+class SNES_STATE;
+
+// WRAM, the I/O area and SRAM as they were at one point, page by page.
+// pages are read only and shared with other snapshots of the same memory
+// until they change, so a snapshot costs only the pages written since the
+// one before it. copies are cheap and can be kept on any thread
+class SNES_MEMORY_SNAPSHOT {
+public:
+	typedef std::array<byte, MEM_PAGE_SIZE> page;
+
+	size_t pageCount() const {return pages.size();};
+	// the same pointer in two snapshots is the same shared page
+	const byte* getPage(size_t index) const {return pages[index]->data();};
+private:
+	friend class SNES_MEMORY;
+	std::vector<std::shared_ptr<const page>> pages;
+};
+
+// cartridge layout is delegated to the SNES_MAPPER picked at ROM load
 class SNES_MEMORY {
 public:
-	SNES_MEMORY(CPU_APU_IO* apu_io) : apu_io(apu_io) {};
+	SNES_MEMORY(CPU_APU_IO* apu_io);
+	~SNES_MEMORY();
 
 	byte read8(byte bank, twobyte addr);
 	byte read8(threebyte addr);
@@ -25,27 +60,203 @@ public:
 	threebyte read24(byte bank, twobyte addr);
 	threebyte read24(threebyte addr);
 	threebyte read24_bank0(twobyte addr);
-	
+
 	byte readROM8(byte K, twobyte& PC);
 	twobyte readROM16(byte K, twobyte& PC);
 	threebyte readROM24(byte K, twobyte& PC);
-	
+
 	void write8(byte bank, twobyte addr, byte entry);
 	void write16(byte bank, twobyte addr, twobyte entry, bool wrap = false);
 
 	twobyte brk_vector();
 	twobyte cop_vector();
+	twobyte nmi_vector(bool emulation);
+	twobyte irq_vector(bool emulation);
 	twobyte reset_vector();
 
-	void override_reset_vector(twobyte addr) {m_reset_vector = addr; std::cout<<"hi: "<<addr<<std::endl;};
-	
+	void override_reset_vector(twobyte addr) {m_reset_vector = addr;};
+
 	bool openROM(std::string filename);
+
+	// used by mappers to back a range of banks and addresses with cartridge memory.
+	// (bank_lo, addr_lo) maps to offset, each following bank starts bank_stride
+	// bytes further in, and offsets wrap around at the size of the ROM/SRAM
+	void mapROM(byte bank_lo, byte bank_hi, twobyte addr_lo, twobyte addr_hi, size_t offset, size_t bank_stride);
+	void mapSRAM(byte bank_lo, byte bank_hi, twobyte addr_lo, twobyte addr_hi, size_t offset, size_t bank_stride);
+
+	// accesses are traced under TRACE_MEM at TRACE_VERBOSE when set
+	SNES_TRACER* tracer = nullptr;
+	// where the cartridge and the cpu report problems, each instance can
+	// have its own
+	std::ostream* log = &std::cout;
+	// owns $2100-$213F and the vblank/hblank flags when set, otherwise
+	// those are plain storage like the other registers
+	SNES_PPU* ppu = nullptr;
+	// the dma channels, started by writes to $420B and $420C. hdma runs when
+	// the ppu is given them with setDMA()
+	SNES_DMA dma{this};
+	// nmi and the h/v timer irq. it runs as a scheduler component, timed
+	// from the ppu
+	SNES_INTERRUPTS interrupts{this};
+
+	// called by the cpu before it caches code from addr's page. returns false
+	// for the register pages, which can't hold cached code. writable pages get
+	// their write pointer pulled (in every mirror), so the first write takes
+	// the slow path, which puts it back and has the cpu drop the page's code
+	bool watchCode(threebyte addr);
+	// told about writes to watched pages
+	SNES_CPU* cpu = nullptr;
+
+	// the page tables, for code generated against them. entries are null
+	// where the slow path has to be taken
+	byte* const* getReadPages() {return readPages.data();};
+	byte* const* getWritePages() {return writePages.data();};
+	// reads that took the slow path so far, as MMIO reads can't be told
+	// from plain ones by the address alone
+	uint64_t getSlowReads() {return slow_reads;};
+
+	// WRAM, SRAM and the I/O registers, then the dma. the ROM isn't saved, a
+	// state only loads over the same sizes of ROM and SRAM it was taken with
+	void serialize(SNES_STATE& state);
+
+	// copy-on-write snapshots. after one is taken its pages are written
+	// through the slow path once, to mark them dirty, and the next snapshot
+	// only copies those. restoring copies back the pages that differ from
+	// it, and works on any memory with the same ROM and SRAM size, e.g. to
+	// fork many machines from one
+	SNES_MEMORY_SNAPSHOT snapshot();
+	bool restore(const SNES_MEMORY_SNAPSHOT& snapshot);
 private:
+	friend class SNES_DMA;
+	friend class SNES_INTERRUPTS;
 	CPU_APU_IO* apu_io;
-	void apply_mirrors(byte& bank, twobyte addr);
 
-	std::array<byte, SNES_RAM_SIZE> data;
+	// the B bus, $2100-$21FF by the low byte
+	byte readB(byte reg) {return readSlow(0x2100 | reg);};
+	void writeB(byte reg, byte data) {writeSlow(0x2100 | reg, data);};
+
+	// the WRAM port at $2180-$2183, a 17-bit address
+	uint32_t wram_port = 0;
+	// size bytes through $2180, a page at a time
+	void writeWRAMBlock(const byte* data, size_t size);
+
+	// one entry per 4 KB page of the 24-bit address space, pointing at the
+	// host memory backing that page. pages that can't be resolved by a single
+	// pointer (MMIO registers) are left null and go through the slow path
+	void buildPageTable();
+	byte readSlow(threebyte addr);
+	void writeSlow(threebyte addr, byte entry);
+	uint64_t slow_reads = 0;
+
+	std::array<byte*, MEM_PAGE_COUNT> readPages;
+	std::array<byte*, MEM_PAGE_COUNT> writePages;
+	// the write pointer of pages pulled by watchCode(), null otherwise
+	std::array<byte*, MEM_PAGE_COUNT> watchedPages;
+	// every page writing to the same host memory, by host page
+	std::unordered_map<byte*, std::vector<twobyte>> mirrors;
+	void unwatchCode(byte* host_page);
+
+	// snapshot pages are WRAM's, then the I/O area's, then SRAM's
+	size_t snapshotPages() {return (wram.size() + io.size() + sram.size()) >> MEM_PAGE_BITS;};
+	byte* snapshotPage(size_t index);
+	size_t snapshotIndex(const byte* host_page);
+	// the write pointer of pages clean since the last snapshot, null otherwise
+	std::array<byte*, MEM_PAGE_COUNT> cleanPages;
+	// what each page held when it was last snapshotted or restored
+	std::vector<std::shared_ptr<const SNES_MEMORY_SNAPSHOT::page>> snapshot_base;
+	std::vector<byte> snapshot_dirty;
+	void protectPage(byte* host_page);
+	void markDirty(byte* host_page);
+	void forgetSnapshots();
+
+	void mapRange(byte bank_lo, byte bank_hi, twobyte addr_lo, twobyte addr_hi, size_t offset, size_t bank_stride,
+		byte* source, size_t source_size, bool writable);
+
+	SNES_MAPPER* mapper = nullptr;
+	SNES_ROM rom;
+	// leaves the cartridge area as open bus
+	void unloadROM();
+	std::vector<byte> sram;
+	// SRAM smaller than a page repeats within it, so its pages take the slow
+	// path. by page, where in SRAM the page starts, empty for larger SRAM
+	std::vector<byte*> sram_pages;
+	// the SRAM byte at addr when it's on one of those pages
+	byte* mirroredSRAM(threebyte addr);
+	std::array<byte, SNES_WRAM_SIZE> wram;
+	// $2000-$7FFF of the system banks: MMIO registers and the expansion area
+	std::array<byte, 0x6000> io;
+
+	// unmapped pages read from a page of zeroes, and writes to them or to ROM
+	// land in the sink and are dropped
+	std::array<byte, MEM_PAGE_SIZE> open_bus_page;
+	std::array<byte, MEM_PAGE_SIZE> write_sink;
 	twobyte m_reset_vector;
 };
 
-#endif //_RAM_H
\ No newline at end of file
+//
+// fast paths, kept inline so the cpu's accesses compile down to a table lookup
+//
+
+inline byte SNES_MEMORY::read8(byte bank, twobyte addr) {
+	threebyte full_addr = addr | (bank << 16);
+	byte* page = readPages[full_addr >> MEM_PAGE_BITS];
+	byte value = page ? page[full_addr & MEM_PAGE_MASK] : readSlow(full_addr);
+	TRACE(tracer, TRACE_MEM, TRACE_VERBOSE, TRACE_EV_READ8, 0, full_addr, value);
+	return value;
+}
+
+inline byte SNES_MEMORY::read8(threebyte addr) {
+	return read8((addr & 0xFF0000) >> 16, addr & 0xFFFF);
+}
+
+inline byte SNES_MEMORY::read8_bank0(twobyte addr) {
+	return read8(0x00, addr);
+}
+
+inline twobyte SNES_MEMORY::read16(byte bank, twobyte addr) {
+	threebyte full_addr = addr | (bank << 16);
+	byte* page = readPages[full_addr >> MEM_PAGE_BITS];
+
+	twobyte value;
+	if(page && (full_addr & MEM_PAGE_MASK) != MEM_PAGE_MASK) {
+		byte* p = page + (full_addr & MEM_PAGE_MASK);
+		value = (twobyte)p[0] | (p[1] << 8);
+	} else {
+		value = (twobyte)read8(full_addr) | (read8((full_addr + 1) & 0xFFFFFF) << 8);
+	}
+	TRACE(tracer, TRACE_MEM, TRACE_VERBOSE, TRACE_EV_READ16, 0, full_addr, value);
+	return value;
+}
+
+inline twobyte SNES_MEMORY::read16(threebyte addr) {
+	return read16((addr & 0xFF0000) >> 16, addr & 0xFFFF);
+}
+
+inline twobyte SNES_MEMORY::read16_bank0(twobyte addr) {
+	return read16(0x00, addr);
+}
+
+inline threebyte SNES_MEMORY::read24(threebyte addr) {
+	return read24((addr & 0xFF0000) >> 16, addr & 0xFFFF);
+}
+
+inline threebyte SNES_MEMORY::read24_bank0(twobyte addr) {
+	return read24(0x00, addr);
+}
+
+inline byte SNES_MEMORY::readROM8(byte K, twobyte& PC) {
+	return read8(K, PC++);
+}
+
+inline void SNES_MEMORY::write8(byte bank, twobyte addr, byte entry) {
+	threebyte full_addr = addr | (bank << 16);
+	byte* page = writePages[full_addr >> MEM_PAGE_BITS];
+	if(page) {
+		page[full_addr & MEM_PAGE_MASK] = entry;
+	} else {
+		writeSlow(full_addr, entry);
+	}
+	TRACE(tracer, TRACE_MEM, TRACE_VERBOSE, TRACE_EV_WRITE8, 0, full_addr, entry);
+}
+
+#endif //_RAM_H
@@ -0,0 +1,97 @@
+#include "common.h"
+
+#include "rom.hpp"
+#include "mapper.hpp"
+#include "ram.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string.h>
+#include <iostream>
+
+SNES_ROM::~SNES_ROM() {
+	close();
+}
+
+bool SNES_ROM::open(const std::string& filename, std::ostream& log) {
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd < 0) {
+		log << "openROM: could not open file" << std::endl;
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+		log << "openROM: file empty" << std::endl;
+		::close(fd);
+		return false;
+	}
+
+	m_file_size = st.st_size;
+	m_header_size = SNES_MAPPER::copierHeaderSize(m_file_size);
+	size_t rom_size = m_file_size - m_header_size;
+
+	// whole pages can be mapped as they are, the page table never reads past the end
+	if((rom_size & MEM_PAGE_MASK) == 0) {
+		void* mapping = mmap(NULL, m_file_size, PROT_READ, MAP_SHARED, fd, 0);
+		if(mapping != MAP_FAILED) {
+			m_mapping = mapping;
+			m_mapping_size = m_file_size;
+			m_data = (byte*)mapping + m_header_size;
+			m_size = rom_size;
+			::close(fd);
+			return true;
+		}
+	}
+
+	// odd-sized images get copied into zero-padded whole pages
+	m_copy.assign((rom_size + MEM_PAGE_MASK) & ~MEM_PAGE_MASK, 0);
+	size_t done = 0;
+	while(done < rom_size) {
+		ssize_t count = pread(fd, m_copy.data() + done, rom_size - done, m_header_size + done);
+		if(count <= 0) {
+			log << "openROM: read failed" << std::endl;
+			::close(fd);
+			close();
+			return false;
+		}
+		done += count;
+	}
+	::close(fd);
+
+	m_data = m_copy.data();
+	m_size = m_copy.size();
+	return true;
+}
+
+void SNES_ROM::close() {
+	if(m_mapping) {
+		munmap(m_mapping, m_mapping_size);
+		m_mapping = nullptr;
+		m_mapping_size = 0;
+	}
+	m_copy.clear();
+	m_copy.shrink_to_fit();
+	m_data = nullptr;
+	m_size = 0;
+	m_hash = 0;
+}
+
+// FNV-1a over 8-byte words, the image is whole pages
+uint64_t SNES_ROM::hash() {
+	if(m_hash || !m_data) return m_hash;
+
+	uint64_t h = 0xCBF29CE484222325ULL;
+	for(size_t i = 0; i < m_size; i += 8) {
+		uint64_t word;
+		memcpy(&word, m_data + i, 8);
+		h = (h ^ word) * 0x100000001B3ULL;
+	}
+	m_hash = h ? h : 1;
+	return m_hash;
+}
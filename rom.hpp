@@ -0,0 +1,46 @@
+#ifndef _ROM_H
+#define _ROM_H
+
+#include "common.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// read-only cartridge image, with any copier header already skipped.
+// images that are a whole number of 4 KB pages are mmap'd straight from the
+// file, so every instance running the same ROM shares the same physical pages.
+// anything else is read into a zero-padded buffer of whole pages
+class SNES_ROM {
+public:
+	SNES_ROM() {};
+	~SNES_ROM();
+
+	// problems are reported on log
+	bool open(const std::string& filename, std::ostream& log = std::cout);
+	void close();
+
+	byte* data() {return m_data;};
+	size_t size() {return m_size;};
+	size_t fileSize() {return m_file_size;};
+	size_t headerSize() {return m_header_size;};
+	bool isMapped() {return m_mapping != nullptr;};
+	// tells images apart for save states. worked out on first use, so
+	// opening doesn't fault in every mapped page
+	uint64_t hash();
+private:
+	SNES_ROM(const SNES_ROM&) = delete;
+	SNES_ROM& operator=(const SNES_ROM&) = delete;
+
+	byte* m_data = nullptr;
+	size_t m_size = 0;
+	size_t m_file_size = 0;
+	size_t m_header_size = 0;
+	uint64_t m_hash = 0;
+
+	void* m_mapping = nullptr;
+	size_t m_mapping_size = 0;
+	std::vector<byte> m_copy;
+};
+
+#endif //_ROM_H
@@ -0,0 +1,158 @@
+#include "common.h"
+
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define cpu_relax()		_mm_pause()
+#else
+#define cpu_relax()		do {} while(0)
+#endif
+
+// spins this many times before giving the core away, waits on the other
+// thread are usually a few hundred nanoseconds. on a single core spinning
+// only holds up the thread being waited for
+#define SPIN_LIMIT		4096
+
+static const unsigned spin_limit = std::thread::hardware_concurrency() > 1 ? SPIN_LIMIT : 0;
+
+SNES_SCHEDULER::~SNES_SCHEDULER() {
+	setThreaded(false);
+}
+
+void SNES_SCHEDULER::addComponent(SNES_CLOCKED* component, bool threadable) {
+	FOLLOWER* follower = new FOLLOWER;
+	follower->component = component;
+	follower->threadable = threadable;
+	followers.emplace_back(follower);
+}
+
+void SNES_SCHEDULER::setSyncInterval(uint64_t master_cycles) {
+	if(master_cycles == 0) master_cycles = 1;
+	if(master_cycles > MAX_SYNC_INTERVAL) master_cycles = MAX_SYNC_INTERVAL;
+	sync_interval = master_cycles;
+}
+
+void SNES_SCHEDULER::setWindow(uint64_t master_cycles) {
+	if(master_cycles > MAX_SYNC_INTERVAL) master_cycles = MAX_SYNC_INTERVAL;
+	window = master_cycles;
+}
+
+void SNES_SCHEDULER::setThreaded(bool threaded) {
+	if(threaded == this->threaded) return;
+
+	if(threaded) {
+		publish();
+		stopping = false;
+		for(auto& follower : followers) {
+			if(!follower->threadable) continue;
+			follower->published = follower->component->time;
+			follower->thread = std::thread(&SNES_SCHEDULER::followerLoop, this, follower.get());
+		}
+	} else {
+		stopping = true;
+		for(auto& follower : followers) {
+			if(follower->thread.joinable())
+				follower->thread.join();
+		}
+	}
+	this->threaded = threaded;
+}
+
+bool SNES_SCHEDULER::run(uint64_t master_cycles) {
+	uint64_t end = leader->time + master_cycles;
+	bool running = true;
+
+	while(running && leader->time < end) {
+		uint64_t target = leader->time + sync_interval;
+		uint64_t event = nextEvent();
+		if(target > event || leader->idle()) target = event;
+		if(target > end) target = end;
+
+		running = leader->runUntil(target);
+
+		if(threaded) {
+			// let the followers chase the new time, but don't get more than window ahead
+			publish();
+			runInline();
+			uint64_t floor = leader->time > window ? leader->time - window : 0;
+			for(auto& follower : followers) {
+				if(follower->threadable)
+					waitFor(follower.get(), floor);
+			}
+		} else {
+			sync();
+		}
+	}
+
+	if(threaded) sync();
+	return running;
+}
+
+void SNES_SCHEDULER::sync() {
+	if(threaded) {
+		publish();
+		runInline();
+		for(auto& follower : followers) {
+			if(follower->threadable)
+				waitFor(follower.get(), leader->time);
+		}
+		return;
+	}
+
+	for(auto& follower : followers) {
+		if(follower->component->time < leader->time)
+			follower->component->runUntil(leader->time);
+	}
+}
+
+void SNES_SCHEDULER::runInline() {
+	for(auto& follower : followers) {
+		if(!follower->threadable && follower->component->time < leader->time)
+			follower->component->runUntil(leader->time);
+	}
+}
+
+uint64_t SNES_SCHEDULER::nextEvent() {
+	uint64_t event = UINT64_MAX;
+	for(auto& follower : followers) {
+		if(!follower->threadable)
+			event = std::min(event, follower->component->nextEvent());
+	}
+	return event;
+}
+
+void SNES_SCHEDULER::waitFor(FOLLOWER* follower, uint64_t time) {
+	unsigned spins = 0;
+	while(follower->published.load(std::memory_order_acquire) < time) {
+		if(++spins < spin_limit) {
+			cpu_relax();
+		} else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void SNES_SCHEDULER::followerLoop(FOLLOWER* follower) {
+	SNES_CLOCKED* component = follower->component;
+	unsigned idle = 0;
+
+	while(!stopping.load(std::memory_order_acquire)) {
+		uint64_t limit = leader_time.load(std::memory_order_acquire);
+		if(component->time < limit) {
+			component->runUntil(limit);
+			follower->published.store(component->time, std::memory_order_release);
+			idle = 0;
+		} else if(++idle < spin_limit) {
+			cpu_relax();
+		} else if(idle < spin_limit + 1024) {
+			std::this_thread::yield();
+		} else {
+			// the cpu is paused or between runs
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+}
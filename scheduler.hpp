@@ -0,0 +1,105 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include "common.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// every component keeps its own timestamp in master clock cycles (NTSC)
+#define MASTER_CLOCK_HZ					21477272
+#define APU_CLOCK_HZ					1024000
+// the 65816 really takes 6, 8 or 12 master cycles per cycle depending on the
+// region accessed; every cycle is counted as a slow (ROM/WRAM) access for now
+#define MASTER_CYCLES_PER_CPU_CYCLE		8
+
+// default distance the cpu may run ahead of everything else, in master cycles
+#define DEFAULT_SYNC_INTERVAL			(64 * MASTER_CYCLES_PER_CPU_CYCLE)
+// upper bound for the sync interval and the thread window, keeps the traffic
+// between two syncs well inside the CPU_APU_IO queues
+#define MAX_SYNC_INTERVAL				16384
+
+// anything driven by the master clock
+class SNES_CLOCKED {
+public:
+	virtual ~SNES_CLOCKED() {};
+
+	// runs until time reaches target, returns false if the component stopped.
+	// followers have to reach target even then, time just passes
+	virtual bool runUntil(uint64_t target) = 0;
+	// when a component next has something to raise in the leader (an
+	// interrupt), UINT64_MAX for nothing. the leader's batches end there
+	virtual uint64_t nextEvent() {return UINT64_MAX;};
+	// the leader does nothing until the next event (e.g. waiting for an
+	// interrupt), so its batch can go straight there
+	virtual bool idle() {return false;};
+
+	uint64_t time = 0;
+};
+
+// catch-up scheduler: the cpu leads and runs ahead in batches of up to
+// sync_interval master cycles, then every other component is brought up to
+// its timestamp in one go. accesses to shared state (e.g. the APU ports)
+// call sync() so the other side is never observed from the past.
+//
+// components with events (interrupt sources) cut the batches short at
+// them, so what they raise reaches the cpu when it happens instead of being
+// looked for every cycle. they have to stay on the cpu's thread.
+//
+// with threading on, each follower instead runs on its own thread, chasing
+// the time the cpu last published and never passing it. the cpu waits only
+// when a follower falls more than window master cycles behind, or in sync().
+// followers that share state with the cpu directly (the ppu's registers)
+// stay on the cpu's thread and are caught up inline either way
+class SNES_SCHEDULER {
+public:
+	SNES_SCHEDULER(SNES_CLOCKED* leader) : leader(leader) {};
+	~SNES_SCHEDULER();
+
+	void addComponent(SNES_CLOCKED* component, bool threadable = true);
+
+	// smaller intervals interleave the components more finely, larger ones run faster.
+	// one cpu cycle (MASTER_CYCLES_PER_CPU_CYCLE) is lockstep
+	void setSyncInterval(uint64_t master_cycles);
+	uint64_t getSyncInterval() {return sync_interval;};
+
+	// only touch these between runs
+	void setThreaded(bool threaded);
+	bool isThreaded() {return threaded;};
+	void setWindow(uint64_t master_cycles);
+
+	// runs the system for master_cycles, returns false if the cpu stopped.
+	// all components end up at the cpu's time, threaded or not
+	bool run(uint64_t master_cycles);
+	// brings every component up to the cpu's current time
+	void sync();
+
+	uint64_t now() {return leader->time;};
+private:
+	struct FOLLOWER {
+		SNES_CLOCKED* component;
+		bool threadable;
+		// component->time as last seen from the cpu's side
+		std::atomic<uint64_t> published{0};
+		std::thread thread;
+	};
+
+	void publish() {leader_time.store(leader->time, std::memory_order_release);};
+	void waitFor(FOLLOWER* follower, uint64_t time);
+	void followerLoop(FOLLOWER* follower);
+	void runInline();
+	uint64_t nextEvent();
+
+	SNES_CLOCKED* leader;
+	std::vector<std::unique_ptr<FOLLOWER>> followers;
+	uint64_t sync_interval = DEFAULT_SYNC_INTERVAL;
+	uint64_t window = DEFAULT_SYNC_INTERVAL;
+
+	bool threaded = false;
+	std::atomic<uint64_t> leader_time{0};
+	std::atomic<bool> stopping{false};
+};
+
+#endif //_SCHEDULER_H
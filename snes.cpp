@@ -5,45 +5,109 @@ class SNES_CPU;
 class SNES_MEMORY;
 #include "ram.hpp"
 #include "snes.hpp"
+#include "state.hpp"
 
-#include <stdio.h>
-#include <iostream>
-#include <iomanip>
+#include <vector>
 
-int main() {
-    SNES s;
-    s.run();
-	std::cout << "completed execution!" << std::endl;
-	
-	return 0;
-}
+SNES::SNES() : cpu(&cpu_apu_io), apu(&cpu_apu_io), scheduler(&cpu) {
+	scheduler.addComponent(&apu);
+	// the ppu's registers are read and written straight from the cpu's thread
+	scheduler.addComponent(&ppu, false);
+	// raises the interrupts, timed from the ppu
+	scheduler.addComponent(&(cpu.mem)->interrupts, false);
+	cpu_apu_io.connect(&scheduler, &cpu, &apu);
+	ppu.setClock(&cpu.time);
+	(cpu.mem)->ppu = &ppu;
+	ppu.setDMA(&(cpu.mem)->dma);
+	tracer.setClock(&cpu.time);
 
-SNES::SNES() : cpu(&cpu_apu_io), apu(&cpu_apu_io) {
 	ready = false;
-	std::cout << "running it!" << std::endl;
-	std::string filename;
-	std::cin >> filename;
-	std::cout << "reading ROM file: " << filename << std::endl;
-	if ((cpu.mem)->openROM(filename)) {
-		ready = true;
-	}
-	std::cout << "finished reading file" << std::endl;
+}
+
+bool SNES::loadROM(const std::string& filename) {
+	ready = (cpu.mem)->openROM(filename);
+	if(!ready) return false;
 
 // todo: why is this here?
 #ifdef FORCE_RESET_TO_8000
 	(cpu.mem)->override_reset_vector(0x8000);
+#endif
+	cpu.init();
+	// room to take the machine back if a state fails to load
+	rollback.resize(stateSize());
+	return true;
+}
+
+bool SNES::run(uint64_t master_cycles) {
+	if(!ready) return false;
+	return scheduler.run(master_cycles);
+}
+
+bool SNES::startTrace(const char* spec, const char* filename) {
+#ifdef SNES_TRACE
+	if(!tracer.configure(spec) || !tracer.open(filename)) return false;
+	cpu.tracer = &tracer;
+	(cpu.mem)->tracer = &tracer;
+	cpu_apu_io.tracer = &tracer;
+	apu.setTracer(&tracer);
+	apu_traced = tracer.enabled(TRACE_APU, TRACE_INFO);
+	if(apu_traced) scheduler.setThreaded(false);
+	return true;
+#else
+	*(cpu.mem)->log << "tracing is not compiled in, build with make debug" << std::endl;
+	return false;
 #endif
 }
 
-void SNES::run() {
-	if(!ready) return;
-    cpu.init();
+void SNES::startProfile(uint32_t sample_period) {
+	cpu.flushProfile();
+	profiler.setPeriod(sample_period);
+	cpu.profiler = &profiler;
+}
+
+void SNES::writeProfile(std::ostream& report, std::ostream* folded) {
+	cpu.flushProfile();
+	profiler.report(report);
+	if(folded) profiler.writeFolded(*folded);
+}
+
+void SNES::serialize(SNES_STATE& state) {
+	cpu.serialize(state);
+	cpu_apu_io.serialize(state);
+	apu.serialize(state);
+	ppu.serialize(state);
+}
+
+size_t SNES::saveState(byte* buffer, size_t capacity) {
+	SNES_STATE state(buffer, capacity);
+	serialize(state);
+	return state.finish();
+}
+
+bool SNES::loadState(const byte* buffer, size_t size) {
+	SNES_STATE state(buffer, size);
+	if(!state.ok()) return false;
+
+	// components check their chunks as they read them, some against what
+	// they read earlier, so only loading tells a good state. the machine is
+	// kept to be loaded back when this one fails partway, in a buffer that
+	// only grows if the apu ports have more writes queued than ever before
+	size_t kept = saveState(rollback.data(), rollback.size());
+	if(!kept) {
+		rollback.resize(stateSize());
+		kept = saveState(rollback.data(), rollback.size());
+	}
 
-    for(int i = 0; i < 10000; i++) {
-		if (!cpu.clock()) {
-			break;
-		}
+	// the apu's thread starts again from the loaded state
+	bool threaded = scheduler.isThreaded();
+	scheduler.setThreaded(false);
+	serialize(state);
+	if(!state.ok()) {
+		SNES_STATE undo((const byte*)rollback.data(), kept);
+		serialize(undo);
 	}
+	scheduler.setThreaded(threaded);
+	return state.ok();
 }
 
 SNES::~SNES() {
@@ -5,20 +5,88 @@
 
 #include "cpu.hpp"
 #include "apu.hpp"
+#include "ppu.hpp"
 #include "cpu_apu_io.hpp"
+#include "trace.hpp"
+#include "profile.hpp"
+#include "scheduler.hpp"
 
+#include <vector>
+
+class SNES_STATE;
+
+// one console. instances share nothing, any number can run side by side
 class SNES {
 public:
     SNES();
     ~SNES();
 
-    void run();
+    // loads a cartridge and resets, false if it can't be used
+    bool loadROM(const std::string& filename);
+    // runs for master_cycles from where it left off, false once the cpu has
+    // halted (or without a ROM)
+    bool run(uint64_t master_cycles);
+
+    // where this instance's messages go
+    void setLog(std::ostream* log) {cpu.mem->log = log;};
+    // traces to filename with a SNES_TRACE spec such as cpu=1,mem=2, false
+    // if tracing isn't compiled in or the spec or file are no good
+    bool startTrace(const char* spec, const char* filename);
+    // counts and samples the emulated code from now on, a K:PC sample every
+    // sample_period cpu cycles. the cpu runs as it does without it, jit
+    // and all, hot spots are the blocks of code it runs by their first K:PC
+    void startProfile(uint32_t sample_period = 1000);
+    void stopProfile() {cpu.flushProfile(); cpu.profiler = nullptr;};
+    // the report, and the sampled call stacks for flamegraph.pl when folded
+    // is given
+    void writeProfile(std::ostream& report, std::ostream* folded = nullptr);
+
+    // master cycles the cpu may run ahead of the apu, ppu and interrupt
+    // controller before they catch up. interrupts still end a batch on time
+    void setSyncInterval(uint64_t master_cycles) {scheduler.setSyncInterval(master_cycles);};
+    // not while the apu is traced, the tracer takes records from one thread
+    void setThreadedAPU(bool threaded) {scheduler.setThreaded(threaded && !apu_traced);};
+    void setPPUThreads(int threads) {ppu.setThreads(threads);};
+    // runs hot cpu code natively, false if this host can't
+    bool setJIT(bool enabled) {return cpu.setJIT(enabled);};
+    // skips the cpu's idle loops up to the next event, on by default
+    void setIdleSkip(bool enabled) {cpu.setIdleSkip(enabled);};
+
+    uint64_t getTime() {return cpu.time;};
+    uint64_t getInstructions() {return cpu.getInstructions();};
+    // master cycles the cpu skipped over idle loops
+    uint64_t getSkippedCycles() {return cpu.getSkippedCycles();};
+    uint64_t getFrame() {return ppu.getFrame();};
+    SNES_CPU_REGISTERS getRegisters() {return cpu.getRegisters();};
+    // the cpu's bus, to look at or poke between runs
+    SNES_MEMORY* getMemory() {return cpu.mem;};
+    // XRGB8888, PPU_WIDTH pixels per row
+    const uint32_t* getFramebuffer() {return ppu.getFramebuffer();};
+    int getHeight() {return ppu.getHeight();};
+
+    // save states, taken and restored between runs. saving fills the given
+    // buffer without allocating and returns the size used, 0 if it didn't
+    // fit. stateSize() is what saving needs right now, it only grows if the
+    // apu ports have more writes queued. a state only loads into the same
+    // ROM, and a failed load leaves the machine as it was
+    size_t saveState(byte* buffer, size_t capacity);
+    size_t stateSize() {return saveState(nullptr, 0);};
+    bool loadState(const byte* buffer, size_t size);
 private:
+    void serialize(SNES_STATE& state);
+
+    SNES_TRACER tracer;
+    SNES_PROFILER profiler;
     CPU_APU_IO cpu_apu_io;
     SNES_CPU cpu;
     SNES_APU apu;
+    SNES_PPU ppu;
+    SNES_SCHEDULER scheduler;
     
     bool ready;
+    bool apu_traced = false;
+    // what loadState() puts back when a state fails partway
+    std::vector<byte> rollback;
 };
 
 #endif //_SNES_H
\ No newline at end of file
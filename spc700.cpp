@@ -1,10 +1,1103 @@
-#ifndef _SPC_700_H
-#define _SPC_700_H
-
 #include "spc700.hpp"
+#include "state.hpp"
+
+#include <iostream>
+
+SPC700::SPC700(CPU_APU_IO* cpu_io, SNES_DSP* dsp) : ram(cpu_io, dsp) {
+    init();
+}
+
+void SPC700::init() {
+    A = 0x00;
+    X = 0x00;
+    Y = 0x00;
+    SP = 0x00;
+    setPSW(0x00);
+    // resets into the IPL ROM
+    PC = read16(0xFFFE);
+    dest_addr = src_addr = 0;
+    rel = 0;
+    data_bit = 0;
+    cyclesRemaining = 0;
+    stopped = false;
+}
+
+void SPC700::serialize(SNES_STATE& state) {
+    if(!state.begin(STATE_TAG('S', 'P', 'C', ' '), 1)) return;
+    state.value(A);
+    state.value(X);
+    state.value(Y);
+    state.value(SP);
+    state.value(PC);
+    state.value(n); state.value(v); state.value(p); state.value(b);
+    state.value(h); state.value(i); state.value(z); state.value(c);
+    state.value(dest_addr);
+    state.value(src_addr);
+    state.value(rel);
+    state.value(data_bit);
+    state.value(extra_cycles);
+    state.value(cyclesRemaining);
+    state.value(stopped);
+    state.end();
+
+    ram.serialize(state);
+}
 
 bool SPC700::clock() {
+    if(stopped) return false;
+
+    if(cyclesRemaining == 0) {
+        cyclesRemaining = step();
+        if(stopped) return false;
+    }
+    cyclesRemaining--;
     return true;
 }
 
-#endif // _SPC_700_H
\ No newline at end of file
+byte SPC700::step() {
+    if(stopped) return 0;
+
+#ifdef SNES_TRACE
+    twobyte pc = PC;
+#endif
+    byte opcode = fetch8();
+    const instruction& inst = ops[opcode];
+    extra_cycles = 0;
+
+    // fetch operand addresses, then execute
+    (this->*inst.mode)();
+    (this->*inst.op)();
+
+    byte cycles = inst.cycles + extra_cycles;
+    ram.tick(cycles);
+
+    TRACE(tracer, TRACE_APU, TRACE_VERBOSE, TRACE_EV_SPC_OPCODE, opcode, pc, A, X, Y, SP, getPSW());
+    return cycles;
+}
+
+//
+// utils
+//
+
+byte SPC700::getPSW() {
+    return (n << 7) | (v << 6) | (p << 5) | (b << 4) | (h << 3) | (i << 2) | (z << 1) | c;
+}
+
+void SPC700::setPSW(byte psw) {
+    n = (psw >> 7) & 1;
+    v = (psw >> 6) & 1;
+    p = (psw >> 5) & 1;
+    b = (psw >> 4) & 1;
+    h = (psw >> 3) & 1;
+    i = (psw >> 2) & 1;
+    z = (psw >> 1) & 1;
+    c = psw & 1;
+}
+
+twobyte SPC700::fetch16() {
+    twobyte value = fetch8();
+    return value | (fetch8() << 8);
+}
+
+twobyte SPC700::read16(twobyte addr) {
+    return ram.read8(addr) | (ram.read8(addr + 1) << 8);
+}
+
+twobyte SPC700::readWord(twobyte addr) {
+    twobyte high = (addr & 0xFF00) | ((addr + 1) & 0x00FF);
+    return ram.read8(addr) | (ram.read8(high) << 8);
+}
+
+void SPC700::writeWord(twobyte addr, twobyte value) {
+    twobyte high = (addr & 0xFF00) | ((addr + 1) & 0x00FF);
+    ram.write8(addr, value & 0xFF);
+    ram.write8(high, value >> 8);
+}
+
+void SPC700::pushPC() {
+    push(PC >> 8);
+    push(PC & 0xFF);
+}
+
+void SPC700::branch(bool taken) {
+    if(taken) {
+        PC += rel;
+        extra_cycles += 2;
+    }
+}
+
+byte SPC700::adc(byte a, byte m) {
+    int result = a + m + c;
+    c = result > 0xFF;
+    h = ((a ^ m ^ result) & 0x10) != 0;
+    v = (~(a ^ m) & (a ^ result) & 0x80) != 0;
+    setNZ(result);
+    return result;
+}
+
+void SPC700::compare(byte a, byte m) {
+    int result = a - m;
+    c = result >= 0;
+    setNZ(result);
+}
+
+byte SPC700::asl(byte value) {
+    c = value >> 7;
+    value <<= 1;
+    setNZ(value);
+    return value;
+}
+
+byte SPC700::lsr(byte value) {
+    c = value & 1;
+    value >>= 1;
+    setNZ(value);
+    return value;
+}
+
+byte SPC700::rol(byte value) {
+    byte carry = c;
+    c = value >> 7;
+    value = (value << 1) | carry;
+    setNZ(value);
+    return value;
+}
+
+byte SPC700::ror(byte value) {
+    byte carry = c;
+    c = value & 1;
+    value = (value >> 1) | (carry << 7);
+    setNZ(value);
+    return value;
+}
+
+//
+// addressing modes
+//
+
+void SPC700::IMM() {
+    dest_addr = PC++;
+}
+
+void SPC700::DP() {
+    dest_addr = dp(fetch8());
+}
+
+void SPC700::DPX() {
+    dest_addr = dp(fetch8() + X);
+}
+
+void SPC700::DPY() {
+    dest_addr = dp(fetch8() + Y);
+}
+
+// operands are encoded source first
+void SPC700::DP_DP() {
+    src_addr = dp(fetch8());
+    dest_addr = dp(fetch8());
+}
+
+void SPC700::DP_IMM() {
+    src_addr = PC++;
+    dest_addr = dp(fetch8());
+}
+
+void SPC700::IND_XY() {
+    src_addr = dp(Y);
+    dest_addr = dp(X);
+}
+
+void SPC700::ABS() {
+    dest_addr = fetch16();
+}
+
+void SPC700::ABSX() {
+    dest_addr = fetch16() + X;
+}
+
+void SPC700::ABSY() {
+    dest_addr = fetch16() + Y;
+}
+
+void SPC700::INDX() {
+    dest_addr = dp(X);
+}
+
+void SPC700::INDX_INC() {
+    dest_addr = dp(X++);
+}
+
+void SPC700::DPIX() {
+    dest_addr = readWord(dp(fetch8() + X));
+}
+
+void SPC700::DPINY() {
+    dest_addr = readWord(dp(fetch8())) + Y;
+}
+
+void SPC700::REL() {
+    rel = fetch8();
+}
+
+void SPC700::DP_REL() {
+    dest_addr = dp(fetch8());
+    rel = fetch8();
+}
+
+void SPC700::DPX_REL() {
+    dest_addr = dp(fetch8() + X);
+    rel = fetch8();
+}
+
+void SPC700::MEM_BIT() {
+    twobyte operand = fetch16();
+    dest_addr = operand & 0x1FFF;
+    data_bit = operand >> 13;
+}
+
+//
+// operations
+//
+
+// moves
+
+void SPC700::LDA() {
+    A = ram.read8(dest_addr);
+    setNZ(A);
+}
+
+void SPC700::LDX() {
+    X = ram.read8(dest_addr);
+    setNZ(X);
+}
+
+void SPC700::LDY() {
+    Y = ram.read8(dest_addr);
+    setNZ(Y);
+}
+
+void SPC700::STA() {
+    ram.write8(dest_addr, A);
+}
+
+void SPC700::STX() {
+    ram.write8(dest_addr, X);
+}
+
+void SPC700::STY() {
+    ram.write8(dest_addr, Y);
+}
+
+void SPC700::TXA() {
+    A = X;
+    setNZ(A);
+}
+
+void SPC700::TYA() {
+    A = Y;
+    setNZ(A);
+}
+
+void SPC700::TAX() {
+    X = A;
+    setNZ(X);
+}
+
+void SPC700::TAY() {
+    Y = A;
+    setNZ(Y);
+}
+
+void SPC700::TSX() {
+    X = SP;
+    setNZ(X);
+}
+
+void SPC700::TXS() {
+    SP = X;
+}
+
+void SPC700::MOV_DP() {
+    ram.write8(dest_addr, ram.read8(src_addr));
+}
+
+// alu
+
+void SPC700::ORA() {
+    A |= ram.read8(dest_addr);
+    setNZ(A);
+}
+
+void SPC700::ORA_DP() {
+    byte value = ram.read8(src_addr);
+    value |= ram.read8(dest_addr);
+    ram.write8(dest_addr, value);
+    setNZ(value);
+}
+
+void SPC700::AND() {
+    A &= ram.read8(dest_addr);
+    setNZ(A);
+}
+
+void SPC700::AND_DP() {
+    byte value = ram.read8(src_addr);
+    value &= ram.read8(dest_addr);
+    ram.write8(dest_addr, value);
+    setNZ(value);
+}
+
+void SPC700::EOR() {
+    A ^= ram.read8(dest_addr);
+    setNZ(A);
+}
+
+void SPC700::EOR_DP() {
+    byte value = ram.read8(src_addr);
+    value ^= ram.read8(dest_addr);
+    ram.write8(dest_addr, value);
+    setNZ(value);
+}
+
+void SPC700::ADC() {
+    A = adc(A, ram.read8(dest_addr));
+}
+
+void SPC700::ADC_DP() {
+    byte value = ram.read8(src_addr);
+    ram.write8(dest_addr, adc(ram.read8(dest_addr), value));
+}
+
+void SPC700::SBC() {
+    A = sbc(A, ram.read8(dest_addr));
+}
+
+void SPC700::SBC_DP() {
+    byte value = ram.read8(src_addr);
+    ram.write8(dest_addr, sbc(ram.read8(dest_addr), value));
+}
+
+void SPC700::CMP() {
+    compare(A, ram.read8(dest_addr));
+}
+
+void SPC700::CMP_DP() {
+    byte value = ram.read8(src_addr);
+    compare(ram.read8(dest_addr), value);
+}
+
+void SPC700::CPX() {
+    compare(X, ram.read8(dest_addr));
+}
+
+void SPC700::CPY() {
+    compare(Y, ram.read8(dest_addr));
+}
+
+void SPC700::INC() {
+    byte value = ram.read8(dest_addr) + 1;
+    ram.write8(dest_addr, value);
+    setNZ(value);
+}
+
+void SPC700::INCA() {
+    setNZ(++A);
+}
+
+void SPC700::INX() {
+    setNZ(++X);
+}
+
+void SPC700::INY() {
+    setNZ(++Y);
+}
+
+void SPC700::DEC() {
+    byte value = ram.read8(dest_addr) - 1;
+    ram.write8(dest_addr, value);
+    setNZ(value);
+}
+
+void SPC700::DECA() {
+    setNZ(--A);
+}
+
+void SPC700::DEX() {
+    setNZ(--X);
+}
+
+void SPC700::DEY() {
+    setNZ(--Y);
+}
+
+void SPC700::ASL() {
+    ram.write8(dest_addr, asl(ram.read8(dest_addr)));
+}
+
+void SPC700::ASLA() {
+    A = asl(A);
+}
+
+void SPC700::LSR() {
+    ram.write8(dest_addr, lsr(ram.read8(dest_addr)));
+}
+
+void SPC700::LSRA() {
+    A = lsr(A);
+}
+
+void SPC700::ROL() {
+    ram.write8(dest_addr, rol(ram.read8(dest_addr)));
+}
+
+void SPC700::ROLA() {
+    A = rol(A);
+}
+
+void SPC700::ROR() {
+    ram.write8(dest_addr, ror(ram.read8(dest_addr)));
+}
+
+void SPC700::RORA() {
+    A = ror(A);
+}
+
+void SPC700::XCN() {
+    A = (A >> 4) | (A << 4);
+    setNZ(A);
+}
+
+// 16-bit
+
+void SPC700::MOVW() {
+    twobyte value = readWord(dest_addr);
+    A = value & 0xFF;
+    Y = value >> 8;
+    setNZ16(value);
+}
+
+void SPC700::MOVW_DP() {
+    writeWord(dest_addr, getYA());
+}
+
+void SPC700::INCW() {
+    twobyte value = readWord(dest_addr) + 1;
+    writeWord(dest_addr, value);
+    setNZ16(value);
+}
+
+void SPC700::DECW() {
+    twobyte value = readWord(dest_addr) - 1;
+    writeWord(dest_addr, value);
+    setNZ16(value);
+}
+
+// the high byte's flags win, except Z which covers the whole word
+void SPC700::ADDW() {
+    twobyte value = readWord(dest_addr);
+    c = 0;
+    A = adc(A, value & 0xFF);
+    Y = adc(Y, value >> 8);
+    z = (getYA() == 0);
+}
+
+void SPC700::SUBW() {
+    twobyte value = readWord(dest_addr);
+    c = 1;
+    A = sbc(A, value & 0xFF);
+    Y = sbc(Y, value >> 8);
+    z = (getYA() == 0);
+}
+
+void SPC700::CMPW() {
+    int result = getYA() - readWord(dest_addr);
+    c = result >= 0;
+    setNZ16(result);
+}
+
+void SPC700::MUL() {
+    twobyte result = Y * A;
+    A = result & 0xFF;
+    Y = result >> 8;
+    setNZ(Y);
+}
+
+// matches the hardware's results for overflowing quotients too
+void SPC700::DIV() {
+    twobyte ya = getYA();
+    h = (Y & 0x0F) >= (X & 0x0F);
+    v = Y >= X;
+
+    if(Y < (X << 1)) {
+        A = ya / X;
+        Y = ya % X;
+    } else {
+        A = 255 - (ya - (X << 9)) / (256 - X);
+        Y = X + (ya - (X << 9)) % (256 - X);
+    }
+    setNZ(A);
+}
+
+void SPC700::DAA() {
+    if(c || A > 0x99) {
+        A += 0x60;
+        c = 1;
+    }
+    if(h || (A & 0x0F) > 0x09) {
+        A += 0x06;
+    }
+    setNZ(A);
+}
+
+void SPC700::DAS() {
+    if(!c || A > 0x99) {
+        A -= 0x60;
+        c = 0;
+    }
+    if(!h || (A & 0x0F) > 0x09) {
+        A -= 0x06;
+    }
+    setNZ(A);
+}
+
+// branches
+
+void SPC700::BRA() {
+    PC += rel;
+}
+
+void SPC700::BEQ() {
+    branch(z);
+}
+
+void SPC700::BNE() {
+    branch(!z);
+}
+
+void SPC700::BCS() {
+    branch(c);
+}
+
+void SPC700::BCC() {
+    branch(!c);
+}
+
+void SPC700::BVS() {
+    branch(v);
+}
+
+void SPC700::BVC() {
+    branch(!v);
+}
+
+void SPC700::BMI() {
+    branch(n);
+}
+
+void SPC700::BPL() {
+    branch(!n);
+}
+
+template<int B>
+void SPC700::BBS() {
+    branch(ram.read8(dest_addr) & (1 << B));
+}
+
+template<int B>
+void SPC700::BBC() {
+    branch(!(ram.read8(dest_addr) & (1 << B)));
+}
+
+template<int B>
+void SPC700::SET1() {
+    ram.write8(dest_addr, ram.read8(dest_addr) | (1 << B));
+}
+
+template<int B>
+void SPC700::CLR1() {
+    ram.write8(dest_addr, ram.read8(dest_addr) & ~(1 << B));
+}
+
+void SPC700::CBNE() {
+    branch(A != ram.read8(dest_addr));
+}
+
+void SPC700::DBNZ() {
+    byte value = ram.read8(dest_addr) - 1;
+    ram.write8(dest_addr, value);
+    branch(value != 0);
+}
+
+void SPC700::DBNZ_Y() {
+    branch(--Y != 0);
+}
+
+// jumps and calls
+
+void SPC700::JMP() {
+    PC = dest_addr;
+}
+
+void SPC700::JMP_IND() {
+    PC = read16(dest_addr);
+}
+
+void SPC700::JSR() {
+    pushPC();
+    PC = dest_addr;
+}
+
+void SPC700::PCALL() {
+    byte offset = ram.read8(dest_addr);
+    pushPC();
+    PC = 0xFF00 | offset;
+}
+
+template<int N>
+void SPC700::TCALL() {
+    pushPC();
+    PC = read16(0xFFDE - (N << 1));
+}
+
+void SPC700::BRK() {
+    pushPC();
+    push(getPSW());
+    b = 1;
+    i = 0;
+    PC = read16(0xFFDE);
+}
+
+void SPC700::RTS() {
+    PC = pull();
+    PC |= pull() << 8;
+}
+
+void SPC700::RTI() {
+    setPSW(pull());
+    PC = pull();
+    PC |= pull() << 8;
+}
+
+// stack
+
+void SPC700::PHA() {
+    push(A);
+}
+
+void SPC700::PHX() {
+    push(X);
+}
+
+void SPC700::PHY() {
+    push(Y);
+}
+
+void SPC700::PHP() {
+    push(getPSW());
+}
+
+void SPC700::PLA() {
+    A = pull();
+}
+
+void SPC700::PLX() {
+    X = pull();
+}
+
+void SPC700::PLY() {
+    Y = pull();
+}
+
+void SPC700::PLP() {
+    setPSW(pull());
+}
+
+// test and set/clear bits, flags as for CMP A,m
+
+void SPC700::TSB() {
+    byte value = ram.read8(dest_addr);
+    setNZ(A - value);
+    ram.write8(dest_addr, value | A);
+}
+
+void SPC700::TRB() {
+    byte value = ram.read8(dest_addr);
+    setNZ(A - value);
+    ram.write8(dest_addr, value & ~A);
+}
+
+// carry and memory bits
+
+void SPC700::AND1() {
+    c &= (ram.read8(dest_addr) >> data_bit) & 1;
+}
+
+void SPC700::AND1_N() {
+    c &= ~(ram.read8(dest_addr) >> data_bit) & 1;
+}
+
+void SPC700::OR1() {
+    c |= (ram.read8(dest_addr) >> data_bit) & 1;
+}
+
+void SPC700::OR1_N() {
+    c |= ~(ram.read8(dest_addr) >> data_bit) & 1;
+}
+
+void SPC700::EOR1() {
+    c ^= (ram.read8(dest_addr) >> data_bit) & 1;
+}
+
+void SPC700::NOT1() {
+    ram.write8(dest_addr, ram.read8(dest_addr) ^ (1 << data_bit));
+}
+
+void SPC700::MOV1() {
+    c = (ram.read8(dest_addr) >> data_bit) & 1;
+}
+
+void SPC700::MOV1_REVERSE() {
+    byte value = ram.read8(dest_addr) & ~(1 << data_bit);
+    ram.write8(dest_addr, value | (c << data_bit));
+}
+
+// flags
+
+void SPC700::CLC() {
+    c = 0;
+}
+
+void SPC700::SEC() {
+    c = 1;
+}
+
+void SPC700::NOTC() {
+    c ^= 1;
+}
+
+void SPC700::CLV() {
+    v = 0;
+    h = 0;
+}
+
+void SPC700::CLRP() {
+    p = 0;
+}
+
+void SPC700::SETP() {
+    p = 1;
+}
+
+// I enables interrupts on the spc700 (EI/DI), not that anything raises them
+void SPC700::CLI() {
+    i = 0;
+}
+
+void SPC700::SEI() {
+    i = 1;
+}
+
+// SLEEP and STOP both halt the core until reset
+void SPC700::STP() {
+    stopped = true;
+}
+
+//
+// dispatch table
+//
+
+const std::array<SPC700::instruction, 256> SPC700::ops = SPC700::buildOps();
+
+std::array<SPC700::instruction, 256> SPC700::buildOps() {
+    std::array<instruction, 256> t;
+
+    // alu ops on A, in every addressing mode
+    t[0x04] = {&SPC700::ORA, &SPC700::DP, 3};
+    t[0x05] = {&SPC700::ORA, &SPC700::ABS, 4};
+    t[0x06] = {&SPC700::ORA, &SPC700::INDX, 3};
+    t[0x07] = {&SPC700::ORA, &SPC700::DPIX, 6};
+    t[0x08] = {&SPC700::ORA, &SPC700::IMM, 2};
+    t[0x14] = {&SPC700::ORA, &SPC700::DPX, 4};
+    t[0x15] = {&SPC700::ORA, &SPC700::ABSX, 5};
+    t[0x16] = {&SPC700::ORA, &SPC700::ABSY, 5};
+    t[0x17] = {&SPC700::ORA, &SPC700::DPINY, 6};
+    t[0x09] = {&SPC700::ORA_DP, &SPC700::DP_DP, 6};
+    t[0x18] = {&SPC700::ORA_DP, &SPC700::DP_IMM, 5};
+    t[0x19] = {&SPC700::ORA_DP, &SPC700::IND_XY, 5};
+
+    t[0x24] = {&SPC700::AND, &SPC700::DP, 3};
+    t[0x25] = {&SPC700::AND, &SPC700::ABS, 4};
+    t[0x26] = {&SPC700::AND, &SPC700::INDX, 3};
+    t[0x27] = {&SPC700::AND, &SPC700::DPIX, 6};
+    t[0x28] = {&SPC700::AND, &SPC700::IMM, 2};
+    t[0x34] = {&SPC700::AND, &SPC700::DPX, 4};
+    t[0x35] = {&SPC700::AND, &SPC700::ABSX, 5};
+    t[0x36] = {&SPC700::AND, &SPC700::ABSY, 5};
+    t[0x37] = {&SPC700::AND, &SPC700::DPINY, 6};
+    t[0x29] = {&SPC700::AND_DP, &SPC700::DP_DP, 6};
+    t[0x38] = {&SPC700::AND_DP, &SPC700::DP_IMM, 5};
+    t[0x39] = {&SPC700::AND_DP, &SPC700::IND_XY, 5};
+
+    t[0x44] = {&SPC700::EOR, &SPC700::DP, 3};
+    t[0x45] = {&SPC700::EOR, &SPC700::ABS, 4};
+    t[0x46] = {&SPC700::EOR, &SPC700::INDX, 3};
+    t[0x47] = {&SPC700::EOR, &SPC700::DPIX, 6};
+    t[0x48] = {&SPC700::EOR, &SPC700::IMM, 2};
+    t[0x54] = {&SPC700::EOR, &SPC700::DPX, 4};
+    t[0x55] = {&SPC700::EOR, &SPC700::ABSX, 5};
+    t[0x56] = {&SPC700::EOR, &SPC700::ABSY, 5};
+    t[0x57] = {&SPC700::EOR, &SPC700::DPINY, 6};
+    t[0x49] = {&SPC700::EOR_DP, &SPC700::DP_DP, 6};
+    t[0x58] = {&SPC700::EOR_DP, &SPC700::DP_IMM, 5};
+    t[0x59] = {&SPC700::EOR_DP, &SPC700::IND_XY, 5};
+
+    t[0x64] = {&SPC700::CMP, &SPC700::DP, 3};
+    t[0x65] = {&SPC700::CMP, &SPC700::ABS, 4};
+    t[0x66] = {&SPC700::CMP, &SPC700::INDX, 3};
+    t[0x67] = {&SPC700::CMP, &SPC700::DPIX, 6};
+    t[0x68] = {&SPC700::CMP, &SPC700::IMM, 2};
+    t[0x74] = {&SPC700::CMP, &SPC700::DPX, 4};
+    t[0x75] = {&SPC700::CMP, &SPC700::ABSX, 5};
+    t[0x76] = {&SPC700::CMP, &SPC700::ABSY, 5};
+    t[0x77] = {&SPC700::CMP, &SPC700::DPINY, 6};
+    t[0x69] = {&SPC700::CMP_DP, &SPC700::DP_DP, 6};
+    t[0x78] = {&SPC700::CMP_DP, &SPC700::DP_IMM, 5};
+    t[0x79] = {&SPC700::CMP_DP, &SPC700::IND_XY, 5};
+
+    t[0x84] = {&SPC700::ADC, &SPC700::DP, 3};
+    t[0x85] = {&SPC700::ADC, &SPC700::ABS, 4};
+    t[0x86] = {&SPC700::ADC, &SPC700::INDX, 3};
+    t[0x87] = {&SPC700::ADC, &SPC700::DPIX, 6};
+    t[0x88] = {&SPC700::ADC, &SPC700::IMM, 2};
+    t[0x94] = {&SPC700::ADC, &SPC700::DPX, 4};
+    t[0x95] = {&SPC700::ADC, &SPC700::ABSX, 5};
+    t[0x96] = {&SPC700::ADC, &SPC700::ABSY, 5};
+    t[0x97] = {&SPC700::ADC, &SPC700::DPINY, 6};
+    t[0x89] = {&SPC700::ADC_DP, &SPC700::DP_DP, 6};
+    t[0x98] = {&SPC700::ADC_DP, &SPC700::DP_IMM, 5};
+    t[0x99] = {&SPC700::ADC_DP, &SPC700::IND_XY, 5};
+
+    t[0xA4] = {&SPC700::SBC, &SPC700::DP, 3};
+    t[0xA5] = {&SPC700::SBC, &SPC700::ABS, 4};
+    t[0xA6] = {&SPC700::SBC, &SPC700::INDX, 3};
+    t[0xA7] = {&SPC700::SBC, &SPC700::DPIX, 6};
+    t[0xA8] = {&SPC700::SBC, &SPC700::IMM, 2};
+    t[0xB4] = {&SPC700::SBC, &SPC700::DPX, 4};
+    t[0xB5] = {&SPC700::SBC, &SPC700::ABSX, 5};
+    t[0xB6] = {&SPC700::SBC, &SPC700::ABSY, 5};
+    t[0xB7] = {&SPC700::SBC, &SPC700::DPINY, 6};
+    t[0xA9] = {&SPC700::SBC_DP, &SPC700::DP_DP, 6};
+    t[0xB8] = {&SPC700::SBC_DP, &SPC700::DP_IMM, 5};
+    t[0xB9] = {&SPC700::SBC_DP, &SPC700::IND_XY, 5};
+
+    t[0xC8] = {&SPC700::CPX, &SPC700::IMM, 2};
+    t[0x3E] = {&SPC700::CPX, &SPC700::DP, 3};
+    t[0x1E] = {&SPC700::CPX, &SPC700::ABS, 4};
+    t[0xAD] = {&SPC700::CPY, &SPC700::IMM, 2};
+    t[0x7E] = {&SPC700::CPY, &SPC700::DP, 3};
+    t[0x5E] = {&SPC700::CPY, &SPC700::ABS, 4};
+
+    // loads
+    t[0xE4] = {&SPC700::LDA, &SPC700::DP, 3};
+    t[0xE5] = {&SPC700::LDA, &SPC700::ABS, 4};
+    t[0xE6] = {&SPC700::LDA, &SPC700::INDX, 3};
+    t[0xE7] = {&SPC700::LDA, &SPC700::DPIX, 6};
+    t[0xE8] = {&SPC700::LDA, &SPC700::IMM, 2};
+    t[0xF4] = {&SPC700::LDA, &SPC700::DPX, 4};
+    t[0xF5] = {&SPC700::LDA, &SPC700::ABSX, 5};
+    t[0xF6] = {&SPC700::LDA, &SPC700::ABSY, 5};
+    t[0xF7] = {&SPC700::LDA, &SPC700::DPINY, 6};
+    t[0xBF] = {&SPC700::LDA, &SPC700::INDX_INC, 4};
+    t[0xCD] = {&SPC700::LDX, &SPC700::IMM, 2};
+    t[0xF8] = {&SPC700::LDX, &SPC700::DP, 3};
+    t[0xF9] = {&SPC700::LDX, &SPC700::DPY, 4};
+    t[0xE9] = {&SPC700::LDX, &SPC700::ABS, 4};
+    t[0x8D] = {&SPC700::LDY, &SPC700::IMM, 2};
+    t[0xEB] = {&SPC700::LDY, &SPC700::DP, 3};
+    t[0xFB] = {&SPC700::LDY, &SPC700::DPX, 4};
+    t[0xEC] = {&SPC700::LDY, &SPC700::ABS, 4};
+
+    // stores
+    t[0xC4] = {&SPC700::STA, &SPC700::DP, 4};
+    t[0xC5] = {&SPC700::STA, &SPC700::ABS, 5};
+    t[0xC6] = {&SPC700::STA, &SPC700::INDX, 4};
+    t[0xC7] = {&SPC700::STA, &SPC700::DPIX, 7};
+    t[0xD4] = {&SPC700::STA, &SPC700::DPX, 5};
+    t[0xD5] = {&SPC700::STA, &SPC700::ABSX, 6};
+    t[0xD6] = {&SPC700::STA, &SPC700::ABSY, 6};
+    t[0xD7] = {&SPC700::STA, &SPC700::DPINY, 7};
+    t[0xAF] = {&SPC700::STA, &SPC700::INDX_INC, 4};
+    t[0xD8] = {&SPC700::STX, &SPC700::DP, 4};
+    t[0xD9] = {&SPC700::STX, &SPC700::DPY, 5};
+    t[0xC9] = {&SPC700::STX, &SPC700::ABS, 5};
+    t[0xCB] = {&SPC700::STY, &SPC700::DP, 4};
+    t[0xDB] = {&SPC700::STY, &SPC700::DPX, 5};
+    t[0xCC] = {&SPC700::STY, &SPC700::ABS, 5};
+
+    // register and memory to memory moves
+    t[0x7D] = {&SPC700::TXA, &SPC700::IMP, 2};
+    t[0xDD] = {&SPC700::TYA, &SPC700::IMP, 2};
+    t[0x5D] = {&SPC700::TAX, &SPC700::IMP, 2};
+    t[0xFD] = {&SPC700::TAY, &SPC700::IMP, 2};
+    t[0x9D] = {&SPC700::TSX, &SPC700::IMP, 2};
+    t[0xBD] = {&SPC700::TXS, &SPC700::IMP, 2};
+    t[0xFA] = {&SPC700::MOV_DP, &SPC700::DP_DP, 5};
+    t[0x8F] = {&SPC700::MOV_DP, &SPC700::DP_IMM, 5};
+
+    // increments, decrements, shifts
+    t[0xAB] = {&SPC700::INC, &SPC700::DP, 4};
+    t[0xBB] = {&SPC700::INC, &SPC700::DPX, 5};
+    t[0xAC] = {&SPC700::INC, &SPC700::ABS, 5};
+    t[0xBC] = {&SPC700::INCA, &SPC700::IMP, 2};
+    t[0x3D] = {&SPC700::INX, &SPC700::IMP, 2};
+    t[0xFC] = {&SPC700::INY, &SPC700::IMP, 2};
+    t[0x8B] = {&SPC700::DEC, &SPC700::DP, 4};
+    t[0x9B] = {&SPC700::DEC, &SPC700::DPX, 5};
+    t[0x8C] = {&SPC700::DEC, &SPC700::ABS, 5};
+    t[0x9C] = {&SPC700::DECA, &SPC700::IMP, 2};
+    t[0x1D] = {&SPC700::DEX, &SPC700::IMP, 2};
+    t[0xDC] = {&SPC700::DEY, &SPC700::IMP, 2};
+
+    t[0x0B] = {&SPC700::ASL, &SPC700::DP, 4};
+    t[0x1B] = {&SPC700::ASL, &SPC700::DPX, 5};
+    t[0x0C] = {&SPC700::ASL, &SPC700::ABS, 5};
+    t[0x1C] = {&SPC700::ASLA, &SPC700::IMP, 2};
+    t[0x4B] = {&SPC700::LSR, &SPC700::DP, 4};
+    t[0x5B] = {&SPC700::LSR, &SPC700::DPX, 5};
+    t[0x4C] = {&SPC700::LSR, &SPC700::ABS, 5};
+    t[0x5C] = {&SPC700::LSRA, &SPC700::IMP, 2};
+    t[0x2B] = {&SPC700::ROL, &SPC700::DP, 4};
+    t[0x3B] = {&SPC700::ROL, &SPC700::DPX, 5};
+    t[0x2C] = {&SPC700::ROL, &SPC700::ABS, 5};
+    t[0x3C] = {&SPC700::ROLA, &SPC700::IMP, 2};
+    t[0x6B] = {&SPC700::ROR, &SPC700::DP, 4};
+    t[0x7B] = {&SPC700::ROR, &SPC700::DPX, 5};
+    t[0x6C] = {&SPC700::ROR, &SPC700::ABS, 5};
+    t[0x7C] = {&SPC700::RORA, &SPC700::IMP, 2};
+    t[0x9F] = {&SPC700::XCN, &SPC700::IMP, 5};
+
+    // 16-bit and multiply/divide
+    t[0xBA] = {&SPC700::MOVW, &SPC700::DP, 5};
+    t[0xDA] = {&SPC700::MOVW_DP, &SPC700::DP, 5};
+    t[0x3A] = {&SPC700::INCW, &SPC700::DP, 6};
+    t[0x1A] = {&SPC700::DECW, &SPC700::DP, 6};
+    t[0x7A] = {&SPC700::ADDW, &SPC700::DP, 5};
+    t[0x9A] = {&SPC700::SUBW, &SPC700::DP, 5};
+    t[0x5A] = {&SPC700::CMPW, &SPC700::DP, 4};
+    t[0xCF] = {&SPC700::MUL, &SPC700::IMP, 9};
+    t[0x9E] = {&SPC700::DIV, &SPC700::IMP, 12};
+    t[0xDF] = {&SPC700::DAA, &SPC700::IMP, 3};
+    t[0xBE] = {&SPC700::DAS, &SPC700::IMP, 3};
+
+    // branches, 2 more cycles when taken
+    t[0x2F] = {&SPC700::BRA, &SPC700::REL, 4};
+    t[0xF0] = {&SPC700::BEQ, &SPC700::REL, 2};
+    t[0xD0] = {&SPC700::BNE, &SPC700::REL, 2};
+    t[0xB0] = {&SPC700::BCS, &SPC700::REL, 2};
+    t[0x90] = {&SPC700::BCC, &SPC700::REL, 2};
+    t[0x70] = {&SPC700::BVS, &SPC700::REL, 2};
+    t[0x50] = {&SPC700::BVC, &SPC700::REL, 2};
+    t[0x30] = {&SPC700::BMI, &SPC700::REL, 2};
+    t[0x10] = {&SPC700::BPL, &SPC700::REL, 2};
+    t[0x2E] = {&SPC700::CBNE, &SPC700::DP_REL, 5};
+    t[0xDE] = {&SPC700::CBNE, &SPC700::DPX_REL, 6};
+    t[0x6E] = {&SPC700::DBNZ, &SPC700::DP_REL, 5};
+    t[0xFE] = {&SPC700::DBNZ_Y, &SPC700::REL, 4};
+
+    // direct page bits: SET1/BBS on even rows, CLR1/BBC on odd rows
+    t[0x02] = {&SPC700::SET1<0>, &SPC700::DP, 4};
+    t[0x22] = {&SPC700::SET1<1>, &SPC700::DP, 4};
+    t[0x42] = {&SPC700::SET1<2>, &SPC700::DP, 4};
+    t[0x62] = {&SPC700::SET1<3>, &SPC700::DP, 4};
+    t[0x82] = {&SPC700::SET1<4>, &SPC700::DP, 4};
+    t[0xA2] = {&SPC700::SET1<5>, &SPC700::DP, 4};
+    t[0xC2] = {&SPC700::SET1<6>, &SPC700::DP, 4};
+    t[0xE2] = {&SPC700::SET1<7>, &SPC700::DP, 4};
+    t[0x12] = {&SPC700::CLR1<0>, &SPC700::DP, 4};
+    t[0x32] = {&SPC700::CLR1<1>, &SPC700::DP, 4};
+    t[0x52] = {&SPC700::CLR1<2>, &SPC700::DP, 4};
+    t[0x72] = {&SPC700::CLR1<3>, &SPC700::DP, 4};
+    t[0x92] = {&SPC700::CLR1<4>, &SPC700::DP, 4};
+    t[0xB2] = {&SPC700::CLR1<5>, &SPC700::DP, 4};
+    t[0xD2] = {&SPC700::CLR1<6>, &SPC700::DP, 4};
+    t[0xF2] = {&SPC700::CLR1<7>, &SPC700::DP, 4};
+    t[0x03] = {&SPC700::BBS<0>, &SPC700::DP_REL, 5};
+    t[0x23] = {&SPC700::BBS<1>, &SPC700::DP_REL, 5};
+    t[0x43] = {&SPC700::BBS<2>, &SPC700::DP_REL, 5};
+    t[0x63] = {&SPC700::BBS<3>, &SPC700::DP_REL, 5};
+    t[0x83] = {&SPC700::BBS<4>, &SPC700::DP_REL, 5};
+    t[0xA3] = {&SPC700::BBS<5>, &SPC700::DP_REL, 5};
+    t[0xC3] = {&SPC700::BBS<6>, &SPC700::DP_REL, 5};
+    t[0xE3] = {&SPC700::BBS<7>, &SPC700::DP_REL, 5};
+    t[0x13] = {&SPC700::BBC<0>, &SPC700::DP_REL, 5};
+    t[0x33] = {&SPC700::BBC<1>, &SPC700::DP_REL, 5};
+    t[0x53] = {&SPC700::BBC<2>, &SPC700::DP_REL, 5};
+    t[0x73] = {&SPC700::BBC<3>, &SPC700::DP_REL, 5};
+    t[0x93] = {&SPC700::BBC<4>, &SPC700::DP_REL, 5};
+    t[0xB3] = {&SPC700::BBC<5>, &SPC700::DP_REL, 5};
+    t[0xD3] = {&SPC700::BBC<6>, &SPC700::DP_REL, 5};
+    t[0xF3] = {&SPC700::BBC<7>, &SPC700::DP_REL, 5};
+
+    // jumps and calls
+    t[0x5F] = {&SPC700::JMP, &SPC700::ABS, 3};
+    t[0x1F] = {&SPC700::JMP_IND, &SPC700::ABSX, 6};
+    t[0x3F] = {&SPC700::JSR, &SPC700::ABS, 8};
+    t[0x4F] = {&SPC700::PCALL, &SPC700::IMM, 6};
+    t[0x0F] = {&SPC700::BRK, &SPC700::IMP, 8};
+    t[0x6F] = {&SPC700::RTS, &SPC700::IMP, 5};
+    t[0x7F] = {&SPC700::RTI, &SPC700::IMP, 6};
+    t[0x01] = {&SPC700::TCALL<0>, &SPC700::IMP, 8};
+    t[0x11] = {&SPC700::TCALL<1>, &SPC700::IMP, 8};
+    t[0x21] = {&SPC700::TCALL<2>, &SPC700::IMP, 8};
+    t[0x31] = {&SPC700::TCALL<3>, &SPC700::IMP, 8};
+    t[0x41] = {&SPC700::TCALL<4>, &SPC700::IMP, 8};
+    t[0x51] = {&SPC700::TCALL<5>, &SPC700::IMP, 8};
+    t[0x61] = {&SPC700::TCALL<6>, &SPC700::IMP, 8};
+    t[0x71] = {&SPC700::TCALL<7>, &SPC700::IMP, 8};
+    t[0x81] = {&SPC700::TCALL<8>, &SPC700::IMP, 8};
+    t[0x91] = {&SPC700::TCALL<9>, &SPC700::IMP, 8};
+    t[0xA1] = {&SPC700::TCALL<10>, &SPC700::IMP, 8};
+    t[0xB1] = {&SPC700::TCALL<11>, &SPC700::IMP, 8};
+    t[0xC1] = {&SPC700::TCALL<12>, &SPC700::IMP, 8};
+    t[0xD1] = {&SPC700::TCALL<13>, &SPC700::IMP, 8};
+    t[0xE1] = {&SPC700::TCALL<14>, &SPC700::IMP, 8};
+    t[0xF1] = {&SPC700::TCALL<15>, &SPC700::IMP, 8};
+
+    // stack
+    t[0x2D] = {&SPC700::PHA, &SPC700::IMP, 4};
+    t[0x4D] = {&SPC700::PHX, &SPC700::IMP, 4};
+    t[0x6D] = {&SPC700::PHY, &SPC700::IMP, 4};
+    t[0x0D] = {&SPC700::PHP, &SPC700::IMP, 4};
+    t[0xAE] = {&SPC700::PLA, &SPC700::IMP, 4};
+    t[0xCE] = {&SPC700::PLX, &SPC700::IMP, 4};
+    t[0xEE] = {&SPC700::PLY, &SPC700::IMP, 4};
+    t[0x8E] = {&SPC700::PLP, &SPC700::IMP, 4};
+
+    // memory bits
+    t[0x0E] = {&SPC700::TSB, &SPC700::ABS, 6};
+    t[0x4E] = {&SPC700::TRB, &SPC700::ABS, 6};
+    t[0x4A] = {&SPC700::AND1, &SPC700::MEM_BIT, 4};
+    t[0x6A] = {&SPC700::AND1_N, &SPC700::MEM_BIT, 4};
+    t[0x0A] = {&SPC700::OR1, &SPC700::MEM_BIT, 5};
+    t[0x2A] = {&SPC700::OR1_N, &SPC700::MEM_BIT, 5};
+    t[0x8A] = {&SPC700::EOR1, &SPC700::MEM_BIT, 5};
+    t[0xEA] = {&SPC700::NOT1, &SPC700::MEM_BIT, 5};
+    t[0xAA] = {&SPC700::MOV1, &SPC700::MEM_BIT, 4};
+    t[0xCA] = {&SPC700::MOV1_REVERSE, &SPC700::MEM_BIT, 6};
+
+    // flags
+    t[0x60] = {&SPC700::CLC, &SPC700::IMP, 2};
+    t[0x80] = {&SPC700::SEC, &SPC700::IMP, 2};
+    t[0xED] = {&SPC700::NOTC, &SPC700::IMP, 3};
+    t[0xE0] = {&SPC700::CLV, &SPC700::IMP, 2};
+    t[0x20] = {&SPC700::CLRP, &SPC700::IMP, 2};
+    t[0x40] = {&SPC700::SETP, &SPC700::IMP, 2};
+    t[0xC0] = {&SPC700::CLI, &SPC700::IMP, 3};
+    t[0xA0] = {&SPC700::SEI, &SPC700::IMP, 3};
+
+    t[0x00] = {&SPC700::NOP, &SPC700::IMP, 2};
+    t[0xEF] = {&SPC700::STP, &SPC700::IMP, 3};
+    t[0xFF] = {&SPC700::STP, &SPC700::IMP, 3};
+
+    return t;
+}
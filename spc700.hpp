@@ -3,128 +3,118 @@
 
 #include "common.h"
 #include "aram.hpp"
+#include "trace.hpp"
 
-#include <map>
-#include <functional>
+#include <array>
+
+class SNES_STATE;
 
 class SPC700 {
 public:
+    SPC700(CPU_APU_IO* cpu_io, SNES_DSP* dsp);
+
     void init();
+    // one cycle at a time, the instruction executes on its first cycle
     bool clock();
+    // executes one whole instruction and returns the cycles it took (0 once stopped)
+    byte step();
+
+    bool isStopped() {return stopped;};
+
+    // executed instructions are traced under TRACE_APU at TRACE_VERBOSE when set
+    SNES_TRACER* tracer = nullptr;
+
+    // registers, then audio RAM and the dsp through the bus
+    void serialize(SNES_STATE& state);
 private:
     byte A;
     byte X;
     byte Y;
     byte SP;
-    byte PC;
-    byte PSW;
+    twobyte PC;
 
-    //
-	// operations (using 6502 syntax where possible)
-	//
+    // PSW, kept unpacked. each flag is 0 or 1
+    byte n, v, p, b, h, i, z, c;
+    byte getPSW();
+    void setPSW(byte psw);
 
-    // todo: update comments to describe _X, _DP, and _X_POSTINC
+    void setNZ(byte value) {n = value >> 7; z = (value == 0);};
+    void setNZ16(twobyte value) {n = value >> 15; z = (value == 0);};
 
-    void LDA();
-    void LDA_X(); void LDA_X_POSTINC();
-    void LDX(); void LDY();
+    //
+    // operations (using 6502 syntax where possible)
+    //
 
-    void STA();
-    void STA_X(); void STA_X_POSTINC();
-    void STX(); void STY();
+    // register and memory moves. ops work on dest_addr as computed by the mode,
+    // the _DP variants are memory to memory with the source at src_addr
+    void LDA(); void LDX(); void LDY();
+    void STA(); void STX(); void STY();
 
     void TXA(); void TYA();
     void TAX(); void TAY();
     void TSX(); void TXS();
     void MOV_DP();
 
-    void ADC();
-    void ADC_X(); void ADC_DP();
-
-    void SBC();
-    void SBC_X(); void SBC_DP();
-
-    void CMP();
-    void CMP_X(); void CMP_DP();
+    // alu ops on A, and memory to memory
+    void ORA(); void ORA_DP();
+    void AND(); void AND_DP();
+    void EOR(); void EOR_DP();
+    void ADC(); void ADC_DP();
+    void SBC(); void SBC_DP();
+    void CMP(); void CMP_DP();
 
     void CPX(); void CPY();
 
-    void AND();
-    void AND_X(); void AND_DP();
-
-    void ORA();
-    void ORA_X(); void ORA_DP();
-
-    void EOR();
-    void EOR_X(); void EOR_DP();
-
-    void INC();
-    void INCA(); void INX(); void INY();
-
-    void DEC();
-    void DECA(); void DEX(); void DEY();
+    void INC(); void INCA(); void INX(); void INY();
+    void DEC(); void DECA(); void DEX(); void DEY();
 
-    void ASL();
-    void ASLA();
-
-    void LSR();
-    void LSRA();
-
-    void ROL();
-    void ROLA();
-
-    void ROR();
-    void RORA();
+    void ASL(); void ASLA();
+    void LSR(); void LSRA();
+    void ROL(); void ROLA();
+    void ROR(); void RORA();
 
     void XCN();
 
-    void MOVW();
-    void MOVW_DP();
-
+    // 16-bit ops on YA and a direct page word
+    void MOVW(); void MOVW_DP();
     void INCW(); void DECW();
-
     void ADDW(); void SUBW(); void CMPW();
 
     void MUL(); void DIV();
 
     void DAA(); void DAS();
 
+    // branches take rel from the mode and add 2 cycles when taken
     void BRA();
     void BEQ(); void BNE();
     void BCS(); void BCC();
     void BVS(); void BVC();
     void BMI(); void BPL();
 
-    void BBS0(); void BBS1(); void BBS2(); void BBS3();
-    void BBS4(); void BBS5(); void BBS6(); void BBS7();
-
-    void BBC0(); void BBC1(); void BBC2(); void BBC3();
-    void BBC4(); void BBC5(); void BBC6(); void BBC7();
+    // bit number in the opcode's top 3 bits
+    template<int B> void BBS();
+    template<int B> void BBC();
+    template<int B> void SET1();
+    template<int B> void CLR1();
 
     void CBNE();
-    void CBNE_X();
     void DBNZ();
     void DBNZ_Y();
 
-    void JMP();
+    void JMP(); void JMP_IND();
 
     void JSR();
     void PCALL();
-    void TCALL();
+    template<int N> void TCALL();
 
     void BRK(); void RTS(); void RTI();
 
     void PHA(); void PHX(); void PHY(); void PHP();
     void PLA(); void PLX(); void PLY(); void PLP();
 
-    void SMB0(); void SMB1(); void SMB2(); void SMB3();
-    void SMB4(); void SMB5(); void SMB6(); void SMB7();
-
-    void RMB0(); void RMB1(); void RMB2(); void RMB3();
-    void RMB4(); void RMB5(); void RMB6(); void RMB7();
-
     void TSB(); void TRB();
 
+    // carry and memory bit ops, bit and address from MEM_BIT
     void AND1(); void AND1_N();
     void OR1(); void OR1_N();
     void EOR1();
@@ -137,69 +127,84 @@ private:
     void CLI(); void SEI();
 
     void NOP() {}
-    void WAI();
     void STP();
 
     //
     // addressing modes
     //
 
-    // immediate
+    // immediate: dest_addr points at the operand byte
     void IMM();
 
-    // direct page
-    void DP();
-    void DP_DP(); void DP_IMM();
+    // direct page, on page 0 or 1 depending on P
+    void DP(); void DPX(); void DPY();
+    // memory to memory: d,s / d,#imm / (X),(Y)
+    void DP_DP(); void DP_IMM(); void IND_XY();
 
     // absolute
-    void ABS();
+    void ABS(); void ABSX(); void ABSY();
+
+    // (X), (X)+, [d+X], [d]+Y
+    void INDX(); void INDX_INC();
+    void DPIX(); void DPINY();
 
     // relative offset
     void REL();
 
-    // direct page relative
-    void DP_REL_X(); void DP_REL_Y();
+    // direct page then relative offset: for BBS/BBC, CBNE and DBNZ
+    void DP_REL(); void DPX_REL();
 
     // special mode for bit operations:
-    // high 3 bits are target bit, remaining 15 bits are address to fetch data from
+    // high 3 bits are target bit, remaining 13 bits are address to fetch data from
     void MEM_BIT();
 
     // implied
     void IMP() {}
 
-    // flags
-	union {
-		struct {
-			char c : 1;
-			char z : 1;
-			char i : 1;
-			char d : 1;
-			char x : 1;
-			char m : 1;
-			char v : 1;
-			char n : 1;
-		} bits;
-		char full;
-	} status;
-
-    byte fetched;
+    // utils
+    twobyte dp(byte addr) {return (p << 8) | addr;};
+    byte fetch8() {return ram.read8(PC++);};
+    twobyte fetch16();
+    twobyte read16(twobyte addr);
+    // words in the direct page wrap around within the page
+    twobyte readWord(twobyte addr);
+    void writeWord(twobyte addr, twobyte value);
+    twobyte getYA() {return (Y << 8) | A;};
+    void push(byte value) {ram.write8(0x0100 | SP--, value);};
+    byte pull() {return ram.read8(0x0100 | ++SP);};
+    void pushPC();
+    void branch(bool taken);
+
+    byte adc(byte a, byte m);
+    byte sbc(byte a, byte m) {return adc(a, ~m);};
+    void compare(byte a, byte m);
+    byte asl(byte value);
+    byte lsr(byte value);
+    byte rol(byte value);
+    byte ror(byte value);
+
     twobyte dest_addr;
+    twobyte src_addr;
+    signedbyte rel;
     // used for testing/setting specified bit of data
     byte data_bit;
 
-    typedef struct {
-		std::string name;
-
-		std::function<void()> op;
-		std::function<void()> mode;
-		std::function<byte()> cycleCount;
-	} instruction;
-
-    std::map<byte, instruction> ops {
+    // extra cycles taken by the last instruction (branches)
+    byte extra_cycles = 0;
+    byte cyclesRemaining = 0;
+    bool stopped = false;
 
+    typedef void (SPC700::*handler)();
+    struct instruction {
+        handler op;
+        handler mode;
+        byte cycles;
     };
 
+    static const std::array<instruction, 256> ops;
+    static std::array<instruction, 256> buildOps();
+
     SNES_ARAM ram;
 };
 
-#endif //_SPC700_H
\ No newline at end of file
+#endif //_SPC700_H
@@ -0,0 +1,99 @@
+#include "common.h"
+
+#include "state.hpp"
+
+#include <string.h>
+
+SNES_STATE::SNES_STATE(byte* buffer, size_t capacity) : out(buffer), capacity(capacity) {
+	pos = sizeof(SNES_STATE_HEADER);
+	if(out && capacity < pos) good = false;
+}
+
+SNES_STATE::SNES_STATE(const byte* buffer, size_t size) : in(buffer), capacity(size) {
+	pos = sizeof(SNES_STATE_HEADER);
+
+	SNES_STATE_HEADER header;
+	if(!in || size < sizeof(header)) {
+		good = false;
+		return;
+	}
+	memcpy(&header, in, sizeof(header));
+	if(header.magic != STATE_FILE_MAGIC || header.version != STATE_FILE_VERSION || header.size > size)
+		good = false;
+	else
+		capacity = header.size;
+}
+
+size_t SNES_STATE::finish() {
+	if(!good) return 0;
+	if(out) {
+		SNES_STATE_HEADER header = {STATE_FILE_MAGIC, STATE_FILE_VERSION, (uint32_t)pos, 0};
+		memcpy(out, &header, sizeof(header));
+	}
+	return pos;
+}
+
+uint32_t SNES_STATE::begin(uint32_t tag, uint32_t version) {
+	if(!good) return 0;
+
+	SNES_STATE_CHUNK chunk;
+	if(!loading()) {
+		chunk_start = pos;
+		pos += sizeof(chunk);
+		if(out && pos > capacity) {
+			good = false;
+			return 0;
+		}
+		chunk = {tag, version, 0, 0};
+		if(out) memcpy(out + chunk_start, &chunk, sizeof(chunk));
+		return version;
+	}
+
+	// chunks are few, look from the start every time
+	for(size_t at = sizeof(SNES_STATE_HEADER); at + sizeof(chunk) <= capacity; at += sizeof(chunk) + chunk.size) {
+		memcpy(&chunk, in + at, sizeof(chunk));
+		if(chunk.size > capacity - at - sizeof(chunk)) break;
+		if(chunk.tag != tag) continue;
+
+		// written by a newer version of the component
+		if(chunk.version > version || chunk.version == 0) break;
+		chunk_start = pos = at + sizeof(chunk);
+		chunk_end = chunk_start + chunk.size;
+		return chunk.version;
+	}
+	good = false;
+	return 0;
+}
+
+void SNES_STATE::end() {
+	if(!good) return;
+
+	if(loading()) {
+		// what was read has to be the whole chunk
+		if(pos != chunk_end) good = false;
+		return;
+	}
+	if(out) {
+		uint32_t size = pos - chunk_start - sizeof(SNES_STATE_CHUNK);
+		memcpy(out + chunk_start + offsetof(SNES_STATE_CHUNK, size), &size, sizeof(size));
+	}
+}
+
+void SNES_STATE::bytes(void* data, size_t size) {
+	if(!good) return;
+
+	if(loading()) {
+		if(pos + size > chunk_end) {
+			good = false;
+			return;
+		}
+		memcpy(data, in + pos, size);
+	} else if(out) {
+		if(pos + size > capacity) {
+			good = false;
+			return;
+		}
+		memcpy(out + pos, data, size);
+	}
+	pos += size;
+}
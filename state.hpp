@@ -0,0 +1,75 @@
+#ifndef _STATE_H
+#define _STATE_H
+
+#include "common.h"
+
+#include <stddef.h>
+#include <array>
+
+#define STATE_FILE_MAGIC	0x54534E53	// "SNST"
+#define STATE_FILE_VERSION	1
+
+// four characters, e.g. STATE_TAG('C', 'P', 'U', ' ')
+#define STATE_TAG(a, b, c, d)	((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+struct SNES_STATE_HEADER {
+	uint32_t magic;
+	uint32_t version;
+	// header and chunks
+	uint32_t size;
+	uint32_t reserved;
+};
+
+// every chunk starts with this, followed by size bytes of fields
+struct SNES_STATE_CHUNK {
+	uint32_t tag;
+	uint32_t version;
+	uint32_t size;
+	uint32_t reserved;
+};
+
+// a save state: a header and one chunk per component, each with its own
+// version. fields are stored in host byte order, as they are in memory.
+//
+// components have one serialize() for both directions, which wraps its
+// fields in begin()/end() and hands them to value()/bytes(). saving writes
+// into the caller's buffer and never allocates, so states can be taken every
+// frame. loading finds chunks by tag, in any order, skipping ones it doesn't
+// know. anything that doesn't fit (short buffer, missing chunk, chunk newer
+// than the code or of the wrong size) fails the whole state
+class SNES_STATE {
+public:
+	// saves into buffer, or only counts the bytes needed when it is null
+	SNES_STATE(byte* buffer, size_t capacity);
+	// loads from buffer
+	SNES_STATE(const byte* buffer, size_t size);
+
+	bool loading() {return in != nullptr;};
+	bool ok() {return good;};
+	// a component found something it can't load, e.g. a different ROM
+	void fail() {good = false;};
+	// finishes a saved state, returns its size or 0 if it failed
+	size_t finish();
+
+	// starts a chunk. returns the version to read (the saved one when
+	// loading), 0 if there is none to read
+	uint32_t begin(uint32_t tag, uint32_t version);
+	void end();
+	// loading, goes back to the start of the current chunk to read it again
+	void rewind() {pos = chunk_start;};
+
+	void bytes(void* data, size_t size);
+	template<typename T> void value(T& v) {bytes(&v, sizeof(v));};
+	template<typename T, size_t N> void value(std::array<T, N>& a) {bytes(a.data(), sizeof(T) * N);};
+private:
+	byte* out = nullptr;
+	const byte* in = nullptr;
+	size_t capacity;
+	size_t pos;
+	// payload of the current chunk
+	size_t chunk_start = 0;
+	size_t chunk_end = 0;
+	bool good = true;
+};
+
+#endif //_STATE_H
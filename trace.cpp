@@ -0,0 +1,102 @@
+#include "common.h"
+
+#include "trace.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+static const char* category_names[TRACE_CATEGORIES] = {"cpu", "mem", "apu"};
+
+SNES_TRACER::SNES_TRACER(size_t capacity) : head(0), tail(0), running(false) {
+	size_t size = 1;
+	while(size < capacity) size <<= 1;
+	ring.resize(size);
+	mask = size - 1;
+
+	for(int i = 0; i < TRACE_CATEGORIES; i++)
+		levels[i] = TRACE_OFF;
+}
+
+SNES_TRACER::~SNES_TRACER() {
+	close();
+}
+
+bool SNES_TRACER::configure(const std::string& spec) {
+	std::stringstream ss(spec);
+	std::string item;
+	while(std::getline(ss, item, ',')) {
+		size_t eq = item.find('=');
+		std::string name = item.substr(0, eq);
+		int level = (eq == std::string::npos) ? TRACE_INFO : atoi(item.c_str() + eq + 1);
+
+		bool found = false;
+		for(int i = 0; i < TRACE_CATEGORIES; i++) {
+			if(name == category_names[i] || name == "all") {
+				levels[i] = level;
+				found = true;
+			}
+		}
+		if(!found) {
+			std::cout << "trace: unknown category " << name << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SNES_TRACER::open(const std::string& filename) {
+	close();
+
+	out = fopen(filename.c_str(), "wb");
+	if(!out) {
+		std::cout << "trace: could not open " << filename << std::endl;
+		return false;
+	}
+
+	SNES_TRACE_FILE_HEADER header = {TRACE_FILE_MAGIC, TRACE_FILE_VERSION, sizeof(SNES_TRACE_RECORD), 0};
+	fwrite(&header, sizeof(header), 1, out);
+
+	running = true;
+	writer = std::thread(&SNES_TRACER::writerLoop, this);
+	return true;
+}
+
+void SNES_TRACER::close() {
+	if(!out) return;
+
+	running = false;
+	writer.join();
+	drain();
+
+	fclose(out);
+	out = nullptr;
+
+	if(m_dropped)
+		std::cout << "trace: ring buffer overflowed, dropped " << m_dropped << " records" << std::endl;
+}
+
+// consumer side: writes out everything published so far
+size_t SNES_TRACER::drain() {
+	size_t t = tail.load(std::memory_order_relaxed);
+	size_t h = head.load(std::memory_order_acquire);
+	size_t count = h - t;
+
+	while(t != h) {
+		// write contiguous runs up to the end of the ring
+		size_t start = t & mask;
+		size_t run = std::min(h - t, ring.size() - start);
+		fwrite(&ring[start], sizeof(SNES_TRACE_RECORD), run, out);
+		t += run;
+	}
+
+	tail.store(t, std::memory_order_release);
+	return count;
+}
+
+void SNES_TRACER::writerLoop() {
+	while(running) {
+		if(drain() == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
@@ -0,0 +1,142 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "common.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// trace points are compiled in only when building with -DSNES_TRACE (make debug).
+// in release builds TRACE() expands to nothing and its arguments are never evaluated
+#ifdef SNES_TRACE
+#define TRACE(tracer, category, level, event, ...) \
+	do { \
+		if((tracer) && (tracer)->enabled(category, level)) \
+			(tracer)->record(category, event, __VA_ARGS__); \
+	} while(0)
+#else
+#define TRACE(tracer, category, level, event, ...) do {} while(0)
+#endif
+
+enum trace_category : byte {
+	TRACE_CPU,
+	TRACE_MEM,
+	TRACE_APU,
+	TRACE_CATEGORIES
+};
+
+enum trace_level : byte {
+	TRACE_OFF,
+	TRACE_INFO,
+	TRACE_VERBOSE
+};
+
+enum trace_event : byte {
+	// arg16: opcode, args: K:PC, C, X, Y, S | D << 16, P | e << 8 | DBR << 16
+	TRACE_EV_OPCODE,
+	// args: address, value
+	TRACE_EV_READ8,
+	TRACE_EV_READ16,
+	TRACE_EV_READ24,
+	TRACE_EV_WRITE8,
+	TRACE_EV_WRITE16,
+	// arg16: opcode, args: PC, A, X, Y, SP, PSW
+	TRACE_EV_SPC_OPCODE,
+	// arg16: 0 from the cpu's side, 1 from the apu's, args: port, value
+	TRACE_EV_PORT_WRITE,
+	TRACE_EV_PORT_READ
+};
+
+// fixed-size binary record, written to the trace file as is
+struct SNES_TRACE_RECORD {
+	uint64_t time;
+	byte category;
+	byte event;
+	twobyte arg16;
+	uint32_t args[6];
+};
+
+#define TRACE_FILE_MAGIC	0x52544E53	// "SNTR"
+#define TRACE_FILE_VERSION	1
+
+struct SNES_TRACE_FILE_HEADER {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t reserved;
+};
+
+// collects trace records from one emulation thread into a lock-free
+// single-producer/single-consumer ring. a writer thread drains the ring into
+// a binary file, which tracefmt turns into text offline
+class SNES_TRACER {
+public:
+	SNES_TRACER(size_t capacity = 1 << 16);
+	~SNES_TRACER();
+
+	void setLevel(trace_category category, trace_level level) {levels[category] = level;};
+	// spec is a comma separated list of category=level, e.g. "cpu=1,mem=2"
+	bool configure(const std::string& spec);
+
+	// starts draining records into filename
+	bool open(const std::string& filename);
+	void close();
+
+	// records are timestamped from clock when one is set, otherwise numbered
+	void setClock(const uint64_t* clock) {this->clock = clock;};
+
+	bool enabled(byte category, byte level) {return levels[category] >= level;};
+	void record(byte category, byte event, twobyte arg16, uint32_t arg0 = 0, uint32_t arg1 = 0,
+		uint32_t arg2 = 0, uint32_t arg3 = 0, uint32_t arg4 = 0, uint32_t arg5 = 0);
+
+	uint64_t dropped() {return m_dropped;};
+private:
+	SNES_TRACER(const SNES_TRACER&) = delete;
+	SNES_TRACER& operator=(const SNES_TRACER&) = delete;
+
+	size_t drain();
+	void writerLoop();
+
+	byte levels[TRACE_CATEGORIES];
+	const uint64_t* clock = nullptr;
+	uint64_t sequence = 0;
+	uint64_t m_dropped = 0;
+
+	std::vector<SNES_TRACE_RECORD> ring;
+	size_t mask;
+	// head is only written by the producer, tail only by the consumer
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+
+	FILE* out = nullptr;
+	std::thread writer;
+	std::atomic<bool> running;
+};
+
+inline void SNES_TRACER::record(byte category, byte event, twobyte arg16, uint32_t arg0, uint32_t arg1,
+	uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5) {
+	size_t h = head.load(std::memory_order_relaxed);
+	if(h - tail.load(std::memory_order_acquire) > mask) {
+		m_dropped++;
+		return;
+	}
+
+	SNES_TRACE_RECORD& r = ring[h & mask];
+	r.time = clock ? *clock : sequence++;
+	r.category = category;
+	r.event = event;
+	r.arg16 = arg16;
+	r.args[0] = arg0;
+	r.args[1] = arg1;
+	r.args[2] = arg2;
+	r.args[3] = arg3;
+	r.args[4] = arg4;
+	r.args[5] = arg5;
+
+	head.store(h + 1, std::memory_order_release);
+}
+
+#endif //_TRACE_H
@@ -0,0 +1,79 @@
+#include "common.h"
+
+#include "trace.hpp"
+#include "cpu.hpp"
+
+#include <stdio.h>
+
+// offline formatter for the binary traces written by SNES_TRACER
+//   usage: tracefmt [snes.trace]
+
+static void printRecord(const SNES_TRACE_RECORD& r) {
+	printf("%10llu  ", (unsigned long long)r.time);
+
+	switch(r.event) {
+		case TRACE_EV_OPCODE:
+			printf("cpu  %02X:%04X  %02X %s  A=%04X X=%04X Y=%04X S=%04X D=%04X DB=%02X P=%02X e=%u\n",
+				r.args[0] >> 16, r.args[0] & 0xFFFF, r.arg16, SNES_CPU::mnemonic(r.arg16),
+				r.args[1], r.args[2], r.args[3], r.args[4] & 0xFFFF, r.args[4] >> 16,
+				(r.args[5] >> 16) & 0xFF, r.args[5] & 0xFF, (r.args[5] >> 8) & 1);
+			break;
+		case TRACE_EV_READ8:
+			printf("mem  read8   $%02X at 0x%06X\n", r.args[1], r.args[0]);
+			break;
+		case TRACE_EV_READ16:
+			printf("mem  read16  $%04X at 0x%06X\n", r.args[1], r.args[0]);
+			break;
+		case TRACE_EV_READ24:
+			printf("mem  read24  $%06X at 0x%06X\n", r.args[1], r.args[0]);
+			break;
+		case TRACE_EV_WRITE8:
+			printf("mem  write8  $%02X to 0x%06X\n", r.args[1], r.args[0]);
+			break;
+		case TRACE_EV_WRITE16:
+			printf("mem  write16 $%04X to 0x%06X\n", r.args[1], r.args[0]);
+			break;
+		case TRACE_EV_SPC_OPCODE:
+			printf("apu  %04X  %02X  A=%02X X=%02X Y=%02X SP=%02X PSW=%02X\n",
+				r.args[0], r.arg16, r.args[1], r.args[2], r.args[3], r.args[4], r.args[5]);
+			break;
+		case TRACE_EV_PORT_WRITE:
+			printf("apu  %s writes $%02X to port %u\n", r.arg16 ? "apu" : "cpu", r.args[1], r.args[0]);
+			break;
+		case TRACE_EV_PORT_READ:
+			printf("apu  %s reads $%02X from port %u\n", r.arg16 ? "apu" : "cpu", r.args[1], r.args[0]);
+			break;
+		default:
+			printf("unknown event %u (category %u)\n", r.event, r.category);
+			break;
+	}
+}
+
+int main(int argc, char** argv) {
+	const char* filename = argc > 1 ? argv[1] : "snes.trace";
+	FILE* in = fopen(filename, "rb");
+	if(!in) {
+		fprintf(stderr, "tracefmt: could not open %s\n", filename);
+		return 1;
+	}
+
+	SNES_TRACE_FILE_HEADER header;
+	if(fread(&header, sizeof(header), 1, in) != 1 || header.magic != TRACE_FILE_MAGIC) {
+		fprintf(stderr, "tracefmt: %s is not a trace file\n", filename);
+		return 1;
+	}
+	if(header.version != TRACE_FILE_VERSION || header.record_size != sizeof(SNES_TRACE_RECORD)) {
+		fprintf(stderr, "tracefmt: unsupported trace version %u\n", header.version);
+		return 1;
+	}
+
+	SNES_TRACE_RECORD records[1024];
+	size_t count;
+	while((count = fread(records, sizeof(SNES_TRACE_RECORD), 1024, in)) > 0) {
+		for(size_t i = 0; i < count; i++)
+			printRecord(records[i]);
+	}
+
+	fclose(in);
+	return 0;
+}